@@ -497,12 +497,38 @@ set ::ns_configdoc::data {
             cachemaxsize {
                 type size
                 default {10MB}
-                desc {Maximum total memory used by the fastpath file-content cache; applies only when the fastpath cache parameter is enabled}
+                desc {Maximum total memory used by the fastpath file-content cache; applies only when the fastpath cache parameter is enabled; in cachemode mmap, the total size of the mapped files}
+            }
+            cachemaxfiles {
+                type integer
+                default {1024}
+                desc {Maximum number of files in the fastpath cache in cachemode mmap (rounded up to a power of two)}
+            }
+            cachemode {
+                type enum
+                values {copy mmap}
+                default {copy}
+                desc {Mode of the fastpath cache: "copy" keeps copies of the file contents in a locked cache; "mmap" maps the files read-only and serves them from the mapping, adding an ETag header and honoring If-None-Match. Lookups are not lock-free: a lookup takes the lock of one of 64 lock stripes and pins the mapping with a reference count; files not used recently are evicted when cachemaxsize is reached. Responses sent via writer threads are copied from the mapping into the writer buffer. In mmap mode, files should be replaced (e.g., via rename) rather than truncated in place}
             }
             cachemaxentry {
                 type size
                 default {8KB}
-                desc {Maximum size of an individual static file stored in the fastpath cache; files above this limit are not cached and are served directly from the filesystem or via mmap when enabled}
+                desc {Maximum size of an individual static file stored in the fastpath cache; files above this limit are not cached and are served directly from the filesystem or via mmap when enabled (default in cachemode mmap: 1MB)}
+            }
+            compresscache {
+                type boolean
+                default false
+                desc {Enable the global cache of compressed variants; static files with a compressible MIME type (text, JavaScript, JSON, XML, SVG) are compressed once per content-encoding and level and validated against file mtime, size, device, and inode; dynamic responses with a strong ETag are cached under the URL and ETag. The content-encoding is chosen via compressformats of the server}
+            }
+            compresscachemaxentry {
+                type size
+                default {1MB}
+                desc {Maximum size of the uncompressed content of a compressed variant; larger files and responses are not cached}
+            }
+            compresscachemaxsize {
+                type size
+                default {10MB}
+                desc {Maximum total memory used by the cache of compressed variants}
             }
             gzip_cmd {
                 type command
@@ -607,6 +633,11 @@ set ::ns_configdoc::data {
                 default {bin}
                 desc {Name of the directory used for loading binary libraries or executables such as nsproxy workers; relative paths are resolved against the home directory}
             }
+            blueprintdeltas {
+                type integer
+                default {10}
+                desc {Number of epochs for which the changes of the Tcl interpreter blueprint are kept for incremental interpreter updates; 0 means that interpreters always replay the full blueprint}
+            }
             cachingmode {
                 type enum
                 values {full none}
@@ -831,6 +862,30 @@ set ::ns_configdoc::data {
                 default false
                 desc {Serialize Tcl interpreter initialization; usually disabled, but useful when debugging rare initialization crashes or when running under tools such as valgrind}
             }
+            tlssessioncache {
+                type boolean
+                default true
+                desc {Use a process-wide TLS session cache and rotating session-ticket keys shared by all TLS drivers; when disabled, every TLS context uses the OpenSSL internal session cache}
+            }
+            tlssessioncachesize {
+                type integer
+                default 20000
+                desc {Maximum number of TLS sessions kept in the shared session cache}
+            }
+            tlssessionfile {
+                type path
+                desc {File for persisting the TLS session-ticket keys and cached sessions across restarts; written with mode 0600, since it contains secret key material}
+            }
+            tlssessiontimeout {
+                type time
+                default {2h}
+                desc {Lifetime of TLS sessions and session tickets}
+            }
+            tlsticketkeyrotation {
+                type time
+                default {12h}
+                desc {Interval for rotating the TLS session-ticket key; tickets issued with the two previous keys are still accepted and renewed}
+            }
             tmpdir {
                 type path
                 desc {Directory for temporary files; when unset, NaviServer uses the TMPDIR environment variable or the system default temporary directory, with a trailing slash removed}
@@ -1022,7 +1077,17 @@ set ::ns_configdoc::data {
             compressenable {
                 type boolean
                 default false
-                desc {Enable gzip compression for eligible dynamic responses by default; individual requests can still control compression via ns_conn compress}
+                desc {Enable compression for eligible dynamic responses by default; individual requests can still control compression via ns_conn compress}
+            }
+            compressbrotlilevel {
+                type {integer 1-11}
+                default {5}
+                desc {Compression level for the brotli (br) content-encoding}
+            }
+            compressformats {
+                type list
+                default {gzip}
+                desc {Content-encodings for dynamic responses in order of preference; the first format accepted by the client is used (supported: gzip, br, zstd, depending on the build)}
             }
             compresslevel {
                 type {integer 1-9}
@@ -1039,6 +1104,11 @@ set ::ns_configdoc::data {
                 default false
                 desc {Preallocate compression buffers at startup}
             }
+            compresszstdlevel {
+                type {integer 1-19}
+                default {3}
+                desc {Compression level for the zstd content-encoding}
+            }
             connectionratelimit {
                 type size
                 default 0
@@ -1450,6 +1520,11 @@ stops execution of that ADP page}
                 default false
                 desc {Trim whitespace from output buffer}
             }
+            watchfiles {
+                type boolean
+                default false
+                desc {Detect changes of ADP files via file system notifications (inotify) instead of calling stat() on every evaluation of a cached page; only available on Linux}
+            }
         }
 
         ns/server/*/fastpath {
@@ -1483,6 +1558,11 @@ stops execution of that ADP page}
                 default {_ns_dirlist}
                 desc {Tcl procedure used to generate directory listings when no directory index file is found and directory listing is enabled}
             }
+            fastlane {
+                type list
+                default {}
+                desc {List of URL prefixes (e.g., "/images /assets") for which requests of static files are delivered directly by the driver thread via a writer thread, without passing through a connection thread. Applies only to GET and HEAD requests handled by the fastpath without registered filters or request authorization procs (e.g., as registered by nsperm) on servers without virtual hosting; conditional (If-Modified-Since) and single range requests are handled as well. Other requests, files subject to compression, directories and missing files are processed as usual. Requires writer threads for the driver}
+            }
             pagedir {
                 type path
                 default {pages}
@@ -2146,6 +2226,11 @@ stops execution of that ADP page}
                 default 2s
                 desc {Timeout when closing the socket}
             }
+            cpuaffinity {
+                type boolean
+                default false
+                desc {Bind every driver thread to its own CPU and its connection threads to a shard of neighboring CPUs; requests are handed preferably to idle connection threads of the same shard, threads of other shards are used only when the own shard has none idle (Linux only); intended for use with driverthreads set to the number of sockets or NUMA nodes}
+            }
             defaultserver {
                 type string
                 desc {Default virtual server used for requests accepted by this driver when no more specific host or SNI based mapping selects another server}
@@ -2228,6 +2313,11 @@ stops execution of that ADP page}
                 default true
                 desc {Enable TCP_NODELAY on accepted sockets, disabling Nagle's algorithm; useful for reducing latency, while false leaves Nagle's algorithm enabled}
             }
+            pollbackend {
+                type string
+                default poll
+                desc {Event notification backend of the driver and spooler threads; "poll" rebuilds the set of monitored sockets on every wakeup, "epoll" (Linux only) registers sockets once and keeps idle keep-alive connections out of the per-wakeup processing, useful for servers with many idle connections}
+            }
 
             port {
                 type list
@@ -2272,12 +2362,22 @@ stops execution of that ADP page}
                 default {8kB}
                 desc {Buffer size for writer threads}
             }
+            writermaxbufsize {
+                type size
+                default {1MB}
+                desc {Upper limit for the amount of file data sent per operation when a writer thread sends a single file directly (see writersendfile). Starting with writerbufsize, the amount grows while the socket accepts all data and shrinks after partial sends}
+            }
 
             writerratelimit {
                 type integer
                 default 0
                 desc {Maximum outgoing bandwidth per connection in kilobytes per second for responses sent through writer threads; 0 disables driver-level rate limiting, while limits set per connection or per connection pool override this value}
             }
+            writersendfile {
+                type boolean
+                default true
+                desc {Send single regular files in writer threads directly from the file instead of reading the content into the writer buffer, via the sendfile support of the driver: on plain connections via sendfile(), on TLS connections with kernel TLS via SSL_sendfile(), otherwise the file is read with pread() in blocks of one TLS record (16KB) and encrypted without using the writer buffer}
+            }
             writersize {
                 type size
                 default {1MB}
@@ -2291,7 +2391,7 @@ stops execution of that ADP page}
             writerthreads {
                 type integer
                 default 0
-                desc {Number of writer threads for this network driver; 0 disables writer threads}
+                desc {Number of writer threads for this network driver; 0 disables writer threads. Writer jobs are distributed over the threads in round robin order, the jobs of a socket stay on one thread; each thread has its own queue, poll set and bandwidth accounting}
             }
         }
 
@@ -2357,6 +2457,11 @@ stops execution of that ADP page}
                 default false
                 desc {Add the persist flag to the HTTP/3 Alt-Svc advertisement, indicating that clients may keep using the advertised HTTP/3 alternative across network changes}
             }
+            ktls {
+                type boolean
+                default false
+                desc {Enable kernel TLS (kTLS) offload when supported by OpenSSL and the operating system; files are then sent via sendfile without copying them through user space, otherwise the driver falls back to user-space encryption}
+            }
             key {
                 type path
                 desc {Private key file in PEM format; optional when the private key is included in the certificate file; relative paths are resolved against the certificates directory below the home directory}
@@ -2623,6 +2728,12 @@ stops execution of that ADP page}
                 }
             }
 
+            asyncflush {
+                type boolean
+                default false
+                desc {Append access log entries to per-thread buffers, which are written by a background flusher thread; removes the log lock and the write operation from connection threads}
+            }
+
             checkforproxy {
                 type boolean
                 default false
@@ -2647,6 +2758,18 @@ stops execution of that ADP page}
                 desc {Access log file written by this nslog instance; relative paths are resolved against the server log directory}
             }
 
+            flushinterval {
+                type time
+                default 1s
+                desc {Interval for writing the per-thread buffers when asyncflush is enabled}
+            }
+
+            flushsize {
+                type size
+                default 64KB
+                desc {Size of a per-thread buffer triggering an early flush when asyncflush is enabled}
+            }
+
             formattedtime {
                 type boolean
                 default true
@@ -2699,6 +2822,17 @@ stops execution of that ADP page}
                 default 0
                 desc {Number of log entries buffered}
             }
+            maxqueued {
+                type size
+                default 4MB
+                desc {Maximum amount of buffered but not yet written log data when asyncflush is enabled; when reached, the overflow policy applies}
+            }
+            overflow {
+                type enum
+                values {block drop}
+                default {block}
+                desc {Policy when maxqueued is reached: "block" waits for the flusher thread, "drop" discards the entry and counts it in "ns_accesslog stats"}
+            }
             rollfmt {
                 type string
                 desc {Suffix format used when rotating the access log file; controls how timestamps are appended to rolled log filenames}
@@ -89,6 +89,7 @@ typedef enum {
 #define NS_CONN_ENTITYTOOLARGE    0x0100000u /* The sent entity was too large */
 #define NS_CONN_REQUESTURITOOLONG 0x0200000u /* Request-URI too long */
 #define NS_CONN_LINETOOLONG       0x0400000u /* Request header line too long */
+#define NS_CONN_ZSTDACCEPTED      0x0800000u /* The request accepts zstd compression */
 #define NS_CONN_CONFIGURED        0x1000000u /* The connection is fully configured */
 #define NS_CONN_SSL_WANT_WRITE    0x2000000u /* Flag SSL_ERROR_WANT_WRITE */
 #define NS_CONN_DELIVERY_TRACKED  0x4000000u /* Delivery tracking, currently used only by QUIC */
@@ -252,8 +253,10 @@ typedef enum {
  */
 
 typedef struct Ns_CacheSearch {
-    Ns_Time        now;
-    Tcl_HashSearch hsearch;
+    Ns_Time          now;
+    Tcl_HashSearch   hsearch;
+    struct Ns_Cache *cache;     /* Searched cache, used for segmented caches */
+    int              segment;   /* Currently searched segment */
 } Ns_CacheSearch;
 
 typedef struct Ns_Cache         Ns_Cache;
@@ -269,6 +272,23 @@ typedef struct Ns_Server        Ns_Server;
 typedef struct Ns_Set           Ns_Set;
 
 #define NS_CACHE_MAX_TRANSACTION_DEPTH 16
+#define NS_CACHE_MAX_SEGMENTS 256
+
+/*
+ * Admission policies of caches.
+ */
+typedef enum {
+    NS_CACHE_ADMIT_ALL = 0,   /* Admit every new entry (plain LRU). */
+    NS_CACHE_ADMIT_TINYLFU    /* Admit new entries based on access frequency. */
+} Ns_CacheAdmission;
+
+/*
+ * Eviction policies of caches.
+ */
+typedef enum {
+    NS_CACHE_EVICT_LRU = 0,   /* Evict the least recently used entry. */
+    NS_CACHE_EVICT_COST       /* GreedyDual-Size: weigh recompute cost, size and recency. */
+} Ns_CacheEviction;
 
 typedef struct Ns_CacheTransactionStack {
     uintptr_t    stack[NS_CACHE_MAX_TRANSACTION_DEPTH];
@@ -908,6 +928,35 @@ Ns_CacheCreateEx(const char *name, int keys, time_t ttl, size_t maxSize,
                  Ns_FreeProc *freeProc)
     NS_GNUC_NONNULL(1);
 
+NS_EXTERN Ns_Cache *
+Ns_CacheCreateSegmented(const char *name, int keys, size_t maxSize, Ns_FreeProc *freeProc,
+                        int nsegments)
+    NS_GNUC_RETURNS_NONNULL NS_GNUC_NONNULL(1);
+
+NS_EXTERN Ns_Cache *
+Ns_CacheSegment(Ns_Cache *cache, const char *key)
+    NS_GNUC_RETURNS_NONNULL NS_GNUC_NONNULL(1,2);
+
+NS_EXTERN int
+Ns_CacheGetSegments(const Ns_Cache *cache)
+    NS_GNUC_NONNULL(1) NS_GNUC_PURE;
+
+NS_EXTERN void
+Ns_CacheSetAdmission(Ns_Cache *cache, Ns_CacheAdmission admission)
+    NS_GNUC_NONNULL(1);
+
+NS_EXTERN Ns_CacheAdmission
+Ns_CacheGetAdmission(const Ns_Cache *cache)
+    NS_GNUC_NONNULL(1) NS_GNUC_PURE;
+
+NS_EXTERN void
+Ns_CacheSetEviction(Ns_Cache *cache, Ns_CacheEviction eviction)
+    NS_GNUC_NONNULL(1);
+
+NS_EXTERN Ns_CacheEviction
+Ns_CacheGetEviction(const Ns_Cache *cache)
+    NS_GNUC_NONNULL(1) NS_GNUC_PURE;
+
 NS_EXTERN void
 Ns_CacheDestroy(Ns_Cache *cache)
     NS_GNUC_NONNULL(1);
@@ -920,6 +969,10 @@ NS_EXTERN Ns_Entry *
 Ns_CacheFindEntryT(Ns_Cache *cache, const char *key, const Ns_CacheTransactionStack *transactionStackPtr)
     NS_GNUC_NONNULL(1,2);
 
+NS_EXTERN Ns_Entry *
+Ns_CacheLookupEntryT(Ns_Cache *cache, const char *key, const Ns_CacheTransactionStack *transactionStackPtr)
+    NS_GNUC_NONNULL(1,2);
+
 NS_EXTERN unsigned long
 Ns_CacheCommitEntries(Ns_Cache *cache, uintptr_t epoch)
     NS_GNUC_NONNULL(1);
@@ -928,11 +981,24 @@ NS_EXTERN Ns_Entry *
 Ns_CacheCreateEntry(Ns_Cache *cache, const char *key, int *newPtr)
     NS_GNUC_NONNULL(1,2,3);
 
+NS_EXTERN Ns_Entry *
+Ns_CacheLookupCreateEntry(Ns_Cache *cache, const char *key, int *newPtr)
+    NS_GNUC_NONNULL(1,2,3);
+
 NS_EXTERN Ns_Entry *
 Ns_CacheWaitCreateEntry(Ns_Cache *cache, const char *key, int *newPtr,
                         const Ns_Time *timeoutPtr)
     NS_GNUC_NONNULL(1,2,3);
 
+NS_EXTERN Ns_Entry *
+Ns_CacheFindEntryStale(Ns_Cache *cache, const char *key, const Ns_Time *staleTimePtr,
+                       const Ns_Time *refreshTimePtr, bool *refreshPtr)
+    NS_GNUC_NONNULL(1,2,5);
+
+NS_EXTERN void
+Ns_CacheRefreshDone(Ns_Cache *cache, const char *key)
+    NS_GNUC_NONNULL(1,2);
+
 NS_EXTERN Ns_Entry *
 Ns_CacheWaitCreateEntryT(Ns_Cache *cache, const char *key, int *newPtr,
                         const Ns_Time *timeoutPtr, const Ns_CacheTransactionStack *transactionStackPtr)
@@ -1096,12 +1162,25 @@ NS_EXTERN void Ns_ClsSet(const Ns_Cls *clsPtr, Ns_Conn *conn, void *value);
  * compress.c:
  */
 
+typedef enum {
+    NS_COMPRESS_NONE,
+    NS_COMPRESS_GZIP,
+    NS_COMPRESS_BROTLI,
+    NS_COMPRESS_ZSTD
+} Ns_CompressEncoding;
+
 typedef struct Ns_CompressStream {
 
 #ifdef HAVE_ZLIB_H
     z_stream   z;
 #endif
     unsigned int flags;
+    /*
+     * Encoder state of brotli and zstd, private to compress.c. It is
+     * allocated on first use, keeping the members above at their
+     * offsets.
+     */
+    struct CompressEncoders *encoders;
 
 } Ns_CompressStream;
 
@@ -1123,6 +1202,12 @@ NS_EXTERN Ns_ReturnCode
 Ns_CompressGzip(const char *buf, int len, Tcl_DString *dsPtr, int level)
     NS_GNUC_NONNULL(1,3);
 
+NS_EXTERN Ns_ReturnCode
+Ns_CompressBufs(Ns_CompressStream *cStream, Ns_CompressEncoding encoding,
+                struct iovec *bufs, int nbufs,
+                Tcl_DString *dsPtr, int level, bool flush)
+    NS_GNUC_NONNULL(1,5);
+
 NS_EXTERN Ns_ReturnCode
 Ns_InflateInit(Ns_CompressStream *cStream)
     NS_GNUC_NONNULL(1);
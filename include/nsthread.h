@@ -136,6 +136,31 @@
   #define NS_ALIGNOF(T) (sizeof(void *))
 #endif
 
+/*
+ * Atomic operations on 64-bit integers (int64_t, uint64_t). Loads have
+ * acquire, stores release semantics; the read-modify-write operations act as
+ * full barriers. NS_ATOMIC_CAS() returns true, when "*ptr" was equal to
+ * "expected" and has been replaced by "desired".
+ */
+#if defined(__GNUC__) || defined(__clang__)
+# define NS_ATOMIC_LOAD(ptr)                   __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+# define NS_ATOMIC_STORE(ptr, value)           __atomic_store_n((ptr), (value), __ATOMIC_RELEASE)
+# define NS_ATOMIC_FETCH_ADD(ptr, value)       __atomic_fetch_add((ptr), (value), __ATOMIC_SEQ_CST)
+# define NS_ATOMIC_FETCH_OR(ptr, value)        __atomic_fetch_or((ptr), (value), __ATOMIC_SEQ_CST)
+# define NS_ATOMIC_FETCH_AND(ptr, value)       __atomic_fetch_and((ptr), (value), __ATOMIC_SEQ_CST)
+# define NS_ATOMIC_CAS(ptr, expected, desired) __sync_bool_compare_and_swap((ptr), (expected), (desired))
+#elif defined(_MSC_VER)
+# define NS_ATOMIC_LOAD(ptr)                   InterlockedCompareExchange64((volatile LONG64 *)(ptr), 0, 0)
+# define NS_ATOMIC_STORE(ptr, value)           (void)InterlockedExchange64((volatile LONG64 *)(ptr), (LONG64)(value))
+# define NS_ATOMIC_FETCH_ADD(ptr, value)       InterlockedExchangeAdd64((volatile LONG64 *)(ptr), (LONG64)(value))
+# define NS_ATOMIC_FETCH_OR(ptr, value)        InterlockedOr64((volatile LONG64 *)(ptr), (LONG64)(value))
+# define NS_ATOMIC_FETCH_AND(ptr, value)       InterlockedAnd64((volatile LONG64 *)(ptr), (LONG64)(value))
+# define NS_ATOMIC_CAS(ptr, expected, desired) \
+    (InterlockedCompareExchange64((volatile LONG64 *)(ptr), (LONG64)(desired), (LONG64)(expected)) == (LONG64)(expected))
+#else
+# error "atomic operations are not supported for this compiler"
+#endif
+
 
 /***************************************************************
  * Main Windows defines, including
@@ -1446,6 +1471,8 @@ NS_EXTERN void Ns_RWLockInit(Ns_RWLock *lockPtr)      NS_GNUC_NONNULL(1);
 NS_EXTERN void Ns_RWLockDestroy(Ns_RWLock *lockPtr);
 NS_EXTERN void Ns_RWLockRdLock(Ns_RWLock *lockPtr)    NS_GNUC_NONNULL(1);
 NS_EXTERN void Ns_RWLockWrLock(Ns_RWLock *lockPtr)    NS_GNUC_NONNULL(1);
+NS_EXTERN Ns_ReturnCode Ns_RWLockTryRdLock(Ns_RWLock *lockPtr) NS_GNUC_NONNULL(1);
+NS_EXTERN Ns_ReturnCode Ns_RWLockTryWrLock(Ns_RWLock *lockPtr) NS_GNUC_NONNULL(1);
 NS_EXTERN void Ns_RWLockUnlock(Ns_RWLock *lockPtr)    NS_GNUC_NONNULL(1);
 NS_EXTERN void Ns_RWLockList(Tcl_DString *dsPtr)      NS_GNUC_NONNULL(1);
 NS_EXTERN void Ns_RWLockSetName2(Ns_RWLock *rwPtr, const char *prefix, const char *name)
@@ -0,0 +1,88 @@
+dnl ==========================================================================
+dnl AX_CHECK_BROTLI, AX_CHECK_ZSTD -- optional encoders for dynamic
+dnl response compression (content-encodings "br" and "zstd").
+dnl
+dnl --with-brotli / --with-zstd values:
+dnl   yes (default)   -> use the library when header and library are found
+dnl   no              -> skip detection
+dnl   PREFIX          -> use -I PREFIX/include, -L PREFIX/lib
+dnl
+dnl Defines HAVE_BROTLI resp. HAVE_ZSTD and substitutes
+dnl BROTLI_CFLAGS, BROTLI_LIBS, ZSTD_CFLAGS and ZSTD_LIBS.
+dnl ==========================================================================
+
+AC_DEFUN([AX_CHECK_BROTLI], [
+  AC_ARG_WITH([brotli],
+    [AS_HELP_STRING([--with-brotli@<:@=PREFIX|no@:>@],
+                    [Build with brotli response compression])],
+    [with_brotli="$withval"], [with_brotli="yes"])
+
+  have_brotli="no"
+  if test "x$with_brotli" != "xyes" -a "x$with_brotli" != "xno" ; then
+    BROTLI_CFLAGS="-I$with_brotli/include"
+    BROTLI_LIBS="-L$with_brotli/lib"
+  fi
+
+  if test "x$with_brotli" != "xno" ; then
+    save_CFLAGS="$CFLAGS"; save_LIBS="$LIBS"
+    CFLAGS="$CFLAGS $BROTLI_CFLAGS"
+    LIBS="$LIBS $BROTLI_LIBS"
+
+    AC_CHECK_HEADERS([brotli/encode.h], [
+      AC_CHECK_LIB([brotlienc], [BrotliEncoderCreateInstance], [
+        have_brotli="yes"
+        BROTLI_LIBS="$BROTLI_LIBS -lbrotlienc"
+      ])
+    ])
+
+    CFLAGS="$save_CFLAGS"; LIBS="$save_LIBS"
+  fi
+
+  if test "x$have_brotli" = "xyes" ; then
+    AC_DEFINE([HAVE_BROTLI], [1], [Define if the brotli encoder is available])
+  else
+    BROTLI_CFLAGS=""
+    BROTLI_LIBS=""
+  fi
+  AC_SUBST([BROTLI_CFLAGS])
+  AC_SUBST([BROTLI_LIBS])
+  AC_MSG_RESULT([brotli: $have_brotli])
+])
+
+AC_DEFUN([AX_CHECK_ZSTD], [
+  AC_ARG_WITH([zstd],
+    [AS_HELP_STRING([--with-zstd@<:@=PREFIX|no@:>@],
+                    [Build with zstd response compression])],
+    [with_zstd="$withval"], [with_zstd="yes"])
+
+  have_zstd="no"
+  if test "x$with_zstd" != "xyes" -a "x$with_zstd" != "xno" ; then
+    ZSTD_CFLAGS="-I$with_zstd/include"
+    ZSTD_LIBS="-L$with_zstd/lib"
+  fi
+
+  if test "x$with_zstd" != "xno" ; then
+    save_CFLAGS="$CFLAGS"; save_LIBS="$LIBS"
+    CFLAGS="$CFLAGS $ZSTD_CFLAGS"
+    LIBS="$LIBS $ZSTD_LIBS"
+
+    AC_CHECK_HEADERS([zstd.h], [
+      AC_CHECK_LIB([zstd], [ZSTD_compressStream2], [
+        have_zstd="yes"
+        ZSTD_LIBS="$ZSTD_LIBS -lzstd"
+      ])
+    ])
+
+    CFLAGS="$save_CFLAGS"; LIBS="$save_LIBS"
+  fi
+
+  if test "x$have_zstd" = "xyes" ; then
+    AC_DEFINE([HAVE_ZSTD], [1], [Define if the zstd encoder is available])
+  else
+    ZSTD_CFLAGS=""
+    ZSTD_LIBS=""
+  fi
+  AC_SUBST([ZSTD_CFLAGS])
+  AC_SUBST([ZSTD_LIBS])
+  AC_MSG_RESULT([zstd: $have_zstd])
+])
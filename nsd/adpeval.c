@@ -17,6 +17,10 @@
 
 #include "nsd.h"
 
+#ifdef HAVE_SYS_INOTIFY_H
+# include <sys/inotify.h>
+#endif
+
 #define AdpCodeLen(cp,i)    ((cp)->len[(i)])    /* TCL_SIZE_T */
 #define AdpCodeLine(cp,i)   ((cp)->line[(i)])   /* int */
 #define AdpCodeText(cp)     ((cp)->text.string)
@@ -36,6 +40,20 @@ typedef struct AdpCache {
     AdpCode    code;    /* ADP code for cached result. */
 } AdpCache;
 
+/*
+ * The following structure defines a watched ADP file. The generation is
+ * incremented on every change notification for the file, such that pages
+ * parsed from an older generation are recognized as outdated without
+ * calling stat() on the file.
+ */
+
+typedef struct AdpWatch {
+    int64_t        generation; /* Atomic change counter. */
+    int            wd;         /* Watch descriptor, -1 when the file is not watched. */
+    int            refcnt;     /* Pages and table entry referring to the watch. */
+    Tcl_HashEntry *hPtr;       /* Entry in table of watched files, or NULL. */
+} AdpWatch;
+
 /*
  * The following structure defines a shared page in the ADP cache.  The
  * size of the object is extended to include the filename bytes.
@@ -55,6 +73,8 @@ typedef struct Page {
     AdpCache      *cachePtr; /* Cached output. */
     AdpCode        code;     /* ADP code blocks. */
     bool           locked;   /* Page locked for cache update. */
+    AdpWatch      *watchPtr; /* File watch, or NULL when not watched. */
+    int64_t        watchGen; /* Watch generation when the file was read. */
 } Page;
 
 /*
@@ -116,9 +136,36 @@ static void AdpTrace(const NsInterp *itPtr, const char *ptr, TCL_SIZE_T len)
 static const char *AdpEffectiveTagSetName(const NsInterp *itPtr)
     NS_GNUC_NONNULL(1);
 
+static bool AdpWatchInit(void);
+
+static AdpWatch *AdpWatchFile(const char *file, int64_t *generationPtr)
+    NS_GNUC_NONNULL(1,2);
+
+static void AdpWatchRelease(AdpWatch *watchPtr)
+    NS_GNUC_NONNULL(1);
+
+static bool PageChanged(const Page *pagePtr)
+    NS_GNUC_NONNULL(1);
+
+#ifdef HAVE_SYS_INOTIFY_H
+static Ns_SockProc AdpWatchProc;
+#endif
+
 static Ns_Callback FreeInterpPage;
 static Ns_ServerInitProc ConfigServerAdp;
 
+/*
+ * Static variables defined in this file.
+ */
+
+static struct {
+    Ns_Mutex      lock;
+    int           fd;     /* inotify descriptor */
+    Tcl_HashTable files;  /* AdpWatch structures by file name */
+    Tcl_HashTable wds;    /* AdpWatch structures by watch descriptor */
+    bool          initialized;
+} adpWatcher;
+
 
 /*
  *----------------------------------------------------------------------
@@ -194,6 +241,15 @@ ConfigServerAdp(const char *server)
     (void) Ns_ConfigFlag(section, "trimspace",    ADP_TRIM,      0, &servPtr->adp.flags);
     (void) Ns_ConfigFlag(section, "autoabort",    ADP_AUTOABORT, 1, &servPtr->adp.flags);
 
+    /*
+     * Detect changes of ADP files via file system notifications instead
+     * of calling stat() on every evaluation.
+     */
+    servPtr->adp.watchfiles = Ns_ConfigBool(section, "watchfiles", NS_FALSE);
+    if (servPtr->adp.watchfiles && !AdpWatchInit()) {
+        servPtr->adp.watchfiles = NS_FALSE;
+    }
+
     return NS_OK;
 }
 
@@ -551,11 +607,42 @@ AdpSource(NsInterp *itPtr, TCL_SIZE_T objc, Tcl_Obj *const* objv, const char *fi
         Tcl_DStringSetLength(&tmp, 0);
     }
 
+    /*
+     * When the file of a page in the interp page cache is watched and has
+     * not changed since it was read, use the page without calling stat().
+     */
+
+    if (servPtr->adp.watchfiles) {
+        Ns_Entry *ePtr = Ns_CacheFindEntry(itPtr->adp.cache, cacheKeyString);
+
+        if (ePtr != NULL) {
+            InterpPage *cachedPtr = Ns_CacheGetValue(ePtr);
+            const Page *cachedPagePtr = cachedPtr->pagePtr;
+
+            if (cachedPagePtr->watchPtr != NULL
+                && !PageChanged(cachedPagePtr)
+                && cachedPagePtr->flags == itPtr->adp.flags) {
+                memset(&st, 0, sizeof(st));
+                st.st_mode = S_IFREG;
+                st.st_mtime = cachedPagePtr->mtime;
+                st.st_size = cachedPagePtr->size;
+                st.st_dev = cachedPagePtr->dev;
+                st.st_ino = cachedPagePtr->ino;
+                ipagePtr = cachedPtr;
+            }
+        }
+    }
+
     /*
      * Verify the file is an existing, ordinary file and get page code.
      */
 
-    if (stat(file, &st) != 0) {
+    if (ipagePtr != NULL) {
+        /*
+         * Valid page from the interp page cache.
+         */
+
+    } else if (stat(file, &st) != 0) {
         Ns_TclPrintfResult(interp, "could not stat \"%s\": %s",
                            file, Tcl_PosixError(interp));
     } else if (!S_ISREG(st.st_mode)) {
@@ -574,7 +661,8 @@ AdpSource(NsInterp *itPtr, TCL_SIZE_T objc, Tcl_Obj *const* objv, const char *fi
                     || ipagePtr->pagePtr->size != st.st_size
                     || ipagePtr->pagePtr->dev != st.st_dev
                     || ipagePtr->pagePtr->ino != st.st_ino
-                    || ipagePtr->pagePtr->flags != itPtr->adp.flags) {
+                    || ipagePtr->pagePtr->flags != itPtr->adp.flags
+                    || PageChanged(ipagePtr->pagePtr)) {
                 Ns_CacheFlushEntry(ePtr);
                 ipagePtr = NULL;
             }
@@ -596,16 +684,34 @@ AdpSource(NsInterp *itPtr, TCL_SIZE_T objc, Tcl_Obj *const* objv, const char *fi
                          || pagePtr->size != st.st_size
                          || pagePtr->dev != st.st_dev
                          || pagePtr->ino != st.st_ino
-                         || pagePtr->flags != itPtr->adp.flags)) {
+                         || pagePtr->flags != itPtr->adp.flags
+                         || PageChanged(pagePtr))) {
                 /* NB: Clear entry to indicate read/parse in progress. */
                 Tcl_SetHashValue(hPtr, NULL);
                 pagePtr->hPtr = NULL;
                 isNew = 1;
             }
             if (isNew != 0) {
+                AdpWatch *watchPtr = NULL;
+                int64_t   watchGen = 0;
+
                 Ns_MutexUnlock(&servPtr->adp.pagelock);
+
+                /*
+                 * Register the file watch before reading the file, such
+                 * that changes during reading are not missed.
+                 */
+                if (servPtr->adp.watchfiles) {
+                    watchPtr = AdpWatchFile(file, &watchGen);
+                }
                 Ns_Log(Debug, "AdpSource calls ParseFile with flags %.8x", itPtr->adp.flags);
                 pagePtr = ParseFile(itPtr, file, &st, itPtr->adp.flags);
+                if (pagePtr != NULL) {
+                    pagePtr->watchPtr = watchPtr;
+                    pagePtr->watchGen = watchGen;
+                } else if (watchPtr != NULL) {
+                    AdpWatchRelease(watchPtr);
+                }
                 Ns_MutexLock(&servPtr->adp.pagelock);
                 if (pagePtr == NULL) {
                     Tcl_DeleteHashEntry(hPtr);
@@ -897,11 +1003,12 @@ NsTclAdpStatsObjCmd(ClientData clientData, Tcl_Interp *interp,
 
             Ns_DStringPrintf(&ds, "{%s} "
                              "{dev %" PRIu64 " ino %" PRIu64 " mtime %" PRIu64 " "
-                             "refcnt %d evals %d size %" PROTd" blocks %d scripts %d} ",
+                             "refcnt %d evals %d size %" PROTd" blocks %d scripts %d watched %d} ",
                              file,
                              (uint64_t) pagePtr->dev, (uint64_t) pagePtr->ino, (uint64_t) pagePtr->mtime,
                              pagePtr->refcnt, pagePtr->evals, pagePtr->size,
-                             pagePtr->code.nblocks, pagePtr->code.nscripts);
+                             pagePtr->code.nblocks, pagePtr->code.nscripts,
+                             (pagePtr->watchPtr != NULL) ? 1 : 0);
             hPtr = Tcl_NextHashEntry(&search);
         }
         Ns_MutexUnlock(&servPtr->adp.pagelock);
@@ -1017,6 +1124,8 @@ ParseFile(NsInterp *itPtr, const char *file, struct stat *stPtr, unsigned int fl
         pagePtr->size = stPtr->st_size;
         pagePtr->dev = stPtr->st_dev;
         pagePtr->ino = stPtr->st_ino;
+        pagePtr->watchPtr = NULL;
+        pagePtr->watchGen = 0;
         Ns_Log(Debug, "ParseFile calls NsAdpParse with flags %.8x", flags);
         NsAdpParse(itPtr, &pagePtr->code, page, flags, file);
         Tcl_DStringFree(&utf);
@@ -1405,6 +1514,9 @@ FreeInterpPage(void *arg)
             FreeObjs(ipagePtr->cacheObjs);
             DecrCache(pagePtr->cachePtr);
         }
+        if (pagePtr->watchPtr != NULL) {
+            AdpWatchRelease(pagePtr->watchPtr);
+        }
         NsAdpFreeCode(&pagePtr->code);
         ns_free(pagePtr);
     }
@@ -1538,6 +1650,295 @@ AdpTrace(const NsInterp *itPtr, const char *ptr, TCL_SIZE_T len)
     Ns_Log(Notice, "adp[%d%c]: %.*s", itPtr->adp.depth, type, (int)len, ptr);
 }
 
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * AdpWatchInit --
+ *
+ *      Initialize the file system notifications for watching ADP files.
+ *      The notifications are processed by the socket callback thread.
+ *
+ * Results:
+ *      NS_TRUE when file watches are available, NS_FALSE otherwise.
+ *
+ * Side effects:
+ *      Creates the inotify descriptor on the first call.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static bool
+AdpWatchInit(void)
+{
+#ifdef HAVE_SYS_INOTIFY_H
+    if (!adpWatcher.initialized) {
+        int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+        if (fd < 0) {
+            Ns_Log(Warning, "adp: could not initialize file watches: %s", strerror(errno));
+
+        } else if (Ns_SockCallback((NS_SOCKET)fd, AdpWatchProc, NULL,
+                                   (unsigned int)NS_SOCK_READ | (unsigned int)NS_SOCK_EXIT) != NS_OK) {
+            Ns_Log(Warning, "adp: could not register callback for file watches");
+            (void) ns_close(fd);
+
+        } else {
+            Ns_RegisterProcInfo((ns_funcptr_t)AdpWatchProc, "ns:adpwatch", NULL);
+            Ns_MutexInit(&adpWatcher.lock);
+            Ns_MutexSetName(&adpWatcher.lock, "ns:adp:watch");
+            Tcl_InitHashTable(&adpWatcher.files, TCL_STRING_KEYS);
+            Tcl_InitHashTable(&adpWatcher.wds, TCL_ONE_WORD_KEYS);
+            adpWatcher.fd = fd;
+            adpWatcher.initialized = NS_TRUE;
+        }
+    }
+    return adpWatcher.initialized;
+#else
+    Ns_Log(Warning, "adp: watchfiles is not supported on this platform");
+    return NS_FALSE;
+#endif
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * AdpWatchFile --
+ *
+ *      Start or refresh the watch of an ADP file. When the file was
+ *      replaced since it was watched last, the watch of the previous file
+ *      is removed.
+ *
+ *      Since inotify resolves symbolic links only when the watch is
+ *      added, switching a symbolic link in the path to a different file
+ *      is not noticed until the watch is refreshed.
+ *
+ * Results:
+ *      The watch of the file and its current generation in
+ *      *generationPtr, or NULL when the file cannot be watched, e.g.,
+ *      when the watch limit of the system is reached or the same file is
+ *      already watched under a different name.
+ *
+ * Side effects:
+ *      The reference count of the returned watch is incremented, the
+ *      caller has to release it via AdpWatchRelease().
+ *
+ *----------------------------------------------------------------------
+ */
+
+static AdpWatch *
+AdpWatchFile(const char *file, int64_t *generationPtr)
+{
+    AdpWatch *watchPtr = NULL;
+
+    NS_NONNULL_ASSERT(file != NULL);
+    NS_NONNULL_ASSERT(generationPtr != NULL);
+
+#ifdef HAVE_SYS_INOTIFY_H
+    {
+        int wd;
+
+        Ns_MutexLock(&adpWatcher.lock);
+        wd = inotify_add_watch(adpWatcher.fd, file,
+                               IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_MOVE_SELF | IN_DELETE_SELF);
+        if (wd < 0) {
+            Ns_Log(Warning, "adp: could not watch file \"%s\": %s", file, strerror(errno));
+
+        } else {
+            Tcl_HashEntry *hPtr;
+            int            isNew;
+
+            hPtr = Tcl_CreateHashEntry(&adpWatcher.files, file, &isNew);
+            if (isNew != 0) {
+                watchPtr = ns_calloc(1u, sizeof(AdpWatch));
+                watchPtr->wd = -1;
+                watchPtr->refcnt = 1;
+                watchPtr->hPtr = hPtr;
+                Tcl_SetHashValue(hPtr, watchPtr);
+            } else {
+                watchPtr = Tcl_GetHashValue(hPtr);
+            }
+
+            if (watchPtr->wd != wd) {
+                hPtr = Tcl_CreateHashEntry(&adpWatcher.wds, INT2PTR(wd), &isNew);
+                if (isNew == 0 && Tcl_GetHashValue(hPtr) != watchPtr) {
+                    /*
+                     * The file is watched under a different name (hard
+                     * link or symbolic link). Fall back to stat().
+                     */
+                    watchPtr = NULL;
+                } else {
+                    if (watchPtr->wd != -1) {
+                        Tcl_HashEntry *oldPtr = Tcl_FindHashEntry(&adpWatcher.wds, INT2PTR(watchPtr->wd));
+
+                        if (oldPtr != NULL) {
+                            Tcl_DeleteHashEntry(oldPtr);
+                        }
+                        (void) inotify_rm_watch(adpWatcher.fd, watchPtr->wd);
+                    }
+                    Tcl_SetHashValue(hPtr, watchPtr);
+                    watchPtr->wd = wd;
+                }
+            }
+            if (watchPtr != NULL) {
+                ++watchPtr->refcnt;
+                *generationPtr = NS_ATOMIC_LOAD(&watchPtr->generation);
+            }
+        }
+        Ns_MutexUnlock(&adpWatcher.lock);
+    }
+#endif
+
+    return watchPtr;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * AdpWatchRelease --
+ *
+ *      Release a reference to a file watch obtained from AdpWatchFile().
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      The watch is freed when it was removed from the table of watched
+ *      files and the last page referring to it is gone.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+AdpWatchRelease(AdpWatch *watchPtr)
+{
+    NS_NONNULL_ASSERT(watchPtr != NULL);
+
+    Ns_MutexLock(&adpWatcher.lock);
+    if (--watchPtr->refcnt == 0) {
+        ns_free(watchPtr);
+    }
+    Ns_MutexUnlock(&adpWatcher.lock);
+}
+
+
+#ifdef HAVE_SYS_INOTIFY_H
+/*
+ *----------------------------------------------------------------------
+ *
+ * AdpWatchProc --
+ *
+ *      Socket callback processing the file system notifications for
+ *      watched ADP files.
+ *
+ * Results:
+ *      NS_TRUE to keep the callback, NS_FALSE on shutdown.
+ *
+ * Side effects:
+ *      Increments the generation of changed files, or of all files when
+ *      the event queue overflowed. Watches removed by the kernel are
+ *      dropped from the table of watched files.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static bool
+AdpWatchProc(NS_SOCKET sock, void *UNUSED(arg), unsigned int why)
+{
+    union {
+        struct inotify_event event;
+        char                 buffer[4096];
+    } events;
+    ssize_t n;
+
+    if (why == (unsigned int)NS_SOCK_EXIT) {
+        (void) ns_close((int)sock);
+        return NS_FALSE;
+    }
+
+    while ((n = ns_read((int)sock, events.buffer, sizeof(events.buffer))) > 0) {
+        const char *p = events.buffer;
+
+        Ns_MutexLock(&adpWatcher.lock);
+        while (p < events.buffer + n) {
+            const struct inotify_event *eventPtr = (const struct inotify_event *)(const void *)p;
+            Tcl_HashEntry              *hPtr;
+
+            if (eventPtr->wd == -1 || (eventPtr->mask & IN_Q_OVERFLOW) != 0u) {
+                Tcl_HashSearch search;
+
+                /*
+                 * Events were lost, so every watched file might have
+                 * changed.
+                 */
+                Ns_Log(Warning, "adp: file watch event queue overflow");
+                hPtr = Tcl_FirstHashEntry(&adpWatcher.files, &search);
+                while (hPtr != NULL) {
+                    AdpWatch *watchPtr = Tcl_GetHashValue(hPtr);
+
+                    (void) NS_ATOMIC_FETCH_ADD(&watchPtr->generation, 1);
+                    hPtr = Tcl_NextHashEntry(&search);
+                }
+
+            } else if ((hPtr = Tcl_FindHashEntry(&adpWatcher.wds, INT2PTR(eventPtr->wd))) != NULL) {
+                AdpWatch *watchPtr = Tcl_GetHashValue(hPtr);
+
+                (void) NS_ATOMIC_FETCH_ADD(&watchPtr->generation, 1);
+                if ((eventPtr->mask & IN_IGNORED) != 0u) {
+                    /*
+                     * The watch was removed, e.g., since the file was
+                     * deleted. Drop the watch from the tables; pages
+                     * still referring to it see the new generation.
+                     */
+                    Tcl_DeleteHashEntry(hPtr);
+                    watchPtr->wd = -1;
+                    if (watchPtr->hPtr != NULL) {
+                        Tcl_DeleteHashEntry(watchPtr->hPtr);
+                        watchPtr->hPtr = NULL;
+                    }
+                    if (--watchPtr->refcnt == 0) {
+                        ns_free(watchPtr);
+                    }
+                }
+            }
+            p += sizeof(struct inotify_event) + eventPtr->len;
+        }
+        Ns_MutexUnlock(&adpWatcher.lock);
+    }
+    return NS_TRUE;
+}
+#endif
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * PageChanged --
+ *
+ *      Check, whether the file of a watched page has changed since it was
+ *      read.
+ *
+ * Results:
+ *      NS_TRUE when the page is outdated, NS_FALSE when it is unchanged or
+ *      not watched.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static bool
+PageChanged(const Page *pagePtr)
+{
+    NS_NONNULL_ASSERT(pagePtr != NULL);
+
+    return (pagePtr->watchPtr != NULL
+            && NS_ATOMIC_LOAD(&pagePtr->watchPtr->generation) != pagePtr->watchGen);
+}
+
 /*
  * Local Variables:
  * mode: c
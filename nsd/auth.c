@@ -253,6 +253,36 @@ Ns_AuthorizeUser(const Ns_Server *server, const char *user, const char *passwd,
     return status;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * NsAuthorizeRequestRegistered --
+ *
+ *      Check, whether request-level authorization callbacks are
+ *      registered for the server.
+ *
+ * Results:
+ *      NS_TRUE when at least one callback is registered.
+ *
+ * Side Effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+bool
+NsAuthorizeRequestRegistered(NsServer *servPtr)
+{
+    bool result;
+
+    NS_NONNULL_ASSERT(servPtr != NULL);
+
+    AuthLock(servPtr, NS_READ);
+    result = (servPtr->request.firstRequestAuthPtr != NULL);
+    AuthUnlock(servPtr);
+
+    return result;
+}
+
 /*
  *----------------------------------------------------------------------
  *
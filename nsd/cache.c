@@ -38,10 +38,59 @@ typedef struct Entry {
     void           *value;            /* Will appear NULL for concurrent updates. */
     void           *uncommittedValue; /* Used for transactional mode */
     uintptr_t       transactionEpoch; /* Used for identifying transaction */
+    bool            admitted;         /* A value was admitted to the cache */
+    double          priority;         /* GreedyDual-Size priority */
+    size_t          heapIndex;        /* 1-based position in eviction heap, 0 if not in heap */
+    bool            refreshing;       /* A background refresh of the value is pending */
 } Entry;
 
 /*
- * The following structure defines a cache
+ * Count-min sketch estimating the access frequencies of keys for the TinyLFU
+ * admission policy. The sketch has SKETCH_DEPTH rows of "width" saturating
+ * 4-bit counters (stored in bytes). After "sampleSize" increments, all
+ * counters are halved, such that the sketch ages and adapts to changing
+ * access patterns.
+ */
+
+#define SKETCH_DEPTH      4
+#define SKETCH_MAXCOUNT   15u
+
+typedef struct FrequencySketch {
+    uint8_t      *counters;
+    unsigned int  widthBits;
+    unsigned int  additions;
+    unsigned int  sampleSize;
+} FrequencySketch;
+
+/*
+ * Usage statistics of a cache.
+ */
+
+typedef struct CacheStats {
+    unsigned long   nhit;      /* Successful gets. */
+    unsigned long   nmiss;     /* Unsuccessful gets. */
+    unsigned long   nexpired;  /* Unsuccessful gets due to entry expiry. */
+    unsigned long   nflushed;  /* Explicit flushes by user code. */
+    unsigned long   npruned;   /* Evictions due to size constraint. */
+    unsigned long   ncommit;   /* number of commits. */
+    unsigned long   nrollback; /* number of rollback operations. */
+    unsigned long   nrejected; /* New entries not admitted by the admission policy. */
+    double          saved;     /* Recompute time saved by hits since the last reset (seconds). */
+    unsigned long   nstale;    /* Hits on expired entries within the stale window. */
+} CacheStats;
+
+/*
+ * The following structure defines a cache.
+ *
+ * A segmented cache is a container for "nsegments" caches (segments), each
+ * with its own lock, hash table and LRU list. Keys are assigned to segments
+ * by a hash function, such that operations on different keys do not contend
+ * on the same mutex. The size limit "maxSize" of the container is a global
+ * budget for all segments, the total size of all segments is kept in the
+ * atomically updated "segmentedSize" member of the container. Every
+ * segment holds a copy of the budget, and when the total size exceeds it,
+ * the segment receiving a new value evicts its own entries under its own
+ * lock.
  */
 
 typedef struct Cache {
@@ -56,15 +105,21 @@ typedef struct Cache {
     Tcl_HashTable  entriesTable;
     uintptr_t      transactionEpoch;
     Tcl_HashTable  uncommittedTable;
-    struct {
-        unsigned long   nhit;      /* Successful gets. */
-        unsigned long   nmiss;     /* Unsuccessful gets. */
-        unsigned long   nexpired;  /* Unsuccessful gets due to entry expiry. */
-        unsigned long   nflushed;  /* Explicit flushes by user code. */
-        unsigned long   npruned;   /* Evictions due to size constraint. */
-        unsigned long   ncommit;   /* number of commits. */
-        unsigned long   nrollback; /* number of rollback operations. */
-    } stats;
+    CacheStats     stats;
+
+    struct Cache  *parentPtr;      /* Segmented container of a segment, or NULL. */
+    struct Cache **segments;       /* Segments of a segmented cache, or NULL. */
+    int            nsegments;      /* Number of segments (power of 2), or 0. */
+    int64_t        segmentedSize;  /* Total size of all segments. */
+
+    Ns_CacheAdmission admission;
+    FrequencySketch  *sketchPtr;   /* Access frequencies for TinyLFU, or NULL. */
+
+    Ns_CacheEviction  eviction;
+    Entry           **heap;        /* Min-heap of priorities for cost based eviction. */
+    size_t            heapSize;
+    size_t            heapCapacity;
+    double            inflation;   /* Priority of the last evicted entry. */
 
     char name[1];
 
@@ -88,6 +143,74 @@ static unsigned long
 CacheTransaction(Cache *cachePtr, uintptr_t epoch, bool commit)
     NS_GNUC_NONNULL(1);
 
+static uint32_t KeyHash(int keys, const char *key)
+    NS_GNUC_NONNULL(2) NS_GNUC_PURE;
+
+static Cache *SegmentForKey(const Cache *cachePtr, const char *key)
+    NS_GNUC_NONNULL(1,2) NS_GNUC_RETURNS_NONNULL;
+
+static FrequencySketch *SketchCreate(size_t maxSize)
+    NS_GNUC_RETURNS_NONNULL;
+
+static void SketchFree(FrequencySketch *sketchPtr)
+    NS_GNUC_NONNULL(1);
+
+static void SketchIncrement(FrequencySketch *sketchPtr, uint32_t hash)
+    NS_GNUC_NONNULL(1);
+
+static unsigned int SketchFrequency(const FrequencySketch *sketchPtr, uint32_t hash)
+    NS_GNUC_NONNULL(1) NS_GNUC_PURE;
+
+static bool Admit(const Cache *cachePtr, const Entry *candidatePtr, const Entry *victimPtr)
+    NS_GNUC_NONNULL(1,2,3);
+
+static void CountHit(Cache *cachePtr, Entry *ePtr)
+    NS_GNUC_NONNULL(1,2);
+
+static Ns_Entry *CacheFindEntry(Cache *cachePtr, const char *key,
+                                const Ns_CacheTransactionStack *transactionStackPtr, bool countAccess)
+    NS_GNUC_NONNULL(1,2);
+
+static Ns_Entry *CacheCreateEntry(Cache *cachePtr, const char *key, int *newPtr, bool countAccess)
+    NS_GNUC_NONNULL(1,2,3);
+
+static Entry *Victim(const Cache *cachePtr, const Entry *exceptPtr)
+    NS_GNUC_NONNULL(1,2);
+
+static void SetEviction(Cache *cachePtr, Ns_CacheEviction eviction)
+    NS_GNUC_NONNULL(1);
+
+static double Priority(const Cache *cachePtr, const Entry *ePtr)
+    NS_GNUC_NONNULL(1,2) NS_GNUC_PURE;
+
+static void HeapPlace(Cache *cachePtr, size_t index, Entry *ePtr)
+    NS_GNUC_NONNULL(1,3);
+
+static void HeapSift(Cache *cachePtr, size_t index)
+    NS_GNUC_NONNULL(1);
+
+static void HeapPush(Cache *cachePtr, Entry *ePtr)
+    NS_GNUC_NONNULL(1,2);
+
+static void HeapRemove(Cache *cachePtr, Entry *ePtr)
+    NS_GNUC_NONNULL(1,2);
+
+static void HeapUpdate(Cache *cachePtr, Entry *ePtr)
+    NS_GNUC_NONNULL(1,2);
+
+static void SizeIncr(Cache *cachePtr, size_t size)
+    NS_GNUC_NONNULL(1);
+
+static void SizeDecr(Cache *cachePtr, size_t size)
+    NS_GNUC_NONNULL(1);
+
+static size_t TotalSize(const Cache *cachePtr)
+    NS_GNUC_NONNULL(1);
+
+static Ns_Entry *SearchEntries(Ns_CacheSearch *search, const Tcl_HashEntry *hPtr,
+                               const Ns_CacheTransactionStack *transactionStackPtr)
+    NS_GNUC_NONNULL(1);
+
 
 /*
  *----------------------------------------------------------------------
@@ -129,6 +252,9 @@ Ns_CacheCreateSz(const char *name, int keys, size_t maxSize, Ns_FreeProc *freePr
     cachePtr->stats.npruned   = 0u;
     cachePtr->stats.ncommit   = 0u;
     cachePtr->stats.nrollback = 0u;
+    cachePtr->stats.nrejected = 0u;
+    cachePtr->stats.saved     = 0.0;
+    cachePtr->stats.nstale    = 0u;
 
     Ns_MutexInit(&cachePtr->lock);
     Ns_MutexSetName2(&cachePtr->lock, "ns:cache", name);
@@ -140,6 +266,248 @@ Ns_CacheCreateSz(const char *name, int keys, size_t maxSize, Ns_FreeProc *freePr
     return (Ns_Cache *) cachePtr;
 }
 
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Ns_CacheCreateSegmented --
+ *
+ *      Create a new size limited cache consisting of "nsegments"
+ *      independently locked segments. The number of segments is rounded
+ *      up to the next power of 2. The maximum size applies to the sum of
+ *      all segments. When "nsegments" is less than 2, this function
+ *      behaves like Ns_CacheCreateSz().
+ *
+ *      Operations on a single key should lock and use the segment returned
+ *      by Ns_CacheSegment(). Locking the segmented cache itself locks all
+ *      segments, which is required for iterating, flushing, transaction
+ *      handling and statistics.
+ *
+ * Results:
+ *      A pointer to the new cache.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+Ns_Cache *
+Ns_CacheCreateSegmented(const char *name, int keys, size_t maxSize, Ns_FreeProc *freeProc,
+                        int nsegments)
+{
+    Cache *cachePtr;
+
+    NS_NONNULL_ASSERT(name != NULL);
+
+    cachePtr = (Cache *)Ns_CacheCreateSz(name, keys, maxSize, freeProc);
+
+    if (nsegments > 1) {
+        Tcl_DString ds;
+        int         i, n = 2;
+
+        while (n < nsegments && n < NS_CACHE_MAX_SEGMENTS) {
+            n <<= 1;
+        }
+        cachePtr->nsegments = n;
+        cachePtr->segments = ns_calloc((size_t)n, sizeof(Cache *));
+
+        Tcl_DStringInit(&ds);
+        for (i = 0; i < n; i++) {
+            Cache *segmentPtr = (Cache *)Ns_CacheCreateSz(name, keys, maxSize, freeProc);
+
+            segmentPtr->parentPtr = cachePtr;
+            Tcl_DStringSetLength(&ds, 0);
+            Ns_DStringPrintf(&ds, "%s:%d", name, i);
+            Ns_MutexSetName2(&segmentPtr->lock, "ns:cache", ds.string);
+            cachePtr->segments[i] = segmentPtr;
+        }
+        Tcl_DStringFree(&ds);
+    }
+
+    return (Ns_Cache *) cachePtr;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Ns_CacheSegment --
+ *
+ *      Return the segment of a segmented cache responsible for the
+ *      provided key. For non-segmented caches, the cache itself is
+ *      returned.
+ *
+ * Results:
+ *      Cache (segment) to be used for operations on the key.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+Ns_Cache *
+Ns_CacheSegment(Ns_Cache *cache, const char *key)
+{
+    const Cache *cachePtr = (const Cache *) cache;
+
+    NS_NONNULL_ASSERT(cache != NULL);
+    NS_NONNULL_ASSERT(key != NULL);
+
+    return (cachePtr->nsegments == 0) ? cache : (Ns_Cache *)SegmentForKey(cachePtr, key);
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Ns_CacheGetSegments --
+ *
+ *      Return the number of segments of a cache.
+ *
+ * Results:
+ *      Number of segments, 1 for non-segmented caches.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+Ns_CacheGetSegments(const Ns_Cache *cache)
+{
+    const Cache *cachePtr = (const Cache *) cache;
+
+    NS_NONNULL_ASSERT(cache != NULL);
+
+    return (cachePtr->nsegments == 0) ? 1 : cachePtr->nsegments;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Ns_CacheSetAdmission, Ns_CacheGetAdmission --
+ *
+ *      Set/get the admission policy of a cache. With
+ *      NS_CACHE_ADMIT_TINYLFU, the access frequencies of keys are
+ *      estimated by a count-min sketch. When a new entry requires an
+ *      eviction, it is only admitted when it was accessed more frequently
+ *      than the least recently used entry; otherwise, the new entry is
+ *      dropped. This protects frequently used entries against scans over
+ *      keys, which are used only once.
+ *
+ *      The policy should be set before the cache is used, or with the
+ *      cache locked.
+ *
+ * Results:
+ *      Ns_CacheGetAdmission() returns the admission policy.
+ *
+ * Side effects:
+ *      Allocates or frees the frequency sketch(es) of the cache.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+Ns_CacheSetAdmission(Ns_Cache *cache, Ns_CacheAdmission admission)
+{
+    Cache *cachePtr = (Cache *) cache;
+
+    NS_NONNULL_ASSERT(cache != NULL);
+
+    cachePtr->admission = admission;
+    if (cachePtr->nsegments > 0) {
+        int i;
+
+        for (i = 0; i < cachePtr->nsegments; i++) {
+            Cache *segmentPtr = cachePtr->segments[i];
+
+            segmentPtr->admission = admission;
+            if (segmentPtr->sketchPtr != NULL) {
+                SketchFree(segmentPtr->sketchPtr);
+                segmentPtr->sketchPtr = NULL;
+            }
+            if (admission == NS_CACHE_ADMIT_TINYLFU) {
+                segmentPtr->sketchPtr = SketchCreate(cachePtr->maxSize / (size_t)cachePtr->nsegments);
+            }
+        }
+    } else {
+        if (cachePtr->sketchPtr != NULL) {
+            SketchFree(cachePtr->sketchPtr);
+            cachePtr->sketchPtr = NULL;
+        }
+        if (admission == NS_CACHE_ADMIT_TINYLFU) {
+            cachePtr->sketchPtr = SketchCreate(cachePtr->maxSize);
+        }
+    }
+}
+
+Ns_CacheAdmission
+Ns_CacheGetAdmission(const Ns_Cache *cache)
+{
+    NS_NONNULL_ASSERT(cache != NULL);
+
+    return ((const Cache *) cache)->admission;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Ns_CacheSetEviction, Ns_CacheGetEviction --
+ *
+ *      Set/get the eviction policy of a cache. With NS_CACHE_EVICT_LRU,
+ *      the least recently used entry is evicted. With
+ *      NS_CACHE_EVICT_COST, eviction follows GreedyDual-Size: every entry
+ *      has a priority of L + cost/size, where "cost" is the time needed
+ *      to compute the value and L is the priority of the last evicted
+ *      entry. The priority is refreshed on every hit, and the entry with
+ *      the lowest priority is evicted. Therefore, entries which are
+ *      expensive to recompute stay longer in the cache than cheap ones,
+ *      while entries not used for a long time age out.
+ *
+ *      The policy should be set before the cache is used, or with the
+ *      cache locked.
+ *
+ * Results:
+ *      Ns_CacheGetEviction() returns the eviction policy.
+ *
+ * Side effects:
+ *      Builds or frees the eviction heap(s) of the cache.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+Ns_CacheSetEviction(Ns_Cache *cache, Ns_CacheEviction eviction)
+{
+    Cache *cachePtr = (Cache *) cache;
+
+    NS_NONNULL_ASSERT(cache != NULL);
+
+    if (cachePtr->nsegments > 0) {
+        int i;
+
+        cachePtr->eviction = eviction;
+        for (i = 0; i < cachePtr->nsegments; i++) {
+            SetEviction(cachePtr->segments[i], eviction);
+        }
+    } else {
+        SetEviction(cachePtr, eviction);
+    }
+}
+
+Ns_CacheEviction
+Ns_CacheGetEviction(const Ns_Cache *cache)
+{
+    NS_NONNULL_ASSERT(cache != NULL);
+
+    return ((const Cache *) cache)->eviction;
+}
+
 
 /*
  *----------------------------------------------------------------------
@@ -165,6 +533,20 @@ Ns_CacheDestroy(Ns_Cache *cache)
     NS_NONNULL_ASSERT(cache != NULL);
 
     (void) Ns_CacheFlush(cache);
+    if (cachePtr->nsegments > 0) {
+        int i;
+
+        for (i = 0; i < cachePtr->nsegments; i++) {
+            Ns_CacheDestroy((Ns_Cache *)cachePtr->segments[i]);
+        }
+        ns_free(cachePtr->segments);
+    }
+    if (cachePtr->sketchPtr != NULL) {
+        SketchFree(cachePtr->sketchPtr);
+    }
+    if (cachePtr->heap != NULL) {
+        ns_free(cachePtr->heap);
+    }
     Ns_MutexDestroy(&cachePtr->lock);
     Ns_CondDestroy(&cachePtr->cond);
     Tcl_DeleteHashTable(&cachePtr->entriesTable);
@@ -176,16 +558,20 @@ Ns_CacheDestroy(Ns_Cache *cache)
 /*
  *----------------------------------------------------------------------
  *
- * Ns_CacheFindEntry --
+ * Ns_CacheFindEntry, Ns_CacheFindEntryT, Ns_CacheLookupEntryT --
  *
- *      Find a cache entry given its key.
+ *      Find a cache entry given its key. Ns_CacheLookupEntryT() is
+ *      intended for management operations (like flushing) and does not
+ *      count an access: it leaves the statistics, the frequency sketch
+ *      and the LRU list unchanged.
  *
  * Results:
  *      A pointer to an Ns_Entry cache entry, or NULL if the key does
  *      not exist or the entry has expired.
  *
  * Side effects:
- *      A valid entry will move to the top of the LRU list.
+ *      A valid entry will move to the top of the LRU list (except for
+ *      Ns_CacheLookupEntryT()). Expired entries are deleted.
  *
  *----------------------------------------------------------------------
  */
@@ -198,19 +584,45 @@ Ns_CacheFindEntry(Ns_Cache *cache, const char *key)
 Ns_Entry *
 Ns_CacheFindEntryT(Ns_Cache *cache, const char *key, const Ns_CacheTransactionStack *transactionStackPtr)
 {
-    Cache               *cachePtr = (Cache *) cache;
+    NS_NONNULL_ASSERT(cache != NULL);
+    NS_NONNULL_ASSERT(key != NULL);
+
+    return CacheFindEntry((Cache *) cache, key, transactionStackPtr, NS_TRUE);
+}
+
+Ns_Entry *
+Ns_CacheLookupEntryT(Ns_Cache *cache, const char *key, const Ns_CacheTransactionStack *transactionStackPtr)
+{
+    NS_NONNULL_ASSERT(cache != NULL);
+    NS_NONNULL_ASSERT(key != NULL);
+
+    return CacheFindEntry((Cache *) cache, key, transactionStackPtr, NS_FALSE);
+}
+
+static Ns_Entry *
+CacheFindEntry(Cache *cachePtr, const char *key, const Ns_CacheTransactionStack *transactionStackPtr,
+               bool countAccess)
+{
     const Tcl_HashEntry *hPtr;
     Ns_Entry            *result = NULL;
 
-    NS_NONNULL_ASSERT(cache != NULL);
+    NS_NONNULL_ASSERT(cachePtr != NULL);
     NS_NONNULL_ASSERT(key != NULL);
 
+    if (unlikely(cachePtr->nsegments > 0)) {
+        cachePtr = SegmentForKey(cachePtr, key);
+    }
+    if (countAccess && cachePtr->sketchPtr != NULL) {
+        SketchIncrement(cachePtr->sketchPtr, KeyHash(cachePtr->keys, key));
+    }
     hPtr = Tcl_FindHashEntry(&cachePtr->entriesTable, key);
     if (unlikely(hPtr == NULL)) {
         /*
          * Entry does not exist at all.
          */
-        ++cachePtr->stats.nmiss;
+        if (countAccess) {
+            ++cachePtr->stats.nmiss;
+        }
 
     } else {
         Entry *ePtr = Tcl_GetHashValue(hPtr);
@@ -221,21 +633,25 @@ Ns_CacheFindEntryT(Ns_Cache *cache, const char *key, const Ns_CacheTransactionSt
             /*
              * Entry is being updated by some other thread.
              */
-            ++cachePtr->stats.nmiss;
+            if (countAccess) {
+                ++cachePtr->stats.nmiss;
+            }
 
         } else if (unlikely(Expired(ePtr, NULL))) {
             /*
              * Entry exists but has expired.
              */
             Ns_CacheDeleteEntry((Ns_Entry *) ePtr);
-            ++cachePtr->stats.nmiss;
+            if (countAccess) {
+                ++cachePtr->stats.nmiss;
+            }
 
         } else {
             const void *value;
 
             if (ePtr->value == NULL) {
                 value = Ns_CacheGetValueT((Ns_Entry *) ePtr, transactionStackPtr);
-                if (value == NULL) {
+                if (value == NULL && countAccess) {
                     ++cachePtr->stats.nmiss;
                 }
             } else {
@@ -245,10 +661,12 @@ Ns_CacheFindEntryT(Ns_Cache *cache, const char *key, const Ns_CacheTransactionSt
                 /*
                  * Entry is valid.
                  */
-                ++cachePtr->stats.nhit;
-                Remove(ePtr);
-                ePtr->count ++;
-                Push(ePtr);
+                if (countAccess) {
+                    CountHit(cachePtr, ePtr);
+                    Remove(ePtr);
+                    ePtr->count ++;
+                    Push(ePtr);
+                }
                 result = (Ns_Entry *) ePtr;
             }
         }
@@ -256,14 +674,17 @@ Ns_CacheFindEntryT(Ns_Cache *cache, const char *key, const Ns_CacheTransactionSt
     return result;
 }
 
-
+
 /*
  *----------------------------------------------------------------------
  *
- * Ns_CacheCreateEntry --
+ * Ns_CacheCreateEntry, Ns_CacheLookupCreateEntry --
  *
  *      Create a new cache entry or return an existing one with the
- *      given key.
+ *      given key. Ns_CacheLookupCreateEntry() does not count an access
+ *      and is intended for storing a value computed in the background
+ *      (e.g. a refresh) or for re-fetching an entry after its value was
+ *      computed.
  *
  * Results:
  *      A pointer to a cache entry.
@@ -277,56 +698,238 @@ Ns_CacheFindEntryT(Ns_Cache *cache, const char *key, const Ns_CacheTransactionSt
 Ns_Entry *
 Ns_CacheCreateEntry(Ns_Cache *cache, const char *key, int *newPtr)
 {
-    Cache         *cachePtr = (Cache *) cache;
+    NS_NONNULL_ASSERT(cache != NULL);
+    NS_NONNULL_ASSERT(key != NULL);
+    NS_NONNULL_ASSERT(newPtr != NULL);
+
+    return CacheCreateEntry((Cache *) cache, key, newPtr, NS_TRUE);
+}
+
+Ns_Entry *
+Ns_CacheLookupCreateEntry(Ns_Cache *cache, const char *key, int *newPtr)
+{
+    NS_NONNULL_ASSERT(cache != NULL);
+    NS_NONNULL_ASSERT(key != NULL);
+    NS_NONNULL_ASSERT(newPtr != NULL);
+
+    return CacheCreateEntry((Cache *) cache, key, newPtr, NS_FALSE);
+}
+
+static Ns_Entry *
+CacheCreateEntry(Cache *cachePtr, const char *key, int *newPtr, bool countAccess)
+{
     Tcl_HashEntry *hPtr;
     Entry         *ePtr;
     int            isNew;
 
-    NS_NONNULL_ASSERT(cache != NULL);
+    NS_NONNULL_ASSERT(cachePtr != NULL);
     NS_NONNULL_ASSERT(key != NULL);
     NS_NONNULL_ASSERT(newPtr != NULL);
 
+    if (unlikely(cachePtr->nsegments > 0)) {
+        cachePtr = SegmentForKey(cachePtr, key);
+    }
     hPtr = Tcl_CreateHashEntry(&cachePtr->entriesTable, key, &isNew);
     if (isNew != 0) {
         ePtr = ns_calloc(1u, sizeof(Entry));
         ePtr->hPtr = hPtr;
         ePtr->cachePtr = cachePtr;
         Tcl_SetHashValue(hPtr, ePtr);
-        cachePtr->currentSize += (sizeof(Entry) + sizeof(Tcl_HashEntry) + strlen(key));
-        ++cachePtr->stats.nmiss;
+        SizeIncr(cachePtr, sizeof(Entry) + sizeof(Tcl_HashEntry) + strlen(key));
+        if (countAccess) {
+            ++cachePtr->stats.nmiss;
+        }
+        Push(ePtr);
     } else {
         ePtr = Tcl_GetHashValue(hPtr);
         if (Expired(ePtr, NULL)) {
-            ++cachePtr->stats.nexpired;
+            if (countAccess) {
+                ++cachePtr->stats.nexpired;
+            }
             Ns_CacheUnsetValue((Ns_Entry *) ePtr);
             isNew = 1;
-        } else {
+        } else if (!countAccess) {
+            /*
+             * Leave the LRU position and the counts of the entry unchanged.
+             */
+        } else if (ePtr->value != NULL || ePtr->uncommittedValue != NULL) {
             ePtr->count ++;
-            ++cachePtr->stats.nhit;
+            CountHit(cachePtr, ePtr);
+        } else {
+            /*
+             * The entry is under concurrent update. The miss was already
+             * counted, when the entry was created.
+             */
         }
-        Remove(ePtr);
+        if (countAccess || isNew != 0) {
+            Remove(ePtr);
+            Push(ePtr);
+        }
+    }
+    if (countAccess && cachePtr->sketchPtr != NULL && (isNew != 0 || ePtr->value != NULL)) {
+        /*
+         * Count the access, but not the repeated lookups of an entry under
+         * concurrent update.
+         */
+        SketchIncrement(cachePtr->sketchPtr, KeyHash(cachePtr->keys, key));
     }
-    Push(ePtr);
     *newPtr = isNew;
 
     return (Ns_Entry *) ePtr;
 }
 
-
+
 /*
  *----------------------------------------------------------------------
  *
- * Ns_CacheWaitCreateEntry --
+ * Ns_CacheFindEntryStale --
  *
- *      Create a new cache entry or return an existing one with the
- *      given key.  Wait until the given absolute timeout for another
- *      thread to complete an update.
+ *      Find an entry with a (committed) value for serving it
+ *      stale-while-revalidate. In contrast to Ns_CacheFindEntry(), an
+ *      expired entry is returned as long its expiry time is not longer
+ *      ago than the "staleTimePtr" (relative time, might be NULL).
+ *
+ *      When the returned entry is expired, or when it expires within the
+ *      relative time "refreshTimePtr" (might be NULL), and no refresh of
+ *      the entry is pending, the entry is marked as refreshing and
+ *      "*refreshPtr" is set to true. The caller is then responsible to
+ *      refresh the value (e.g. via a background job), or to call
+ *      Ns_CacheRefreshDone() when this fails. Setting a new
+ *      value clears the refreshing state as well.
  *
  * Results:
- *      A pointer to a new cache entry, or NULL on timeout.
+ *      Pointer to the entry or NULL, when there is no usable entry.
  *
  * Side effects:
- *      Cache lock may be released and re-acquired.
+ *      Updates the statistics and the LRU list for returned entries;
+ *      expired values are counted as stale, not as hits. Misses are not
+ *      counted, since the caller will typically continue
+ *      with Ns_CacheCreateEntry() or Ns_CacheWaitCreateEntry().
+ *
+ *----------------------------------------------------------------------
+ */
+
+Ns_Entry *
+Ns_CacheFindEntryStale(Ns_Cache *cache, const char *key, const Ns_Time *staleTimePtr,
+                       const Ns_Time *refreshTimePtr, bool *refreshPtr)
+{
+    Cache               *cachePtr = (Cache *) cache;
+    const Tcl_HashEntry *hPtr;
+    Ns_Entry            *result = NULL;
+
+    NS_NONNULL_ASSERT(cache != NULL);
+    NS_NONNULL_ASSERT(key != NULL);
+    NS_NONNULL_ASSERT(refreshPtr != NULL);
+
+    *refreshPtr = NS_FALSE;
+    if (unlikely(cachePtr->nsegments > 0)) {
+        cachePtr = SegmentForKey(cachePtr, key);
+    }
+    hPtr = Tcl_FindHashEntry(&cachePtr->entriesTable, key);
+    if (hPtr != NULL) {
+        Entry   *ePtr = Tcl_GetHashValue(hPtr);
+        Ns_Time  now, limit;
+        bool     refresh = NS_FALSE, stale = NS_FALSE;
+
+        if (ePtr->value != NULL) {
+            result = (Ns_Entry *) ePtr;
+
+            if (ePtr->expires.sec > 0) {
+                Ns_GetTime(&now);
+                if (Expired(ePtr, &now)) {
+                    limit = ePtr->expires;
+                    if (staleTimePtr != NULL) {
+                        Ns_IncrTime(&limit, staleTimePtr->sec, staleTimePtr->usec);
+                    }
+                    if (Ns_DiffTime(&limit, &now, NULL) < 0) {
+                        result = NULL;
+                    } else {
+                        ++cachePtr->stats.nstale;
+                        refresh = NS_TRUE;
+                        stale = NS_TRUE;
+                    }
+                } else if (refreshTimePtr != NULL) {
+                    limit = now;
+                    Ns_IncrTime(&limit, refreshTimePtr->sec, refreshTimePtr->usec);
+                    refresh = (Ns_DiffTime(&ePtr->expires, &limit, NULL) < 0);
+                }
+            }
+        }
+        if (result != NULL) {
+            if (refresh && !ePtr->refreshing) {
+                ePtr->refreshing = NS_TRUE;
+                *refreshPtr = NS_TRUE;
+            }
+            if (cachePtr->sketchPtr != NULL) {
+                SketchIncrement(cachePtr->sketchPtr, KeyHash(cachePtr->keys, key));
+            }
+            if (!stale) {
+                /*
+                 * Serving an expired value is counted via "nstale" only.
+                 */
+                CountHit(cachePtr, ePtr);
+            }
+            Remove(ePtr);
+            ePtr->count ++;
+            Push(ePtr);
+        }
+    }
+    return result;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Ns_CacheRefreshDone --
+ *
+ *      Clear the refreshing state of the entry with the given key, set by
+ *      Ns_CacheFindEntryStale(), e.g. when the refresh failed. The entry
+ *      is not touched otherwise, in particular, an expired value is kept.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      A later call of Ns_CacheFindEntryStale() might trigger a new
+ *      refresh.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+Ns_CacheRefreshDone(Ns_Cache *cache, const char *key)
+{
+    Cache               *cachePtr = (Cache *) cache;
+    const Tcl_HashEntry *hPtr;
+
+    NS_NONNULL_ASSERT(cache != NULL);
+    NS_NONNULL_ASSERT(key != NULL);
+
+    if (unlikely(cachePtr->nsegments > 0)) {
+        cachePtr = SegmentForKey(cachePtr, key);
+    }
+    hPtr = Tcl_FindHashEntry(&cachePtr->entriesTable, key);
+    if (hPtr != NULL) {
+        ((Entry *) Tcl_GetHashValue(hPtr))->refreshing = NS_FALSE;
+    }
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Ns_CacheWaitCreateEntry --
+ *
+ *      Create a new cache entry or return an existing one with the
+ *      given key.  Wait until the given absolute timeout for another
+ *      thread to complete an update.
+ *
+ * Results:
+ *      A pointer to a new cache entry, or NULL on timeout.
+ *
+ * Side effects:
+ *      Cache lock may be released and re-acquired.
  *
  *----------------------------------------------------------------------
  */
@@ -349,6 +952,10 @@ Ns_CacheWaitCreateEntryT(Ns_Cache *cache, const char *key, int *newPtr,
     NS_NONNULL_ASSERT(key != NULL);
     NS_NONNULL_ASSERT(newPtr != NULL);
 
+    /*
+     * Waiting has to happen on the condition variable of the segment.
+     */
+    cache = Ns_CacheSegment(cache, key);
     entry = Ns_CacheCreateEntry(cache, key, &isNew);
 
     if (isNew == 0 && Ns_CacheGetValueT(entry, transactionStackPtr) == NULL) {
@@ -562,11 +1169,20 @@ TCL_SIZE_T
 Ns_CacheGetNrUncommittedEntries(const Ns_Cache *cache)
 {
     const Cache *cachePtr;
+    TCL_SIZE_T   result;
 
     NS_NONNULL_ASSERT(cache != NULL);
 
     cachePtr = (const Cache *)cache;
-    return cachePtr->uncommittedTable.numEntries;
+    result = cachePtr->uncommittedTable.numEntries;
+    if (cachePtr->nsegments > 0) {
+        int i;
+
+        for (i = 0; i < cachePtr->nsegments; i++) {
+            result += cachePtr->segments[i]->uncommittedTable.numEntries;
+        }
+    }
+    return result;
 }
 
 
@@ -586,8 +1202,9 @@ Ns_CacheGetNrUncommittedEntries(const Ns_Cache *cache)
  *      The previous maximum size of the cache.
  *
  * Side Effects:
- *      Updates the cache's maxsize parameter. Callers must ensure proper
- *      locking to avoid races with concurrent cache operations.
+ *      Updates the cache's maxsize parameter and the copies in its
+ *      segments. Callers must ensure proper locking (Ns_CacheLock()) to
+ *      avoid races with concurrent cache operations.
  *
  *----------------------------------------------------------------------
  */
@@ -601,7 +1218,7 @@ Ns_CacheSetMaxsize(Ns_Cache *cache, size_t size)
 
     cachePtr = (Cache*)cache;
     oldSize = cachePtr->maxSize;
-    cachePtr->maxSize = size;
+    Ns_CacheSetMaxSize(cache, size);
     return oldSize;
 }
 
@@ -616,10 +1233,13 @@ Ns_CacheSetMaxsize(Ns_Cache *cache, size_t size)
  *      it is back under the maximum size.
  *
  * Results:
- *      None.
+ *      Ns_CacheSetValueExpires() returns 1 when the value was stored as
+ *      an uncommitted value, 0 when it was stored, and -1 when the
+ *      admission policy rejected the new entry.
  *
  * Side effects:
- *      Cache pruning and freeing of old contents may occur.
+ *      Cache pruning and freeing of old contents may occur. When the
+ *      admission policy rejects a new entry, the entry is deleted.
  *
  *----------------------------------------------------------------------
  */
@@ -645,7 +1265,7 @@ Ns_CacheSetValueExpires(Ns_Entry *entry, void *value, size_t size,
                         const Ns_Time *timeoutPtr, int cost, size_t maxSize,
                         uintptr_t transactionEpoch)
 {
-    Entry *ePtr;
+    Entry *ePtr, *victimPtr;
     Cache *cachePtr;
     int    result;
 
@@ -676,38 +1296,79 @@ Ns_CacheSetValueExpires(Ns_Entry *entry, void *value, size_t size,
     ePtr->size = size;
     ePtr->cost = cost;
     ePtr->count = 1;
+    ePtr->refreshing = NS_FALSE;
 
     if (timeoutPtr != NULL) {
         ePtr->expires = *timeoutPtr;
     }
-    cachePtr->currentSize += size;
+    SizeIncr(cachePtr, size);
+    if (cachePtr->eviction == NS_CACHE_EVICT_COST && transactionEpoch == 0u) {
+        /*
+         * Pending (uncommitted) values are added to the eviction heap on
+         * commit. Otherwise, they could become the eviction candidate,
+         * which can't be evicted, and block pruning.
+         */
+        ePtr->priority = Priority(cachePtr, ePtr);
+        HeapPush(cachePtr, ePtr);
+    }
 
     if (maxSize == 0u) {
         /*
          * Use the maxSize setting as configured in cPtr
          */
         maxSize = cachePtr->maxSize;
-    } else if (maxSize != cachePtr->maxSize) {
+    } else {
         /*
-         * Update the cache max size via the provided setting
+         * Update the cache max size via the provided setting. Only the own
+         * (locked) segment is updated here; the container and the other
+         * segments are updated via Ns_CacheSetMaxsize().
          */
-        cachePtr->maxSize = maxSize;
+        if (maxSize != cachePtr->maxSize) {
+            cachePtr->maxSize = maxSize;
+        }
     }
 
-    if (maxSize > 0u) {
+    if (maxSize > 0u
+        && cachePtr->sketchPtr != NULL
+        && !ePtr->admitted
+        && transactionEpoch == 0u
+        && TotalSize(cachePtr) > maxSize
+        && (victimPtr = Victim(cachePtr, ePtr)) != NULL
+        && victimPtr->value != NULL
+        && !Admit(cachePtr, ePtr, victimPtr)
+        ) {
         /*
-         * Make space for the new entry, but don't delete the current
-         * entry, and don't delete other newborn entries (with a value
-         * of NULL) of some other threads which are concurrently
-         * created.  There might be concurrent updates, since
-         * e.g. nscache_eval releases its mutex.
+         * The new entry requires an eviction, but it is used less
+         * frequently than the eviction candidate. Keep the cached entries
+         * and drop the new one.
          */
-        while (cachePtr->currentSize > maxSize
-               && cachePtr->lastEntryPtr != ePtr
-               && cachePtr->lastEntryPtr->value != NULL
-               ) {
-            Ns_CacheDeleteEntry((Ns_Entry *) cachePtr->lastEntryPtr);
-            ++cachePtr->stats.npruned;
+        ++cachePtr->stats.nrejected;
+        Ns_CacheDeleteEntry(entry);
+        result = -1;
+
+    } else {
+        ePtr->admitted = NS_TRUE;
+
+        if (maxSize > 0u) {
+            /*
+             * Make space for the new entry, but don't delete the current
+             * entry, and don't delete other newborn entries (with a value
+             * of NULL) of some other threads which are concurrently
+             * created.  There might be concurrent updates, since
+             * e.g. nscache_eval releases its mutex. Segments can only evict
+             * their own entries, and only when the total size of all
+             * segments exceeds the budget.
+             */
+            while (TotalSize(cachePtr) > maxSize
+                   && (victimPtr = Victim(cachePtr, ePtr)) != NULL
+                   && victimPtr->value != NULL
+                   ) {
+                if (cachePtr->eviction == NS_CACHE_EVICT_COST) {
+                    cachePtr->inflation = victimPtr->priority;
+                }
+                Ns_CacheDeleteEntry((Ns_Entry *) victimPtr);
+                ++cachePtr->stats.npruned;
+            }
         }
     }
     return result;
@@ -761,7 +1422,10 @@ Ns_CacheUnsetValue(Ns_Entry *entry)
         }
 
         cachePtr = ePtr->cachePtr;
-        cachePtr->currentSize -= ePtr->size;
+        SizeDecr(cachePtr, ePtr->size);
+        if (ePtr->heapIndex != 0u) {
+            HeapRemove(cachePtr, ePtr);
+        }
         ePtr->size = 0u;
         ePtr->expires.sec = ePtr->expires.usec = 0;
 
@@ -813,7 +1477,7 @@ Ns_CacheDeleteEntry(Ns_Entry *entry)
 
     ePtr = (Entry *) entry;
     key = Tcl_GetHashKey(&ePtr->cachePtr->entriesTable, ePtr->hPtr);
-    ePtr->cachePtr->currentSize -= (sizeof(Entry) + sizeof(Tcl_HashEntry) + strlen(key));
+    SizeDecr(ePtr->cachePtr, sizeof(Entry) + sizeof(Tcl_HashEntry) + strlen(key));
     Ns_CacheUnsetValue(entry);
     Remove(ePtr);
     Tcl_DeleteHashEntry(ePtr->hPtr);
@@ -893,27 +1557,19 @@ Ns_CacheFirstEntryT(Ns_Cache *cache, Ns_CacheSearch *search, const Ns_CacheTrans
 {
     Cache               *cachePtr = (Cache *) cache;
     const Tcl_HashEntry *hPtr;
-    Ns_Entry            *result = NULL;
 
     NS_NONNULL_ASSERT(cache != NULL);
     NS_NONNULL_ASSERT(search != NULL);
 
     Ns_GetTime(&search->now);
+    search->cache = cache;
+    search->segment = 0;
+    if (cachePtr->nsegments > 0) {
+        cachePtr = cachePtr->segments[0];
+    }
     hPtr = Tcl_FirstHashEntry(&cachePtr->entriesTable, &search->hsearch);
-    while (hPtr != NULL) {
-        Ns_Entry  *entry = Tcl_GetHashValue(hPtr);
 
-        if (Ns_CacheGetValueT(entry, transactionStackPtr) != NULL) {
-            if (!Expired((Entry *) entry, &search->now)) {
-                result = entry;
-                break;
-            }
-            ++cachePtr->stats.nexpired;
-            Ns_CacheDeleteEntry(entry);
-        }
-        hPtr = Tcl_NextHashEntry(&search->hsearch);
-    }
-    return result;
+    return SearchEntries(search, hPtr, transactionStackPtr);
 }
 
 
@@ -1004,6 +1660,14 @@ CacheTransaction(Cache *cachePtr, uintptr_t epoch, bool commit)
 
     NS_NONNULL_ASSERT(cachePtr != NULL);
 
+    if (cachePtr->nsegments > 0) {
+        int i;
+
+        for (i = 0; i < cachePtr->nsegments; i++) {
+            count += CacheTransaction(cachePtr->segments[i], epoch, commit);
+        }
+    }
+
     hPtr = Tcl_FirstHashEntry(&cachePtr->uncommittedTable, &search.hsearch);
     while (hPtr != NULL) {
         Ns_Entry  *entry = (Ns_Entry *)Tcl_GetHashKey(&cachePtr->uncommittedTable, hPtr);
@@ -1015,6 +1679,10 @@ CacheTransaction(Cache *cachePtr, uintptr_t epoch, bool commit)
                 e->value = e->uncommittedValue;
                 e->uncommittedValue = NULL;
                 e->transactionEpoch = 0u;
+                if (cachePtr->eviction == NS_CACHE_EVICT_COST) {
+                    e->priority = Priority(cachePtr, e);
+                    HeapPush(cachePtr, e);
+                }
 
                 Tcl_DeleteHashEntry(hPtr);
             } else {
@@ -1057,24 +1725,61 @@ Ns_CacheNextEntry(Ns_CacheSearch *search)
 Ns_Entry *
 Ns_CacheNextEntryT(Ns_CacheSearch *search, const Ns_CacheTransactionStack *transactionStackPtr)
 {
-    const Tcl_HashEntry  *hPtr;
-    Ns_Entry             *result = NULL;
+    NS_NONNULL_ASSERT(search != NULL);
+
+    return SearchEntries(search, Tcl_NextHashEntry(&search->hsearch), transactionStackPtr);
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SearchEntries --
+ *
+ *      Helper for Ns_CacheFirstEntryT() and Ns_CacheNextEntryT(). Starting
+ *      with the provided hash entry, return the first valid entry. In
+ *      segmented caches, the search continues with the next segment, when
+ *      the hash table of the current segment is exhausted.
+ *
+ * Results:
+ *      Pointer to next valid entry, or NULL when all entries visited.
+ *
+ * Side effects:
+ *      Expired entries are flushed, concurrent updates skipped.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Ns_Entry *
+SearchEntries(Ns_CacheSearch *search, const Tcl_HashEntry *hPtr,
+              const Ns_CacheTransactionStack *transactionStackPtr)
+{
+    const Cache *cachePtr;
+    Ns_Entry    *result = NULL;
 
     NS_NONNULL_ASSERT(search != NULL);
 
-    hPtr = Tcl_NextHashEntry(&search->hsearch);
-    while (hPtr != NULL) {
-        Ns_Entry *entry = Tcl_GetHashValue(hPtr);
+    cachePtr = (const Cache *)search->cache;
 
-        if (Ns_CacheGetValueT(entry, transactionStackPtr) != NULL) {
-            if (!Expired((Entry *) entry, &search->now)) {
-                result = entry;
-                break;
+    for (;;) {
+        while (hPtr != NULL) {
+            Ns_Entry *entry = Tcl_GetHashValue(hPtr);
+
+            if (Ns_CacheGetValueT(entry, transactionStackPtr) != NULL) {
+                if (!Expired((Entry *) entry, &search->now)) {
+                    result = entry;
+                    break;
+                }
+                ((Entry *) entry)->cachePtr->stats.nexpired++;
+                Ns_CacheDeleteEntry(entry);
             }
-            ((Entry *) entry)->cachePtr->stats.nexpired++;
-            Ns_CacheDeleteEntry(entry);
+            hPtr = Tcl_NextHashEntry(&search->hsearch);
         }
-        hPtr = Tcl_NextHashEntry(&search->hsearch);
+        if (result != NULL || ++search->segment >= cachePtr->nsegments) {
+            break;
+        }
+        hPtr = Tcl_FirstHashEntry(&cachePtr->segments[search->segment]->entriesTable,
+                                  &search->hsearch);
     }
     return result;
 }
@@ -1085,7 +1790,7 @@ Ns_CacheNextEntryT(Ns_CacheSearch *search, const Ns_CacheTransactionStack *trans
  *
  * Ns_CacheLock --
  *
- *      Lock the cache.
+ *      Lock the cache. Locking a segmented cache locks all segments.
  *
  * Results:
  *      None.
@@ -1103,6 +1808,13 @@ Ns_CacheLock(Ns_Cache *cache)
 
     NS_NONNULL_ASSERT(cache != NULL);
     Ns_MutexLock(&cachePtr->lock);
+    if (cachePtr->nsegments > 0) {
+        int i;
+
+        for (i = 0; i < cachePtr->nsegments; i++) {
+            Ns_MutexLock(&cachePtr->segments[i]->lock);
+        }
+    }
 }
 
 
@@ -1127,8 +1839,29 @@ Ns_CacheTryLock(Ns_Cache *cache)
 {
     Cache *cachePtr = (Cache *) cache;
 
+    Ns_ReturnCode status;
+
     NS_NONNULL_ASSERT(cache != NULL);
-    return Ns_MutexTryLock(&cachePtr->lock);
+
+    status = Ns_MutexTryLock(&cachePtr->lock);
+    if (status == NS_OK && cachePtr->nsegments > 0) {
+        int i;
+
+        for (i = 0; i < cachePtr->nsegments; i++) {
+            status = Ns_MutexTryLock(&cachePtr->segments[i]->lock);
+            if (status != NS_OK) {
+                /*
+                 * Release the locks obtained so far.
+                 */
+                while (i-- > 0) {
+                    Ns_MutexUnlock(&cachePtr->segments[i]->lock);
+                }
+                Ns_MutexUnlock(&cachePtr->lock);
+                break;
+            }
+        }
+    }
+    return status;
 }
 
 
@@ -1154,6 +1887,13 @@ Ns_CacheUnlock(Ns_Cache *cache)
     Cache *cachePtr = (Cache *) cache;
 
     NS_NONNULL_ASSERT(cache != NULL);
+    if (cachePtr->nsegments > 0) {
+        int i;
+
+        for (i = cachePtr->nsegments - 1; i >= 0; i--) {
+            Ns_MutexUnlock(&cachePtr->segments[i]->lock);
+        }
+    }
     Ns_MutexUnlock(&cachePtr->lock);
 }
 
@@ -1246,6 +1986,13 @@ Ns_CacheBroadcast(Ns_Cache *cache)
 
     NS_NONNULL_ASSERT(cache != NULL);
     Ns_CondBroadcast(&cachePtr->cond);
+    if (cachePtr->nsegments > 0) {
+        int i;
+
+        for (i = 0; i < cachePtr->nsegments; i++) {
+            Ns_CondBroadcast(&cachePtr->segments[i]->cond);
+        }
+    }
 }
 
 
@@ -1270,33 +2017,56 @@ Ns_CacheStats(Ns_Cache *cache, Tcl_DString *dest)
 {
     const Cache    *cachePtr;
     unsigned long   count;
-    const Entry    *ePtr;
-    Ns_CacheSearch  search;
-    double          savedCost = 0.0, hitrate;
+    CacheStats      stats;
+    TCL_SIZE_T      nentries;
+    double          hitrate;
 
     NS_NONNULL_ASSERT(cache != NULL);
     NS_NONNULL_ASSERT(dest != NULL);
 
     cachePtr = (Cache *)cache;
-    count = cachePtr->stats.nhit + cachePtr->stats.nmiss;
-    hitrate = ((count != 0u) ? ((double)cachePtr->stats.nhit * 100.0) / (double)count : 0.0);
+    stats = cachePtr->stats;
+    nentries = cachePtr->entriesTable.numEntries;
+    if (cachePtr->nsegments > 0) {
+        int i;
 
-    ePtr = (Entry *)Ns_CacheFirstEntry(cache, &search);
-    while (ePtr != NULL) {
-        savedCost += ((double)ePtr->count * (double)ePtr->cost) / 1000000.0;
-        ePtr = (Entry *)Ns_CacheNextEntry(&search);
+        /*
+         * Sum up the statistics of the segments.
+         */
+        for (i = 0; i < cachePtr->nsegments; i++) {
+            const Cache *segmentPtr = cachePtr->segments[i];
+
+            stats.nhit      += segmentPtr->stats.nhit;
+            stats.nmiss     += segmentPtr->stats.nmiss;
+            stats.nexpired  += segmentPtr->stats.nexpired;
+            stats.nflushed  += segmentPtr->stats.nflushed;
+            stats.npruned   += segmentPtr->stats.npruned;
+            stats.ncommit   += segmentPtr->stats.ncommit;
+            stats.nrollback += segmentPtr->stats.nrollback;
+            stats.nrejected += segmentPtr->stats.nrejected;
+            stats.saved     += segmentPtr->stats.saved;
+            stats.nstale    += segmentPtr->stats.nstale;
+            nentries        += segmentPtr->entriesTable.numEntries;
+        }
     }
+    count = stats.nhit + stats.nmiss;
+    hitrate = ((count != 0u) ? ((double)stats.nhit * 100.0) / (double)count : 0.0);
 
     return Ns_DStringPrintf(dest, "maxsize %lu size %lu entries %" PRITcl_Size
                " flushed %lu hits %lu missed %lu hitrate %.2f"
-               " expired %lu pruned %lu commit %lu rollback %lu saved %.6f",
+               " expired %lu pruned %lu commit %lu rollback %lu saved %.6f"
+               " segments %d admission %s rejected %lu eviction %s stale %lu",
                (unsigned long) cachePtr->maxSize,
-               (unsigned long) cachePtr->currentSize,
-               cachePtr->entriesTable.numEntries, cachePtr->stats.nflushed,
-               cachePtr->stats.nhit, cachePtr->stats.nmiss, hitrate,
-                            cachePtr->stats.nexpired, cachePtr->stats.npruned,
-                            cachePtr->stats.ncommit, cachePtr->stats.nrollback,
-                            savedCost);
+               (unsigned long) TotalSize(cachePtr),
+               nentries, stats.nflushed,
+               stats.nhit, stats.nmiss, hitrate,
+                            stats.nexpired, stats.npruned,
+                            stats.ncommit, stats.nrollback,
+                            stats.saved, Ns_CacheGetSegments(cache),
+                            cachePtr->admission == NS_CACHE_ADMIT_TINYLFU ? "tinylfu" : "all",
+                            stats.nrejected,
+                            cachePtr->eviction == NS_CACHE_EVICT_COST ? "cost" : "lru",
+                            stats.nstale);
 }
 
 
@@ -1323,6 +2093,13 @@ Ns_CacheResetStats(Ns_Cache *cache)
 
     NS_NONNULL_ASSERT(cache != NULL);
     memset(&cachePtr->stats, 0, sizeof(cachePtr->stats));
+    if (cachePtr->nsegments > 0) {
+        int i;
+
+        for (i = 0; i < cachePtr->nsegments; i++) {
+            memset(&cachePtr->segments[i]->stats, 0, sizeof(cachePtr->stats));
+        }
+    }
 }
 
 
@@ -1345,9 +2122,15 @@ Ns_CacheResetStats(Ns_Cache *cache)
 void
 Ns_CacheSetMaxSize(Ns_Cache *cache, size_t maxSize)
 {
+    Cache *cachePtr = (Cache *) cache;
+    int    i;
+
     NS_NONNULL_ASSERT(cache != NULL);
 
-    ((Cache *) cache)->maxSize = maxSize;
+    cachePtr->maxSize = maxSize;
+    for (i = 0; i < cachePtr->nsegments; i++) {
+        cachePtr->segments[i]->maxSize = maxSize;
+    }
 }
 
 size_t
@@ -1397,6 +2180,577 @@ Expired(const Entry *ePtr, const Ns_Time *nowPtr)
 }
 
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * SegmentForKey --
+ *
+ *      Select the segment of a segmented cache for the provided key. The
+ *      key is hashed with FNV-1a according to the key type of the cache.
+ *
+ * Results:
+ *      Pointer to the segment.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Cache *
+SegmentForKey(const Cache *cachePtr, const char *key)
+{
+    uint32_t hash;
+
+    NS_NONNULL_ASSERT(cachePtr != NULL);
+    NS_NONNULL_ASSERT(key != NULL);
+    assert(cachePtr->nsegments > 0);
+
+    /*
+     * Fold the high bits in, since the lower bits of FNV-1a are mixed
+     * weakest.
+     */
+    hash = KeyHash(cachePtr->keys, key);
+    hash ^= hash >> 16;
+
+    return cachePtr->segments[hash & (uint32_t)(cachePtr->nsegments - 1)];
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * KeyHash --
+ *
+ *      Compute the FNV-1a hash of a key according to the key type of a
+ *      cache.
+ *
+ * Results:
+ *      Hash value.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static uint32_t
+KeyHash(int keys, const char *key)
+{
+    const unsigned char *p, *end;
+    uint32_t             hash = 2166136261u;
+
+    NS_NONNULL_ASSERT(key != NULL);
+
+    if (keys == TCL_STRING_KEYS) {
+        for (p = (const unsigned char *)key; *p != 0u; p++) {
+            hash = (hash ^ *p) * 16777619u;
+        }
+    } else {
+        uintptr_t word = (uintptr_t)key;
+
+        if (keys == TCL_ONE_WORD_KEYS) {
+            p = (const unsigned char *)&word;
+            end = p + sizeof(word);
+        } else {
+            p = (const unsigned char *)key;
+            end = p + (size_t)keys * sizeof(int);
+        }
+        for (; p < end; p++) {
+            hash = (hash ^ *p) * 16777619u;
+        }
+    }
+    return hash;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SketchCreate, SketchFree --
+ *
+ *      Create/free a frequency sketch. The width of the sketch is
+ *      derived from the estimated number of entries of a cache with the
+ *      given maximum size.
+ *
+ * Results:
+ *      SketchCreate() returns the new sketch.
+ *
+ * Side effects:
+ *      Memory allocation/deallocation.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static FrequencySketch *
+SketchCreate(size_t maxSize)
+{
+    FrequencySketch *sketchPtr;
+    size_t           nentries = maxSize / 128u;
+    unsigned int     bits = 8u;
+
+    while (bits < 20u && ((size_t)1u << bits) < nentries) {
+        bits++;
+    }
+    sketchPtr = ns_calloc(1u, sizeof(FrequencySketch));
+    sketchPtr->widthBits = bits;
+    sketchPtr->sampleSize = 10u << bits;
+    sketchPtr->counters = ns_calloc((size_t)SKETCH_DEPTH << bits, sizeof(uint8_t));
+
+    return sketchPtr;
+}
+
+static void
+SketchFree(FrequencySketch *sketchPtr)
+{
+    NS_NONNULL_ASSERT(sketchPtr != NULL);
+
+    ns_free(sketchPtr->counters);
+    ns_free(sketchPtr);
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SketchIncrement, SketchFrequency --
+ *
+ *      Count an access to a key, identified by its hash value, or
+ *      estimate the number of accesses as the minimum of the counters
+ *      of all rows. Every row uses a different multiplier for
+ *      determining the counter of a hash value.
+ *
+ * Results:
+ *      SketchFrequency() returns the estimated frequency.
+ *
+ * Side effects:
+ *      SketchIncrement() halves all counters when the sample size is
+ *      reached.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static const uint32_t sketchSeeds[SKETCH_DEPTH] = {
+    0x9e3779b1u, 0x85ebca77u, 0xc2b2ae3du, 0x27d4eb2fu
+};
+
+static void
+SketchIncrement(FrequencySketch *sketchPtr, uint32_t hash)
+{
+    unsigned int row;
+    bool         added = NS_FALSE;
+
+    NS_NONNULL_ASSERT(sketchPtr != NULL);
+
+    for (row = 0u; row < SKETCH_DEPTH; row++) {
+        uint32_t  idx = (hash * sketchSeeds[row]) >> (32u - sketchPtr->widthBits);
+        uint8_t  *counterPtr = &sketchPtr->counters[(row << sketchPtr->widthBits) + idx];
+
+        if (*counterPtr < SKETCH_MAXCOUNT) {
+            (*counterPtr)++;
+            added = NS_TRUE;
+        }
+    }
+    if (added && ++sketchPtr->additions >= sketchPtr->sampleSize) {
+        size_t i, n = (size_t)SKETCH_DEPTH << sketchPtr->widthBits;
+
+        for (i = 0u; i < n; i++) {
+            sketchPtr->counters[i] >>= 1;
+        }
+        sketchPtr->additions /= 2u;
+    }
+}
+
+static unsigned int
+SketchFrequency(const FrequencySketch *sketchPtr, uint32_t hash)
+{
+    unsigned int row, result = SKETCH_MAXCOUNT;
+
+    NS_NONNULL_ASSERT(sketchPtr != NULL);
+
+    for (row = 0u; row < SKETCH_DEPTH; row++) {
+        uint32_t     idx = (hash * sketchSeeds[row]) >> (32u - sketchPtr->widthBits);
+        unsigned int count = sketchPtr->counters[(row << sketchPtr->widthBits) + idx];
+
+        if (count < result) {
+            result = count;
+        }
+    }
+    return result;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Admit --
+ *
+ *      TinyLFU admission: decide whether a new entry should replace the
+ *      eviction candidate, based on their estimated access frequencies.
+ *
+ * Results:
+ *      NS_TRUE if the new entry should be admitted.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static bool
+Admit(const Cache *cachePtr, const Entry *candidatePtr, const Entry *victimPtr)
+{
+    const char *candidateKey, *victimKey;
+
+    NS_NONNULL_ASSERT(cachePtr != NULL);
+    NS_NONNULL_ASSERT(candidatePtr != NULL);
+    NS_NONNULL_ASSERT(victimPtr != NULL);
+    assert(cachePtr->sketchPtr != NULL);
+
+    candidateKey = Tcl_GetHashKey(&cachePtr->entriesTable, candidatePtr->hPtr);
+    victimKey = Tcl_GetHashKey(&cachePtr->entriesTable, victimPtr->hPtr);
+
+    return (SketchFrequency(cachePtr->sketchPtr, KeyHash(cachePtr->keys, candidateKey))
+            > SketchFrequency(cachePtr->sketchPtr, KeyHash(cachePtr->keys, victimKey)));
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SizeIncr, SizeDecr, TotalSize --
+ *
+ *      Maintain the size of a cache. The sizes of segments are
+ *      additionally accumulated in the segmented cache, which is the
+ *      basis for size-based eviction.
+ *
+ * Results:
+ *      TotalSize() returns the size relevant for the size limit.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+SizeIncr(Cache *cachePtr, size_t size)
+{
+    NS_NONNULL_ASSERT(cachePtr != NULL);
+
+    cachePtr->currentSize += size;
+    if (cachePtr->parentPtr != NULL) {
+        (void) NS_ATOMIC_FETCH_ADD(&cachePtr->parentPtr->segmentedSize, (int64_t)size);
+    }
+}
+
+static void
+SizeDecr(Cache *cachePtr, size_t size)
+{
+    NS_NONNULL_ASSERT(cachePtr != NULL);
+
+    cachePtr->currentSize -= size;
+    if (cachePtr->parentPtr != NULL) {
+        (void) NS_ATOMIC_FETCH_ADD(&cachePtr->parentPtr->segmentedSize, -(int64_t)size);
+    }
+}
+
+static size_t
+TotalSize(const Cache *cachePtr)
+{
+    size_t result;
+
+    NS_NONNULL_ASSERT(cachePtr != NULL);
+
+    if (cachePtr->parentPtr != NULL) {
+        cachePtr = cachePtr->parentPtr;
+    }
+    if (cachePtr->nsegments > 0) {
+        result = (size_t)NS_ATOMIC_LOAD(&cachePtr->segmentedSize);
+    } else {
+        result = cachePtr->currentSize;
+    }
+    return result;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * CountHit --
+ *
+ *      Account for a cache hit. The recompute time of the entry is added
+ *      to the saved time, which therefore includes as well hits on
+ *      entries evicted or flushed in the meantime. For cost based eviction, the priority of the
+ *      entry is refreshed.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Updates statistics and potentially the eviction heap.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+CountHit(Cache *cachePtr, Entry *ePtr)
+{
+    NS_NONNULL_ASSERT(cachePtr != NULL);
+    NS_NONNULL_ASSERT(ePtr != NULL);
+
+    ++cachePtr->stats.nhit;
+    cachePtr->stats.saved += (double)ePtr->cost / 1000000.0;
+    if (ePtr->heapIndex != 0u) {
+        ePtr->priority = Priority(cachePtr, ePtr);
+        HeapUpdate(cachePtr, ePtr);
+    }
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Victim --
+ *
+ *      Return the entry to be evicted next according to the eviction
+ *      policy, but never the provided entry (the entry currently being
+ *      set). In LRU mode, this is the tail of the LRU list; in cost mode,
+ *      the entry with the lowest priority.
+ *
+ * Results:
+ *      Entry or NULL, when there is no eviction candidate.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Entry *
+Victim(const Cache *cachePtr, const Entry *exceptPtr)
+{
+    Entry *result;
+
+    NS_NONNULL_ASSERT(cachePtr != NULL);
+    NS_NONNULL_ASSERT(exceptPtr != NULL);
+
+    if (cachePtr->eviction == NS_CACHE_EVICT_COST && cachePtr->heapSize > 0u) {
+        result = cachePtr->heap[0];
+        if (result == exceptPtr) {
+            /*
+             * Take the smaller child of the root instead.
+             */
+            if (cachePtr->heapSize > 2u
+                && cachePtr->heap[2]->priority < cachePtr->heap[1]->priority) {
+                result = cachePtr->heap[2];
+            } else if (cachePtr->heapSize > 1u) {
+                result = cachePtr->heap[1];
+            } else {
+                result = NULL;
+            }
+        }
+    } else {
+        result = cachePtr->lastEntryPtr;
+        if (result == exceptPtr) {
+            result = NULL;
+        }
+    }
+    return result;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SetEviction --
+ *
+ *      Set the eviction policy of a single cache or segment. When
+ *      switching to cost based eviction, all entries with committed
+ *      values are added to the eviction heap.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Builds or frees the eviction heap.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+SetEviction(Cache *cachePtr, Ns_CacheEviction eviction)
+{
+    Tcl_HashSearch       search;
+    const Tcl_HashEntry *hPtr;
+
+    NS_NONNULL_ASSERT(cachePtr != NULL);
+
+    if (eviction != cachePtr->eviction) {
+        for (hPtr = Tcl_FirstHashEntry(&cachePtr->entriesTable, &search);
+             hPtr != NULL;
+             hPtr = Tcl_NextHashEntry(&search)
+             ) {
+            Entry *ePtr = Tcl_GetHashValue(hPtr);
+
+            if (eviction == NS_CACHE_EVICT_COST) {
+                if (ePtr->value != NULL) {
+                    ePtr->priority = Priority(cachePtr, ePtr);
+                    HeapPush(cachePtr, ePtr);
+                }
+            } else {
+                ePtr->heapIndex = 0u;
+            }
+        }
+        if (eviction != NS_CACHE_EVICT_COST && cachePtr->heap != NULL) {
+            ns_free(cachePtr->heap);
+            cachePtr->heap = NULL;
+            cachePtr->heapSize = cachePtr->heapCapacity = 0u;
+        }
+        cachePtr->eviction = eviction;
+    }
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Priority --
+ *
+ *      Compute the GreedyDual-Size priority of an entry: the current
+ *      inflation value plus the recompute cost (in microseconds) per
+ *      byte. The per-entry overhead is included in the size, the cost is
+ *      incremented by one such that entries without cost are ordered by
+ *      size and recency.
+ *
+ * Results:
+ *      Priority.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static double
+Priority(const Cache *cachePtr, const Entry *ePtr)
+{
+    NS_NONNULL_ASSERT(cachePtr != NULL);
+    NS_NONNULL_ASSERT(ePtr != NULL);
+
+    return cachePtr->inflation
+        + ((double)ePtr->cost + 1.0) / (double)(ePtr->size + sizeof(Entry));
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * HeapPush, HeapRemove, HeapUpdate --
+ *
+ *      Maintain the binary min-heap of entry priorities used for cost
+ *      based eviction. The position of an entry in the heap is kept in
+ *      its "heapIndex" (1-based), such that entries can be removed and
+ *      updated in O(log n).
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      The heap might be reallocated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+HeapPlace(Cache *cachePtr, size_t index, Entry *ePtr)
+{
+    cachePtr->heap[index - 1u] = ePtr;
+    ePtr->heapIndex = index;
+}
+
+static void
+HeapSift(Cache *cachePtr, size_t index)
+{
+    Entry **heap = cachePtr->heap;
+    Entry  *ePtr = heap[index - 1u];
+
+    /*
+     * Move the entry up, as long its priority is lower than the priority
+     * of its parent.
+     */
+    while (index > 1u && heap[index / 2u - 1u]->priority > ePtr->priority) {
+        HeapPlace(cachePtr, index, heap[index / 2u - 1u]);
+        index /= 2u;
+    }
+    /*
+     * Move the entry down, as long as a child has a lower priority.
+     */
+    for (;;) {
+        size_t child = index * 2u;
+
+        if (child > cachePtr->heapSize) {
+            break;
+        }
+        if (child < cachePtr->heapSize
+            && heap[child]->priority < heap[child - 1u]->priority) {
+            child++;
+        }
+        if (heap[child - 1u]->priority >= ePtr->priority) {
+            break;
+        }
+        HeapPlace(cachePtr, index, heap[child - 1u]);
+        index = child;
+    }
+    HeapPlace(cachePtr, index, ePtr);
+}
+
+static void
+HeapPush(Cache *cachePtr, Entry *ePtr)
+{
+    NS_NONNULL_ASSERT(cachePtr != NULL);
+    NS_NONNULL_ASSERT(ePtr != NULL);
+
+    if (cachePtr->heapSize == cachePtr->heapCapacity) {
+        cachePtr->heapCapacity = (cachePtr->heapCapacity == 0u) ? 64u : cachePtr->heapCapacity * 2u;
+        cachePtr->heap = ns_realloc(cachePtr->heap, cachePtr->heapCapacity * sizeof(Entry *));
+    }
+    cachePtr->heapSize++;
+    HeapPlace(cachePtr, cachePtr->heapSize, ePtr);
+    HeapSift(cachePtr, cachePtr->heapSize);
+}
+
+static void
+HeapRemove(Cache *cachePtr, Entry *ePtr)
+{
+    size_t index;
+    Entry *lastPtr;
+
+    NS_NONNULL_ASSERT(cachePtr != NULL);
+    NS_NONNULL_ASSERT(ePtr != NULL);
+    assert(ePtr->heapIndex != 0u);
+
+    index = ePtr->heapIndex;
+    lastPtr = cachePtr->heap[cachePtr->heapSize - 1u];
+    cachePtr->heapSize--;
+    ePtr->heapIndex = 0u;
+    if (lastPtr != ePtr) {
+        HeapPlace(cachePtr, index, lastPtr);
+        HeapSift(cachePtr, index);
+    }
+}
+
+static void
+HeapUpdate(Cache *cachePtr, Entry *ePtr)
+{
+    NS_NONNULL_ASSERT(cachePtr != NULL);
+    NS_NONNULL_ASSERT(ePtr != NULL);
+    assert(ePtr->heapIndex != 0u);
+
+    HeapSift(cachePtr, ePtr->heapIndex);
+}
+
+
 /*
  *----------------------------------------------------------------------
  *
@@ -12,23 +12,535 @@
 /*
  * compress.c --
  *
- *      Support for gzip compression using Zlib.
+ *      Support for response compression: gzip compression using Zlib,
+ *      and optionally brotli and zstd compression.
  */
 
 #include "nsd.h"
 
-#ifdef HAVE_ZLIB_H
+#ifdef HAVE_BROTLI
+# include <brotli/encode.h>
+#endif
+#ifdef HAVE_ZSTD
+# include <zstd.h>
+#endif
 
-# define COMPRESS_SENT_HEADER 0x01u
+#define COMPRESS_SENT_HEADER    0x01u
+#define COMPRESS_BROTLI_STARTED 0x02u
+#define COMPRESS_ZSTD_STARTED   0x04u
+
+/*
+ * Encoder state behind Ns_CompressStream.encoders.
+ */
+typedef struct CompressEncoders {
+#ifdef HAVE_BROTLI
+    BrotliEncoderState *brotliState;
+#endif
+#ifdef HAVE_ZSTD
+    ZSTD_CCtx          *zstdCtx;
+#endif
+    int                 unused;  /* keeps the struct non-empty */
+} CompressEncoders;
 
 
 /*
  * Static functions defined in this file.
  */
 
+#ifdef HAVE_BROTLI
+static Ns_ReturnCode CompressBufsBrotli(Ns_CompressStream *cStream, const struct iovec *bufs, int nbufs,
+                                        Tcl_DString *dsPtr, int level, bool flush)
+    NS_GNUC_NONNULL(1,4);
+static bool BrotliStream(BrotliEncoderState *state, BrotliEncoderOperation op,
+                         const uint8_t *data, size_t length, Tcl_DString *dsPtr)
+    NS_GNUC_NONNULL(1,5);
+static void *BrotliAlloc(void *UNUSED(opaque), size_t size);
+static void BrotliFree(void *UNUSED(opaque), void *address);
+#endif
+
+#ifdef HAVE_ZSTD
+static Ns_ReturnCode CompressBufsZstd(Ns_CompressStream *cStream, const struct iovec *bufs, int nbufs,
+                                      Tcl_DString *dsPtr, int level, bool flush)
+    NS_GNUC_NONNULL(1,4);
+static bool ZstdStream(ZSTD_CCtx *cctx, ZSTD_EndDirective mode,
+                       const void *data, size_t length, Tcl_DString *dsPtr)
+    NS_GNUC_NONNULL(1,5);
+#endif
+
+static void EncodersFree(Ns_CompressStream *cStream)
+    NS_GNUC_NONNULL(1);
+#if defined(HAVE_BROTLI) || defined(HAVE_ZSTD)
+static CompressEncoders *EncodersGet(Ns_CompressStream *cStream)
+    NS_GNUC_NONNULL(1) NS_GNUC_RETURNS_NONNULL;
+#endif
+
+#ifdef HAVE_ZLIB_H
+static Ns_ReturnCode GzipInit(Ns_CompressStream *cStream, int level)
+    NS_GNUC_NONNULL(1);
 static void DeflateOrAbort(z_stream *z, int flushFlags);
 static voidpf ZAlloc(voidpf UNUSED(arg), uInt items, uInt size);
 static void ZFree(voidpf UNUSED(arg), voidpf address);
+#endif
+
+/*
+ * Content-encoding names, indexed by Ns_CompressEncoding.
+ */
+static const char *const encodingNames[] = {
+    "identity", "gzip", "br", "zstd"
+};
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Ns_CompressBufs --
+ *
+ *      Compress a vector of bufs with the specified content-encoding
+ *      and append the result to the dstring. The meaning of "level"
+ *      depends on the encoding (gzip: 1-9, brotli: 1-11, zstd: 1-19).
+ *
+ *      As for Ns_CompressBufsGzip(), "flush" terminates the compressed
+ *      stream; otherwise, the output is flushed such that the client
+ *      can decode everything sent so far.
+ *
+ * Results:
+ *      NS_OK or NS_ERROR, when the encoding is not available or the
+ *      encoder failed.
+ *
+ * Side effects:
+ *      Creates the encoder state on demand.
+ *
+ *----------------------------------------------------------------------
+ */
+
+Ns_ReturnCode
+Ns_CompressBufs(Ns_CompressStream *cStream, Ns_CompressEncoding encoding,
+                struct iovec *bufs, int nbufs,
+                Tcl_DString *dsPtr, int level, bool flush)
+{
+    Ns_ReturnCode status = NS_ERROR;
+
+    NS_NONNULL_ASSERT(cStream != NULL);
+    NS_NONNULL_ASSERT(dsPtr != NULL);
+
+    switch (encoding) {
+    case NS_COMPRESS_GZIP:
+        status = Ns_CompressBufsGzip(cStream, bufs, nbufs, dsPtr, level, flush);
+        break;
+    case NS_COMPRESS_BROTLI:
+#ifdef HAVE_BROTLI
+        status = CompressBufsBrotli(cStream, bufs, nbufs, dsPtr, level, flush);
+#else
+        status = NS_ERROR;
+#endif
+        break;
+    case NS_COMPRESS_ZSTD:
+#ifdef HAVE_ZSTD
+        status = CompressBufsZstd(cStream, bufs, nbufs, dsPtr, level, flush);
+#else
+        status = NS_ERROR;
+#endif
+        break;
+    case NS_COMPRESS_NONE:
+        status = NS_ERROR;
+        break;
+    }
+    return status;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * NsCompressEncodingName, NsCompressEncodingFromName --
+ *
+ *      Convert between Ns_CompressEncoding values and content-encoding
+ *      names. NsCompressEncodingFromName() accepts "brotli" as alias for
+ *      "br".
+ *
+ * Results:
+ *      NsCompressEncodingName() returns the content-encoding name,
+ *      NsCompressEncodingFromName() returns NS_ERROR for unknown names
+ *      and for encodings not compiled in.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+const char *
+NsCompressEncodingName(Ns_CompressEncoding encoding)
+{
+    return ((size_t)encoding < Ns_NrElements(encodingNames))
+        ? encodingNames[encoding]
+        : encodingNames[NS_COMPRESS_NONE];
+}
+
+Ns_ReturnCode
+NsCompressEncodingFromName(const char *name, Ns_CompressEncoding *encodingPtr)
+{
+    Ns_ReturnCode status = NS_OK;
+
+    NS_NONNULL_ASSERT(name != NULL);
+    NS_NONNULL_ASSERT(encodingPtr != NULL);
+
+    if (STREQ(name, "gzip")) {
+#ifdef HAVE_ZLIB_H
+        *encodingPtr = NS_COMPRESS_GZIP;
+#else
+        status = NS_ERROR;
+#endif
+    } else if (STREQ(name, "br") || STREQ(name, "brotli")) {
+#ifdef HAVE_BROTLI
+        *encodingPtr = NS_COMPRESS_BROTLI;
+#else
+        status = NS_ERROR;
+#endif
+    } else if (STREQ(name, "zstd")) {
+#ifdef HAVE_ZSTD
+        *encodingPtr = NS_COMPRESS_ZSTD;
+#else
+        status = NS_ERROR;
+#endif
+    } else {
+        status = NS_ERROR;
+    }
+    return status;
+}
+
+#ifdef HAVE_BROTLI
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * CompressBufsBrotli --
+ *
+ *      Brotli variant of Ns_CompressBufsGzip(). Brotli has no reset
+ *      operation, so a new encoder instance is created for every
+ *      response and freed, when the stream is finished.
+ *
+ * Results:
+ *      NS_OK or NS_ERROR.
+ *
+ * Side effects:
+ *      Memory allocation.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Ns_ReturnCode
+CompressBufsBrotli(Ns_CompressStream *cStream, const struct iovec *bufs, int nbufs,
+                   Tcl_DString *dsPtr, int level, bool flush)
+{
+    CompressEncoders   *encPtr = EncodersGet(cStream);
+    BrotliEncoderState *state = encPtr->brotliState;
+    bool                success = NS_TRUE;
+    int                 i;
+
+    if ((cStream->flags & COMPRESS_BROTLI_STARTED) == 0u) {
+        if (state != NULL) {
+            BrotliEncoderDestroyInstance(state);
+        }
+        state = BrotliEncoderCreateInstance(BrotliAlloc, BrotliFree, NULL);
+        encPtr->brotliState = state;
+        if (state == NULL) {
+            Ns_Log(Error, "Ns_CompressBufs: cannot create brotli encoder");
+            return NS_ERROR;
+        }
+        (void) BrotliEncoderSetParameter(state, BROTLI_PARAM_QUALITY,
+                                         (uint32_t)MIN(MAX(level, 1), BROTLI_MAX_QUALITY));
+        /*
+         * Limit the window to 1MB (default 4MB) to bound the memory per
+         * connection; dynamic responses rarely benefit from larger windows.
+         */
+        (void) BrotliEncoderSetParameter(state, BROTLI_PARAM_LGWIN, 20u);
+        if (flush && nbufs > 0) {
+            (void) BrotliEncoderSetParameter(state, BROTLI_PARAM_SIZE_HINT,
+                                             (uint32_t)MIN(Ns_SumVec(bufs, nbufs), UINT32_MAX));
+        }
+        cStream->flags |= COMPRESS_BROTLI_STARTED;
+    }
+
+    for (i = 0; success && i < nbufs; i++) {
+        if (bufs[i].iov_len > 0u) {
+            success = BrotliStream(state, BROTLI_OPERATION_PROCESS,
+                                   bufs[i].iov_base, bufs[i].iov_len, dsPtr);
+        }
+    }
+    if (success) {
+        success = BrotliStream(state, flush ? BROTLI_OPERATION_FINISH : BROTLI_OPERATION_FLUSH,
+                               NULL, 0u, dsPtr);
+    }
+
+    if (flush || !success) {
+        BrotliEncoderDestroyInstance(state);
+        encPtr->brotliState = NULL;
+        cStream->flags &= ~COMPRESS_BROTLI_STARTED;
+    }
+    if (!success) {
+        Ns_Log(Error, "Ns_CompressBufs: brotli compression failed");
+    }
+
+    return success ? NS_OK : NS_ERROR;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * BrotliStream --
+ *
+ *      Feed data with the specified operation into the brotli encoder
+ *      and append all produced output to the dstring. The output is
+ *      taken directly from the encoder's internal buffer.
+ *
+ * Results:
+ *      Boolean success.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static bool
+BrotliStream(BrotliEncoderState *state, BrotliEncoderOperation op,
+             const uint8_t *data, size_t length, Tcl_DString *dsPtr)
+{
+    size_t         availIn = length, availOut = 0u;
+    const uint8_t *nextIn = data;
+
+    for (;;) {
+        if (BrotliEncoderCompressStream(state, op, &availIn, &nextIn, &availOut, NULL, NULL) == BROTLI_FALSE) {
+            return NS_FALSE;
+        }
+        while (BrotliEncoderHasMoreOutput(state) == BROTLI_TRUE) {
+            size_t         outSize = 0u;
+            const uint8_t *out = BrotliEncoderTakeOutput(state, &outSize);
+
+            Tcl_DStringAppend(dsPtr, (const char *)out, (TCL_SIZE_T)outSize);
+        }
+        if (op == BROTLI_OPERATION_FINISH
+            ? (BrotliEncoderIsFinished(state) == BROTLI_TRUE)
+            : (availIn == 0u)
+            ) {
+            break;
+        }
+    }
+    return NS_TRUE;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * BrotliAlloc, BrotliFree --
+ *
+ *      Memory callbacks for the brotli library.
+ *
+ * Results:
+ *      Memory/None.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void *
+BrotliAlloc(void *UNUSED(opaque), size_t size)
+{
+    return ns_malloc(size);
+}
+
+static void
+BrotliFree(void *UNUSED(opaque), void *address)
+{
+    ns_free(address);
+}
+#endif /* HAVE_BROTLI */
+
+#ifdef HAVE_ZSTD
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * CompressBufsZstd --
+ *
+ *      Zstd variant of Ns_CompressBufsGzip(). The compression context
+ *      is kept in the stream and reused for later responses.
+ *
+ * Results:
+ *      NS_OK or NS_ERROR.
+ *
+ * Side effects:
+ *      Memory allocation.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Ns_ReturnCode
+CompressBufsZstd(Ns_CompressStream *cStream, const struct iovec *bufs, int nbufs,
+                 Tcl_DString *dsPtr, int level, bool flush)
+{
+    CompressEncoders *encPtr = EncodersGet(cStream);
+    ZSTD_CCtx        *cctx = encPtr->zstdCtx;
+    bool              success = NS_TRUE;
+    int               i;
+
+    if (cctx == NULL) {
+        cctx = ZSTD_createCCtx();
+        if (cctx == NULL) {
+            Ns_Log(Error, "Ns_CompressBufs: cannot create zstd context");
+            return NS_ERROR;
+        }
+        encPtr->zstdCtx = cctx;
+    }
+    if ((cStream->flags & COMPRESS_ZSTD_STARTED) == 0u) {
+        (void) ZSTD_CCtx_reset(cctx, ZSTD_reset_session_only);
+        (void) ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, MIN(MAX(level, 1), 19));
+        if (flush) {
+            /*
+             * The full response is provided at once. Announcing the size
+             * reduces the window and places the size in the frame header.
+             */
+            (void) ZSTD_CCtx_setPledgedSrcSize(cctx, (unsigned long long)Ns_SumVec(bufs, nbufs));
+        }
+        cStream->flags |= COMPRESS_ZSTD_STARTED;
+    }
+
+    for (i = 0; success && i < nbufs; i++) {
+        if (bufs[i].iov_len > 0u) {
+            success = ZstdStream(cctx, ZSTD_e_continue, bufs[i].iov_base, bufs[i].iov_len, dsPtr);
+        }
+    }
+    if (success) {
+        success = ZstdStream(cctx, flush ? ZSTD_e_end : ZSTD_e_flush, NULL, 0u, dsPtr);
+    }
+
+    if (flush || !success) {
+        cStream->flags &= ~COMPRESS_ZSTD_STARTED;
+    }
+
+    return success ? NS_OK : NS_ERROR;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ZstdStream --
+ *
+ *      Feed data with the specified end directive into the zstd
+ *      compressor and append all produced output to the dstring.
+ *
+ * Results:
+ *      Boolean success.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static bool
+ZstdStream(ZSTD_CCtx *cctx, ZSTD_EndDirective mode, const void *data, size_t length, Tcl_DString *dsPtr)
+{
+    ZSTD_inBuffer input;
+    size_t        remaining, chunkSize = ZSTD_CStreamOutSize();
+
+    input.src = data;
+    input.size = length;
+    input.pos = 0u;
+
+    do {
+        ZSTD_outBuffer output;
+        TCL_SIZE_T     offset = dsPtr->length;
+
+        Tcl_DStringSetLength(dsPtr, offset + (TCL_SIZE_T)chunkSize);
+        output.dst = dsPtr->string + offset;
+        output.size = chunkSize;
+        output.pos = 0u;
+
+        remaining = ZSTD_compressStream2(cctx, &output, &input, mode);
+        Tcl_DStringSetLength(dsPtr, offset + (TCL_SIZE_T)output.pos);
+
+        if (ZSTD_isError(remaining) != 0u) {
+            Ns_Log(Error, "Ns_CompressBufs: zstd error: %s", ZSTD_getErrorName(remaining));
+            return NS_FALSE;
+        }
+    } while (mode == ZSTD_e_continue ? (input.pos < input.size) : (remaining != 0u));
+
+    return NS_TRUE;
+}
+#endif /* HAVE_ZSTD */
+
+#if defined(HAVE_BROTLI) || defined(HAVE_ZSTD)
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * EncodersGet --
+ *
+ *      Return the brotli and zstd encoder state of the stream, allocate
+ *      it on first use.
+ *
+ * Results:
+ *      Encoder state.
+ *
+ * Side effects:
+ *      Memory allocation.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static CompressEncoders *
+EncodersGet(Ns_CompressStream *cStream)
+{
+    if (cStream->encoders == NULL) {
+        cStream->encoders = ns_calloc(1u, sizeof(CompressEncoders));
+    }
+    return cStream->encoders;
+}
+#endif
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * EncodersFree --
+ *
+ *      Release the brotli and zstd encoders of the stream together with
+ *      their state.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Frees memory.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+EncodersFree(Ns_CompressStream *cStream)
+{
+    CompressEncoders *encPtr = cStream->encoders;
+
+    if (encPtr != NULL) {
+#ifdef HAVE_BROTLI
+        if (encPtr->brotliState != NULL) {
+            BrotliEncoderDestroyInstance(encPtr->brotliState);
+        }
+#endif
+#ifdef HAVE_ZSTD
+        if (encPtr->zstdCtx != NULL) {
+            (void) ZSTD_freeCCtx(encPtr->zstdCtx);
+        }
+#endif
+        ns_free(encPtr);
+        cStream->encoders = NULL;
+    }
+}
+
+#ifdef HAVE_ZLIB_H
 
 
 /*
@@ -36,7 +548,10 @@ static void ZFree(voidpf UNUSED(arg), voidpf address);
  *
  * Ns_CompressInit, Ns_CompressFree --
  *
- *      Initialize a copression stream buffer. Do this once.
+ *      Initialize a compression stream buffer. Do this once. No
+ *      encoder is set up here: the gzip, brotli and zstd encoders are
+ *      created on demand by the first Ns_CompressBufs() call using
+ *      them and released by Ns_CompressFree().
  *
  * Results:
  *      Ns_ReturnCode
@@ -49,12 +564,22 @@ static void ZFree(voidpf UNUSED(arg), voidpf address);
 
 Ns_ReturnCode
 Ns_CompressInit(Ns_CompressStream *cStream)
+{
+    cStream->z.zalloc = NULL;
+    cStream->encoders = NULL;
+    cStream->flags = 0u;
+
+    return NS_OK;
+}
+
+static Ns_ReturnCode
+GzipInit(Ns_CompressStream *cStream, int level)
 {
     z_stream     *z = &cStream->z;
     int           rc;
     Ns_ReturnCode status = NS_OK;
 
-    cStream->flags = 0u;
+    cStream->flags &= ~COMPRESS_SENT_HEADER;
     z->zalloc = ZAlloc;
     z->zfree = ZFree;
     z->opaque = Z_NULL;
@@ -62,14 +587,17 @@ Ns_CompressInit(Ns_CompressStream *cStream)
     /*
      * Memory requirements (see zconf.h):
      *    (1 << (windowBits+2)) +  (1 << (memLevel+9)) =
-     *    (1 << (15+2)) +  (1 << (9+9)) = 393216 = ~400KB
+     *    (1 << (15+2)) +  (1 << (8+9)) = 262144 = ~256KB
+     *
+     * The level of later streams on the same buffer is set via
+     * deflateParams() in Ns_CompressBufsGzip().
      */
 
     rc = deflateInit2(z,
-                      Z_BEST_COMPRESSION, /* to size memory, will be reset later */
+                      level,
                       Z_DEFLATED, /* method. */
                       15 + 16,    /* windowBits: 15 (max), +16 (Gzip header/footer). */
-                      9,          /* memlevel: 1-9 (min-max), default: 8.*/
+                      8,          /* memlevel: 1-9 (min-max), default: 8.*/
                       Z_DEFAULT_STRATEGY);
     if (rc != Z_OK) {
       /*
@@ -79,11 +607,12 @@ Ns_CompressInit(Ns_CompressStream *cStream)
        * client gives up quickly.
        */
       if (rc == Z_STREAM_ERROR) {
-        Ns_Log(Notice, "Ns_CompressInit: zlib error: %d (%s): %s",
+        Ns_Log(Notice, "Ns_CompressBufsGzip: zlib error: %d (%s): %s",
                  rc, zError(rc), (z->msg != NULL) ? z->msg : "(none)");
+        z->zalloc = NULL;
         status = NS_ERROR;
       } else {
-        Ns_Fatal("Ns_CompressInit: zlib error: %d (%s): %s",
+        Ns_Fatal("Ns_CompressBufsGzip: zlib error: %d (%s): %s",
                  rc, zError(rc), (z->msg != NULL) ? z->msg : "(none)");
       }
     }
@@ -102,7 +631,9 @@ Ns_CompressFree(Ns_CompressStream *cStream)
             Ns_Log(Bug, "Ns_CompressFree: deflateEnd: %d (%s): %s",
                    status, zError(status), (z->msg != NULL) ? z->msg : "(unknown)");
         }
+        z->zalloc = NULL;
     }
+    EncodersFree(cStream);
 }
 
 /*
@@ -208,10 +739,11 @@ Ns_InflateEnd(Ns_CompressStream *cStream)
  *      any number of times in-between.
  *
  * Results:
- *      NS_OK.
+ *      NS_OK, or NS_ERROR when the deflate stream cannot be created.
  *
  * Side effects:
- *      Aborts on error (which should not happen).
+ *      Creates the deflate stream on the first call. Aborts on
+ *      compression errors (which should not happen).
  *
  *----------------------------------------------------------------------
  */
@@ -228,8 +760,9 @@ Ns_CompressBufsGzip(Ns_CompressStream *cStream, struct iovec *bufs, int nbufs,
     NS_NONNULL_ASSERT(cStream != NULL);
     NS_NONNULL_ASSERT(dsPtr != NULL);
 
-    if (z->zalloc == NULL) {
-        (void) Ns_CompressInit(cStream);
+    level = MIN(MAX(level, 1), 9);
+    if (z->zalloc == NULL && GzipInit(cStream, level) != NS_OK) {
+        return NS_ERROR;
     }
 
     offset = (ptrdiff_t) dsPtr->length;
@@ -239,9 +772,7 @@ Ns_CompressBufsGzip(Ns_CompressStream *cStream, struct iovec *bufs, int nbufs,
     if (!(cStream->flags & COMPRESS_SENT_HEADER)) {
         cStream->flags |= COMPRESS_SENT_HEADER;
         compressLen += 10u; /* Gzip header length. */
-        (void) deflateParams(z,
-                             MIN(MAX(level, 1), 9),
-                             Z_DEFAULT_STRATEGY);
+        (void) deflateParams(z, level, Z_DEFAULT_STRATEGY);
     }
     if (flush) {
         compressLen += 4u; /* Gzip footer. */
@@ -285,7 +816,7 @@ Ns_CompressBufsGzip(Ns_CompressStream *cStream, struct iovec *bufs, int nbufs,
 
     if (flush) {
         (void) deflateReset(z);
-        cStream->flags = 0u;
+        cStream->flags &= ~COMPRESS_SENT_HEADER;
     }
 
     return NS_OK;
@@ -396,15 +927,18 @@ ZFree(voidpf UNUSED(arg), voidpf address)
 #else /* ! HAVE_ZLIB_H */
 
 Ns_ReturnCode
-Ns_CompressInit(Ns_CompressStream *UNUSED(cStream))
+Ns_CompressInit(Ns_CompressStream *cStream)
 {
-    return NS_ERROR;
+    cStream->encoders = NULL;
+    cStream->flags = 0u;
+
+    return NS_OK;
 }
 
 void
-Ns_CompressFree(Ns_CompressStream *UNUSED(cStream))
+Ns_CompressFree(Ns_CompressStream *cStream)
 {
-    return;
+    EncodersFree(cStream);
 }
 
 Ns_ReturnCode
@@ -260,6 +260,7 @@ NsDStringAppendConnFlags(Tcl_DString *dsPtr, unsigned int flags)
         { NS_CONN_ENTITYTOOLARGE,    "ENTITYTOOLARGE" },
         { NS_CONN_REQUESTURITOOLONG, "REQUESTURITOOLONG" },
         { NS_CONN_LINETOOLONG,       "LINETOOLONG" },
+        { NS_CONN_ZSTDACCEPTED,      "ZSTDACCEPTED" },
         { NS_CONN_CONFIGURED,        "CONFIGURED" },
         { NS_CONN_SSL_WANT_WRITE,    "SSL_WANT_WRITE" },
         { NS_CONN_JSONPARSED,        "JSONPARSED" },
@@ -3207,6 +3208,9 @@ ConnNoArg(int opt, unsigned int required_flags, Conn *connPtr, NsInterp *itPtr,
             if ((connPtr->flags & NS_CONN_ZIPACCEPTED) != 0u) {
                 Tcl_ListObjAppendElement(interp, listObj, NsAtomObj(NS_ATOM_gzip));
             }
+            if ((connPtr->flags & NS_CONN_ZSTDACCEPTED) != 0u) {
+                Tcl_ListObjAppendElement(interp, listObj, NsAtomObj(NS_ATOM_zstd));
+            }
 
             Tcl_SetObjResult(interp, listObj);
         }
@@ -49,9 +49,14 @@ static Ns_ReturnCode ConnCopy(const Ns_Conn *conn, size_t toCopy, Tcl_Channel ch
 static bool CheckKeep(const Conn *connPtr)
     NS_GNUC_NONNULL(1);
 
-static int CheckCompress(const Conn *connPtr, const struct iovec *bufs, int nbufs, unsigned int ioflags)
+static int CheckCompress(const Conn *connPtr, const struct iovec *bufs, int nbufs, unsigned int ioflags,
+                         Ns_CompressEncoding *encodingPtr)
     NS_GNUC_NONNULL(1);
 
+static const char *CompressCacheLookup(const Conn *connPtr, const struct iovec *bufs, int nbufs,
+                                       size_t *lengthPtr, void **handlePtr)
+    NS_GNUC_NONNULL(1,2,4,5);
+
 static bool HdrEq(const Ns_Set *set, const char *name, const char *value, size_t valueLength)
     NS_GNUC_NONNULL(1,2,3);
 
@@ -90,6 +95,7 @@ Ns_ConnWriteVChars(Ns_Conn *conn, struct iovec *bufs, int nbufs, unsigned int fl
     Conn              *connPtr   = (Conn *) conn;
     Tcl_DString        encDs, gzDs;
     struct iovec       iov;
+    void              *cacheHandle = NULL;
     Ns_ReturnCode      status;
 
     Tcl_DStringInit(&encDs);
@@ -130,24 +136,45 @@ Ns_ConnWriteVChars(Ns_Conn *conn, struct iovec *bufs, int nbufs, unsigned int fl
      */
 
     if (connPtr->compress < 0) {
-        connPtr->compress = CheckCompress(connPtr, bufs, nbufs, flags);
+        connPtr->compress = CheckCompress(connPtr, bufs, nbufs, flags, &connPtr->compressEncoding);
     }
     if (connPtr->compress > 0
         && (nbufs > 0 || (flags & NS_CONN_STREAM_CLOSE) != 0u)
         ) {
-        bool flush = ((flags & NS_CONN_STREAM) == 0u);
+        bool        flush = ((flags & NS_CONN_STREAM) == 0u);
+        const char *cached = NULL;
+        size_t      cachedLength = 0u;
+
+        if (flush && nbufs > 0 && NsCompressCacheEnabled()) {
+            cached = CompressCacheLookup(connPtr, bufs, nbufs, &cachedLength, &cacheHandle);
+        }
+
+        if (cached != NULL) {
+            (void)Ns_SetVec(&iov, 0, cached, cachedLength);
+            bufs = &iov;
+            nbufs = 1;
 
-        if (Ns_CompressBufsGzip(&connPtr->cStream, bufs, nbufs, &gzDs,
-                                connPtr->compress, flush) == NS_OK) {
-            /* NB: Compression will always succeed. */
+        } else if (Ns_CompressBufs(&connPtr->cStream, connPtr->compressEncoding, bufs, nbufs, &gzDs,
+                                   connPtr->compress, flush) == NS_OK) {
             (void)Ns_SetVec(&iov, 0, gzDs.string, (size_t)gzDs.length);
             bufs = &iov;
             nbufs = 1;
+        } else {
+            /*
+             * The content-encoding header is already set, sending the
+             * data uncompressed would corrupt the response.
+             */
+            Tcl_DStringFree(&encDs);
+            Tcl_DStringFree(&gzDs);
+            return NS_ERROR;
         }
     }
 
     status = Ns_ConnWriteVData(conn, bufs, nbufs, flags);
 
+    if (cacheHandle != NULL) {
+        NsCompressCacheRelease(cacheHandle);
+    }
     Tcl_DStringFree(&encDs);
     Tcl_DStringFree(&gzDs);
 
@@ -161,10 +188,13 @@ Ns_ConnWriteVChars(Ns_Conn *conn, struct iovec *bufs, int nbufs, unsigned int fl
  *
  * CheckCompress --
  *
- *      Is compression enabled, and at what level.
+ *      Is compression enabled, and at what level. The content-encoding
+ *      is the first of the server's configured compression formats,
+ *      which is accepted by the client.
  *
  * Results:
- *      compress level 0-9
+ *      Compression level of the chosen content-encoding or 0; the
+ *      content-encoding is returned in the last argument.
  *
  * Side effects:
  *      May set the content-encoding and Vary headers.
@@ -173,15 +203,18 @@ Ns_ConnWriteVChars(Ns_Conn *conn, struct iovec *bufs, int nbufs, unsigned int fl
  */
 
 static int
-CheckCompress(const Conn *connPtr, const struct iovec *bufs, int nbufs, unsigned int ioflags)
+CheckCompress(const Conn *connPtr, const struct iovec *bufs, int nbufs, unsigned int ioflags,
+              Ns_CompressEncoding *encodingPtr)
 {
     const Ns_Conn  *conn = (const Ns_Conn *)connPtr;
     const NsServer *servPtr;
     int             configuredCompressionLevel, compressionLevel = 0;
 
     NS_NONNULL_ASSERT(connPtr != NULL);
+    NS_NONNULL_ASSERT(encodingPtr != NULL);
 
     servPtr = connPtr->poolPtr->servPtr;
+    *encodingPtr = NS_COMPRESS_NONE;
 
     /*
      * Check the default setting and explicit override.
@@ -201,11 +234,13 @@ CheckCompress(const Conn *connPtr, const struct iovec *bufs, int nbufs, unsigned
              */
             if (((connPtr->flags & NS_CONN_SENTHDRS) == 0u)
                 && ((connPtr->flags & NS_CONN_SKIPBODY) == 0u)) {
-                Ns_ConnSetHeadersSz(conn, "vary", 4, "accept-encoding", 15);
 
-                if ((connPtr->flags & NS_CONN_ZIPACCEPTED) != 0u) {
-                    Ns_ConnSetHeadersSz(conn, "content-encoding", 16, "gzip", 4);
-                    compressionLevel = configuredCompressionLevel;
+                Ns_ConnSetHeadersSz(conn, "vary", 4, "accept-encoding", 15);
+                *encodingPtr = NsConnSelectCompression(connPtr, configuredCompressionLevel,
+                                                       &compressionLevel);
+                if (*encodingPtr != NS_COMPRESS_NONE) {
+                    Ns_ConnSetHeadersSz(conn, "content-encoding", 16,
+                                        NsCompressEncodingName(*encodingPtr), TCL_INDEX_NONE);
                 }
             }
         }
@@ -213,7 +248,118 @@ CheckCompress(const Conn *connPtr, const struct iovec *bufs, int nbufs, unsigned
     return compressionLevel;
 }
 
-
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * CompressCacheLookup --
+ *
+ *      Obtain the compressed variant of a complete dynamic response
+ *      from the compress cache. This is only done for responses with
+ *      a strong ETag, which identifies the content of the resource;
+ *      the cache key consists of the content-encoding, the level, the
+ *      server, the URL with the query and the ETag.
+ *
+ * Results:
+ *      Compressed content or NULL. On success, the length and the
+ *      handle for NsCompressCacheRelease() are returned in the last
+ *      arguments.
+ *
+ * Side effects:
+ *      See NsCompressCacheGet().
+ *
+ *----------------------------------------------------------------------
+ */
+
+static const char *
+CompressCacheLookup(const Conn *connPtr, const struct iovec *bufs, int nbufs,
+                    size_t *lengthPtr, void **handlePtr)
+{
+    const char *etag, *result = NULL;
+
+    NS_NONNULL_ASSERT(connPtr != NULL);
+    NS_NONNULL_ASSERT(bufs != NULL);
+    NS_NONNULL_ASSERT(lengthPtr != NULL);
+    NS_NONNULL_ASSERT(handlePtr != NULL);
+
+    etag = Ns_SetIGet(connPtr->outputheaders, "etag");
+    if (etag != NULL && *etag == '"') {
+        Tcl_DString ds;
+
+        Tcl_DStringInit(&ds);
+        Ns_DStringPrintf(&ds, "%s %d %s %s",
+                         NsCompressEncodingName(connPtr->compressEncoding),
+                         connPtr->compress, connPtr->server, connPtr->request.url);
+        if (connPtr->request.query != NULL) {
+            Tcl_DStringAppend(&ds, "?", 1);
+            Tcl_DStringAppend(&ds, connPtr->request.query, TCL_INDEX_NONE);
+        }
+        Tcl_DStringAppend(&ds, " ", 1);
+        Tcl_DStringAppend(&ds, etag, TCL_INDEX_NONE);
+
+        result = NsCompressCacheGet(ds.string, NULL, connPtr->compressEncoding, connPtr->compress,
+                                    NULL, bufs, nbufs, lengthPtr, handlePtr);
+        Tcl_DStringFree(&ds);
+    }
+    return result;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * NsConnSelectCompression --
+ *
+ *      Select the content-encoding for a response: the first of the
+ *      server's configured compression formats which is accepted by
+ *      the client.
+ *
+ * Results:
+ *      Content-encoding (NS_COMPRESS_NONE when none is acceptable); the
+ *      compression level for the encoding is returned in the last
+ *      argument. gzip uses the provided gzipLevel.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+Ns_CompressEncoding
+NsConnSelectCompression(const Conn *connPtr, int gzipLevel, int *levelPtr)
+{
+    const NsServer     *servPtr;
+    Ns_CompressEncoding result = NS_COMPRESS_NONE;
+    int                 i;
+
+    NS_NONNULL_ASSERT(connPtr != NULL);
+    NS_NONNULL_ASSERT(levelPtr != NULL);
+
+    servPtr = connPtr->poolPtr->servPtr;
+    *levelPtr = 0;
+
+    for (i = 0; i < servPtr->compress.nrFormats; i++) {
+        Ns_CompressEncoding encoding = servPtr->compress.formats[i];
+
+        if (encoding == NS_COMPRESS_GZIP
+            && (connPtr->flags & NS_CONN_ZIPACCEPTED) != 0u) {
+            *levelPtr = gzipLevel;
+        } else if (encoding == NS_COMPRESS_BROTLI
+                   && (connPtr->flags & NS_CONN_BROTLIACCEPTED) != 0u) {
+            *levelPtr = servPtr->compress.brotliLevel;
+        } else if (encoding == NS_COMPRESS_ZSTD
+                   && (connPtr->flags & NS_CONN_ZSTDACCEPTED) != 0u) {
+            *levelPtr = servPtr->compress.zstdLevel;
+        } else {
+            continue;
+        }
+        result = encoding;
+        break;
+    }
+    return result;
+}
+
+
 /*
  *----------------------------------------------------------------------
  *
@@ -802,7 +948,7 @@ Ns_ConnClose(Ns_Conn *conn)
             /*
              * Streaming:
              *   In chunked mode, write the end-of-content trailer.
-             *   If compressing, write the gzip footer.
+             *   If compressing, write the trailer of the compressed stream.
              */
             (void) Ns_ConnWriteVChars(conn, NULL, 0, NS_CONN_STREAM_CLOSE);
         }
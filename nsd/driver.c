@@ -24,6 +24,10 @@ NS_EXPORT Ns_LogSeverity Ns_LogAccessDebug;
 # include "nsopenssl.h"
 #endif
 
+#ifdef HAVE_SYS_EPOLL_H
+# include <sys/epoll.h>
+#endif
+
 #ifdef NS_DRIVER_MEM_STATS
 # define WRITER_MEM_STATS 1
 #endif
@@ -67,24 +71,37 @@ typedef struct {
 } SpoolerStateMap;
 
 
-const struct {
-    const char     *name;
+/*
+ * Request header fields checked or extracted in a single pass over the
+ * received header fields (see CheckSingletonHeaderFields). The table has
+ * to be sorted by name. Fields marked as singletons must not be provided
+ * more than once; for the other fields, the first occurrence is extracted,
+ * which is the same value as returned by Ns_SetIGet().
+ */
+static const struct {
+    const char             *name;
     NsExtractedHeaderIndex  extract;
-} singletonRequestHeaderFields[] = {
-    { "authorization",       NS_EXTRACTED_HEADER_AUTHORIZATION},
-    { "content-length",      NS_EXTRACTED_HEADER_CONTENT_LENGTH},
-    { "content-type",        NS_EXTRACTED_NONE},
-    { "expect",              NS_EXTRACTED_HEADER_EXPECT},
-    { "host",                NS_EXTRACTED_HEADER_HOST},
-    { "if-match",            NS_EXTRACTED_NONE},
-    { "if-modified-since",   NS_EXTRACTED_NONE},
-    { "if-none-match",       NS_EXTRACTED_NONE},
-    { "if-range",            NS_EXTRACTED_NONE},
-    { "if-unmodified-since", NS_EXTRACTED_NONE},
-    { "origin",              NS_EXTRACTED_NONE},
-    { "transfer-encoding",   NS_EXTRACTED_NONE },
-    { "upgrade",             NS_EXTRACTED_NONE},
-    { "user-agent",          NS_EXTRACTED_NONE}
+    bool                    singleton;
+} requestHeaderFields[] = {
+    { "accept-encoding",          NS_EXTRACTED_HEADER_ACCEPT_ENCODING,          NS_FALSE},
+    { "authorization",            NS_EXTRACTED_HEADER_AUTHORIZATION,            NS_TRUE},
+    { "connection",               NS_EXTRACTED_HEADER_CONNECTION,               NS_FALSE},
+    { "content-length",           NS_EXTRACTED_HEADER_CONTENT_LENGTH,           NS_TRUE},
+    { "content-type",             NS_EXTRACTED_NONE,                            NS_TRUE},
+    { "expect",                   NS_EXTRACTED_HEADER_EXPECT,                   NS_TRUE},
+    { "host",                     NS_EXTRACTED_HEADER_HOST,                     NS_TRUE},
+    { "if-match",                 NS_EXTRACTED_NONE,                            NS_TRUE},
+    { "if-modified-since",        NS_EXTRACTED_NONE,                            NS_TRUE},
+    { "if-none-match",            NS_EXTRACTED_NONE,                            NS_TRUE},
+    { "if-range",                 NS_EXTRACTED_NONE,                            NS_TRUE},
+    { "if-unmodified-since",      NS_EXTRACTED_NONE,                            NS_TRUE},
+    { "origin",                   NS_EXTRACTED_NONE,                            NS_TRUE},
+    { "range",                    NS_EXTRACTED_HEADER_RANGE,                    NS_FALSE},
+    { "transfer-encoding",        NS_EXTRACTED_HEADER_TRANSFER_ENCODING,        NS_TRUE},
+    { "upgrade",                  NS_EXTRACTED_NONE,                            NS_TRUE},
+    { "user-agent",               NS_EXTRACTED_NONE,                            NS_TRUE},
+    { "x-expected-entity-length", NS_EXTRACTED_HEADER_X_EXPECTED_ENTITY_LENGTH, NS_FALSE},
+    { "x-forwarded-for",          NS_EXTRACTED_HEADER_X_FORWARDED_FOR,          NS_FALSE}
 };
 
 /*
@@ -110,6 +127,16 @@ static const SpoolerStateMap spoolerStateMap[] = {
 /*
  * The following structure manages polling.  The PollIn macro is
  * used for the common case of checking for readability.
+ *
+ * With the poll() backend, the pollfd array is rebuilt on every spin of
+ * the thread. With the epoll backend, the slots of the pollfd array
+ * (trigger pipe, listen sockets) and all client sockets are registered
+ * once in the epoll instance, client sockets with EPOLLONESHOT, such that
+ * only changed interest sets cause system calls. Returned events are
+ * stored in the pollfd array for the slots and in the Sock structure for
+ * client sockets. Idle keepalive sockets are kept in a separate list of
+ * "parked" sockets ordered by their timeout, such that they do not have
+ * to be traversed on every spin.
  */
 
 typedef struct PollData {
@@ -117,12 +144,38 @@ typedef struct PollData {
     unsigned int   maxfds;     /* Max fds (will grow as needed). */
     struct pollfd *pfds;        /* Dynamic array of poll structs. */
     Ns_Time        timeout;     /* Min timeout, if any, for next spin. */
+    NsPollBackend  backend;     /* Backend used for waiting. */
+#ifdef HAVE_SYS_EPOLL_H
+    int                 epfd;         /* File descriptor of the epoll instance. */
+    unsigned int        nregistered;  /* Number of pfds slots registered in epfd. */
+    int                 nevents;      /* Number of events returned by last wait. */
+    struct epoll_event *events;       /* Array of returned events. */
+#endif
+    Sock          *firstParkedPtr;  /* Oldest parked socket. */
+    Sock          *lastParkedPtr;   /* Newest parked socket. */
 } PollData;
 
+#define POLL_MAX_EVENTS          1024
+
+/*
+ * The epoll event data is either the index of a pollfd slot or a pointer
+ * to a client Sock structure. Slot indices are tagged by the lowest bit,
+ * which is always 0 for the (aligned) Sock pointers.
+ */
+#define POLL_SLOT_TAG(i)         ((((uint64_t)(i)) << 1) | 1u)
+#define POLL_IS_SLOT(u)          (((u) & 1u) != 0u)
+#define POLL_SLOT_INDEX(u)       ((unsigned int)((u) >> 1))
+
 #define PollIn(ppd, i)           (((ppd)->pfds[(i)].revents & POLLIN)  == POLLIN )
 #define PollOut(ppd, i)          (((ppd)->pfds[(i)].revents & POLLOUT) == POLLOUT)
 #define PollHup(ppd, i)          (((ppd)->pfds[(i)].revents & POLLHUP) == POLLHUP)
 
+#define SockRevents(ppd, sockPtr) ((ppd)->backend == NS_POLL_BACKEND_POLL  \
+                                   ? (ppd)->pfds[(sockPtr)->pidx].revents \
+                                   : (sockPtr)->revents)
+#define SockPollIn(ppd, sockPtr)  ((SockRevents((ppd), (sockPtr)) & POLLIN)  == POLLIN )
+#define SockPollHup(ppd, sockPtr) ((SockRevents((ppd), (sockPtr)) & POLLHUP) == POLLHUP)
+
 
 
 /*
@@ -141,6 +194,14 @@ typedef struct PollData {
         }                                                                 \
     } while (0)
 
+/*
+ * Number of mutexes protecting the linkage between connections, sockets and
+ * writer jobs (must be a power of two), and the minimum interval between two
+ * recomputations of the per-pool bandwidth of a writer thread.
+ */
+#define NS_WRITER_LOCK_STRIPES         16u
+#define NS_WRITER_POOLRATE_INTERVAL    100000 /* microseconds */
+
 /*
  * Collected informationof writer threads for per pool rates, necessary for
  * per pool bandwidth management.
@@ -192,6 +253,9 @@ typedef struct WriterSock {
             TCL_SIZE_T         nbufs;
             TCL_SIZE_T         currentbuf;
             Ns_Mutex           fdlock;
+            bool               direct;               /* send without the buffer */
+            size_t             chunk;                /* adaptive size of direct sends */
+            off_t              fileoffset;           /* next file position for direct sends */
         } file;
     } c;
 
@@ -275,12 +339,12 @@ static bool    DriverKeep(Sock *sockPtr)
     NS_GNUC_NONNULL(1);
 static void    DriverClose(Sock *sockPtr)
     NS_GNUC_NONNULL(1);
-static Ns_ReturnCode DriverInit(const char *server, const char *moduleName, const char *threadName,
+static Ns_ReturnCode DriverInit(const char *server, const char *moduleName, const char *threadName, int shard,
                                 const Ns_DriverInitData *init,
                                 NsServer *servPtr, const char *section,
                                 const char *bindaddrs,
                                 const char *defserver)
-    NS_GNUC_NONNULL(2,3,4,6,7);
+    NS_GNUC_NONNULL(2,3,5,7,8);
 static bool DriverModuleInitialized(const char *module)
     NS_GNUC_NONNULL(1);
 static const ServerMap *DriverLookupHost(Tcl_DString *hostDs, Ns_Request *requestPtr, Driver *drvPtr)
@@ -297,6 +361,8 @@ static SockState SockAccept(Driver *drvPtr, NS_SOCKET sock, Sock **sockPtrPtr, c
     NS_GNUC_NONNULL(1);
 static Ns_ReturnCode SockQueue(Sock *sockPtr, const Ns_Time *timePtr)
     NS_GNUC_NONNULL(1);
+static bool SockFastLane(Sock *sockPtr)
+    NS_GNUC_NONNULL(1);
 static void SockDeliveryRelease(Sock *sockPtr)
     NS_GNUC_NONNULL(1);
 static void SockDeliveryAcquire(Sock *sock)
@@ -330,7 +396,7 @@ static void SpoolerQueueStart(SpoolerQueue *queuePtr, Ns_ThreadProc *proc)
     NS_GNUC_NONNULL(2);
 static void SpoolerQueueStop(SpoolerQueue *queuePtr, const Ns_Time *timeoutPtr, const char *name)
     NS_GNUC_NONNULL(2,3);
-static void PollCreate(PollData *pdata)
+static void PollCreate(PollData *pdata, NsPollBackend backend)
     NS_GNUC_NONNULL(1);
 static void PollFree(PollData *pdata)
     NS_GNUC_NONNULL(1);
@@ -338,8 +404,22 @@ static void PollReset(PollData *pdata)
     NS_GNUC_NONNULL(1);
 static NS_POLL_NFDS_TYPE PollSet(PollData *pdata, NS_SOCKET sock, short type, const Ns_Time *timeoutPtr)
     NS_GNUC_NONNULL(1);
-static int PollWait(const PollData *pdata, int timeout)
+static void PollSetTimeout(PollData *pdata, const Ns_Time *timeoutPtr)
+    NS_GNUC_NONNULL(1,2);
+static int PollWait(PollData *pdata, int timeout)
     NS_GNUC_NONNULL(1);
+static void PollArm(PollData *pdata, Sock *sockPtr, short type)
+    NS_GNUC_NONNULL(1,2);
+static void PollDisarm(PollData *pdata, Sock *sockPtr)
+    NS_GNUC_NONNULL(1,2);
+static void PollPark(PollData *pdata, Sock *sockPtr)
+    NS_GNUC_NONNULL(1,2);
+static void PollUnpark(PollData *pdata, Sock *sockPtr)
+    NS_GNUC_NONNULL(1,2);
+static NsPollBackend PollBackendFromString(const char *section, const char *value)
+    NS_GNUC_NONNULL(1);
+static const char *PollBackendString(NsPollBackend backend)
+    NS_GNUC_CONST;
 static SockState ChunkedDecode(Request *reqPtr, bool update)
     NS_GNUC_NONNULL(1);
 static WriterSock *WriterSockRequire(const Conn *connPtr)
@@ -350,6 +430,10 @@ static SpoolerState WriterReadFromSpool(WriterSock *curPtr)
     NS_GNUC_NONNULL(1);
 static SpoolerState WriterSend(WriterSock *curPtr, int *err)
     NS_GNUC_NONNULL(1,2);
+static SpoolerState WriterSendDirect(WriterSock *curPtr, int *err)
+    NS_GNUC_NONNULL(1,2);
+static void WriterSubmit(DrvWriter *wrPtr, WriterSock *wrSockPtr, const char *requestLine)
+    NS_GNUC_NONNULL(1,2);
 
 static Ns_ReturnCode WriterSetupStreamingMode(Conn *connPtr, const struct iovec *bufs, int nbufs, int *fdPtr)
     NS_GNUC_NONNULL(1,4);
@@ -398,6 +482,10 @@ static Driver *LookupDriver(Tcl_Interp *interp, const char* protocol, const char
 
 static void WriterPerPoolRates(WriterSock *writePtr, Tcl_HashTable *pools)
     NS_GNUC_NONNULL(1,2);
+static SpoolerQueue *WriterQueueForSock(DrvWriter *wrPtr, Sock *sockPtr)
+    NS_GNUC_NONNULL(1,2);
+static Ns_Mutex *WriterLockForKey(const void *key)
+    NS_GNUC_NONNULL(1) NS_GNUC_RETURNS_NONNULL;
 
 
 static void BandwidthAdjustRateLimitsPerPool(WriterSock *writers, Tcl_HashTable *pools)
@@ -433,9 +521,14 @@ bool NsWriterBandwidthManagement = NS_FALSE;
 static Ns_LogSeverity   WriterDebug;        /* Severity at which to log verbose debugging. */
 static Ns_LogSeverity   DriverDebug;        /* Severity at which to log verbose debugging. */
 static Ns_Mutex         reqLock     = NULL; /* Lock for allocated Request structure pool */
-static Ns_Mutex         writerlock  = NULL; /* Lock updating streaming information in the writer */
+static Ns_Mutex         writerlocks[NS_WRITER_LOCK_STRIPES]; /* Locks for stream and delivery linkage */
 static Request         *firstReqPtr = NULL; /* Allocated request structures kept in a pool */
 static Driver          *firstDrvPtr = NULL; /* First in list of all drivers */
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+static cpu_set_t        processCpus;        /* CPUs available to the process at startup */
+static bool             shardAffinity = NS_FALSE; /* Some driver uses "cpuaffinity" */
+static int              nrShards    = 0;    /* Driver threads using "cpuaffinity" over all drivers */
+#endif
 
 #define Push(x, xs) ((x)->nextPtr = (xs), (xs) = (x))
 
@@ -624,6 +717,8 @@ SockStateString(SockState sockState)
 void
 NsInitDrivers(void)
 {
+    size_t i;
+
     DriverDebug = Ns_CreateLogSeverity("Debug(ns:driver)");
     WriterDebug = Ns_CreateLogSeverity("Debug(writer)");
     Ns_LogTaskDebug = Ns_CreateLogSeverity("Debug(task)");
@@ -635,9 +730,94 @@ NsInitDrivers(void)
     Ns_LogNsSetDebug = Ns_CreateLogSeverity("Debug(nsset)");
     Ns_LogMemoryDebug = Ns_CreateLogSeverity("Debug(memory)");
     Ns_MutexInit(&reqLock);
-    Ns_MutexInit(&writerlock);
     Ns_MutexSetName2(&reqLock, "ns:driver", "requestpool");
-    Ns_MutexSetName2(&writerlock, "ns:writer", "stream");
+    for (i = 0u; i < NS_WRITER_LOCK_STRIPES; i++) {
+        char name[32];
+
+        snprintf(name, sizeof(name), "stream:%" PRIuz, i);
+        Ns_MutexInit(&writerlocks[i]);
+        Ns_MutexSetName2(&writerlocks[i], "ns:writer", name);
+    }
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+    CPU_ZERO(&processCpus);
+    if (pthread_getaffinity_np(pthread_self(), sizeof(processCpus), &processCpus) != 0) {
+        CPU_ZERO(&processCpus);
+    }
+#endif
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * NsDriverSetShardAffinity --
+ *
+ *      Bind the calling thread to the CPUs of a driver shard. The CPUs
+ *      available to the process are split into contiguous ranges, one
+ *      per driver thread using "cpuaffinity" over all drivers, such that
+ *      neighboring cores (and usually the same NUMA node) end up in the
+ *      same shard and different drivers use different CPUs. When "singleCpu" is set, the
+ *      thread is bound only to the first CPU of its range (used for the
+ *      driver thread itself). A negative shard restores the affinity of
+ *      the process, which is needed for threads inheriting the affinity
+ *      of a pinned driver thread.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Changes the CPU affinity of the calling thread. No-op, when no
+ *      driver is configured with "cpuaffinity" or the operating system
+ *      does not support it.
+ *
+ *----------------------------------------------------------------------
+ */
+void
+NsDriverSetShardAffinity(int shard, bool singleCpu)
+{
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+    if (shardAffinity) {
+        cpu_set_t cpus;
+        int       ncpus = CPU_COUNT(&processCpus), nshards = nrShards;
+
+        if (shard < 0 || nshards < 1 || ncpus == 0) {
+            cpus = processCpus;
+        } else {
+            size_t cpu;
+            int    n = 0, first, last;
+
+            if (ncpus >= nshards) {
+                first = (shard * ncpus) / nshards;
+                last = ((shard + 1) * ncpus) / nshards - 1;
+            } else {
+                first = last = shard % ncpus;
+            }
+            if (singleCpu) {
+                last = first;
+            }
+            CPU_ZERO(&cpus);
+            for (cpu = 0u; cpu < (size_t)CPU_SETSIZE && n <= last; cpu++) {
+                if (CPU_ISSET(cpu, &processCpus)) {
+                    if (n >= first) {
+                        CPU_SET(cpu, &cpus);
+                    }
+                    n++;
+                }
+            }
+        }
+        {
+            int rc = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+
+            if (rc != 0) {
+                Ns_Log(Warning, "driver: could not set CPU affinity for shard %d: %s",
+                       shard, strerror(rc));
+            }
+        }
+    }
+#else
+    (void)shard;
+    (void)singleCpu;
+#endif
 }
 
 
@@ -903,7 +1083,7 @@ Ns_DriverInit(const char *server, const char *module, const Ns_DriverInitData *i
 
             for (i = 0; i < nrDrivers; i++) {
                 snprintf(moduleName, maxModuleNameLength, "%s:%d", module, i);
-                status = DriverInit(server, module, moduleName, init,
+                status = DriverInit(server, module, moduleName, i, init,
                                     servPtr, section,
                                     address,
                                     passedDefserver);
@@ -1415,7 +1595,7 @@ PortsPrint(Tcl_DString *dsPtr, const Ns_DList *dlPtr)
  *----------------------------------------------------------------------
  */
 static Ns_ReturnCode
-DriverInit(const char *server, const char *moduleName, const char *threadName,
+DriverInit(const char *server, const char *moduleName, const char *threadName, int shard,
            const Ns_DriverInitData *init,
            NsServer *servPtr, const char *section,
            const char *bindaddrs, const char *defserver)
@@ -1458,9 +1638,6 @@ DriverInit(const char *server, const char *moduleName, const char *threadName,
     Ns_MutexInit(&drvPtr->spooler.lock);
     Ns_MutexSetName2(&drvPtr->spooler.lock, "ns:drv:spool", threadName);
 
-    Ns_MutexInit(&drvPtr->writer.lock);
-    Ns_MutexSetName2(&drvPtr->writer.lock, "ns:drv:writer", threadName);
-
     if (ns_sockpair(drvPtr->trigger) != 0) {
         // @infer-ignore MEMORY_LEAK_C
         Ns_Fatal("ns_sockpair() failed: %s", ns_sockstrerror(ns_sockerrno));
@@ -1523,6 +1700,9 @@ DriverInit(const char *server, const char *moduleName, const char *threadName,
     drvPtr->reuseport      = Ns_ConfigBool(section,     "reuseport",       NS_FALSE);
     drvPtr->acceptsize     = Ns_ConfigIntRange(section, "acceptsize",      drvPtr->backlog, 1, INT_MAX);
     drvPtr->sockacceptlog  = Ns_ConfigIntRange(section, "sockacceptlog",   nsconf.sockacceptlog, 2, drvPtr->backlog);
+    drvPtr->pollBackend    = PollBackendFromString(section, Ns_ConfigString(section, "pollbackend", "poll"));
+    drvPtr->cpuaffinity    = Ns_ConfigBool(section,     "cpuaffinity",     NS_FALSE);
+    drvPtr->shard          = shard;
 
     drvPtr->keepmaxuploadsize   = (size_t)Ns_ConfigMemUnitRange(section, "keepalivemaxuploadsize",
                                                                 "0MB", (Tcl_WideInt)0, 0, INT_MAX);
@@ -1558,6 +1738,24 @@ DriverInit(const char *server, const char *moduleName, const char *threadName,
         drvPtr->reuseport = NS_FALSE;
 #endif
     }
+    if (drvPtr->cpuaffinity) {
+        /*
+         * Every driver thread forms a shard with its own CPUs. Connection
+         * threads are bound to the shard of the driver thread feeding them.
+         * Shards are numbered over all drivers, such that e.g. several
+         * drivers with a single driver thread are not pinned all to the
+         * same CPU.
+         */
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+        shardAffinity = NS_TRUE;
+        drvPtr->shard = nrShards++;
+#else
+        Ns_Log(Warning,
+               "parameter %s cpuaffinity was specified, but is not supported by the operating system",
+               section);
+        drvPtr->cpuaffinity = NS_FALSE;
+#endif
+    }
 
     drvPtr->uploadpath = ns_strcopy(Ns_ConfigString(section, "uploadpath", nsconf.tmpDir));
 
@@ -1627,6 +1825,7 @@ DriverInit(const char *server, const char *moduleName, const char *threadName,
             Ns_MutexSetName2(&queuePtr->lock, buffer, "queue");
             Ns_CondInit(&queuePtr->cond);
             queuePtr->id = i;
+            queuePtr->pollBackend = drvPtr->pollBackend;
             Push(queuePtr, spPtr->firstPtr);
         }
     } else {
@@ -1646,13 +1845,20 @@ DriverInit(const char *server, const char *moduleName, const char *threadName,
                                                           (Tcl_WideInt)1024*1024, 1024, INT_MAX);
         wrPtr->bufsize = (size_t)Ns_ConfigMemUnitRange(section, "writerbufsize", "8kB",
                                                        (Tcl_WideInt)8192, 512, INT_MAX);
+        wrPtr->maxbufsize = (size_t)Ns_ConfigMemUnitRange(section, "writermaxbufsize", "1MB",
+                                                          (Tcl_WideInt)1024*1024,
+                                                          (Tcl_WideInt)wrPtr->bufsize, INT_MAX);
+        wrPtr->sendfile = Ns_ConfigBool(section, "writersendfile", NS_TRUE);
         wrPtr->rateLimit = Ns_ConfigIntRange(section, "writerratelimit", 0, 0, INT_MAX);
         wrPtr->doStream = Ns_ConfigBool(section, "writerstreaming", NS_FALSE)
             ? NS_WRITER_STREAM_ACTIVE : NS_WRITER_STREAM_NONE;
         Ns_Log(Notice, "%s: enable %d writer thread(s) "
-               "for downloads >= %" PRIdz " bytes, bufsize=%" PRIdz " bytes, HTML streaming %d",
-               threadName, wrPtr->threads, wrPtr->writersize, wrPtr->bufsize, wrPtr->doStream);
+               "for downloads >= %" PRIdz " bytes, bufsize=%" PRIdz " bytes, maxbufsize=%" PRIdz
+               " bytes, HTML streaming %d, sendfile %d",
+               threadName, wrPtr->threads, wrPtr->writersize, wrPtr->bufsize, wrPtr->maxbufsize,
+               wrPtr->doStream, wrPtr->sendfile);
 
+        wrPtr->queues = ns_calloc((size_t)wrPtr->threads, sizeof(SpoolerQueue *));
         for (i = 0; i < wrPtr->threads; i++) {
             SpoolerQueue *queuePtr = ns_calloc(1u, sizeof(SpoolerQueue));
             char          buffer[100];
@@ -1662,6 +1868,7 @@ DriverInit(const char *server, const char *moduleName, const char *threadName,
             Ns_CondInit(&queuePtr->cond);
             queuePtr->id = i;
             Push(queuePtr, wrPtr->firstPtr);
+            wrPtr->queues[i] = queuePtr;
         }
     } else {
         Ns_Log(Notice, "%s: enable %d writer thread(s) ",
@@ -1946,6 +2153,15 @@ DriverInfoObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp, TCL_SIZE_T o
                 Tcl_ListObjAppendElement(interp, listObj, NsAtomObj(NS_ATOM_libraryversion));
                 Tcl_ListObjAppendElement(interp, listObj, NsStringObj(drvPtr->libraryVersion));
 
+                Tcl_ListObjAppendElement(interp, listObj, NsAtomObj(NS_ATOM_pollbackend));
+                Tcl_ListObjAppendElement(interp, listObj, Tcl_NewStringObj(PollBackendString(drvPtr->pollBackend), TCL_INDEX_NONE));
+
+                Tcl_ListObjAppendElement(interp, listObj, NsAtomObj(NS_ATOM_cpuaffinity));
+                Tcl_ListObjAppendElement(interp, listObj, Tcl_NewBooleanObj(drvPtr->cpuaffinity));
+
+                Tcl_ListObjAppendElement(interp, listObj, NsAtomObj(NS_ATOM_shard));
+                Tcl_ListObjAppendElement(interp, listObj, Tcl_NewIntObj(drvPtr->shard));
+
                 Tcl_ListObjAppendElement(interp, resultObj, listObj);
             }
         }
@@ -2020,6 +2236,9 @@ DriverStatsObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp, TCL_SIZE_T
             Tcl_ListObjAppendElement(interp, listObj, NsAtomObj(NS_ATOM_errors));
             Tcl_ListObjAppendElement(interp, listObj, Tcl_NewWideIntObj(drvPtr->stats.errors));
 
+            Tcl_ListObjAppendElement(interp, listObj, NsAtomObj(NS_ATOM_fastlane));
+            Tcl_ListObjAppendElement(interp, listObj, Tcl_NewWideIntObj(drvPtr->stats.fastlane));
+
             Tcl_ListObjAppendElement(interp, listObj, NsAtomObj(NS_ATOM_waiting));
             Tcl_ListObjAppendElement(interp, listObj, Tcl_NewWideIntObj((Tcl_WideInt)drvPtr->stats.waiting));
 
@@ -2029,6 +2248,24 @@ DriverStatsObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp, TCL_SIZE_T
             Tcl_ListObjAppendElement(interp, listObj, NsAtomObj(NS_ATOM_closing));
             Tcl_ListObjAppendElement(interp, listObj, Tcl_NewWideIntObj((Tcl_WideInt)drvPtr->stats.closing));
 
+            Tcl_ListObjAppendElement(interp, listObj, NsAtomObj(NS_ATOM_parked));
+            Tcl_ListObjAppendElement(interp, listObj, Tcl_NewWideIntObj((Tcl_WideInt)drvPtr->stats.parked));
+
+            Tcl_ListObjAppendElement(interp, listObj, NsAtomObj(NS_ATOM_localhandoffs));
+            Tcl_ListObjAppendElement(interp, listObj, Tcl_NewWideIntObj(NS_ATOMIC_LOAD(&drvPtr->stats.localhandoffs)));
+
+            Tcl_ListObjAppendElement(interp, listObj, NsAtomObj(NS_ATOM_remotehandoffs));
+            Tcl_ListObjAppendElement(interp, listObj, Tcl_NewWideIntObj(NS_ATOMIC_LOAD(&drvPtr->stats.remotehandoffs)));
+
+            Tcl_ListObjAppendElement(interp, listObj, NsAtomObj(NS_ATOM_ktls));
+            Tcl_ListObjAppendElement(interp, listObj, Tcl_NewWideIntObj(NS_ATOMIC_LOAD(&drvPtr->stats.ktls)));
+
+            Tcl_ListObjAppendElement(interp, listObj, NsAtomObj(NS_ATOM_resumptions));
+            Tcl_ListObjAppendElement(interp, listObj, Tcl_NewWideIntObj(NS_ATOMIC_LOAD(&drvPtr->stats.resumptions)));
+
+            Tcl_ListObjAppendElement(interp, listObj, NsAtomObj(NS_ATOM_resumptionmisses));
+            Tcl_ListObjAppendElement(interp, listObj, Tcl_NewWideIntObj(NS_ATOMIC_LOAD(&drvPtr->stats.resumptionmisses)));
+
             Tcl_ListObjAppendElement(interp, resultObj, listObj);
         }
         Tcl_SetObjResult(interp, resultObj);
@@ -3043,6 +3280,13 @@ DriverThread(void *arg)
     if (nrBindaddrs > 0) {
         NsDriverStartSpoolers(drvPtr);
         flags |= NS_DRIVER_THREAD_READY;
+        if (drvPtr->cpuaffinity) {
+            /*
+             * Bind after the spooler and writer threads were started, such
+             * they keep the affinity of the process.
+             */
+            NsDriverSetShardAffinity(drvPtr->shard, NS_TRUE);
+        }
     } else {
         Ns_Log(Warning, "could not bind any of the following addresses, stopping this driver: %s",
                drvPtr->address);
@@ -3059,7 +3303,7 @@ DriverThread(void *arg)
      * connections are complete and gracefully closed.
      */
 
-    PollCreate(&pdata);
+    PollCreate(&pdata, drvPtr->pollBackend);
     Ns_GetTime(&now);
     stopping = ((flags & NS_DRIVER_THREAD_SHUTDOWN) != 0u);
 
@@ -3087,13 +3331,15 @@ DriverThread(void *arg)
         }
 
         /*
-         * If there are any closing or read-ahead sockets, set the bits
-         * and determine the minimum relative timeout.
+         * If there are any closing, read-ahead or parked sockets, set the
+         * bits and determine the minimum relative timeout. Parked sockets
+         * are registered already, only the oldest one determines the
+         * timeout.
          *
          * TODO: the various poll timeouts should probably be configurable.
          */
 
-        if (readPtr == NULL && closePtr == NULL) {
+        if (readPtr == NULL && closePtr == NULL && pdata.firstParkedPtr == NULL) {
             pollTimeout = 10 * 1000;
 
         } else {
@@ -3104,6 +3350,9 @@ DriverThread(void *arg)
             for (sockPtr = closePtr; sockPtr != NULL; sockPtr = sockPtr->nextPtr) {
                 SockPoll(sockPtr, (short)POLLIN, &pdata);
             }
+            if (pdata.firstParkedPtr != NULL) {
+                PollSetTimeout(&pdata, &pdata.firstParkedPtr->timeout);
+            }
 
             if (pdata.timeout.sec == TIME_T_MAX) {
                 /*
@@ -3169,6 +3418,37 @@ DriverThread(void *arg)
          */
         Ns_GetTime(&now);
 
+        /*
+         * Move parked sockets with events to the read-ahead list and
+         * release parked sockets, which timed out. Since the list of
+         * parked sockets is ordered by timeout, only the expired ones
+         * have to be checked.
+         */
+        if (pdata.firstParkedPtr != NULL) {
+#ifdef HAVE_SYS_EPOLL_H
+            int i;
+
+            for (i = 0; i < pdata.nevents; i++) {
+                if (!POLL_IS_SLOT(pdata.events[i].data.u64)) {
+                    sockPtr = pdata.events[i].data.ptr;
+                    if (sockPtr->parked) {
+                        PollUnpark(&pdata, sockPtr);
+                        QueueStatsDecr(drvPtr->stats.parked, "driver parked");
+                        Push(sockPtr, readPtr);
+                    }
+                }
+            }
+#endif
+            while (pdata.firstParkedPtr != NULL
+                   && Ns_DiffTime(&pdata.firstParkedPtr->timeout, &now, NULL) <= 0) {
+                sockPtr = pdata.firstParkedPtr;
+                PollUnpark(&pdata, sockPtr);
+                QueueStatsDecr(drvPtr->stats.parked, "driver parked");
+                QueueStatsDecr(drvPtr->stats.reading, "driver reading");
+                SockRelease(sockPtr, SOCK_READTIMEOUT, 0);
+            }
+        }
+
         if (closePtr != NULL) {
             sockPtr  = closePtr;
             closePtr = NULL;
@@ -3176,12 +3456,12 @@ DriverThread(void *arg)
                 nextPtr = sockPtr->nextPtr;
                 QueueStatsDecr(drvPtr->stats.closing, "driver closing");
 
-                if (unlikely(PollHup(&pdata, sockPtr->pidx))) {
+                if (unlikely(SockPollHup(&pdata, sockPtr))) {
                     /*
                      * Peer has closed the connection
                      */
                     SockRelease(sockPtr, SOCK_CLOSE, 0);
-                } else if (likely(PollIn(&pdata, sockPtr->pidx))) {
+                } else if (likely(SockPollIn(&pdata, sockPtr))) {
                     /*
                      * Got some data
                      */
@@ -3224,14 +3504,14 @@ DriverThread(void *arg)
              */
             QueueStatsDecr(drvPtr->stats.reading, "driver reading");
 
-            if (unlikely(PollHup(&pdata, sockPtr->pidx))) {
+            if (unlikely(SockPollHup(&pdata, sockPtr))) {
                 /*
                  * Peer has closed the connection
                  */
                 Ns_Log(DriverDebug, "Peer has closed %p", (void*)sockPtr);
                 SockRelease(sockPtr, SOCK_CLOSE, 0);
 
-            } else if (unlikely(!PollIn(&pdata, sockPtr->pidx))
+            } else if (unlikely(!SockPollIn(&pdata, sockPtr))
                        && ((sockPtr->reqPtr == NULL) || (sockPtr->reqPtr->leftover == 0u))) {
                 /*
                  * Got no data for this sockPtr.
@@ -3252,6 +3532,13 @@ DriverThread(void *arg)
                 assert(drvPtr == sockPtr->drvPtr);
                 Ns_Log(DriverDebug, "Got some data for this sockPtr %p", (void*)sockPtr);
 
+                /*
+                 * When processing leftover data, the interest set might be
+                 * still active. Disable it, since the socket might be
+                 * passed to some other thread.
+                 */
+                PollDisarm(&pdata, sockPtr);
+
                 if (likely((drvPtr->opts & NS_DRIVER_ASYNC) != 0u)) {
                     SockState s = SockRead(sockPtr, 0, &now);
                     Ns_Log(DriverDebug, "SockRead on %p returned %s", (void*)sockPtr, SockStateString(s));
@@ -3492,7 +3779,16 @@ DriverThread(void *arg)
                        sockPtr->sock);
 
                 SockTimeout(sockPtr, &now, &drvPtr->keepwait);
-                Push(sockPtr, readPtr);
+                if (pdata.backend != NS_POLL_BACKEND_POLL
+                    && (sockPtr->reqPtr == NULL || sockPtr->reqPtr->leftover == 0u)) {
+                    /*
+                     * Idle keepalive socket without pipelined data.
+                     */
+                    PollPark(&pdata, sockPtr);
+                    drvPtr->stats.parked++;
+                } else {
+                    Push(sockPtr, readPtr);
+                }
                 drvPtr->stats.reading++;
             } else {
 
@@ -3544,6 +3840,11 @@ DriverThread(void *arg)
 
             DriverCloseSockList("closePtr", closePtr, &drvPtr->stats.closing);
             closePtr = NULL;
+
+            DriverCloseSockList("parked", pdata.firstParkedPtr, &drvPtr->stats.reading);
+            pdata.firstParkedPtr = NULL;
+            pdata.lastParkedPtr = NULL;
+            drvPtr->stats.parked = 0u;
         }
     }
 
@@ -3581,17 +3882,57 @@ DriverThread(void *arg)
     Ns_MutexUnlock(&drvPtr->lock);
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * PollCreate, PollFree --
+ *
+ *      Initialize and release a PollData structure for the specified
+ *      backend. When the epoll backend was requested but the epoll
+ *      instance cannot be created, fall back to poll().
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Allocates/frees memory and the epoll file descriptor.
+ *
+ *----------------------------------------------------------------------
+ */
 static void
-PollCreate(PollData *pdata)
+PollCreate(PollData *pdata, NsPollBackend backend)
 {
     NS_NONNULL_ASSERT(pdata != NULL);
     memset(pdata, 0, sizeof(PollData));
+    pdata->backend = NS_POLL_BACKEND_POLL;
+
+#ifdef HAVE_SYS_EPOLL_H
+    pdata->epfd = NS_INVALID_FD;
+    if (backend == NS_POLL_BACKEND_EPOLL) {
+        pdata->epfd = epoll_create1(EPOLL_CLOEXEC);
+        if (pdata->epfd == NS_INVALID_FD) {
+            Ns_Log(Warning, "epoll_create1() failed: %s; falling back to poll()",
+                   strerror(errno));
+        } else {
+            pdata->events = ns_malloc(POLL_MAX_EVENTS * sizeof(struct epoll_event));
+            pdata->backend = NS_POLL_BACKEND_EPOLL;
+        }
+    }
+#else
+    (void)backend;
+#endif
 }
 
 static void
 PollFree(PollData *pdata)
 {
     NS_NONNULL_ASSERT(pdata != NULL);
+#ifdef HAVE_SYS_EPOLL_H
+    if (pdata->epfd != NS_INVALID_FD) {
+        (void) ns_close(pdata->epfd);
+    }
+    ns_free(pdata->events);
+#endif
     ns_free(pdata->pfds);
     memset(pdata, 0, sizeof(PollData));
 }
@@ -3605,6 +3946,33 @@ PollReset(PollData *pdata)
     pdata->timeout.usec = 0;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * PollSetTimeout --
+ *
+ *      Update the minimum timeout of the PollData, when the provided
+ *      timeout is earlier.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Might update pdata->timeout.
+ *
+ *----------------------------------------------------------------------
+ */
+static void
+PollSetTimeout(PollData *pdata, const Ns_Time *timeoutPtr)
+{
+    NS_NONNULL_ASSERT(pdata != NULL);
+    NS_NONNULL_ASSERT(timeoutPtr != NULL);
+
+    if (Ns_DiffTime(timeoutPtr, &pdata->timeout, NULL) < 0) {
+        pdata->timeout = *timeoutPtr;
+    }
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -3613,6 +3981,11 @@ PollReset(PollData *pdata)
  *      Add a socket to the PollData's pollfd array, growing the array if
  *      necessary, and update the minimum timeout.
  *
+ *      With the epoll backend, the socket is registered in the epoll
+ *      instance only when the slot is used for the first time or when
+ *      the socket of the slot has changed. The registration stays active
+ *      over multiple spins.
+ *
  * Returns:
  *      The index (nfds before increment) at which this socket was installed
  *
@@ -3636,6 +4009,27 @@ PollSet(PollData *pdata, NS_SOCKET sock, short type, const Ns_Time *timeoutPtr)
         pdata->pfds = ns_realloc(pdata->pfds, pdata->maxfds * sizeof(struct pollfd));
     }
 
+#ifdef HAVE_SYS_EPOLL_H
+    if (pdata->backend == NS_POLL_BACKEND_EPOLL
+        && (pdata->nfds >= pdata->nregistered
+            || pdata->pfds[pdata->nfds].fd != sock
+            || pdata->pfds[pdata->nfds].events != type)
+        ) {
+        struct epoll_event ev;
+
+        memset(&ev, 0, sizeof(ev));
+        ev.events = (uint32_t)type;
+        ev.data.u64 = POLL_SLOT_TAG(pdata->nfds);
+        if (epoll_ctl(pdata->epfd, EPOLL_CTL_ADD, sock, &ev) != 0
+            && (errno != EEXIST || epoll_ctl(pdata->epfd, EPOLL_CTL_MOD, sock, &ev) != 0)) {
+            Ns_Log(Error, "PollSet: epoll_ctl() failed for fd %d: %s", sock, strerror(errno));
+        }
+        if (pdata->nfds >= pdata->nregistered) {
+            pdata->nregistered = pdata->nfds + 1u;
+        }
+    }
+#endif
+
     /*
      * Set the next pollfd struct with this socket.
      */
@@ -3648,20 +4042,73 @@ PollSet(PollData *pdata, NS_SOCKET sock, short type, const Ns_Time *timeoutPtr)
      * Check for new minimum timeout.
      */
 
-    if (timeoutPtr != NULL && Ns_DiffTime(timeoutPtr, &pdata->timeout, NULL) < 0) {
-        pdata->timeout = *timeoutPtr;
+    if (timeoutPtr != NULL) {
+        PollSetTimeout(pdata, timeoutPtr);
     }
 
     return pdata->nfds++;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * PollWait --
+ *
+ *      Wait for events on the sockets of the PollData with the provided
+ *      timeout in milliseconds.
+ *
+ * Returns:
+ *      Number of sockets with events.
+ *
+ * Side Effects:
+ *      Updates the returned events in the pollfd array, and for the epoll
+ *      backend in the Sock structures of the client sockets as well.
+ *
+ *----------------------------------------------------------------------
+ */
 static int
-PollWait(const PollData *pdata, int timeout)
+PollWait(PollData *pdata, int timeout)
 {
     int n;
 
     NS_NONNULL_ASSERT(pdata != NULL);
 
+#ifdef HAVE_SYS_EPOLL_H
+    if (pdata->backend == NS_POLL_BACKEND_EPOLL) {
+        int i;
+
+        do {
+            n = epoll_wait(pdata->epfd, pdata->events, POLL_MAX_EVENTS, timeout);
+        } while (n < 0  && errno == NS_EINTR);
+
+        if (n < 0) {
+            Ns_Fatal("PollWait: epoll_wait() failed: %s", strerror(errno));
+        }
+        pdata->nevents = n;
+
+        for (i = 0; i < n; i++) {
+            const struct epoll_event *evPtr = &pdata->events[i];
+            short revents = (short)(evPtr->events & (EPOLLIN|EPOLLOUT|EPOLLHUP|EPOLLERR));
+
+            if (POLL_IS_SLOT(evPtr->data.u64)) {
+                if (POLL_SLOT_INDEX(evPtr->data.u64) < pdata->nfds) {
+                    pdata->pfds[POLL_SLOT_INDEX(evPtr->data.u64)].revents = revents;
+                }
+            } else {
+                Sock *sockPtr = evPtr->data.ptr;
+
+                /*
+                 * Client sockets are registered with EPOLLONESHOT. After
+                 * an event, the interest set is disabled.
+                 */
+                sockPtr->revents = revents;
+                sockPtr->pollArmed = NS_FALSE;
+            }
+        }
+        return n;
+    }
+#endif
+
     do {
         n = ns_poll(pdata->pfds, pdata->nfds, timeout);
     } while (n < 0  && errno == NS_EINTR);
@@ -3672,6 +4119,215 @@ PollWait(const PollData *pdata, int timeout)
     return n;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * PollArm --
+ *
+ *      Register interest in the provided events of a client socket in
+ *      the epoll instance. When the socket is already registered with an
+ *      active interest set, no system call is needed.
+ *
+ * Returns:
+ *      None.
+ *
+ * Side Effects:
+ *      Resets the returned events of the socket.
+ *
+ *----------------------------------------------------------------------
+ */
+static void
+PollArm(PollData *pdata, Sock *sockPtr, short type)
+{
+    NS_NONNULL_ASSERT(pdata != NULL);
+    NS_NONNULL_ASSERT(sockPtr != NULL);
+
+    sockPtr->revents = 0;
+
+#ifdef HAVE_SYS_EPOLL_H
+    /*
+     * Sockets without a descriptor (e.g. detached via "ns_conn channel")
+     * are ignored like by poll() and handled by the timeouts only.
+     */
+    if (!sockPtr->pollArmed && sockPtr->sock != NS_INVALID_SOCKET) {
+        struct epoll_event ev;
+        int                op, rc;
+
+        memset(&ev, 0, sizeof(ev));
+        ev.events = (uint32_t)type | EPOLLONESHOT;
+        ev.data.ptr = sockPtr;
+
+        /*
+         * Sockets are registered once and modified afterwards. A socket
+         * might have been registered as well in the epoll instance of a
+         * different thread (e.g. a spooler thread).
+         */
+        op = (sockPtr->pollfd == pdata->epfd) ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+        rc = epoll_ctl(pdata->epfd, op, sockPtr->sock, &ev);
+        if (rc != 0) {
+            if (op == EPOLL_CTL_MOD && errno == ENOENT) {
+                rc = epoll_ctl(pdata->epfd, EPOLL_CTL_ADD, sockPtr->sock, &ev);
+            } else if (op == EPOLL_CTL_ADD && errno == EEXIST) {
+                rc = epoll_ctl(pdata->epfd, EPOLL_CTL_MOD, sockPtr->sock, &ev);
+            }
+        }
+        if (rc != 0) {
+            Ns_Log(Error, "PollArm: epoll_ctl() failed for fd %d: %s", sockPtr->sock, strerror(errno));
+        } else {
+            sockPtr->pollfd = pdata->epfd;
+            sockPtr->pollArmed = NS_TRUE;
+        }
+    }
+#else
+    (void)type;
+#endif
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * PollDisarm --
+ *
+ *      Disable the interest set of a registered client socket. This is
+ *      necessary, when the socket is passed to a different thread while
+ *      the interest set is still active. The registration is kept such
+ *      that it can be reactivated cheaply.
+ *
+ * Returns:
+ *      None.
+ *
+ * Side Effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+static void
+PollDisarm(PollData *pdata, Sock *sockPtr)
+{
+    NS_NONNULL_ASSERT(pdata != NULL);
+    NS_NONNULL_ASSERT(sockPtr != NULL);
+
+#ifdef HAVE_SYS_EPOLL_H
+    if (sockPtr->pollArmed) {
+        struct epoll_event ev;
+
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLONESHOT;
+        ev.data.ptr = sockPtr;
+        if (epoll_ctl(pdata->epfd, EPOLL_CTL_MOD, sockPtr->sock, &ev) != 0) {
+            Ns_Log(Warning, "PollDisarm: epoll_ctl() failed for fd %d: %s", sockPtr->sock, strerror(errno));
+        }
+        sockPtr->pollArmed = NS_FALSE;
+    }
+#endif
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * PollPark, PollUnpark --
+ *
+ *      Add a socket to the end of the list of parked sockets or remove
+ *      it from this list. Parked sockets are idle keepalive sockets
+ *      waiting for input. Since all parked sockets use the same
+ *      keepwait timeout, the list is ordered by the timeout.
+ *
+ * Returns:
+ *      None.
+ *
+ * Side Effects:
+ *      PollPark activates the interest set of the socket.
+ *
+ *----------------------------------------------------------------------
+ */
+static void
+PollPark(PollData *pdata, Sock *sockPtr)
+{
+    NS_NONNULL_ASSERT(pdata != NULL);
+    NS_NONNULL_ASSERT(sockPtr != NULL);
+    assert(!sockPtr->parked);
+
+    PollArm(pdata, sockPtr, (short)POLLIN);
+
+    sockPtr->nextPtr = NULL;
+    sockPtr->prevPtr = pdata->lastParkedPtr;
+    if (pdata->lastParkedPtr != NULL) {
+        pdata->lastParkedPtr->nextPtr = sockPtr;
+    } else {
+        pdata->firstParkedPtr = sockPtr;
+    }
+    pdata->lastParkedPtr = sockPtr;
+    sockPtr->parked = NS_TRUE;
+}
+
+static void
+PollUnpark(PollData *pdata, Sock *sockPtr)
+{
+    NS_NONNULL_ASSERT(pdata != NULL);
+    NS_NONNULL_ASSERT(sockPtr != NULL);
+    assert(sockPtr->parked);
+
+    if (sockPtr->prevPtr != NULL) {
+        sockPtr->prevPtr->nextPtr = sockPtr->nextPtr;
+    } else {
+        pdata->firstParkedPtr = sockPtr->nextPtr;
+    }
+    if (sockPtr->nextPtr != NULL) {
+        sockPtr->nextPtr->prevPtr = sockPtr->prevPtr;
+    } else {
+        pdata->lastParkedPtr = sockPtr->prevPtr;
+    }
+    sockPtr->nextPtr = NULL;
+    sockPtr->prevPtr = NULL;
+    sockPtr->parked = NS_FALSE;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * PollBackendFromString, PollBackendString --
+ *
+ *      Convert between the configured name of a poll backend and its
+ *      internal representation. Unsupported backends fall back to
+ *      poll().
+ *
+ * Returns:
+ *      Backend or name of the backend.
+ *
+ * Side Effects:
+ *      Might write a warning to the system log.
+ *
+ *----------------------------------------------------------------------
+ */
+static NsPollBackend
+PollBackendFromString(const char *section, const char *value)
+{
+    NsPollBackend backend = NS_POLL_BACKEND_POLL;
+
+    NS_NONNULL_ASSERT(section != NULL);
+
+    if (value == NULL || STREQ(value, "poll")) {
+        backend = NS_POLL_BACKEND_POLL;
+    } else if (STREQ(value, "epoll")) {
+#ifdef HAVE_SYS_EPOLL_H
+        backend = NS_POLL_BACKEND_EPOLL;
+#else
+        Ns_Log(Warning, "parameter %s pollbackend: epoll is not supported"
+               " by this operating system, using poll", section);
+#endif
+    } else {
+        Ns_Log(Warning, "parameter %s pollbackend: invalid value '%s'"
+               " (must be poll or epoll), using poll", section, value);
+    }
+    return backend;
+}
+
+static const char *
+PollBackendString(NsPollBackend backend)
+{
+    return (backend == NS_POLL_BACKEND_EPOLL) ? "epoll" : "poll";
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -3958,11 +4614,18 @@ SockQueue(Sock *sockPtr, const Ns_Time *timePtr)
 
         /*
          * Actual queueing. NS_OK means that ownership was transferred to a
-         * connection thread queue. NS_ERROR means that queueing failed and the
-         * request should be rejected. NS_TIMEOUT means that the socket remains
-         * owned by the driver and will be retried later.
-         */
-        result = NsQueueConn(sockPtr, timePtr);
+         * connection thread queue (or to a writer thread via the fast
+         * lane). NS_ERROR means that queueing failed and the request should
+         * be rejected. NS_TIMEOUT means that the socket remains owned by the
+         * driver and will be retried later.
+         */
+        if (sockPtr->servPtr != NULL
+            && sockPtr->servPtr->fastpath.lanec > 0
+            && SockFastLane(sockPtr)) {
+            result = NS_OK;
+        } else {
+            result = NsQueueConn(sockPtr, timePtr);
+        }
         if (unlikely(result == NS_ERROR)) {
 #ifdef NS_TRACE_QUEUEFULL_MEMORY
             if (Ns_LogSeverityEnabled(Ns_LogMemoryDebug)) {
@@ -3983,6 +4646,109 @@ SockQueue(Sock *sockPtr, const Ns_Time *timePtr)
     return result;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * SockFastLane --
+ *
+ *      Deliver a static file for a request directly from the driver
+ *      thread ("fast lane") when NsFastLaneLookup() accepts the
+ *      request. The response is handed to a writer thread without
+ *      involving a connection thread.
+ *
+ * Results:
+ *      NS_TRUE when the ownership of the socket was transferred to a
+ *      writer thread, NS_FALSE when the request has to be queued as
+ *      usual.
+ *
+ * Side effects:
+ *      Adds an entry to the access log and queues a writer job.
+ *
+ *----------------------------------------------------------------------
+ */
+static bool
+SockFastLane(Sock *sockPtr)
+{
+    Driver          *drvPtr;
+    DrvWriter       *wrPtr;
+    ConnPool        *poolPtr;
+    WriterSock      *wrSockPtr;
+    NsFastLaneReply  reply;
+    size_t           headerSize;
+
+    NS_NONNULL_ASSERT(sockPtr != NULL);
+
+    drvPtr = sockPtr->drvPtr;
+    wrPtr = &drvPtr->writer;
+
+    if (wrPtr->threads == 0
+        || (drvPtr->opts & NS_DRIVER_QUIC) != 0u
+        || !NsFastLaneLookup(sockPtr, &reply)) {
+        return NS_FALSE;
+    }
+
+    poolPtr = NsSockSelectPool(sockPtr->servPtr, sockPtr);
+    drvPtr->stats.received++;
+    drvPtr->stats.fastlane++;
+    (void) NS_ATOMIC_FETCH_ADD(&poolPtr->stats.fastlane, 1);
+
+    /*
+     * Write the access log entry before the writer thread might release
+     * the request.
+     */
+    NsAddNslogEntry(sockPtr, reply.statusCode, NULL, reply.length);
+
+    wrSockPtr = (WriterSock *)ns_calloc(1u, sizeof(WriterSock));
+    WriterMemStatsIncr(&writerMemStats.counters.writersock_new);
+
+    wrSockPtr->sockPtr = sockPtr;
+    wrSockPtr->poolPtr = poolPtr;
+    wrSockPtr->refCount = 1;
+    wrSockPtr->keep = reply.keep;
+    wrSockPtr->startTime = sockPtr->acceptTime;
+    wrSockPtr->rateLimit = (poolPtr->rate.poolLimit > 0)
+        ? poolPtr->rate.poolLimit / 2
+        : wrPtr->rateLimit;
+    sockPtr->timeout.sec = 0;
+
+    headerSize = (size_t)reply.headers.length;
+    if (reply.fd != NS_INVALID_FD) {
+        /*
+         * Place the header as "leftover" in the buffer for the file reads.
+         */
+        (void) ns_lseek(reply.fd, reply.offset, SEEK_SET);
+        wrSockPtr->fd = reply.fd;
+        wrSockPtr->c.file.maxsize = MAX(wrPtr->bufsize, headerSize);
+        wrSockPtr->c.file.buf = ns_malloc(wrSockPtr->c.file.maxsize);
+        memcpy(wrSockPtr->c.file.buf, reply.headers.string, headerSize);
+        wrSockPtr->c.file.bufsize = headerSize;
+        wrSockPtr->c.file.bufoffset = 0;
+        wrSockPtr->c.file.toRead = reply.length;
+    } else {
+        /*
+         * Header-only reply; the header is owned by c.mem.bufs[0].
+         */
+        wrSockPtr->fd = NS_INVALID_FD;
+        wrSockPtr->c.mem.bufs = wrSockPtr->c.mem.preallocated_bufs;
+        wrSockPtr->c.mem.nbufs = 1;
+        wrSockPtr->c.mem.bufs[0].iov_base = ns_strdup(reply.headers.string);
+        wrSockPtr->c.mem.bufs[0].iov_len  = headerSize;
+        WriterMemStatsIncr(&writerMemStats.counters.header_alloc);
+#ifdef WRITER_MEM_STATS
+        wrSockPtr->headerbufs = 1;
+#endif
+    }
+    wrSockPtr->size = headerSize + reply.length;
+    Tcl_DStringFree(&reply.headers);
+
+    Ns_Log(DriverDebug, "SockFastLane: status %d size %" PRIdz ": %s",
+           reply.statusCode, wrSockPtr->size, sockPtr->reqPtr->request.line);
+
+    WriterSubmit(wrPtr, wrSockPtr, NULL);
+
+    return NS_TRUE;
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -4013,10 +4779,10 @@ SockDeliveryAcquire(Sock *sock)
 
     assert((sockPtr->drvPtr->opts & NS_DRIVER_QUIC) != 0u);
 
-    NsWriterLock();
+    NsWriterLock(sockPtr);
     sockPtr->flags |= NS_CONN_DELIVERY_TRACKED;
     sockPtr->deliveryRefs++;
-    NsWriterUnlock();
+    NsWriterUnlock(sockPtr);
 }
 
 /*
@@ -4045,13 +4811,13 @@ SockDeliveryRelease(Sock *sockPtr)
 {
     NS_NONNULL_ASSERT(sockPtr != NULL);
 
-    NsWriterLock();
+    NsWriterLock(sockPtr);
     assert(sockPtr->deliveryRefs > 0u);
     sockPtr->deliveryRefs--;
     if (sockPtr->deliveryRefs == 0u) {
         sockPtr->flags &= ~NS_CONN_DELIVERY_TRACKED;
     }
-    NsWriterUnlock();
+    NsWriterUnlock(sockPtr);
 }
 
 /*
@@ -4082,9 +4848,9 @@ NsSockDeliveryRefs(const Ns_Sock *sock)
 
     NS_NONNULL_ASSERT(sock != NULL);
 
-    NsWriterLock();
+    NsWriterLock(sockPtr);
     result = sockPtr->deliveryRefs;
-    NsWriterUnlock();
+    NsWriterUnlock(sockPtr);
 
     return result;
 }
@@ -4177,7 +4943,12 @@ SockPoll(Sock *sockPtr, short type, PollData *pdata)
     NS_NONNULL_ASSERT(sockPtr != NULL);
     NS_NONNULL_ASSERT(pdata != NULL);
 
-    sockPtr->pidx = PollSet(pdata, sockPtr->sock, type, &sockPtr->timeout);
+    if (pdata->backend == NS_POLL_BACKEND_POLL) {
+        sockPtr->pidx = PollSet(pdata, sockPtr->sock, type, &sockPtr->timeout);
+    } else {
+        PollArm(pdata, sockPtr, type);
+        PollSetTimeout(pdata, &sockPtr->timeout);
+    }
 }
 
 /*
@@ -4353,7 +5124,12 @@ SockNew(Driver *drvPtr)
         sockPtr = ns_calloc(1u, sockSize);
         /*fprintf(stderr, "=== SockNew %p\n", (void*)sockPtr);*/
         sockPtr->drvPtr = drvPtr;
+        sockPtr->pollfd = NS_INVALID_FD;
     } else {
+        sockPtr->pollfd    = NS_INVALID_FD;
+        sockPtr->pollArmed = NS_FALSE;
+        sockPtr->parked    = NS_FALSE;
+        sockPtr->revents   = 0;
         sockPtr->tfd     = 0;
         sockPtr->taddr   = NULL;
         sockPtr->flags   = 0u;
@@ -4362,6 +5138,7 @@ SockNew(Driver *drvPtr)
         sockPtr->recvSockState = NS_SOCK_NONE;
         sockPtr->recvErrno = 0u;
         sockPtr->sendErrno = 0u;
+        sockPtr->writerQueue = 0;
     }
     return sockPtr;
 }
@@ -4640,9 +5417,11 @@ SockError(Sock *sockPtr, SockState reason, int err)
  *      Applications:
  *       - direct replies from the driver thread (via SockSendResponse())
  *       - 100 CONTINUE,
+ *       - static files delivered via the driver fast lane,
  *       - cases where the TRACE is not called in the connection thread.
  *
- *       Currently, the function is just used for the first two cases.
+ *      The number of sent content bytes "contentSent" is used only when
+ *      no connection is provided.
  *
  * Results:
  *      None.
@@ -4653,7 +5432,7 @@ SockError(Sock *sockPtr, SockState reason, int err)
  *----------------------------------------------------------------------
  */
 void
-NsAddNslogEntry(Sock *sockPtr, int statusCode, Ns_Conn *connPtr, const char *UNUSED(headers))
+NsAddNslogEntry(Sock *sockPtr, int statusCode, Ns_Conn *connPtr, size_t contentSent)
 {
     bool isConnConstructed;
     Conn conn;
@@ -4684,6 +5463,7 @@ NsAddNslogEntry(Sock *sockPtr, int statusCode, Ns_Conn *connPtr, const char *UNU
             conn.request            = sockPtr->reqPtr->request;
             conn.headers            = conn.reqPtr->headers;
             conn.responseStatus     = statusCode;
+            conn.nContentSent       = contentSent;
             conn.acceptTime         = sockPtr->acceptTime;
             conn.requestQueueTime   = sockPtr->acceptTime;
             conn.requestDequeueTime = sockPtr->acceptTime;
@@ -4815,7 +5595,7 @@ SockSendResponse(Sock *sockPtr, SockState reason, int statusCode, const char *er
     Ns_Log(Debug, "SockSendResponse finishes request with status code %d msg <%s> headers <%s>",
            statusCode, errMsg, headers);
 
-    NsAddNslogEntry(sockPtr, statusCode, NULL, headers);
+    NsAddNslogEntry(sockPtr, statusCode, NULL, 0u);
 
     snprintf(firstline, sizeof(firstline), "HTTP/1.0 %d ", statusCode);
     ns_iov_set(&iov[0], firstline,      strlen(firstline));
@@ -5552,10 +6332,7 @@ LogBuffer(Ns_LogSeverity severity, const char *msg, const char *buffer, size_t l
 static void
 DeterminePeerAddrFromHeaders(Sock *sockPtr)
 {
-    Request    *reqPtr = sockPtr->reqPtr;
-    const char *s = Ns_SetIGet(reqPtr->headers, "x-forwarded-for");
-
-    //Ns_Log(Notice, "XXXXX DeterminePeerAddrFromHeaders sockPtr %p reqPtr %p", (void*)sockPtr, (void*)reqPtr);
+    const char *s = sockPtr->extractedHeaderFields[NS_EXTRACTED_HEADER_X_FORWARDED_FOR];
 
     if (s != NULL && !strcasecmp(s, "unknown")) {
         s = NULL;
@@ -6005,7 +6782,8 @@ EndOfHeader(Sock *sockPtr, size_t *contentOffsetPtr)
     contentLengthString =
         sockPtr->extractedHeaderFields[NS_EXTRACTED_HEADER_CONTENT_LENGTH];
 
-    transferEncodingString = Ns_SetIGet(reqPtr->headers, "transfer-encoding");
+    transferEncodingString =
+        sockPtr->extractedHeaderFields[NS_EXTRACTED_HEADER_TRANSFER_ENCODING];
 
     /*
      * CL+TE is ambiguous and request-smuggling relevant as RFC 9112 points
@@ -6041,7 +6819,7 @@ EndOfHeader(Sock *sockPtr, size_t *contentOffsetPtr)
         /*
          * Preserve existing x-expected-entity-length support.
          */
-        s = Ns_SetIGet(reqPtr->headers, "x-expected-entity-length");
+        s = sockPtr->extractedHeaderFields[NS_EXTRACTED_HEADER_X_EXPECTED_ENTITY_LENGTH];
         if (s != NULL) {
             size_t expected;
 
@@ -6090,15 +6868,15 @@ EndOfHeader(Sock *sockPtr, size_t *contentOffsetPtr)
     /*
      * Compression format handling: preserve existing behavior.
      */
-    sockPtr->flags &= ~(NS_CONN_ZIPACCEPTED|NS_CONN_BROTLIACCEPTED);
+    sockPtr->flags &= ~(NS_CONN_ZIPACCEPTED|NS_CONN_BROTLIACCEPTED|NS_CONN_ZSTDACCEPTED);
 
-    s = Ns_SetIGet(reqPtr->headers, "accept-encoding");
+    s = sockPtr->extractedHeaderFields[NS_EXTRACTED_HEADER_ACCEPT_ENCODING];
     if (s != NULL) {
-        bool gzipAccept, brotliAccept;
+        bool gzipAccept, brotliAccept, zstdAccept;
 
-        NsParseAcceptEncoding(reqPtr->request.version, s, &gzipAccept, &brotliAccept);
-        if (gzipAccept || brotliAccept) {
-            s = Ns_SetIGet(reqPtr->headers, "range");
+        NsParseAcceptEncoding(reqPtr->request.version, s, &gzipAccept, &brotliAccept, &zstdAccept);
+        if (gzipAccept || brotliAccept || zstdAccept) {
+            s = sockPtr->extractedHeaderFields[NS_EXTRACTED_HEADER_RANGE];
             if (s == NULL) {
                 if (gzipAccept) {
                     sockPtr->flags |= NS_CONN_ZIPACCEPTED;
@@ -6106,6 +6884,9 @@ EndOfHeader(Sock *sockPtr, size_t *contentOffsetPtr)
                 if (brotliAccept) {
                     sockPtr->flags |= NS_CONN_BROTLIACCEPTED;
                 }
+                if (zstdAccept) {
+                    sockPtr->flags |= NS_CONN_ZSTDACCEPTED;
+                }
             }
         }
     }
@@ -6286,7 +7067,7 @@ SockParse(Sock *sockPtr)
                      * Reply with "100 continue".
                      */
                     Ns_Log(Ns_LogRequestDebug, "100-continue: reply CONTINUE");
-                    NsAddNslogEntry(sockPtr, 100, NULL, NULL);
+                    NsAddNslogEntry(sockPtr, 100, NULL, 0u);
                     Ns_Log(Debug, "**** 100-continue line <%s>", sockPtr->reqPtr->request.line);
 
                     ns_iov_set(&iov[0], continueResponse, sizeof(continueResponse) - 1);
@@ -6333,7 +7114,7 @@ SockParse(Sock *sockPtr)
                     Ns_Log(Notice, "pre-HTTP/1.0 request <%s>", reqPtr->request.line);
                 }
 
-            } else if (Ns_ParseHeader(reqPtr->headers, s, NULL, NULL) != NS_OK) {
+            } else if (NsParseRequestHeaderLine(reqPtr->headers, s, (size_t)(e-s)) != NS_OK) {
                 /*
                  * Invalid header.
                  */
@@ -6931,7 +7712,9 @@ NsDriverLookupHostCtx(Tcl_DString *hostDs, const char *hostName, Ns_Driver *drvP
  *
  *      Check if the singleton request header fields are provided only once.
  *      Certain header field values, which are often used are extracted into
- *      "extractedHeaderFields".
+ *      "extractedHeaderFields", such that the driver does not have to
+ *      search the header set for every lookup. For non-singleton fields, the
+ *      first occurrence is extracted.
  *
  *      Note that these strings are only guaranteed to be correct as long the
  *      underlying Ns_Set is not changed. This typically the case just in the
@@ -6951,7 +7734,7 @@ CheckSingletonHeaderFields(Sock *sockPtr)
 {
     size_t        i, idx;
     Ns_Set       *headers = sockPtr->reqPtr->headers;
-    int           counts[Ns_NrElements(singletonRequestHeaderFields)] = {0};
+    int           counts[Ns_NrElements(requestHeaderFields)] = {0};
     const char **singletonFields = sockPtr->extractedHeaderFields;
 
     memset(sockPtr->extractedHeaderFields, 0, sizeof(sockPtr->extractedHeaderFields));
@@ -6964,8 +7747,8 @@ CheckSingletonHeaderFields(Sock *sockPtr)
         const char *name       = headers->fields[idx].name;
         char        first_char = (CHARTYPE(lower, *name) != 0) ? *name : CHARCONV(lower, *name);
 
-        for (i = 0; i < Ns_NrElements(singletonRequestHeaderFields); i++) {
-            const char *singletonName = singletonRequestHeaderFields[i].name;
+        for (i = 0; i < Ns_NrElements(requestHeaderFields); i++) {
+            const char *singletonName = requestHeaderFields[i].name;
             int         cmp;
 
             /*
@@ -6978,19 +7761,27 @@ CheckSingletonHeaderFields(Sock *sockPtr)
             //Ns_Log(Notice, "cmd %s vs %s -> %d",name, singletonName, cmp);
 
             if (cmp == 0) {
+                NsExtractedHeaderIndex extract = requestHeaderFields[i].extract;
+
                 if (++counts[i] > 1) {
+                    if (!requestHeaderFields[i].singleton) {
+                        /*
+                         * Keep the first occurrence.
+                         */
+                        break;
+                    }
                     Ns_Log(Warning, "request header field \"%s\" is provided more than once. Request: \"%s\"\n",
                            singletonName, sockPtr->reqPtr->request.line);
                     return NS_ERROR;
 
                 }
-                if (singletonRequestHeaderFields[i].extract != NS_EXTRACTED_NONE) {
-                    singletonFields[singletonRequestHeaderFields[i].extract] = headers->fields[idx].value;
+                if (extract != NS_EXTRACTED_NONE) {
+                    singletonFields[extract] = headers->fields[idx].value;
                 }
                 break;
             } else if (cmp > 0) {
                 /*
-                 * The fields in singletonRequestHeaderFields are
+                 * The fields in requestHeaderFields are
                  * sorted. Later values can't match.
                  */
                 break;
@@ -7239,7 +8030,7 @@ SpoolerThread(void *arg)
 
     Ns_Log(Notice, "spooler%d: accepting connections", queuePtr->id);
 
-    PollCreate(&pdata);
+    PollCreate(&pdata, queuePtr->pollBackend);
     Ns_GetTime(&now);
 
     while (!stopping) {
@@ -7288,14 +8079,14 @@ SpoolerThread(void *arg)
 
             QueueStatsDecr(drvPtr->spooler.stats.reading, "spooler reading");
 
-            if (unlikely(PollHup(&pdata, sockPtr->pidx))) {
+            if (unlikely(SockPollHup(&pdata, sockPtr))) {
                 /*
                  * Peer has closed the connection
                  */
                 SockRelease(sockPtr, SOCK_CLOSE, 0);
                 queuePtr->queuesize--;
 
-            } else if (!PollIn(&pdata, sockPtr->pidx)) {
+            } else if (!SockPollIn(&pdata, sockPtr)) {
                 /*
                  * Got no data
                  */
@@ -7574,9 +8365,12 @@ SockSpoolerQueue(Driver *drvPtr, Sock *sockPtr)
  *       Provide an API for locking and unlocking context information
  *       for streaming asynchronous writer jobs.  The locks are just
  *       needed for managing linkage between "connPtr" and a writer
- *       entry. The lock operations are rather infrequent and the
- *       lock duration is very short, such that at a single global
- *       appears sufficient.
+ *       entry and for the delivery references of a socket. The lock
+ *       duration is very short, but with many writer threads and
+ *       connection threads a single global lock becomes a point of
+ *       contention. Therefore, the lock is striped: the "key" (the
+ *       connection for stream linkage, the socket for delivery
+ *       references) selects one of NS_WRITER_LOCK_STRIPES mutexes.
  *
  * Results:
  *      None
@@ -7586,12 +8380,24 @@ SockSpoolerQueue(Driver *drvPtr, Sock *sockPtr)
  *
  *----------------------------------------------------------------------
  */
-void NsWriterLock(void) {
-    Ns_MutexLock(&writerlock);
+static Ns_Mutex *
+WriterLockForKey(const void *key)
+{
+    uintptr_t h = (uintptr_t)key >> 4;
+
+    h ^= h >> 7;
+    h ^= h >> 13;
+    return &writerlocks[h & (NS_WRITER_LOCK_STRIPES - 1u)];
 }
 
-void NsWriterUnlock(void) {
-    Ns_MutexUnlock(&writerlock);
+void NsWriterLock(const void *key) {
+    NS_NONNULL_ASSERT(key != NULL);
+    Ns_MutexLock(WriterLockForKey(key));
+}
+
+void NsWriterUnlock(const void *key) {
+    NS_NONNULL_ASSERT(key != NULL);
+    Ns_MutexUnlock(WriterLockForKey(key));
 }
 
 /*
@@ -7668,12 +8474,12 @@ WriterSockRequire(const Conn *connPtr) {
 
     NS_NONNULL_ASSERT(connPtr != NULL);
 
-    NsWriterLock();
+    NsWriterLock(connPtr);
     wrSockPtr = (WriterSock *)connPtr->strWriter;
     if (wrSockPtr != NULL) {
         wrSockPtr->refCount ++;
     }
-    NsWriterUnlock();
+    NsWriterUnlock(connPtr);
     return wrSockPtr;
 }
 
@@ -7704,14 +8510,19 @@ WriterSockRelease(WriterSock *wrSockPtr) {
     NsPoolAddBytesSent(wrSockPtr->poolPtr, wrSockPtr->nsent);
 
     if (wrSockPtr->doStream != NS_WRITER_STREAM_NONE) {
-        Conn *connPtr;
+        Conn *connPtr = wrSockPtr->connPtr;
 
-        NsWriterLock();
-        connPtr = wrSockPtr->connPtr;
-        if (connPtr != NULL && connPtr->strWriter != NULL) {
-            connPtr->strWriter = NULL;
+        /*
+         * The connPtr is set once when the writer job is submitted, so it
+         * can be used as a lock key without holding the lock.
+         */
+        if (connPtr != NULL) {
+            NsWriterLock(connPtr);
+            if (connPtr->strWriter != NULL) {
+                connPtr->strWriter = NULL;
+            }
+            NsWriterUnlock(connPtr);
         }
-        NsWriterUnlock();
 
         /*
          * In case, writer streams are activated for this wrSockPtr, make sure
@@ -7898,6 +8709,7 @@ WriterReadFromSpool(WriterSock *curPtr) {
             (void) ns_lseek(curPtr->fd, (off_t)curPtr->nsent, SEEK_SET);
         }
 
+        curPtr->queuePtr->stats.readcalls++;
         if (curPtr->c.file.nbufs == 0) {
             /*
              * Working on a single fd.
@@ -8061,6 +8873,7 @@ WriterSend(WriterSock *curPtr, int *err) {
      * Perform the actual send operation.
      */
     n = NsDriverSend(curPtr->sockPtr, bufs, nbufs, 0u);
+    curPtr->queuePtr->stats.sendcalls++;
 
     if (n == -1) {
         *err = ns_sockerrno;
@@ -8069,6 +8882,7 @@ WriterSend(WriterSock *curPtr, int *err) {
         /*
          * We have sent zero or more bytes.
          */
+        curPtr->queuePtr->stats.bytes += n;
         if (curPtr->doStream != NS_WRITER_STREAM_NONE) {
             Ns_MutexLock(&curPtr->c.file.fdlock);
             curPtr->size -= (size_t)n;
@@ -8121,6 +8935,136 @@ WriterSend(WriterSock *curPtr, int *err) {
     return status;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * WriterSendDirect --
+ *
+ *      Utility function of the WriterThread to send file content without
+ *      reading it into the writer buffer. The file is sent via the
+ *      sendfile infrastructure of the driver (NsDriverSendFile()), which
+ *      uses sendfile() on plain connections and e.g. SSL_sendfile() on
+ *      TLS connections with kernel TLS. Drivers without such support
+ *      read the file with pread() into a small buffer. A leftover in the
+ *      buffer (the response header) is sent first. The file is never
+ *      mapped into memory: accessing a mapping of a file truncated
+ *      during the delivery raises SIGBUS inside the TLS library, where
+ *      it cannot be handled safely. Instead, a truncated file ends the
+ *      delivery with a read error.
+ *
+ *      The amount of file data per send operation adapts to what the
+ *      socket accepted: after a complete send, the size is doubled (up
+ *      to "writermaxbufsize"), after a partial send, it is reduced to
+ *      the sent amount (but not below "writerbufsize"). Rate-limited
+ *      jobs use always the minimum size.
+ *
+ * Results:
+ *      SPOOLER_OK or an error state.
+ *
+ * Side effects:
+ *      Sends data.
+ *
+ *----------------------------------------------------------------------
+ */
+static SpoolerState
+WriterSendDirect(WriterSock *curPtr, int *err) {
+    Sock            *sockPtr;
+    const DrvWriter *wrPtr;
+    SpoolerState     status = SPOOLER_OK;
+    size_t           toSend, headerSize, minChunk, fileSent = 0u;
+    ssize_t          n = 0;
+    bool             truncated = NS_FALSE;
+
+    NS_NONNULL_ASSERT(curPtr != NULL);
+    NS_NONNULL_ASSERT(err != NULL);
+
+    sockPtr = curPtr->sockPtr;
+    wrPtr = &sockPtr->drvPtr->writer;
+    headerSize = curPtr->c.file.bufsize;
+    toSend = MIN(curPtr->c.file.toRead, curPtr->c.file.chunk);
+
+    /*
+     * A TLS write retried after a partial write must offer at least the
+     * pending record, therefore never go below the maximum record size.
+     */
+    minChunk = ((sockPtr->drvPtr->opts & NS_DRIVER_SSL) != 0u)
+        ? MAX(wrPtr->bufsize, NS_TLS_MAX_RECORD_SIZE)
+        : wrPtr->bufsize;
+
+    if (headerSize > 0u) {
+        struct iovec iov;
+
+        (void) Ns_SetVec(&iov, 0, curPtr->c.file.buf + curPtr->c.file.bufoffset, headerSize);
+        n = NsDriverSend(sockPtr, &iov, 1, 0u);
+        curPtr->queuePtr->stats.sendcalls++;
+    }
+    if (n == (ssize_t)headerSize && toSend > 0u) {
+        Ns_FileVec fbuf;
+        ssize_t    sent;
+
+        (void) Ns_SetFileVec(&fbuf, 0, curPtr->fd, NULL, curPtr->c.file.fileoffset, toSend);
+        sent = NsDriverSendFile(sockPtr, &fbuf, 1, 0u);
+        curPtr->queuePtr->stats.sendcalls++;
+        if (sent <= 0) {
+            struct stat st;
+
+            /*
+             * sendfile() returns 0 at the end of the file, the pread()
+             * emulation fails there. When the file was truncated
+             * during the delivery, the promised content cannot be
+             * sent anymore, so give up instead of retrying forever.
+             */
+            if (fstat(curPtr->fd, &st) == 0
+                && st.st_size < curPtr->c.file.fileoffset + (off_t)toSend) {
+                Ns_Log(Warning, "writer: file truncated during delivery"
+                       " (fd %d size %" PROTd " expected %" PROTd ")",
+                       curPtr->fd, st.st_size, curPtr->c.file.fileoffset + (off_t)toSend);
+                truncated = NS_TRUE;
+            }
+        }
+        if (sent == -1) {
+            n = -1;
+        } else {
+            fileSent = (size_t)sent;
+            n += sent;
+        }
+    }
+
+    if (truncated) {
+        *err = 0;
+        status = SPOOLER_READERROR;
+    } else if (n == -1) {
+        *err = ns_sockerrno;
+        status = SPOOLER_WRITEERROR;
+    } else {
+        size_t headerSent = (size_t)n - fileSent;
+
+        curPtr->queuePtr->stats.bytes += n;
+        curPtr->queuePtr->stats.direct += (Tcl_WideInt)fileSent;
+
+        curPtr->size -= (size_t)n;
+        curPtr->nsent += n;
+        sockPtr->timeout.sec = 0;
+
+        curPtr->c.file.bufsize -= headerSent;
+        curPtr->c.file.bufoffset = (curPtr->c.file.bufsize > 0u)
+            ? curPtr->c.file.bufoffset + (off_t)headerSent
+            : 0;
+        curPtr->c.file.fileoffset += (off_t)fileSent;
+        curPtr->c.file.toRead -= fileSent;
+
+        if (curPtr->rateLimit > 0) {
+            curPtr->c.file.chunk = minChunk;
+        } else if (fileSent == toSend) {
+            curPtr->c.file.chunk = MAX(MIN(curPtr->c.file.chunk * 2u, wrPtr->maxbufsize), minChunk);
+        } else if (headerSent == headerSize) {
+            curPtr->c.file.chunk = MAX(fileSent, minChunk);
+        }
+    }
+
+    return status;
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -8254,7 +9198,8 @@ ConnPoolInfoUpdateCB(const void *hashKey, void *hashValue, const void *UNUSED(ct
      *
      *  - deltaPercentage: adjust in a single iteration just a fraction
      *    (e.g. 10 percent) of the potential change. This function is
-     *    called often enough to justify delayed adjustments.
+     *    called every NS_WRITER_POOLRATE_INTERVAL by every busy writer
+     *    thread, which is often enough to justify delayed adjustments.
      */
     totalPoolRate = NsPoolTotalRate(poolPtr,
                                     infoPtr->threadSlot,
@@ -8571,9 +9516,11 @@ WriterThread(void *arg)
     WriterSock     *curPtr, *nextPtr, *writePtr = NULL;
     PollData        pdata;
     Tcl_HashTable   pools;     /* used for accumulating bandwidth per pool */
+    Ns_Time         poolRateTime = {0, 0}; /* next recomputation of pool rates */
 
     Ns_ThreadSetName("-writer%d-", queuePtr->id);
     queuePtr->threadName = Ns_ThreadGetName();
+    Ns_GetTime(&queuePtr->startTime);
 
     Tcl_InitHashTable(&pools, TCL_ONE_WORD_KEYS);
 
@@ -8583,7 +9530,7 @@ WriterThread(void *arg)
      */
 
     Ns_Log(Notice, "writer%d: accepting connections", queuePtr->id);
-    PollCreate(&pdata);
+    PollCreate(&pdata, NS_POLL_BACKEND_POLL);
 
     while (!stopping) {
         char charBuffer[1];
@@ -8598,8 +9545,20 @@ WriterThread(void *arg)
         if (writePtr == NULL) {
             pollTimeout = 30 * 1000;
         } else {
-            /* 1. adjust rate limits per pool */
-            BandwidthAdjustRateLimitsPerPool(writePtr, &pools);
+            /*
+             * 1. adjust rate limits per pool. The aggregation over all
+             * writer threads is done lazily, at most every
+             * NS_WRITER_POOLRATE_INTERVAL, such that busy writer threads
+             * do not contend on the pool rate locks in every iteration.
+             */
+            if (NsWriterBandwidthManagement) {
+                Ns_GetTime(&now);
+                if (Ns_DiffTime(&now, &poolRateTime, NULL) >= 0) {
+                    BandwidthAdjustRateLimitsPerPool(writePtr, &pools);
+                    poolRateTime = now;
+                    Ns_IncrTime(&poolRateTime, 0, NS_WRITER_POOLRATE_INTERVAL);
+                }
+            }
             /* 2. set up writer sockets in poll and get minimal timeout */
             pollTimeout = BandwidthAdjustPollForWriters(writePtr, &pdata);
         }
@@ -8697,12 +9656,17 @@ WriterThread(void *arg)
                      * If we are spooling from a file, read some data
                      * from the (spool) file and place it into curPtr->c.file.buf.
                      */
-                    if (curPtr->fd != NS_INVALID_FD) {
-                        spoolerState = WriterReadFromSpool(curPtr);
-                    }
+                    if (curPtr->fd != NS_INVALID_FD && curPtr->c.file.direct) {
+                        spoolerState = WriterSendDirect(curPtr, &err);
 
-                    if (spoolerState == SPOOLER_OK) {
-                        spoolerState = WriterSend(curPtr, &err);
+                    } else {
+                        if (curPtr->fd != NS_INVALID_FD) {
+                            spoolerState = WriterReadFromSpool(curPtr);
+                        }
+
+                        if (spoolerState == SPOOLER_OK) {
+                            spoolerState = WriterSend(curPtr, &err);
+                        }
                     }
                 }
             } else {
@@ -9005,9 +9969,7 @@ NsWriterQueue(Ns_Conn *conn, size_t nsend,
 {
     Conn          *connPtr;
     WriterSock    *wrSockPtr;
-    SpoolerQueue  *queuePtr;
     DrvWriter     *wrPtr;
-    bool           trigger = NS_FALSE;
     size_t         headerSize;
     Ns_ReturnCode  status = NS_OK;
     Ns_FileVec    *fbufs = NULL;
@@ -9368,26 +10330,96 @@ NsWriterQueue(Ns_Conn *conn, size_t nsend,
         connPtr->nContentSent = nsend - headerSize;
     }
 
+    WriterSubmit(wrPtr, wrSockPtr, connPtr->request.line);
+
+    return NS_OK;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * WriterQueueForSock --
+ *
+ *      Select the writer thread for a socket. The first writer job of a
+ *      socket takes the next writer thread in round robin order via an
+ *      atomic counter, so the selection requires no lock. Later jobs of
+ *      the same socket (e.g. on a persistent connection) stay on this
+ *      thread. Hashing the socket address instead would depend on the
+ *      allocation pattern of the Sock structures and could load a single
+ *      writer thread.
+ *
+ * Results:
+ *      Writer queue.
+ *
+ * Side effects:
+ *      Pins the writer thread in the socket structure.
+ *
+ *----------------------------------------------------------------------
+ */
+static SpoolerQueue *
+WriterQueueForSock(DrvWriter *wrPtr, Sock *sockPtr)
+{
+    if (sockPtr->writerQueue == 0) {
+        int64_t n = NS_ATOMIC_FETCH_ADD(&wrPtr->next, 1);
+
+        sockPtr->writerQueue = (int)(n % (int64_t)wrPtr->threads) + 1;
+    }
+    return wrPtr->queues[sockPtr->writerQueue - 1];
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * WriterSubmit --
+ *
+ *      Add a fully set up writer job to the queue of the writer thread
+ *      selected for its socket.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Wakes up the writer thread if necessary.
+ *
+ *----------------------------------------------------------------------
+ */
+static void
+WriterSubmit(DrvWriter *wrPtr, WriterSock *wrSockPtr, const char *requestLine)
+{
+    SpoolerQueue *queuePtr;
+    bool          trigger = NS_FALSE;
+
+    NS_NONNULL_ASSERT(wrPtr != NULL);
+    NS_NONNULL_ASSERT(wrSockPtr != NULL);
+
     /*
-     * Get the next writer thread from the list, all writer requests are
-     * rotated between all writer threads
+     * Deliveries of a single regular file are sent directly from the file,
+     * without reading the content into the writer buffer.
      */
+    if (wrPtr->sendfile
+        && wrSockPtr->fd != NS_INVALID_FD
+        && wrSockPtr->doStream == NS_WRITER_STREAM_NONE
+        && wrSockPtr->c.file.nbufs == 0
+        && wrSockPtr->c.file.toRead > 0u) {
+        struct stat st;
+        off_t       offset = ns_lseek(wrSockPtr->fd, 0, SEEK_CUR);
 
-    Ns_MutexLock(&wrPtr->lock);
-    if (wrPtr->curPtr == NULL) {
-        wrPtr->curPtr = wrPtr->firstPtr;
+        if (offset != -1 && fstat(wrSockPtr->fd, &st) == 0 && S_ISREG(st.st_mode)) {
+            wrSockPtr->c.file.direct = NS_TRUE;
+            wrSockPtr->c.file.fileoffset = offset;
+            wrSockPtr->c.file.chunk = wrPtr->bufsize;
+        }
     }
-    queuePtr = wrPtr->curPtr;
-    wrPtr->curPtr = wrPtr->curPtr->nextPtr;
-    Ns_MutexUnlock(&wrPtr->lock);
+
+    queuePtr = WriterQueueForSock(wrPtr, wrSockPtr->sockPtr);
 
     Ns_Log(WriterDebug, "Writer(%d): started: id=%d fd=%d, "
            "size=%" PRIdz ", flags=%X, rate %d KB/s: %s",
            wrSockPtr->sockPtr->sock,
            queuePtr->id, wrSockPtr->fd,
-           nsend, wrSockPtr->flags,
+           wrSockPtr->size, wrSockPtr->flags,
            wrSockPtr->rateLimit,
-           connPtr->request.line);
+           requestLine != NULL ? requestLine : NS_EMPTY_STRING);
 
     /*
      * Now add new writer socket to the writer thread's queue
@@ -9410,8 +10442,6 @@ NsWriterQueue(Ns_Conn *conn, size_t nsend,
     if (trigger) {
         SockTrigger(queuePtr->pipe[1]);
     }
-
-    return NS_OK;
 }
 
 /*
@@ -9916,7 +10946,8 @@ WriterSubmitFilesObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp, TCL_S
  * WriterListObjCmd - subcommand of NsTclWriterObjCmd --
  *
  *      Implements "ns_writer list" command.
- *      List the current writer jobs.
+ *      List the current writer jobs, or with "-stats" the throughput
+ *      of the writer threads.
  *
  * Results:
  *      Standard Tcl result.
@@ -9929,16 +10960,78 @@ WriterSubmitFilesObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp, TCL_S
 static int
 WriterListObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp, TCL_SIZE_T objc, Tcl_Obj *const* objv)
 {
-    int          result = TCL_OK;
+    int          result = TCL_OK, withStats = 0;
     NsServer    *servPtr = NULL;
     Ns_ObjvSpec  lopts[] = {
-        {"-server",  Ns_ObjvServer, &servPtr, NULL},
+        {"-server",  Ns_ObjvServer, &servPtr,   NULL},
+        {"-stats",   Ns_ObjvBool,   &withStats, INT2PTR(NS_TRUE)},
         {NULL, NULL, NULL, NULL}
     };
 
     if (unlikely(Ns_ParseObjv(lopts, NULL, interp, 2, objc, objv) != NS_OK)) {
         result = TCL_ERROR;
 
+    } else if (withStats != 0) {
+        Tcl_Obj      *resultObj = Tcl_NewListObj(0, NULL);
+        const Driver *drvPtr;
+        Ns_Time       now;
+
+        /*
+         * Report the throughput of every writer thread.
+         */
+        Ns_GetTime(&now);
+        for (drvPtr = firstDrvPtr; drvPtr != NULL; drvPtr = drvPtr->nextPtr) {
+            SpoolerQueue *queuePtr;
+
+            if (servPtr != NULL && servPtr != drvPtr->servPtr) {
+                continue;
+            }
+            for (queuePtr = drvPtr->writer.firstPtr; queuePtr != NULL; queuePtr = queuePtr->nextPtr) {
+                Tcl_Obj    *listObj = Tcl_NewListObj(0, NULL);
+                Tcl_WideInt bytes, sendcalls, readcalls, direct, calls;
+                Ns_Time     diff;
+                time_t      ms;
+                int         jobs;
+
+                Ns_MutexLock(&queuePtr->lock);
+                bytes     = queuePtr->stats.bytes;
+                sendcalls = queuePtr->stats.sendcalls;
+                readcalls = queuePtr->stats.readcalls;
+                direct    = queuePtr->stats.direct;
+                jobs      = queuePtr->queuesize;
+                Ns_MutexUnlock(&queuePtr->lock);
+
+                calls = sendcalls + readcalls;
+                Ns_DiffTime(&now, &queuePtr->startTime, &diff);
+                ms = Ns_TimeToMilliseconds(&diff);
+
+                Tcl_ListObjAppendElement(interp, listObj, NsAtomObj(NS_ATOM_thread));
+                Tcl_ListObjAppendElement(interp, listObj,
+                                         Tcl_NewStringObj(queuePtr->threadName != NULL
+                                                          ? queuePtr->threadName : NS_EMPTY_STRING,
+                                                          TCL_INDEX_NONE));
+                Tcl_ListObjAppendElement(interp, listObj, NsAtomObj(NS_ATOM_driver));
+                Tcl_ListObjAppendElement(interp, listObj, Tcl_NewStringObj(drvPtr->threadName, TCL_INDEX_NONE));
+                Tcl_ListObjAppendElement(interp, listObj, NsAtomObj(NS_ATOM_jobs));
+                Tcl_ListObjAppendElement(interp, listObj, Tcl_NewIntObj(jobs));
+                Tcl_ListObjAppendElement(interp, listObj, NsAtomObj(NS_ATOM_bytes));
+                Tcl_ListObjAppendElement(interp, listObj, Tcl_NewWideIntObj(bytes));
+                Tcl_ListObjAppendElement(interp, listObj, NsAtomObj(NS_ATOM_direct));
+                Tcl_ListObjAppendElement(interp, listObj, Tcl_NewWideIntObj(direct));
+                Tcl_ListObjAppendElement(interp, listObj, NsAtomObj(NS_ATOM_sendcalls));
+                Tcl_ListObjAppendElement(interp, listObj, Tcl_NewWideIntObj(sendcalls));
+                Tcl_ListObjAppendElement(interp, listObj, NsAtomObj(NS_ATOM_readcalls));
+                Tcl_ListObjAppendElement(interp, listObj, Tcl_NewWideIntObj(readcalls));
+                Tcl_ListObjAppendElement(interp, listObj, NsAtomObj(NS_ATOM_bytespercall));
+                Tcl_ListObjAppendElement(interp, listObj, Tcl_NewWideIntObj(calls > 0 ? bytes / calls : 0));
+                Tcl_ListObjAppendElement(interp, listObj, NsAtomObj(NS_ATOM_callspersec));
+                Tcl_ListObjAppendElement(interp, listObj,
+                                         Tcl_NewDoubleObj(ms > 0 ? (double)calls * 1000.0 / (double)ms : 0.0));
+                Tcl_ListObjAppendElement(interp, resultObj, listObj);
+            }
+        }
+        Tcl_SetObjResult(interp, resultObj);
+
     } else {
         Tcl_DString       ds, *dsPtr = &ds;
         const Driver     *drvPtr;
@@ -10550,7 +11643,7 @@ AsyncWriterThread(void *arg)
      * Allocate and initialize controlling variables
      */
 
-    PollCreate(&pdata);
+    PollCreate(&pdata, NS_POLL_BACKEND_POLL);
 
     /*
      * Loop forever until signaled to shutdown and all
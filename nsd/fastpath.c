@@ -19,18 +19,44 @@
 
 /*
  * The following structure defines the contents of a file
- * stored in the file cache.
+ * stored in the file cache. The same structure is used for
+ * compressed variants, where "bytes" contains the compressed
+ * content and "srcSize" the size of the source file.
  */
 
 typedef struct {
     time_t mtime;
     size_t size;
+    off_t  srcSize;
     dev_t  dev;
     ino_t  ino;
     int    refcnt;
     char   bytes[1];  /* Grown to actual file size. */
 } File;
 
+/*
+ * The following structure defines a read-only mapped file in the
+ * file cache in "mmap" mode. Entries are immutable after being
+ * published in a slot of the slot table. A reader takes its reference
+ * under the lock of the slot group; the entry is unmapped when the
+ * slot reference and all reader references are gone.
+ */
+
+typedef struct MapEntry {
+    int64_t          refcnt;      /* Slot reference plus references of readers. */
+    bool             used;        /* Accessed since the last eviction sweep (under group lock). */
+    time_t           mtime;
+    off_t            size;
+    dev_t            dev;
+    ino_t            ino;
+    FileMap          fmap;
+    char             etag[40];    /* Precomputed ETag header value. */
+    char             path[1];     /* Grown to actual length of path. */
+} MapEntry;
+
+#define MAP_CACHE_PROBES  4       /* Slots of a group probed for a path (power of two). */
+#define MAP_CACHE_STRIPES 64      /* Locks shared by the slot groups (power of two). */
+
 
 /*
  * Local functions defined in this file
@@ -51,6 +77,64 @@ static Ns_ReturnCode FastReturn(Ns_Conn *conn, int statusCode, const char *mimeT
 static int  CompressExternalFile(Tcl_Interp *interp, const char *cmdName, const char *fileName, const char *gzFileName)
     NS_GNUC_NONNULL(1,2,3,4);
 
+static bool FileEntryValid(const File *filePtr, const struct stat *stPtr)
+    NS_GNUC_NONNULL(1,2) NS_GNUC_PURE;
+
+static bool CompressibleMimeType(const char *mimeType)
+    NS_GNUC_NONNULL(1) NS_GNUC_PURE;
+
+static File *CompressVariant(const struct stat *stPtr, Ns_CompressEncoding encoding, int level,
+                             const char *fileName, const struct iovec *bufs, int nbufs);
+
+static const char *CheckCompressCache(Ns_Conn *conn, const char *mimeType, const char *fileName,
+                                      size_t *lengthPtr, void **handlePtr)
+    NS_GNUC_NONNULL(1,2,3,4,5);
+
+static void MapCacheInit(const char *section)
+    NS_GNUC_NONNULL(1);
+
+static MapEntry *MapCacheGet(const char *fileName, const struct stat *stPtr)
+    NS_GNUC_NONNULL(1,2);
+
+static MapEntry *MapCacheInsert(MapEntry *newPtr, size_t group)
+    NS_GNUC_NONNULL(1);
+
+static void MapCacheEvict(size_t needed);
+
+static Ns_Mutex *MapCacheLock(size_t group);
+
+static void MapEntryRelease(MapEntry *entryPtr)
+    NS_GNUC_NONNULL(1);
+
+static bool MapEntryValid(const MapEntry *entryPtr, const struct stat *stPtr)
+    NS_GNUC_NONNULL(1,2) NS_GNUC_PURE;
+
+static Ns_ReturnCode MapEntryReturn(Ns_Conn *conn, int statusCode, const char *mimeType,
+                                    const MapEntry *entryPtr)
+    NS_GNUC_NONNULL(1,3,4);
+
+static bool ETagMatch(const char *header, const char *etag)
+    NS_GNUC_NONNULL(1,2) NS_GNUC_PURE;
+
+static size_t MapCacheHash(const char *path)
+    NS_GNUC_NONNULL(1) NS_GNUC_PURE;
+
+static void MapCacheStats(Tcl_DString *dsPtr, bool contents, bool reset)
+    NS_GNUC_NONNULL(1);
+
+static bool FastLaneUrl(const NsServer *servPtr, const char *url)
+    NS_GNUC_NONNULL(1,2) NS_GNUC_PURE;
+
+static bool FastLaneRange(const char *spec, off_t size, off_t *startPtr, off_t *endPtr)
+    NS_GNUC_NONNULL(1,3,4);
+
+static bool FastLaneKeep(const Sock *sockPtr, size_t length)
+    NS_GNUC_NONNULL(1);
+
+static void FastLaneHeaders(const Sock *sockPtr, NsFastLaneReply *replyPtr, const char *mimeType,
+                            const struct stat *stPtr, off_t start, off_t end)
+    NS_GNUC_NONNULL(1,2,3,4);
+
 
 static const char *
 CheckStaticCompressedDelivery(
@@ -81,6 +165,26 @@ static bool      useGzipRefresh = NS_FALSE;   /* Update outdated gzip files auto
 static bool      useBrotli = NS_FALSE;        /* Use brotli delivery if possible                      */
 static bool      useBrotliRefresh = NS_FALSE; /* Update outdated brotli files automatically via ::ns_brotlifile */
 
+static Ns_Cache *compressCache = NULL;        /* Global cache of compressed variants.                    */
+static size_t    compressMaxEntry;            /* Maximum size of the source of a compressed variant.     */
+
+/*
+ * File cache in "mmap" mode.
+ */
+static struct {
+    MapEntry **slots;                         /* Slot table, groups of MAP_CACHE_PROBES slots.       */
+    size_t     mask;                          /* Number of slots - 1 (power of two).                 */
+    size_t     maxSize;                       /* Maximum total size of mapped files.                 */
+    size_t     size;                          /* Current total size of mapped files (under lock).    */
+    size_t     hand;                          /* Next group of the eviction sweep (under lock).      */
+    int64_t    nhit;                          /* Statistics, accessed atomically.                    */
+    int64_t    nmiss;
+    int64_t    nflushed;
+    int64_t    npruned;
+    Ns_Mutex   lock;                          /* Serializes slot updates, eviction and the size.     */
+    Ns_Mutex   stripes[MAP_CACHE_STRIPES];    /* Locks of the slot groups, taken by readers.         */
+} mapCache = {NULL, 0u, 0u, 0u, 0u, 0, 0, 0, 0, NULL, {NULL}};
+
 
 
 /*
@@ -112,10 +216,26 @@ NsConfigFastpath(void)
     useBrotliRefresh = Ns_ConfigBool(section, "brotli_refresh", NS_FALSE);
 
     if (Ns_ConfigBool(section, "cache", NS_FALSE)) {
-        size_t size = (size_t)Ns_ConfigMemUnitRange(section, "cachemaxsize", "10MB",
+        const char *mode = Ns_ConfigString(section, "cachemode", "copy");
+
+        if (STREQ(mode, "mmap")) {
+            MapCacheInit(section);
+        } else {
+            size_t size = (size_t)Ns_ConfigMemUnitRange(section, "cachemaxsize", "10MB",
+                                                        (Tcl_WideInt)1024*10000, 1024, INT_MAX);
+            if (!STREQ(mode, "copy")) {
+                Ns_Log(Warning, "fastpath: invalid cachemode '%s' (must be copy or mmap), using copy", mode);
+            }
+            cache = Ns_CacheCreateSz("ns:fastpath", TCL_STRING_KEYS, size, FreeEntry);
+            maxentry = (int)Ns_ConfigMemUnitRange(section, "cachemaxentry", "8KB", 8192, 8, INT_MAX);
+        }
+    }
+    if (Ns_ConfigBool(section, "compresscache", NS_FALSE)) {
+        size_t size = (size_t)Ns_ConfigMemUnitRange(section, "compresscachemaxsize", "10MB",
                                                     (Tcl_WideInt)1024*10000, 1024, INT_MAX);
-        cache = Ns_CacheCreateSz("ns:fastpath", TCL_STRING_KEYS, size, FreeEntry);
-        maxentry = (int)Ns_ConfigMemUnitRange(section, "cachemaxentry", "8KB", 8192, 8, INT_MAX);
+        compressCache = Ns_CacheCreateSz("ns:fastpath:compressed", TCL_STRING_KEYS, size, FreeEntry);
+        compressMaxEntry = (size_t)Ns_ConfigMemUnitRange(section, "compresscachemaxentry", "1MB",
+                                                         1024*1024, 1, INT_MAX);
     }
     /*
      * Register the fastpath initialization for every server.
@@ -199,6 +319,12 @@ ConfigServerFastpath(const char *server)
          */
             (void)Ns_NullIfEmpty(Ns_ConfigString(section, "directorylisting", "none"));
 
+        p = Ns_ConfigString(section, "fastlane", NS_EMPTY_STRING);
+        if (Tcl_SplitList(NULL, p, &servPtr->fastpath.lanec, &servPtr->fastpath.lanev) != TCL_OK) {
+            Ns_Log(Error, "fastpath[%s]: fastlane is not a list: %s", server, p);
+            servPtr->fastpath.lanec = 0;
+        }
+
         Ns_RegisterRequest2(NULL, server, "GET", "/",  Ns_FastPathProc, NULL, NULL, 0u, NULL);
         Ns_RegisterRequest2(NULL, server, "HEAD", "/", Ns_FastPathProc, NULL, NULL, 0u, NULL);
         Ns_RegisterRequest2(NULL, server, "POST", "/", Ns_FastPathProc, NULL, NULL, 0u, NULL);
@@ -361,6 +487,384 @@ Ns_FastPathProc(const void *UNUSED(arg), Ns_Conn *conn)
 }
 
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * NsFastLaneLookup --
+ *
+ *      Check, whether the request of the socket can be answered by the
+ *      driver directly ("fast lane"), without passing it to a connection
+ *      thread, and prepare the reply. This is the case for GET and HEAD
+ *      requests without a body for URLs below one of the "fastlane"
+ *      prefixes, which are served by the fastpath, have no filters or
+ *      request authorization procs registered and map to a regular
+ *      file. Servers with virtual hosting are not supported. Beside plain deliveries, If-Modified-Since and single byte
+ *      ranges are handled. Everything else (directories, missing files,
+ *      compressed deliveries, entity tags, multiple ranges, ...) is left
+ *      to the connection threads.
+ *
+ * Results:
+ *      NS_TRUE when the reply was prepared. In this case, the caller is
+ *      responsible for replyPtr->fd (when valid) and replyPtr->headers.
+ *
+ * Side effects:
+ *      Opens the file.
+ *
+ *----------------------------------------------------------------------
+ */
+bool
+NsFastLaneLookup(Sock *sockPtr, NsFastLaneReply *replyPtr)
+{
+    NsServer         *servPtr;
+    const Request    *reqPtr;
+    const Ns_Set     *headers;
+    const char       *method, *url, *mimeType, *hdr;
+    Ns_OpProc        *proc;
+    Ns_Callback      *deleteCallback;
+    void             *arg;
+    unsigned int      flags;
+    NsUrlSpaceContext ctx;
+    struct stat       st;
+    Tcl_DString       ds;
+    int               fd;
+    off_t             start, end;
+    bool              notModified = NS_FALSE, partial = NS_FALSE;
+
+    NS_NONNULL_ASSERT(sockPtr != NULL);
+    NS_NONNULL_ASSERT(replyPtr != NULL);
+
+    servPtr = sockPtr->servPtr;
+    reqPtr = sockPtr->reqPtr;
+    if (servPtr == NULL || servPtr->fastpath.lanec == 0 || reqPtr == NULL) {
+        return NS_FALSE;
+    }
+    /*
+     * Virtual hosting and server root procs determine the page directory
+     * from the connection, which does not exist yet.
+     */
+    if (servPtr->vhost.enabled || NsServerRootProcEnabled(servPtr)) {
+        return NS_FALSE;
+    }
+    method = reqPtr->request.method;
+    url = reqPtr->request.url;
+    headers = reqPtr->headers;
+
+    if (method == NULL || url == NULL || headers == NULL
+        || reqPtr->request.requestType != NS_REQUEST_TYPE_PLAIN
+        || reqPtr->request.version < 1.0
+        || reqPtr->length > 0u || reqPtr->contentLength > 0u
+        || (!STREQ(method, "GET") && !STREQ(method, "HEAD"))
+        || !FastLaneUrl(servPtr, url)
+        || Ns_SetIGet(headers, "if-none-match") != NULL
+        || Ns_SetIGet(headers, "if-match") != NULL
+        || Ns_SetIGet(headers, "if-unmodified-since") != NULL
+        ) {
+        return NS_FALSE;
+    }
+
+    /*
+     * The request must be handled by the fastpath without filters and
+     * request authorization.
+     */
+    NsUrlSpaceContextInit(&ctx, sockPtr, headers);
+    NsGetRequest2(servPtr, method, url, 0u, NS_URLSPACE_DEFAULT,
+                  NsUrlSpaceContextFilterEval, &ctx,
+                  &proc, &deleteCallback, &arg, &flags);
+    if (proc != Ns_FastPathProc
+        || NsFiltersRegistered(servPtr, method, url)
+        || NsAuthorizeRequestRegistered(servPtr)) {
+        return NS_FALSE;
+    }
+
+    Tcl_DStringInit(&ds);
+    if (NsUrlToFileDirect(&ds, servPtr, url) != NS_OK) {
+        Tcl_DStringFree(&ds);
+        return NS_FALSE;
+    }
+    mimeType = Ns_GetMimeType(ds.string);
+
+    /*
+     * Leave potentially compressed deliveries to the connection threads.
+     */
+    if ((useGzip || useBrotli || compressCache != NULL || servPtr->compress.enable)
+        && Ns_SetIGet(headers, "accept-encoding") != NULL
+        && CompressibleMimeType(mimeType)) {
+        Tcl_DStringFree(&ds);
+        return NS_FALSE;
+    }
+
+    fd = ns_open(ds.string, O_RDONLY | O_CLOEXEC, 0);
+    Tcl_DStringFree(&ds);
+    if (fd == NS_INVALID_FD) {
+        return NS_FALSE;
+    }
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        (void) ns_close(fd);
+        return NS_FALSE;
+    }
+
+    start = 0;
+    end = st.st_size - 1;
+
+    hdr = Ns_SetIGet(headers, "if-modified-since");
+    if (servPtr->opts.modsince && hdr != NULL && Ns_ParseHttpTime(hdr) >= st.st_mtime) {
+        notModified = NS_TRUE;
+
+    } else {
+        hdr = Ns_SetIGet(headers, "range");
+        if (hdr != NULL) {
+            const char *ifRange = Ns_SetIGet(headers, "if-range");
+
+            if (ifRange == NULL || st.st_mtime <= Ns_ParseHttpTime(ifRange)) {
+                if (!FastLaneRange(hdr, st.st_size, &start, &end)) {
+                    (void) ns_close(fd);
+                    return NS_FALSE;
+                }
+                partial = NS_TRUE;
+            }
+        }
+    }
+
+    if (notModified) {
+        replyPtr->statusCode = 304;
+        replyPtr->length = 0u;
+    } else {
+        replyPtr->statusCode = partial ? 206 : 200;
+        replyPtr->length = (size_t)(end - start + 1);
+    }
+    replyPtr->offset = start;
+    replyPtr->keep = FastLaneKeep(sockPtr, replyPtr->length);
+    FastLaneHeaders(sockPtr, replyPtr, mimeType, &st, start, end);
+
+    if (notModified || *method == 'H' || replyPtr->length == 0u) {
+        (void) ns_close(fd);
+        replyPtr->fd = NS_INVALID_FD;
+        replyPtr->length = 0u;
+    } else {
+        replyPtr->fd = fd;
+    }
+
+    return NS_TRUE;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * FastLaneUrl --
+ *
+ *      Check, whether the URL is below one of the configured fast lane
+ *      prefixes. A prefix matches only complete path segments.
+ *
+ * Results:
+ *      Boolean value.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+static bool
+FastLaneUrl(const NsServer *servPtr, const char *url)
+{
+    TCL_SIZE_T i;
+    bool       success = NS_FALSE;
+
+    for (i = 0; i < servPtr->fastpath.lanec && !success; i++) {
+        const char *prefix = servPtr->fastpath.lanev[i];
+        size_t      length = strlen(prefix);
+
+        if (length > 0u && strncmp(url, prefix, length) == 0) {
+            success = (prefix[length - 1u] == '/' || url[length] == '/' || url[length] == '\0');
+        }
+    }
+    return success;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * FastLaneRange --
+ *
+ *      Parse a range specification with a single satisfiable byte range
+ *      ("bytes=first-last", "bytes=first-" or "bytes=-suffix").
+ *
+ * Results:
+ *      NS_TRUE when the range was parsed, NS_FALSE for everything the
+ *      fast lane leaves to the range handling of the connection threads.
+ *
+ * Side effects:
+ *      Sets the offsets of the first and last byte.
+ *
+ *----------------------------------------------------------------------
+ */
+static bool
+FastLaneRange(const char *spec, off_t size, off_t *startPtr, off_t *endPtr)
+{
+    const char *p;
+    char       *endp;
+    Tcl_WideInt first = -1, last = -1;
+
+    if (strncasecmp(spec, "bytes=", 6u) != 0 || strchr(spec, INTCHAR(',')) != NULL) {
+        return NS_FALSE;
+    }
+    p = spec + 6;
+    if (CHARTYPE(digit, *p) != 0) {
+        first = strtoll(p, &endp, 10);
+        p = endp;
+    }
+    if (*p != '-') {
+        return NS_FALSE;
+    }
+    p++;
+    if (CHARTYPE(digit, *p) != 0) {
+        last = strtoll(p, &endp, 10);
+        p = endp;
+    }
+    if (*p != '\0' || size == 0) {
+        return NS_FALSE;
+    }
+
+    if (first >= 0) {
+        if (first >= size || (last >= 0 && last < first)) {
+            return NS_FALSE;
+        }
+        *startPtr = (off_t)first;
+        *endPtr = (last >= 0 && last < size) ? (off_t)last : size - 1;
+    } else if (last > 0) {
+        *startPtr = (last >= size) ? 0 : size - (off_t)last;
+        *endPtr = size - 1;
+    } else {
+        return NS_FALSE;
+    }
+    return NS_TRUE;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * FastLaneKeep --
+ *
+ *      Apply the keep-alive rules of the connection threads to a fast
+ *      lane reply.
+ *
+ * Results:
+ *      Boolean value.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+static bool
+FastLaneKeep(const Sock *sockPtr, size_t length)
+{
+    const Driver  *drvPtr = sockPtr->drvPtr;
+    const Request *reqPtr = sockPtr->reqPtr;
+    const char    *connection = sockPtr->extractedHeaderFields[NS_EXTRACTED_HEADER_CONNECTION];
+    bool           keep;
+
+    if (drvPtr->keepwait.sec <= 0 && drvPtr->keepwait.usec <= 0) {
+        keep = NS_FALSE;
+    } else if (reqPtr->request.version == 1.0) {
+        keep = (connection != NULL && strncasecmp(connection, "keep-alive", 10u) == 0);
+    } else {
+        keep = (connection == NULL || strncasecmp(connection, "close", 5u) != 0);
+    }
+    if (keep && drvPtr->keepmaxdownloadsize > 0u && length > drvPtr->keepmaxdownloadsize) {
+        keep = NS_FALSE;
+    }
+    return keep;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * FastLaneHeaders --
+ *
+ *      Construct the response header of a fast lane reply, including the
+ *      extra headers of the server and the driver.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Initializes and fills replyPtr->headers.
+ *
+ *----------------------------------------------------------------------
+ */
+static void
+FastLaneHeaders(const Sock *sockPtr, NsFastLaneReply *replyPtr, const char *mimeType,
+                const struct stat *stPtr, off_t start, off_t end)
+{
+    static const char *const fields[] = {
+        "server", "date", "content-type", "content-length", "last-modified",
+        "accept-ranges", "content-range", "connection", NULL
+    };
+    const Ns_Set *extraHeaders[2];
+    Tcl_DString  *dsPtr = &replyPtr->headers;
+    size_t        i, j;
+
+    Tcl_DStringInit(dsPtr);
+    Ns_DStringPrintf(dsPtr, "HTTP/%.1f %d %s\r\n",
+                     MIN(sockPtr->reqPtr->request.version, 1.1),
+                     replyPtr->statusCode, NsHttpStatusPhrase(replyPtr->statusCode));
+    if (!sockPtr->servPtr->opts.stealthmode) {
+        Ns_DStringVarAppend(dsPtr, "server: ", Ns_InfoServerName(), "/", Ns_InfoServerVersion(), "\r\n",
+                            NS_SENTINEL);
+    }
+    Tcl_DStringAppend(dsPtr, "date: ", 6);
+    (void)Ns_HttpTime(dsPtr, NULL);
+    Tcl_DStringAppend(dsPtr, "\r\nlast-modified: ", 17);
+    (void)Ns_HttpTime(dsPtr, &stPtr->st_mtime);
+    Tcl_DStringAppend(dsPtr, "\r\n", 2);
+
+    if (replyPtr->statusCode != 304) {
+        Ns_DStringVarAppend(dsPtr, "content-type: ", mimeType, "\r\n"
+                            "accept-ranges: bytes\r\n", NS_SENTINEL);
+        Ns_DStringPrintf(dsPtr, "content-length: %" PRIuz "\r\n", replyPtr->length);
+        if (replyPtr->statusCode == 206) {
+            Ns_DStringPrintf(dsPtr, "content-range: bytes %" PROTd "-%" PROTd "/%" PROTd "\r\n",
+                             start, end, stPtr->st_size);
+        }
+    }
+    Ns_DStringVarAppend(dsPtr, "connection: ", replyPtr->keep ? "keep-alive" : "close", "\r\n",
+                        NS_SENTINEL);
+
+    /*
+     * Add the extra headers of the server and the driver, where the
+     * server headers have the higher priority.
+     */
+    extraHeaders[0] = sockPtr->servPtr->opts.extraHeaders;
+    extraHeaders[1] = sockPtr->drvPtr->extraHeaders;
+    for (i = 0u; i < 2u; i++) {
+        if (extraHeaders[i] == NULL) {
+            continue;
+        }
+        for (j = 0u; j < Ns_SetSize(extraHeaders[i]); j++) {
+            const char *key = Ns_SetKey(extraHeaders[i], j);
+            bool        skip = NS_FALSE;
+            size_t      k;
+
+            for (k = 0u; fields[k] != NULL && !skip; k++) {
+                skip = (strcasecmp(key, fields[k]) == 0);
+            }
+            if (!skip && i > 0u && extraHeaders[0] != NULL) {
+                skip = (Ns_SetIFind(extraHeaders[0], key) != -1);
+            }
+            if (!skip) {
+                Ns_DStringVarAppend(dsPtr, key, ": ", Ns_SetValue(extraHeaders[i], j), "\r\n",
+                                    NS_SENTINEL);
+            }
+        }
+    }
+    Tcl_DStringAppend(dsPtr, "\r\n", 2);
+}
+
+
 /*
  *----------------------------------------------------------------------
  *
@@ -688,6 +1192,45 @@ FastReturn(Ns_Conn *conn, int statusCode, const char *mimeType, const char *file
 
     if (compressedFileName != NULL) {
         fileName = compressedFileName;
+
+    } else if (compressCache != NULL) {
+        const char *data;
+        size_t      length = 0u;
+        void       *handle = NULL;
+
+        /*
+         * No precompressed file is available, try a compressed variant
+         * from the compress cache.
+         */
+        data = CheckCompressCache(conn, mimeType, fileName, &length, &handle);
+        if (data != NULL) {
+            if ((conn->flags & NS_CONN_SKIPBODY) != 0u) {
+                data = NS_EMPTY_STRING;
+            }
+            status = Ns_ConnReturnData(conn, statusCode, data, (ssize_t)length, mimeType);
+            NsCompressCacheRelease(handle);
+            Tcl_DStringFree(dsPtr);
+            return status;
+        }
+    }
+
+    /*
+     * In "mmap" mode of the file cache, serve the file from the
+     * read-only mapping; only the lookup is performed under a lock.
+     */
+    if (mapCache.slots != NULL
+        && connPtr->fileInfo.st_size > 0
+        && connPtr->fileInfo.st_size <= maxentry
+        && connPtr->fileInfo.st_ctime < (time_t)(connPtr->acceptTime.sec - 1)
+        ) {
+        MapEntry *entryPtr = MapCacheGet(fileName, &connPtr->fileInfo);
+
+        if (entryPtr != NULL) {
+            status = MapEntryReturn(conn, statusCode, mimeType, entryPtr);
+            MapEntryRelease(entryPtr);
+            Tcl_DStringFree(dsPtr);
+            return status;
+        }
     }
 
     /*
@@ -757,12 +1300,7 @@ FastReturn(Ns_Conn *conn, int statusCode, const char *mimeType, const char *file
 
         if (isNew == 0) {
             filePtr = Ns_CacheGetValue(entry);
-            if (filePtr != NULL
-                && (filePtr->mtime != connPtr->fileInfo.st_mtime
-                    || filePtr->size != (size_t)connPtr->fileInfo.st_size
-                    || filePtr->dev  != (dev_t)connPtr->fileInfo.st_dev
-                    || filePtr->ino  != connPtr->fileInfo.st_ino)
-                ) {
+            if (filePtr != NULL && !FileEntryValid(filePtr, &connPtr->fileInfo)) {
                 Ns_CacheUnsetValue(entry);
                 isNew = 1;
             }
@@ -789,6 +1327,7 @@ FastReturn(Ns_Conn *conn, int statusCode, const char *mimeType, const char *file
                 filePtr = ns_malloc(sizeof(File) + (size_t)connPtr->fileInfo.st_size);
                 filePtr->refcnt = 1;
                 filePtr->size   = (size_t)connPtr->fileInfo.st_size;
+                filePtr->srcSize = connPtr->fileInfo.st_size;
                 filePtr->mtime  = connPtr->fileInfo.st_mtime;
                 filePtr->dev    = connPtr->fileInfo.st_dev;
                 filePtr->ino    = connPtr->fileInfo.st_ino;
@@ -840,12 +1379,13 @@ FastReturn(Ns_Conn *conn, int statusCode, const char *mimeType, const char *file
 /*
  *----------------------------------------------------------------------
  *
- * Ns_Stat --
+ * FileEntryValid --
  *
- *      Stat a file, logging an error on unexpected results.
+ *      Check, whether a cached entry is still valid for the file
+ *      described by the stat structure.
  *
  * Results:
- *      NS_TRUE if stat() was successful, NS_FALSE otherwise.
+ *      Boolean value.
  *
  * Side effects:
  *      None.
@@ -853,78 +1393,1008 @@ FastReturn(Ns_Conn *conn, int statusCode, const char *mimeType, const char *file
  *----------------------------------------------------------------------
  */
 
-bool
-Ns_Stat(const char *path, struct stat *stPtr)
+static bool
+FileEntryValid(const File *filePtr, const struct stat *stPtr)
 {
-    bool success = NS_TRUE;
-
-    NS_NONNULL_ASSERT(path != NULL);
+    NS_NONNULL_ASSERT(filePtr != NULL);
     NS_NONNULL_ASSERT(stPtr != NULL);
 
-    if (stat(path, stPtr) != 0) {
-        if (errno != ENOENT && errno != EACCES && errno != ENOTDIR) {
-            Ns_Log(Error, "fastpath: stat(%s) failed: %s",
-                   path, strerror(errno));
-        }
-        success = NS_FALSE;
-    }
-    return success;
+    return (filePtr->mtime      == stPtr->st_mtime
+            && filePtr->srcSize == stPtr->st_size
+            && filePtr->dev     == (dev_t)stPtr->st_dev
+            && filePtr->ino     == stPtr->st_ino);
 }
 
-
+
 /*
  *----------------------------------------------------------------------
  *
- * FastGetRestart --
+ * CompressibleMimeType --
  *
- *      Construct the full URL and redirect internally.
+ *      Check, whether content of the specified MIME type benefits from
+ *      compression. Images, audio, video and archives are typically
+ *      compressed already.
  *
  * Results:
- *      See Ns_ConnRedirect().
+ *      Boolean value.
  *
  * Side effects:
- *      See Ns_ConnRedirect().
+ *      None.
  *
  *----------------------------------------------------------------------
  */
 
-static Ns_ReturnCode
-FastGetRestart(Ns_Conn *conn, const char *page)
+static bool
+CompressibleMimeType(const char *mimeType)
 {
-    Ns_ReturnCode status;
-    Tcl_DString   ds;
-
-    NS_NONNULL_ASSERT(conn != NULL);
-    NS_NONNULL_ASSERT(page != NULL);
-
-    Tcl_DStringInit(&ds);
-    status = Ns_ConnRedirect(conn, Ns_MakePath(&ds, conn->request.url, page, NS_SENTINEL));
-    Tcl_DStringFree(&ds);
+    NS_NONNULL_ASSERT(mimeType != NULL);
 
-    return status;
+    return (strncmp(mimeType, "text/", 5u) == 0
+            || strstr(mimeType, "javascript") != NULL
+            || strstr(mimeType, "json") != NULL
+            || strstr(mimeType, "xml") != NULL
+            || strncmp(mimeType, "image/svg", 9u) == 0);
 }
 
-
+
 /*
  *----------------------------------------------------------------------
  *
- * DecrEntry --
+ * CheckCompressCache --
  *
- *      Decrement reference count of cached file.
+ *      Obtain a compressed variant of a static file from the compress
+ *      cache for the content-encoding preferred by the client. The
+ *      variant is created on the first request and replaced, when the
+ *      file changes.
  *
  * Results:
- *      None.
+ *      Compressed content or NULL, when the file is not eligible or the
+ *      client accepts no configured compression format. On success, the
+ *      length and the handle for NsCompressCacheRelease() are returned
+ *      in the last arguments.
  *
  * Side effects:
- *      None.
+ *      Sets the Vary and content-encoding headers.
  *
  *----------------------------------------------------------------------
  */
 
-static void
-DecrEntry(File *filePtr)
+static const char *
+CheckCompressCache(Ns_Conn *conn, const char *mimeType, const char *fileName,
+                   size_t *lengthPtr, void **handlePtr)
 {
-    NS_NONNULL_ASSERT(filePtr != NULL);
+    const Conn         *connPtr = (const Conn *)conn;
+    const NsServer     *servPtr = connPtr->poolPtr->servPtr;
+    const char         *result = NULL;
+    Ns_CompressEncoding encoding;
+    int                 level;
+
+    NS_NONNULL_ASSERT(conn != NULL);
+    NS_NONNULL_ASSERT(mimeType != NULL);
+    NS_NONNULL_ASSERT(fileName != NULL);
+    NS_NONNULL_ASSERT(lengthPtr != NULL);
+    NS_NONNULL_ASSERT(handlePtr != NULL);
+
+    /*
+     * Like for the file cache, skip files changed in the last second,
+     * since these might be written currently.
+     */
+    if (connPtr->fileInfo.st_size < servPtr->compress.minsize
+        || (size_t)connPtr->fileInfo.st_size > compressMaxEntry
+        || connPtr->fileInfo.st_ctime >= (time_t)(connPtr->acceptTime.sec - 1)
+        || !CompressibleMimeType(mimeType)) {
+        return NULL;
+    }
+
+    Ns_ConnCondSetHeadersSz(conn, "vary", 4, "accept-encoding", 15);
+    encoding = NsConnSelectCompression(connPtr, servPtr->compress.level, &level);
+
+    if (encoding != NS_COMPRESS_NONE) {
+        Tcl_DString ds;
+
+        Tcl_DStringInit(&ds);
+        Ns_DStringPrintf(&ds, "%s %d ", NsCompressEncodingName(encoding), level);
+        Tcl_DStringAppend(&ds, fileName, TCL_INDEX_NONE);
+
+        result = NsCompressCacheGet(ds.string, &connPtr->fileInfo, encoding, level,
+                                    fileName, NULL, 0, lengthPtr, handlePtr);
+        if (result != NULL) {
+            Ns_ConnCondSetHeadersSz(conn, "content-encoding", 16,
+                                    NsCompressEncodingName(encoding), TCL_INDEX_NONE);
+        }
+        Tcl_DStringFree(&ds);
+    }
+    return result;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * NsCompressCacheEnabled --
+ *
+ *      Check, whether the compress cache is configured.
+ *
+ * Results:
+ *      Boolean value.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+bool
+NsCompressCacheEnabled(void)
+{
+    return (compressCache != NULL);
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * NsCompressCacheGet --
+ *
+ *      Return the compressed variant cached under the provided key.
+ *      On a miss, the variant is created from either the file (when
+ *      fileName is given) or from the provided buffers and added to
+ *      the cache. When stPtr is given, the cached entry is validated
+ *      against mtime, size, device and inode of the source file.
+ *
+ *      Concurrent requests for the same key wait for the first one to
+ *      finish the compression, such that a variant is compressed once.
+ *
+ * Results:
+ *      Compressed content or NULL, when the source is too large or the
+ *      compression failed. On success, the length and a handle for
+ *      NsCompressCacheRelease() are returned in the last arguments.
+ *
+ * Side effects:
+ *      May compress content and modify the compress cache.
+ *
+ *----------------------------------------------------------------------
+ */
+
+const char *
+NsCompressCacheGet(const char *key, const struct stat *stPtr,
+                   Ns_CompressEncoding encoding, int level,
+                   const char *fileName, const struct iovec *bufs, int nbufs,
+                   size_t *lengthPtr, void **handlePtr)
+{
+    Ns_Entry *entry;
+    File     *filePtr = NULL;
+    int       isNew;
+    size_t    srcSize;
+
+    NS_NONNULL_ASSERT(key != NULL);
+    NS_NONNULL_ASSERT(lengthPtr != NULL);
+    NS_NONNULL_ASSERT(handlePtr != NULL);
+
+    srcSize = (stPtr != NULL) ? (size_t)stPtr->st_size : Ns_SumVec(bufs, nbufs);
+    if (compressCache == NULL || srcSize > compressMaxEntry) {
+        return NULL;
+    }
+
+    Ns_CacheLock(compressCache);
+    entry = Ns_CacheWaitCreateEntry(compressCache, key, &isNew, NULL);
+
+    if (isNew == 0) {
+        filePtr = Ns_CacheGetValue(entry);
+        if (filePtr != NULL && stPtr != NULL && !FileEntryValid(filePtr, stPtr)) {
+            Ns_CacheUnsetValue(entry);
+            filePtr = NULL;
+            isNew = 1;
+        }
+        if (filePtr != NULL) {
+            ++filePtr->refcnt;
+        }
+    }
+
+    if (isNew != 0) {
+        /*
+         * Compress outside the lock; waiting threads are woken up by
+         * the broadcast.
+         */
+        Ns_CacheUnlock(compressCache);
+        filePtr = CompressVariant(stPtr, encoding, level, fileName, bufs, nbufs);
+        Ns_CacheLock(compressCache);
+
+        entry = Ns_CacheCreateEntry(compressCache, key, &isNew);
+        if (filePtr != NULL) {
+            Ns_CacheSetValueSz(entry, filePtr, filePtr->size + sizeof(File));
+        } else {
+            Ns_CacheDeleteEntry(entry);
+        }
+        Ns_CacheBroadcast(compressCache);
+    }
+    Ns_CacheUnlock(compressCache);
+
+    if (filePtr != NULL) {
+        *lengthPtr = filePtr->size;
+        *handlePtr = filePtr;
+    }
+    return (filePtr != NULL) ? filePtr->bytes : NULL;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * NsCompressCacheRelease --
+ *
+ *      Release a compressed variant obtained via NsCompressCacheGet().
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Frees the variant, when it was removed from the cache meanwhile.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+NsCompressCacheRelease(void *handle)
+{
+    NS_NONNULL_ASSERT(handle != NULL);
+
+    Ns_CacheLock(compressCache);
+    DecrEntry(handle);
+    Ns_CacheUnlock(compressCache);
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * CompressVariant --
+ *
+ *      Compress the content of the file or of the provided buffers
+ *      into a new File structure.
+ *
+ * Results:
+ *      File structure with a reference count of 2 (for the cache and
+ *      the caller) or NULL on failure.
+ *
+ * Side effects:
+ *      Reads the file.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static File *
+CompressVariant(const struct stat *stPtr, Ns_CompressEncoding encoding, int level,
+                const char *fileName, const struct iovec *bufs, int nbufs)
+{
+    File             *filePtr = NULL;
+    char             *content = NULL;
+    struct iovec      iov;
+    Ns_CompressStream cStream;
+    Tcl_DString       ds;
+
+    if (fileName != NULL && stPtr != NULL) {
+        int fd = ns_open(fileName, O_RDONLY | O_BINARY | O_CLOEXEC, 0);
+
+        if (fd < 0) {
+            Ns_Log(Warning, "fastpath: ns_open(%s) failed: '%s'",
+                   fileName, strerror(errno));
+            return NULL;
+        } else {
+            ssize_t nread;
+
+            content = ns_malloc((size_t)stPtr->st_size + 1u);
+            nread = ns_read(fd, content, (size_t)stPtr->st_size);
+            (void) ns_close(fd);
+            if (nread != (ssize_t)stPtr->st_size) {
+                Ns_Log(Warning, "fastpath: failed to read '%s': '%s'",
+                       fileName, strerror(errno));
+                ns_free(content);
+                return NULL;
+            }
+            (void)Ns_SetVec(&iov, 0, content, (size_t)stPtr->st_size);
+            bufs = &iov;
+            nbufs = 1;
+        }
+    }
+
+    Tcl_DStringInit(&ds);
+    (void) Ns_CompressInit(&cStream);
+    if (Ns_CompressBufs(&cStream, encoding, (struct iovec *)bufs, nbufs, &ds, level, NS_TRUE) == NS_OK) {
+        filePtr = ns_malloc(sizeof(File) + (size_t)ds.length);
+        filePtr->refcnt  = 2;
+        filePtr->size    = (size_t)ds.length;
+        if (stPtr != NULL) {
+            filePtr->srcSize = stPtr->st_size;
+            filePtr->mtime   = stPtr->st_mtime;
+            filePtr->dev     = stPtr->st_dev;
+            filePtr->ino     = stPtr->st_ino;
+        } else {
+            filePtr->srcSize = 0;
+            filePtr->mtime   = 0;
+            filePtr->dev     = 0;
+            filePtr->ino     = 0;
+        }
+        memcpy(filePtr->bytes, ds.string, (size_t)ds.length);
+    }
+    Ns_CompressFree(&cStream);
+    Tcl_DStringFree(&ds);
+    ns_free(content);
+
+    return filePtr;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * MapCacheInit --
+ *
+ *      Initialize the file cache in "mmap" mode. The number of slots
+ *      is the configured "cachemaxfiles" rounded up to a power of two.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Allocates the slot table.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+MapCacheInit(const char *section)
+{
+    size_t nslots = MAP_CACHE_PROBES, maxFiles, i;
+
+    NS_NONNULL_ASSERT(section != NULL);
+
+    maxFiles = (size_t)Ns_ConfigIntRange(section, "cachemaxfiles", 1024, 1, INT_MAX);
+    while (nslots < maxFiles) {
+        nslots <<= 1;
+    }
+    mapCache.maxSize = (size_t)Ns_ConfigMemUnitRange(section, "cachemaxsize", "10MB",
+                                                     (Tcl_WideInt)1024*10000, 1024, INT_MAX);
+    maxentry = (int)Ns_ConfigMemUnitRange(section, "cachemaxentry", "1MB", 1024*1024, 8, INT_MAX);
+    mapCache.mask = nslots - 1u;
+    mapCache.slots = ns_calloc(nslots, sizeof(MapEntry *));
+    Ns_MutexInit(&mapCache.lock);
+    Ns_MutexSetName2(&mapCache.lock, "ns:fastpath", "mmap");
+    for (i = 0u; i < MAP_CACHE_STRIPES; i++) {
+        char name[32];
+
+        snprintf(name, sizeof(name), "mmap:%" PRIuz, i);
+        Ns_MutexInit(&mapCache.stripes[i]);
+        Ns_MutexSetName2(&mapCache.stripes[i], "ns:fastpath", name);
+    }
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * MapCacheHash --
+ *
+ *      Hash function for file names (FNV-1a).
+ *
+ * Results:
+ *      Hash value.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static size_t
+MapCacheHash(const char *path)
+{
+    uint64_t h = 14695981039346656037u;
+
+    NS_NONNULL_ASSERT(path != NULL);
+
+    while (*path != '\0') {
+        h ^= (uint64_t)(unsigned char)*path++;
+        h *= 1099511628211u;
+    }
+    return (size_t)h;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * MapCacheLock --
+ *
+ *      Return the lock of a slot group, identified by the index of
+ *      its first slot. A path is only stored in the slots of the group
+ *      of its hash value.
+ *
+ * Results:
+ *      Mutex.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Ns_Mutex *
+MapCacheLock(size_t group)
+{
+    return &mapCache.stripes[(group / MAP_CACHE_PROBES) & (MAP_CACHE_STRIPES - 1u)];
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * MapCacheGet --
+ *
+ *      Return the mapped file for the provided file name. The lookup
+ *      is not lock-free: it takes the (striped) lock of the slot group
+ *      of the file name, such that the reference is obtained before
+ *      the entry can be removed from its slot. On a miss or when the cached entry is outdated,
+ *      the file is mapped and published in the slot table.
+ *
+ * Results:
+ *      Referenced entry (to be released via MapEntryRelease()) or NULL,
+ *      when the file cannot be mapped.
+ *
+ * Side effects:
+ *      May map the file and update the slot table.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static MapEntry *
+MapCacheGet(const char *fileName, const struct stat *stPtr)
+{
+    MapEntry *entryPtr = NULL;
+    Ns_Mutex *lockPtr;
+    size_t    hash, group, i, pathLength;
+
+    NS_NONNULL_ASSERT(fileName != NULL);
+    NS_NONNULL_ASSERT(stPtr != NULL);
+
+    hash = MapCacheHash(fileName);
+    group = hash & mapCache.mask & ~(size_t)(MAP_CACHE_PROBES - 1);
+    lockPtr = MapCacheLock(group);
+
+    Ns_MutexLock(lockPtr);
+    for (i = 0u; i < MAP_CACHE_PROBES; i++) {
+        MapEntry *slotEntryPtr = mapCache.slots[group + i];
+
+        if (slotEntryPtr != NULL && STREQ(slotEntryPtr->path, fileName)) {
+            if (MapEntryValid(slotEntryPtr, stPtr)) {
+                (void) NS_ATOMIC_FETCH_ADD(&slotEntryPtr->refcnt, 1);
+                slotEntryPtr->used = NS_TRUE;
+                entryPtr = slotEntryPtr;
+            }
+            break;
+        }
+    }
+    Ns_MutexUnlock(lockPtr);
+
+    if (entryPtr != NULL) {
+        (void) NS_ATOMIC_FETCH_ADD(&mapCache.nhit, 1);
+        return entryPtr;
+    }
+    (void) NS_ATOMIC_FETCH_ADD(&mapCache.nmiss, 1);
+
+    /*
+     * Map the file and prepare the entry outside the lock.
+     */
+    pathLength = strlen(fileName);
+    entryPtr = ns_calloc(1u, sizeof(MapEntry) + pathLength);
+    if (NsMemMap(fileName, (size_t)stPtr->st_size, NS_MMAP_READ, &entryPtr->fmap) != NS_OK) {
+        ns_free(entryPtr);
+        return NULL;
+    }
+    entryPtr->refcnt = 1;
+    entryPtr->mtime  = stPtr->st_mtime;
+    entryPtr->size   = stPtr->st_size;
+    entryPtr->dev    = stPtr->st_dev;
+    entryPtr->ino    = stPtr->st_ino;
+    memcpy(entryPtr->path, fileName, pathLength + 1u);
+    snprintf(entryPtr->etag, sizeof(entryPtr->etag), "\"%" PRIx64 "-%" PRIx64 "\"",
+             (uint64_t)entryPtr->mtime, (uint64_t)entryPtr->size);
+
+    return MapCacheInsert(entryPtr, group);
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * MapCacheInsert --
+ *
+ *      Publish a new entry in the slot group. When a concurrent request
+ *      has published a valid entry for the same file meanwhile, this
+ *      entry is used instead. The entry replaces the entry of the same
+ *      file, takes a free slot, or replaces an entry of the group not
+ *      used since the last eviction sweep (or the first one). Other
+ *      entries are evicted until the new entry fits into the maximum
+ *      size. Entries larger than the maximum size are used only for
+ *      the current request.
+ *
+ * Results:
+ *      Referenced entry.
+ *
+ * Side effects:
+ *      Replaced and evicted entries lose their slot reference.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static MapEntry *
+MapCacheInsert(MapEntry *newPtr, size_t group)
+{
+    MapEntry *resultPtr = newPtr, *oldPtr = NULL;
+    Ns_Mutex *lockPtr;
+    size_t    i, slot = group, victim = group;
+    bool      sameFile = NS_FALSE, freeSlot = NS_FALSE, unusedVictim = NS_FALSE;
+
+    NS_NONNULL_ASSERT(newPtr != NULL);
+
+    lockPtr = MapCacheLock(group);
+
+    /*
+     * All updates of the slots are performed with the global lock
+     * held, so the slots cannot change while the group lock is
+     * released below.
+     */
+    Ns_MutexLock(&mapCache.lock);
+    Ns_MutexLock(lockPtr);
+
+    for (i = 0u; i < MAP_CACHE_PROBES; i++) {
+        MapEntry *entryPtr = mapCache.slots[group + i];
+
+        if (entryPtr == NULL) {
+            if (!freeSlot) {
+                slot = group + i;
+                freeSlot = NS_TRUE;
+            }
+        } else if (STREQ(entryPtr->path, newPtr->path)) {
+            slot = group + i;
+            sameFile = NS_TRUE;
+            break;
+        } else if (!unusedVictim && !entryPtr->used) {
+            victim = group + i;
+            unusedVictim = NS_TRUE;
+        }
+    }
+    if (!sameFile && !freeSlot) {
+        slot = victim;
+    }
+    oldPtr = mapCache.slots[slot];
+
+    if (sameFile
+        && oldPtr->mtime == newPtr->mtime
+        && oldPtr->size  == newPtr->size
+        && oldPtr->dev   == newPtr->dev
+        && oldPtr->ino   == newPtr->ino) {
+        /*
+         * Another thread was faster.
+         */
+        (void) NS_ATOMIC_FETCH_ADD(&oldPtr->refcnt, 1);
+        oldPtr->used = NS_TRUE;
+        resultPtr = oldPtr;
+        oldPtr = NULL;
+        Ns_MutexUnlock(lockPtr);
+
+    } else if ((size_t)newPtr->size <= mapCache.maxSize) {
+        if (oldPtr != NULL) {
+            mapCache.slots[slot] = NULL;
+            mapCache.size -= (size_t)oldPtr->size;
+            (void) NS_ATOMIC_FETCH_ADD(sameFile ? &mapCache.nflushed : &mapCache.npruned, 1);
+        }
+        Ns_MutexUnlock(lockPtr);
+
+        if (mapCache.size + (size_t)newPtr->size > mapCache.maxSize) {
+            MapCacheEvict((size_t)newPtr->size);
+        }
+
+        Ns_MutexLock(lockPtr);
+        (void) NS_ATOMIC_FETCH_ADD(&newPtr->refcnt, 1);
+        newPtr->used = NS_TRUE;
+        mapCache.slots[slot] = newPtr;
+        mapCache.size += (size_t)newPtr->size;
+        Ns_MutexUnlock(lockPtr);
+
+    } else {
+        oldPtr = NULL;
+        Ns_MutexUnlock(lockPtr);
+    }
+    Ns_MutexUnlock(&mapCache.lock);
+
+    if (oldPtr != NULL) {
+        MapEntryRelease(oldPtr);
+    }
+    if (resultPtr != newPtr) {
+        MapEntryRelease(newPtr);
+    }
+    return resultPtr;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * MapCacheEvict --
+ *
+ *      Evict entries until the provided number of bytes fits into the
+ *      maximum size of the cache. The slot groups are swept in a
+ *      round robin fashion (CLOCK): entries used since the last sweep
+ *      get a second chance, other entries are removed. Must be called
+ *      with the global lock held.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Evicted entries lose their slot reference and are unmapped when
+ *      no reader holds a reference anymore.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+MapCacheEvict(size_t needed)
+{
+    size_t ngroups = (mapCache.mask + 1u) / MAP_CACHE_PROBES, n;
+
+    /*
+     * Two rounds suffice: the first one clears all "used" flags.
+     */
+    for (n = 0u; n < 2u * ngroups && mapCache.size + needed > mapCache.maxSize; n++) {
+        MapEntry *evicted[MAP_CACHE_PROBES];
+        size_t    group = mapCache.hand * MAP_CACHE_PROBES, i, nevicted = 0u;
+        Ns_Mutex *lockPtr = MapCacheLock(group);
+
+        mapCache.hand = (mapCache.hand + 1u) % ngroups;
+
+        Ns_MutexLock(lockPtr);
+        for (i = 0u; i < MAP_CACHE_PROBES && mapCache.size + needed > mapCache.maxSize; i++) {
+            MapEntry *entryPtr = mapCache.slots[group + i];
+
+            if (entryPtr == NULL) {
+                continue;
+            }
+            if (entryPtr->used) {
+                entryPtr->used = NS_FALSE;
+            } else {
+                mapCache.slots[group + i] = NULL;
+                mapCache.size -= (size_t)entryPtr->size;
+                evicted[nevicted++] = entryPtr;
+            }
+        }
+        Ns_MutexUnlock(lockPtr);
+
+        for (i = 0u; i < nevicted; i++) {
+            (void) NS_ATOMIC_FETCH_ADD(&mapCache.npruned, 1);
+            MapEntryRelease(evicted[i]);
+        }
+    }
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * MapEntryRelease --
+ *
+ *      Release a reference to an entry. The entry is unmapped and
+ *      freed, when the last reference is gone.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      May unmap and free the entry.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+MapEntryRelease(MapEntry *entryPtr)
+{
+    NS_NONNULL_ASSERT(entryPtr != NULL);
+
+    if (NS_ATOMIC_FETCH_ADD(&entryPtr->refcnt, -1) == 1) {
+        NsMemUmap(&entryPtr->fmap);
+        ns_free(entryPtr);
+    }
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * MapEntryValid --
+ *
+ *      Check, whether the mapped entry corresponds to the current
+ *      file information.
+ *
+ * Results:
+ *      Boolean value.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static bool
+MapEntryValid(const MapEntry *entryPtr, const struct stat *stPtr)
+{
+    NS_NONNULL_ASSERT(entryPtr != NULL);
+    NS_NONNULL_ASSERT(stPtr != NULL);
+
+    return (entryPtr->mtime == stPtr->st_mtime
+            && entryPtr->size == stPtr->st_size
+            && entryPtr->dev  == (dev_t)stPtr->st_dev
+            && entryPtr->ino  == stPtr->st_ino);
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * MapEntryReturn --
+ *
+ *      Return the content of a mapped file. The precomputed ETag is
+ *      added to the response and a matching If-None-Match request
+ *      header results in a "304 Not Modified" reply. The content is
+ *      sent from the mapping by the connection thread; when the
+ *      response is handed to a writer thread, the content is copied
+ *      into the writer buffer, since the caller releases the mapping
+ *      after the return.
+ *
+ * Results:
+ *      NaviServer return code.
+ *
+ * Side effects:
+ *      Sends the response.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Ns_ReturnCode
+MapEntryReturn(Ns_Conn *conn, int statusCode, const char *mimeType, const MapEntry *entryPtr)
+{
+    Ns_ReturnCode status;
+    const char   *ifNoneMatch, *data;
+
+    NS_NONNULL_ASSERT(conn != NULL);
+    NS_NONNULL_ASSERT(mimeType != NULL);
+    NS_NONNULL_ASSERT(entryPtr != NULL);
+
+    Ns_ConnCondSetHeadersSz(conn, "etag", 4, entryPtr->etag, TCL_INDEX_NONE);
+
+    ifNoneMatch = Ns_SetIGet(conn->headers, "if-none-match");
+    if (ifNoneMatch != NULL && statusCode == 200 && ETagMatch(ifNoneMatch, entryPtr->etag)) {
+        status = Ns_ConnReturnNotModified(conn);
+
+    } else {
+        data = ((conn->flags & NS_CONN_SKIPBODY) != 0u) ? NS_EMPTY_STRING : entryPtr->fmap.addr;
+        status = Ns_ConnReturnData(conn, statusCode, data, (ssize_t)entryPtr->size, mimeType);
+    }
+    return status;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ETagMatch --
+ *
+ *      Check, whether the value of an If-None-Match header matches the
+ *      provided entity tag, using the weak comparison (RFC 9110,
+ *      section 13.1.2).
+ *
+ * Results:
+ *      Boolean value.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static bool
+ETagMatch(const char *header, const char *etag)
+{
+    size_t      etagLength;
+    const char *p = header;
+
+    NS_NONNULL_ASSERT(header != NULL);
+    NS_NONNULL_ASSERT(etag != NULL);
+
+    etagLength = strlen(etag);
+
+    while (*p != '\0') {
+        const char *end;
+
+        while (*p == ' ' || *p == '\t' || *p == ',') {
+            p++;
+        }
+        if (*p == '*') {
+            return NS_TRUE;
+        }
+        if (p[0] == 'W' && p[1] == '/') {
+            p += 2;
+        }
+        end = strchr(p, ',');
+        if (end == NULL) {
+            end = p + strlen(p);
+        }
+        while (end > p && (end[-1] == ' ' || end[-1] == '\t')) {
+            end--;
+        }
+        if ((size_t)(end - p) == etagLength && strncmp(p, etag, etagLength) == 0) {
+            return NS_TRUE;
+        }
+        p = end;
+        while (*p != '\0' && *p != ',') {
+            p++;
+        }
+    }
+    return NS_FALSE;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * MapCacheStats --
+ *
+ *      Append the statistics of the file cache in "mmap" mode to the
+ *      dstring in the format of Ns_CacheStats(), or with "contents"
+ *      the sizes of the cached entries.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Resets the counters, when requested.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+MapCacheStats(Tcl_DString *dsPtr, bool contents, bool reset)
+{
+    size_t i, nentries = 0u;
+
+    NS_NONNULL_ASSERT(dsPtr != NULL);
+
+    Ns_MutexLock(&mapCache.lock);
+    if (contents) {
+        Tcl_DStringStartSublist(dsPtr);
+    }
+    for (i = 0u; i <= mapCache.mask; i++) {
+        const MapEntry *entryPtr = mapCache.slots[i];
+
+        if (entryPtr != NULL) {
+            nentries++;
+            if (contents) {
+                Ns_DStringPrintf(dsPtr, "%" PRIdz " 0 ", (size_t)entryPtr->size);
+            }
+        }
+    }
+    if (contents) {
+        Tcl_DStringEndSublist(dsPtr);
+    } else {
+        int64_t nhit = NS_ATOMIC_LOAD(&mapCache.nhit), nmiss = NS_ATOMIC_LOAD(&mapCache.nmiss);
+
+        Ns_DStringPrintf(dsPtr, "maxsize %lu size %lu entries %lu maxentries %lu"
+                         " flushed %" PRId64 " hits %" PRId64 " missed %" PRId64 " hitrate %.2f"
+                         " pruned %" PRId64 " mode mmap",
+                         (unsigned long)mapCache.maxSize, (unsigned long)mapCache.size,
+                         (unsigned long)nentries, (unsigned long)(mapCache.mask + 1u),
+                         NS_ATOMIC_LOAD(&mapCache.nflushed), nhit, nmiss,
+                         (nhit + nmiss) > 0 ? ((double)nhit * 100.0) / (double)(nhit + nmiss) : 0.0,
+                         NS_ATOMIC_LOAD(&mapCache.npruned));
+    }
+    if (reset) {
+        NS_ATOMIC_STORE(&mapCache.nhit, 0);
+        NS_ATOMIC_STORE(&mapCache.nmiss, 0);
+        NS_ATOMIC_STORE(&mapCache.nflushed, 0);
+        NS_ATOMIC_STORE(&mapCache.npruned, 0);
+    }
+    Ns_MutexUnlock(&mapCache.lock);
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Ns_Stat --
+ *
+ *      Stat a file, logging an error on unexpected results.
+ *
+ * Results:
+ *      NS_TRUE if stat() was successful, NS_FALSE otherwise.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+bool
+Ns_Stat(const char *path, struct stat *stPtr)
+{
+    bool success = NS_TRUE;
+
+    NS_NONNULL_ASSERT(path != NULL);
+    NS_NONNULL_ASSERT(stPtr != NULL);
+
+    if (stat(path, stPtr) != 0) {
+        if (errno != ENOENT && errno != EACCES && errno != ENOTDIR) {
+            Ns_Log(Error, "fastpath: stat(%s) failed: %s",
+                   path, strerror(errno));
+        }
+        success = NS_FALSE;
+    }
+    return success;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * FastGetRestart --
+ *
+ *      Construct the full URL and redirect internally.
+ *
+ * Results:
+ *      See Ns_ConnRedirect().
+ *
+ * Side effects:
+ *      See Ns_ConnRedirect().
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Ns_ReturnCode
+FastGetRestart(Ns_Conn *conn, const char *page)
+{
+    Ns_ReturnCode status;
+    Tcl_DString   ds;
+
+    NS_NONNULL_ASSERT(conn != NULL);
+    NS_NONNULL_ASSERT(page != NULL);
+
+    Tcl_DStringInit(&ds);
+    status = Ns_ConnRedirect(conn, Ns_MakePath(&ds, conn->request.url, page, NS_SENTINEL));
+    Tcl_DStringFree(&ds);
+
+    return status;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * DecrEntry --
+ *
+ *      Decrement reference count of cached file.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+DecrEntry(File *filePtr)
+{
+    NS_NONNULL_ASSERT(filePtr != NULL);
 
     if (--filePtr->refcnt == 0) {
         ns_free(filePtr);
@@ -966,6 +2436,8 @@ FreeEntry(void *arg)
  *      Implements "ns_fastpath_cache_stats".  The command returns
  *      stats on a cache. The size and expiry time of each entry in
  *      the cache is also appended if the -contents switch is given.
+ *      With -compressed, the command reports on the compress cache
+ *      instead of the file cache.
  *
  * Results:
  *      Tcl result.
@@ -978,51 +2450,63 @@ FreeEntry(void *arg)
 int
 NsTclFastPathCacheStatsObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp, TCL_SIZE_T objc, Tcl_Obj *const* objv)
 {
-    int         contents = (int)NS_FALSE, reset = (int)NS_FALSE, result = TCL_OK;
+    int         contents = (int)NS_FALSE, reset = (int)NS_FALSE, compressed = (int)NS_FALSE, result = TCL_OK;
     Ns_ObjvSpec opts[] = {
-        {"-contents", Ns_ObjvBool,  &contents, INT2PTR(NS_TRUE)},
-        {"-reset",    Ns_ObjvBool,  &reset,    INT2PTR(NS_TRUE)},
+        {"-compressed", Ns_ObjvBool,  &compressed, INT2PTR(NS_TRUE)},
+        {"-contents",   Ns_ObjvBool,  &contents,   INT2PTR(NS_TRUE)},
+        {"-reset",      Ns_ObjvBool,  &reset,      INT2PTR(NS_TRUE)},
         {NULL, NULL, NULL, NULL}
     };
 
     if (Ns_ParseObjv(opts, NULL, interp, 1, objc, objv) != NS_OK) {
         result = TCL_ERROR;
 
-    } else if (cache != NULL) {
-        Tcl_DString     ds;
-        Ns_CacheSearch  search;
+    } else if (compressed == 0 && mapCache.slots != NULL) {
+        Tcl_DString ds;
 
         Tcl_DStringInit(&ds);
-        Ns_CacheLock(cache);
-
-        if (contents != 0) {
-            const Ns_Entry *entry;
-
-            Tcl_DStringStartSublist(&ds);
-            entry = Ns_CacheFirstEntry(cache, &search);
-            while (entry != NULL) {
-                size_t         size    = Ns_CacheGetSize(entry);
-                const Ns_Time *timePtr = Ns_CacheGetExpirey(entry);
+        MapCacheStats(&ds, (contents != 0), (reset != 0));
+        Tcl_DStringResult(interp, &ds);
 
-                if (timePtr->usec == 0) {
-                    Ns_DStringPrintf(&ds, "%" PRIdz " %" PRId64 " ",
-                                     size, (int64_t)timePtr->sec);
-                } else {
-                    Ns_DStringPrintf(&ds, "%" PRIdz " " NS_TIME_FMT " ",
-                                     size, (int64_t)timePtr->sec, timePtr->usec);
+    } else {
+        Ns_Cache *cachePtr = (compressed != 0) ? compressCache : cache;
+
+        if (cachePtr != NULL) {
+            Tcl_DString     ds;
+            Ns_CacheSearch  search;
+
+            Tcl_DStringInit(&ds);
+            Ns_CacheLock(cachePtr);
+
+            if (contents != 0) {
+                const Ns_Entry *entry;
+
+                Tcl_DStringStartSublist(&ds);
+                entry = Ns_CacheFirstEntry(cachePtr, &search);
+                while (entry != NULL) {
+                    size_t         size    = Ns_CacheGetSize(entry);
+                    const Ns_Time *timePtr = Ns_CacheGetExpirey(entry);
+
+                    if (timePtr->usec == 0) {
+                        Ns_DStringPrintf(&ds, "%" PRIdz " %" PRId64 " ",
+                                         size, (int64_t)timePtr->sec);
+                    } else {
+                        Ns_DStringPrintf(&ds, "%" PRIdz " " NS_TIME_FMT " ",
+                                         size, (int64_t)timePtr->sec, timePtr->usec);
+                    }
+                    entry = Ns_CacheNextEntry(&search);
                 }
-                entry = Ns_CacheNextEntry(&search);
+                Tcl_DStringEndSublist(&ds);
+            } else {
+                (void)Ns_CacheStats(cachePtr, &ds);
             }
-            Tcl_DStringEndSublist(&ds);
-        } else {
-            (void)Ns_CacheStats(cache, &ds);
-        }
-        if (reset != 0) {
-            Ns_CacheResetStats(cache);
-        }
-        Ns_CacheUnlock(cache);
+            if (reset != 0) {
+                Ns_CacheResetStats(cachePtr);
+            }
+            Ns_CacheUnlock(cachePtr);
 
-        Tcl_DStringResult(interp, &ds);
+            Tcl_DStringResult(interp, &ds);
+        }
     }
     return result;
 }
@@ -22,6 +22,12 @@
  * and traces.
  */
 
+typedef enum {
+    FILTER_URL_EXACT,      /* URL pattern without glob characters */
+    FILTER_URL_PREFIX,     /* literal prefix followed by a single trailing "*" */
+    FILTER_URL_GLOB        /* general pattern, prefix is checked first */
+} FilterUrlKind;
+
 typedef struct Filter {
     struct Filter *nextPtr;
     Ns_FilterProc *proc;
@@ -30,8 +36,34 @@ typedef struct Filter {
     NsUrlSpaceContextSpec *ctxFilterSpec;
     Ns_FilterType  when;
     void          *arg;
+    long           seq;           /* Position in the filter list, used for ordering candidates */
+    size_t         prefixLength;  /* Length of the literal prefix of the URL pattern */
+    FilterUrlKind  urlKind;
+    bool           anyMethod;     /* Method pattern is "*" */
+    bool           literalMethod; /* Method pattern has no glob characters */
 } Filter;
 
+/*
+ * Filters are indexed per filter type by the first segment of the literal
+ * prefix of their URL patterns. Filters with URL patterns without a complete
+ * literal first segment (e.g. "*", "/foo*" or "/[a-z]") are kept in the
+ * "wildcard" list. All lists are ordered by the sequence numbers of the
+ * filters, which reflect the order of the filter list.
+ */
+
+typedef struct FilterList {
+    Filter  **filters;
+    size_t    size;
+    size_t    capacity;
+} FilterList;
+
+typedef struct FilterIndex {
+    FilterList     wildcard;
+    Tcl_HashTable  segments;     /* first URL segment -> FilterList* */
+} FilterIndex;
+
+#define FILTER_INDEX_TYPES 4
+
 typedef struct Trace {
     struct Trace    *nextPtr;
     Ns_TraceProc    *proc;
@@ -59,6 +91,24 @@ static void FilterUnlock(NsServer *servPtr)
 static void FilterContextInit(NsUrlSpaceContext *ctxPtr, const Conn *connPtr, struct sockaddr *ipPtr)
     NS_GNUC_NONNULL(1,2,3);
 
+static void FilterCompile(Filter *fPtr)
+    NS_GNUC_NONNULL(1);
+
+static bool FilterMatch(const Filter *fPtr, const char *method, const char *url)
+    NS_GNUC_NONNULL(1,2,3) NS_GNUC_PURE;
+
+static void FilterIndexAdd(NsServer *servPtr, Filter *fPtr, bool first)
+    NS_GNUC_NONNULL(1,2);
+
+static void FilterListInsert(FilterList *listPtr, Filter *fPtr, bool first)
+    NS_GNUC_NONNULL(1,2);
+
+static int FilterTypeIndex(Ns_FilterType when)
+    NS_GNUC_CONST;
+
+static const char *UrlSegment(const char *url, size_t *lengthPtr)
+    NS_GNUC_NONNULL(1,2);
+
 /*
  *----------------------------------------------------------------------
  * FilterLock --
@@ -153,8 +203,10 @@ Ns_RegisterFilter2(const char *server, const char *method, const char *url,
     fPtr->url = ns_strdup(url);
     fPtr->when = when;
     fPtr->arg = arg;
+    FilterCompile(fPtr);
 
     FilterLock(servPtr, NS_WRITE);
+    FilterIndexAdd(servPtr, fPtr, first);
     if (first) {
         /*
          * Prepend element at the start of the list.
@@ -232,11 +284,273 @@ FilterContextInit(NsUrlSpaceContext *ctxPtr, const Conn *connPtr, struct sockadd
 }
 
 
+/*
+ *----------------------------------------------------------------------
+ * FilterCompile --
+ *
+ *      Precompute the matching information of a filter: whether the
+ *      method pattern is a literal, and the literal prefix of the URL
+ *      pattern up to the first glob character.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Updates the filter structure.
+ *
+ *----------------------------------------------------------------------
+ */
+static void
+FilterCompile(Filter *fPtr)
+{
+    const char *url;
+    size_t      prefixLength;
+
+    NS_NONNULL_ASSERT(fPtr != NULL);
+
+    fPtr->anyMethod = (fPtr->method[0] == '*' && fPtr->method[1] == '\0');
+    fPtr->literalMethod = (strpbrk(fPtr->method, "*?[]\\") == NULL);
+
+    url = fPtr->url;
+    prefixLength = strcspn(url, "*?[]\\");
+    fPtr->prefixLength = prefixLength;
+    if (url[prefixLength] == '\0') {
+        fPtr->urlKind = FILTER_URL_EXACT;
+    } else if (url[prefixLength] == '*' && url[prefixLength + 1u] == '\0') {
+        fPtr->urlKind = FILTER_URL_PREFIX;
+    } else {
+        fPtr->urlKind = FILTER_URL_GLOB;
+    }
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ * FilterMatch --
+ *
+ *      Check, whether the method and URL patterns of the filter match
+ *      the provided method and URL. The result is the same as calling
+ *      Tcl_StringMatch() on both patterns, but literal patterns and
+ *      literal prefixes are compared directly.
+ *
+ * Results:
+ *      Boolean value.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+static bool
+FilterMatch(const Filter *fPtr, const char *method, const char *url)
+{
+    bool success;
+
+    NS_NONNULL_ASSERT(fPtr != NULL);
+    NS_NONNULL_ASSERT(method != NULL);
+    NS_NONNULL_ASSERT(url != NULL);
+
+    if (fPtr->anyMethod) {
+        success = NS_TRUE;
+    } else if (fPtr->literalMethod) {
+        success = (strcmp(method, fPtr->method) == 0);
+    } else {
+        success = (Tcl_StringMatch(method, fPtr->method) != 0);
+    }
+
+    if (success) {
+        switch (fPtr->urlKind) {
+        case FILTER_URL_EXACT:
+            success = (strcmp(url, fPtr->url) == 0);
+            break;
+        case FILTER_URL_PREFIX:
+            success = (strncmp(url, fPtr->url, fPtr->prefixLength) == 0);
+            break;
+        case FILTER_URL_GLOB:
+            success = (strncmp(url, fPtr->url, fPtr->prefixLength) == 0
+                       && Tcl_StringMatch(url + fPtr->prefixLength,
+                                          fPtr->url + fPtr->prefixLength) != 0);
+            break;
+        }
+    }
+    return success;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ * FilterTypeIndex --
+ *
+ *      Map the filter type to the index of the filter index array.
+ *
+ * Results:
+ *      Integer between 0 and FILTER_INDEX_TYPES-1.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+static int
+FilterTypeIndex(Ns_FilterType when)
+{
+    int result;
+
+    switch (when) {
+    case NS_FILTER_PRE_AUTH:   result = 0; break;
+    case NS_FILTER_POST_AUTH:  result = 1; break;
+    case NS_FILTER_TRACE:      result = 2; break;
+    case NS_FILTER_VOID_TRACE: result = 3; break;
+    default:                   result = 0; break;
+    }
+    return result;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ * UrlSegment --
+ *
+ *      Return the first segment of an absolute URL path (the characters
+ *      between the leading slash and the next slash or the end of the
+ *      string).
+ *
+ * Results:
+ *      Pointer to the start of the segment and its length in
+ *      "lengthPtr", or NULL, when the URL does not start with a slash.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+static const char *
+UrlSegment(const char *url, size_t *lengthPtr)
+{
+    const char *result = NULL;
+
+    NS_NONNULL_ASSERT(url != NULL);
+    NS_NONNULL_ASSERT(lengthPtr != NULL);
+
+    if (*url == '/') {
+        result = url + 1;
+        *lengthPtr = strcspn(result, "/");
+    }
+    return result;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ * FilterListInsert --
+ *
+ *      Insert a filter at the beginning or at the end of a filter list.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Might grow the list.
+ *
+ *----------------------------------------------------------------------
+ */
+static void
+FilterListInsert(FilterList *listPtr, Filter *fPtr, bool first)
+{
+    NS_NONNULL_ASSERT(listPtr != NULL);
+    NS_NONNULL_ASSERT(fPtr != NULL);
+
+    if (listPtr->size == listPtr->capacity) {
+        listPtr->capacity = (listPtr->capacity == 0u) ? 8u : listPtr->capacity * 2u;
+        listPtr->filters = ns_realloc(listPtr->filters, listPtr->capacity * sizeof(Filter *));
+    }
+    if (first) {
+        memmove(listPtr->filters + 1, listPtr->filters, listPtr->size * sizeof(Filter *));
+        listPtr->filters[0] = fPtr;
+    } else {
+        listPtr->filters[listPtr->size] = fPtr;
+    }
+    listPtr->size++;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ * FilterIndexAdd --
+ *
+ *      Add a filter to the filter index of the server. Must be called
+ *      with the filter write lock held.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Assigns the sequence number of the filter, might create the index.
+ *
+ *----------------------------------------------------------------------
+ */
+static void
+FilterIndexAdd(NsServer *servPtr, Filter *fPtr, bool first)
+{
+    FilterIndex *indexPtr;
+    const char  *segment;
+    size_t       segmentLength = 0u;
+
+    NS_NONNULL_ASSERT(servPtr != NULL);
+    NS_NONNULL_ASSERT(fPtr != NULL);
+
+    if (servPtr->filter.indexPtr == NULL) {
+        int i;
+
+        servPtr->filter.indexPtr = ns_calloc(FILTER_INDEX_TYPES, sizeof(FilterIndex));
+        for (i = 0; i < FILTER_INDEX_TYPES; i++) {
+            Tcl_InitHashTable(&servPtr->filter.indexPtr[i].segments, TCL_STRING_KEYS);
+        }
+    }
+    indexPtr = &servPtr->filter.indexPtr[FilterTypeIndex(fPtr->when)];
+
+    fPtr->seq = first ? --servPtr->filter.minSeq : ++servPtr->filter.maxSeq;
+
+    /*
+     * A filter can be indexed by the first URL segment, when this segment
+     * is completely literal, i.e., it is followed in the literal prefix by
+     * a slash or the URL pattern is a literal.
+     */
+    segment = UrlSegment(fPtr->url, &segmentLength);
+    if (segment != NULL
+        && fPtr->urlKind != FILTER_URL_EXACT
+        && (size_t)(segment - fPtr->url) + segmentLength >= fPtr->prefixLength
+        ) {
+        segment = NULL;
+    }
+
+    if (segment == NULL) {
+        FilterListInsert(&indexPtr->wildcard, fPtr, first);
+    } else {
+        Tcl_DString    ds;
+        Tcl_HashEntry *hPtr;
+        int            isNew;
+
+        Tcl_DStringInit(&ds);
+        Tcl_DStringAppend(&ds, segment, (TCL_SIZE_T)segmentLength);
+        hPtr = Tcl_CreateHashEntry(&indexPtr->segments, ds.string, &isNew);
+        if (isNew != 0) {
+            Tcl_SetHashValue(hPtr, ns_calloc(1u, sizeof(FilterList)));
+        }
+        FilterListInsert(Tcl_GetHashValue(hPtr), fPtr, first);
+        Tcl_DStringFree(&ds);
+    }
+}
+
+
 /*
  *----------------------------------------------------------------------
  * NsRunFilters --
  *
- *      Execute each registered filter function in the Filter list.
+ *      Execute the registered filter functions matching the request in
+ *      the order of the filter list. The candidate filters are obtained
+ *      from the filter index via the first segment of the request URL
+ *      and merged with the filters with wildcard URL patterns.
  *
  * Results:
  *      Returns the status returned from the registered filter function.
@@ -268,18 +582,49 @@ NsRunFilters(Ns_Conn *conn, Ns_FilterType why)
         Ns_ReturnCode filter_status = NS_OK;
 
         FilterLock(servPtr, NS_READ);
-        fPtr = servPtr->filter.firstFilterPtr;
-        while (fPtr != NULL && filter_status == NS_OK) {
-            if (unlikely(fPtr->when == why)
-                && (Tcl_StringMatch(conn->request.method, fPtr->method) != 0)
-                && (Tcl_StringMatch(conn->request.url, fPtr->url) != 0)
-                && (fPtr->ctxFilterSpec == NULL
-                    || NsUrlSpaceContextFilterEval(fPtr->ctxFilterSpec, &ctx)
-                    )
-                ) {
-                filter_status = (*fPtr->proc)(fPtr->arg, conn, why);
+        if (servPtr->filter.indexPtr != NULL) {
+            FilterIndex       *indexPtr = &servPtr->filter.indexPtr[FilterTypeIndex(why)];
+            const FilterList  *wildPtr = &indexPtr->wildcard, *segPtr = NULL;
+            const char        *method = conn->request.method, *url = conn->request.url;
+            const char        *segment;
+            size_t             segmentLength, i = 0u, j = 0u;
+
+            segment = UrlSegment(url, &segmentLength);
+            if (segment != NULL && indexPtr->segments.numEntries > 0) {
+                const Tcl_HashEntry *hPtr;
+                Tcl_DString          ds;
+
+                Tcl_DStringInit(&ds);
+                Tcl_DStringAppend(&ds, segment, (TCL_SIZE_T)segmentLength);
+                hPtr = Tcl_FindHashEntry(&indexPtr->segments, ds.string);
+                if (hPtr != NULL) {
+                    segPtr = Tcl_GetHashValue(hPtr);
+                }
+                Tcl_DStringFree(&ds);
+            }
+
+            /*
+             * Merge the candidates from the wildcard list and the segment
+             * list according to their sequence numbers.
+             */
+            while (filter_status == NS_OK) {
+                if (i < wildPtr->size
+                    && (segPtr == NULL || j >= segPtr->size
+                        || wildPtr->filters[i]->seq < segPtr->filters[j]->seq)) {
+                    fPtr = wildPtr->filters[i++];
+                } else if (segPtr != NULL && j < segPtr->size) {
+                    fPtr = segPtr->filters[j++];
+                } else {
+                    break;
+                }
+                if (FilterMatch(fPtr, method, url)
+                    && (fPtr->ctxFilterSpec == NULL
+                        || NsUrlSpaceContextFilterEval(fPtr->ctxFilterSpec, &ctx)
+                        )
+                    ) {
+                    filter_status = (*fPtr->proc)(fPtr->arg, conn, why);
+                }
             }
-            fPtr = fPtr->nextPtr;
         }
         FilterUnlock(servPtr);
         if (filter_status == NS_FILTER_BREAK ||
@@ -304,6 +649,70 @@ NsRunFilters(Ns_Conn *conn, Ns_FilterType why)
     return status;
 }
 
+
+/*
+ *----------------------------------------------------------------------
+ * NsFiltersRegistered --
+ *
+ *      Check, whether a filter or trace filter of any type might run for
+ *      the provided method and URL. Context constraints of the filters are
+ *      not evaluated, so the check is conservative.
+ *
+ * Results:
+ *      NS_TRUE if some filter matches the method and URL.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+bool
+NsFiltersRegistered(NsServer *servPtr, const char *method, const char *url)
+{
+    bool found = NS_FALSE;
+
+    NS_NONNULL_ASSERT(servPtr != NULL);
+    NS_NONNULL_ASSERT(method != NULL);
+    NS_NONNULL_ASSERT(url != NULL);
+
+    FilterLock(servPtr, NS_READ);
+    if (servPtr->filter.indexPtr != NULL) {
+        const char *segment;
+        size_t      segmentLength, i;
+        int         type;
+        Tcl_DString ds;
+
+        Tcl_DStringInit(&ds);
+        segment = UrlSegment(url, &segmentLength);
+        if (segment != NULL) {
+            Tcl_DStringAppend(&ds, segment, (TCL_SIZE_T)segmentLength);
+        }
+
+        for (type = 0; type < FILTER_INDEX_TYPES && !found; type++) {
+            FilterIndex       *indexPtr = &servPtr->filter.indexPtr[type];
+            const FilterList  *segPtr = NULL;
+
+            for (i = 0u; i < indexPtr->wildcard.size && !found; i++) {
+                found = FilterMatch(indexPtr->wildcard.filters[i], method, url);
+            }
+            if (segment != NULL && indexPtr->segments.numEntries > 0) {
+                const Tcl_HashEntry *hPtr = Tcl_FindHashEntry(&indexPtr->segments, ds.string);
+
+                if (hPtr != NULL) {
+                    segPtr = Tcl_GetHashValue(hPtr);
+                }
+            }
+            for (i = 0u; segPtr != NULL && i < segPtr->size && !found; i++) {
+                found = FilterMatch(segPtr->filters[i], method, url);
+            }
+        }
+        Tcl_DStringFree(&ds);
+    }
+    FilterUnlock(servPtr);
+
+    return found;
+}
+
 
 /*
  *----------------------------------------------------------------------
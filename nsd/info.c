@@ -1229,6 +1229,23 @@ NsTclInfoObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_SIZE_T objc, Tcl_
                            NsAtomObj(NS_ATOM_with_deprecated),
                            Tcl_NewIntObj(defined_NS_WITH_DEPRECATED));
 
+            /*
+             * Content-encodings supported for dynamic response compression.
+             */
+            {
+                Tcl_Obj *listObj = Tcl_NewListObj(0, NULL);
+#ifdef HAVE_ZLIB_H
+                Tcl_ListObjAppendElement(NULL, listObj, NsAtomObj(NS_ATOM_gzip));
+#endif
+#ifdef HAVE_BROTLI
+                Tcl_ListObjAppendElement(NULL, listObj, Tcl_NewStringObj("br", 2));
+#endif
+#ifdef HAVE_ZSTD
+                Tcl_ListObjAppendElement(NULL, listObj, NsAtomObj(NS_ATOM_zstd));
+#endif
+                Tcl_DictObjPut(NULL, dictObj, NsAtomObj(NS_ATOM_compression), listObj);
+            }
+
             /*
              * The nsd binary was built against this version of Tcl
              */
@@ -327,7 +327,9 @@ InitCoreAtomSpecs(void)
     atoms[NS_ATOM_boundary].name         = "boundary";       atoms[NS_ATOM_boundary].len = 8;
     atoms[NS_ATOM_brotli].name           = "brotli";         atoms[NS_ATOM_brotli].len = 6;
     atoms[NS_ATOM_bytes].name            = "bytes";          atoms[NS_ATOM_bytes].len = 5;
+    atoms[NS_ATOM_bytespercall].name     = "bytespercall";   atoms[NS_ATOM_bytespercall].len = 12;
     atoms[NS_ATOM_callback].name         = "callback";       atoms[NS_ATOM_callback].len = 8;
+    atoms[NS_ATOM_callspersec].name      = "callspersec";    atoms[NS_ATOM_callspersec].len = 11;
     atoms[NS_ATOM_capabilities].name     = "capabilities";   atoms[NS_ATOM_capabilities].len = 12;
     atoms[NS_ATOM_channel].name          = "channel";        atoms[NS_ATOM_channel].len = 7;
     atoms[NS_ATOM_charset].name          = "charset";        atoms[NS_ATOM_charset].len = 7;
@@ -338,7 +340,9 @@ InitCoreAtomSpecs(void)
     atoms[NS_ATOM_code].name             = "code";           atoms[NS_ATOM_code].len = 4;
     atoms[NS_ATOM_compiler].name         = "compiler";       atoms[NS_ATOM_compiler].len = 8;
     atoms[NS_ATOM_complete].name         = "complete";       atoms[NS_ATOM_complete].len = 8;
+    atoms[NS_ATOM_compression].name      = "compression";    atoms[NS_ATOM_compression].len = 11;
     atoms[NS_ATOM_condition].name        = "condition";      atoms[NS_ATOM_condition].len = 9;
+    atoms[NS_ATOM_cpuaffinity].name      = "cpuaffinity";    atoms[NS_ATOM_cpuaffinity].len = 11;
     atoms[NS_ATOM_crv].name              = "crv";            atoms[NS_ATOM_crv].len = 3;
     atoms[NS_ATOM_currentaddr].name      = "currentaddr";    atoms[NS_ATOM_currentaddr].len = 11;
     atoms[NS_ATOM_curve].name            = "curve";          atoms[NS_ATOM_curve].len = 5;
@@ -347,6 +351,7 @@ InitCoreAtomSpecs(void)
     atoms[NS_ATOM_description].name      = "description";    atoms[NS_ATOM_description].len = 11;
     atoms[NS_ATOM_digest].name           = "digest";         atoms[NS_ATOM_digest].len = 6;
     atoms[NS_ATOM_digests].name          = "digests";        atoms[NS_ATOM_digests].len = 7;
+    atoms[NS_ATOM_direct].name           = "direct";         atoms[NS_ATOM_direct].len = 6;
     atoms[NS_ATOM_dns].name              = "dns";            atoms[NS_ATOM_dns].len = 3;
     atoms[NS_ATOM_driver].name           = "driver";         atoms[NS_ATOM_driver].len = 6;
     atoms[NS_ATOM_e].name                = "e";              atoms[NS_ATOM_e].len = 1;
@@ -361,6 +366,7 @@ InitCoreAtomSpecs(void)
     atoms[NS_ATOM_expire].name           = "expire";         atoms[NS_ATOM_expire].len = 6;
     atoms[NS_ATOM_expires].name          = "expires";        atoms[NS_ATOM_expires].len = 7;
     atoms[NS_ATOM_extraheaders].name     = "extraheaders";   atoms[NS_ATOM_extraheaders].len = 12;
+    atoms[NS_ATOM_fastlane].name         = "fastlane";       atoms[NS_ATOM_fastlane].len = 8;
     atoms[NS_ATOM_file].name             = "file";           atoms[NS_ATOM_file].len = 4;
     atoms[NS_ATOM_filename].name         = "filename";       atoms[NS_ATOM_filename].len = 8;
     atoms[NS_ATOM_fin].name              = "fin";            atoms[NS_ATOM_fin].len = 3;
@@ -388,9 +394,12 @@ InitCoreAtomSpecs(void)
     atoms[NS_ATOM_ip].name               = "ip";             atoms[NS_ATOM_ip].len = 2;
     atoms[NS_ATOM_iso8859_DASH_1].name   = "iso8859-1";      atoms[NS_ATOM_iso8859_DASH_1].len = 9;
     atoms[NS_ATOM_issuer].name           = "issuer";         atoms[NS_ATOM_issuer].len = 6;
+    atoms[NS_ATOM_jobs].name             = "jobs";           atoms[NS_ATOM_jobs].len = 4;
     atoms[NS_ATOM_kem].name              = "kem";            atoms[NS_ATOM_kem].len = 3;
     atoms[NS_ATOM_keytypes].name         = "keytypes";       atoms[NS_ATOM_keytypes].len = 8;
+    atoms[NS_ATOM_ktls].name             = "ktls";           atoms[NS_ATOM_ktls].len = 4;
     atoms[NS_ATOM_libraryversion].name   = "libraryversion"; atoms[NS_ATOM_libraryversion].len = 14;
+    atoms[NS_ATOM_localhandoffs].name    = "localhandoffs";  atoms[NS_ATOM_localhandoffs].len = 13;
     atoms[NS_ATOM_location].name         = "location";       atoms[NS_ATOM_location].len = 8;
     atoms[NS_ATOM_major].name            = "major";          atoms[NS_ATOM_major].len = 5;
     atoms[NS_ATOM_maxentry].name         = "maxentry";       atoms[NS_ATOM_maxentry].len = 8;
@@ -409,6 +418,7 @@ InitCoreAtomSpecs(void)
     atoms[NS_ATOM_opcode].name           = "opcode";         atoms[NS_ATOM_opcode].len = 6;
     atoms[NS_ATOM_output].name           = "output";         atoms[NS_ATOM_output].len = 6;
     atoms[NS_ATOM_outputchan].name       = "outputchan";     atoms[NS_ATOM_outputchan].len = 10;
+    atoms[NS_ATOM_parked].name           = "parked";         atoms[NS_ATOM_parked].len = 6;
     atoms[NS_ATOM_partial].name          = "partial";        atoms[NS_ATOM_partial].len = 7;
     atoms[NS_ATOM_patch].name            = "patch";          atoms[NS_ATOM_patch].len = 5;
     atoms[NS_ATOM_path].name             = "path";           atoms[NS_ATOM_path].len = 4;
@@ -416,6 +426,7 @@ InitCoreAtomSpecs(void)
     atoms[NS_ATOM_peer].name             = "peer";           atoms[NS_ATOM_peer].len = 4;
     atoms[NS_ATOM_pem].name              = "pem";            atoms[NS_ATOM_pem].len = 3;
     atoms[NS_ATOM_phrase].name           = "phrase";         atoms[NS_ATOM_phrase].len = 6;
+    atoms[NS_ATOM_pollbackend].name      = "pollbackend";    atoms[NS_ATOM_pollbackend].len = 11;
     atoms[NS_ATOM_pool].name             = "pool";           atoms[NS_ATOM_pool].len = 4;
     atoms[NS_ATOM_port].name             = "port";           atoms[NS_ATOM_port].len = 4;
     atoms[NS_ATOM_port].name             = "port";           atoms[NS_ATOM_port].len = 4;
@@ -430,11 +441,13 @@ InitCoreAtomSpecs(void)
     atoms[NS_ATOM_query].name            = "query";          atoms[NS_ATOM_query].len = 5;
     atoms[NS_ATOM_queued].name           = "queued";         atoms[NS_ATOM_queued].len = 6;
     atoms[NS_ATOM_raw].name              = "raw";            atoms[NS_ATOM_raw].len = 3;
+    atoms[NS_ATOM_readcalls].name        = "readcalls";      atoms[NS_ATOM_readcalls].len = 9;
     atoms[NS_ATOM_reading].name          = "reading";        atoms[NS_ATOM_reading].len = 7;
     atoms[NS_ATOM_received].name         = "received";       atoms[NS_ATOM_received].len = 8;
     atoms[NS_ATOM_recverror].name        = "recverror";      atoms[NS_ATOM_recverror].len = 9;
     atoms[NS_ATOM_recvwait].name         = "recvwait";       atoms[NS_ATOM_recvwait].len = 8;
     atoms[NS_ATOM_remaining_days].name   = "remaining_days"; atoms[NS_ATOM_remaining_days].len = 14;
+    atoms[NS_ATOM_remotehandoffs].name   = "remotehandoffs"; atoms[NS_ATOM_remotehandoffs].len = 14;
     atoms[NS_ATOM_replybodysize].name    = "replybodysize";  atoms[NS_ATOM_replybodysize].len = 13;
     atoms[NS_ATOM_replylength].name      = "replylength";    atoms[NS_ATOM_replylength].len = 11;
     atoms[NS_ATOM_replysize].name        = "replysize";      atoms[NS_ATOM_replysize].len = 9;
@@ -442,6 +455,8 @@ InitCoreAtomSpecs(void)
     atoms[NS_ATOM_requestlength].name    = "requestlength";  atoms[NS_ATOM_requestlength].len = 13;
     atoms[NS_ATOM_requests].name         = "requests";       atoms[NS_ATOM_requests].len = 8;
     atoms[NS_ATOM_requiresdigest].name   = "requiresdigest"; atoms[NS_ATOM_requiresdigest].len = 14;
+    atoms[NS_ATOM_resumptionmisses].name = "resumptionmisses"; atoms[NS_ATOM_resumptionmisses].len = 16;
+    atoms[NS_ATOM_resumptions].name      = "resumptions";    atoms[NS_ATOM_resumptions].len = 11;
     atoms[NS_ATOM_rsa].name              = "rsa";            atoms[NS_ATOM_rsa].len = 3;
     atoms[NS_ATOM_running].name          = "running";        atoms[NS_ATOM_running].len = 7;
     atoms[NS_ATOM_runtimeVersionNumber].name = "runtimeVersionNumber"; atoms[NS_ATOM_runtimeVersionNumber].len = 20;
@@ -453,12 +468,14 @@ InitCoreAtomSpecs(void)
     atoms[NS_ATOM_securityCategory].name = "securityCategory"; atoms[NS_ATOM_securityCategory].len = 16;
     atoms[NS_ATOM_sendbodysize].name     = "sendbodysize";   atoms[NS_ATOM_sendbodysize].len = 12;
     atoms[NS_ATOM_sendbuffer].name       = "sendbuffer";     atoms[NS_ATOM_sendbuffer].len = 10;
+    atoms[NS_ATOM_sendcalls].name        = "sendcalls";      atoms[NS_ATOM_sendcalls].len = 9;
     atoms[NS_ATOM_senderror].name        = "senderror";      atoms[NS_ATOM_senderror].len = 9;
     atoms[NS_ATOM_sendwait].name         = "sendwait";       atoms[NS_ATOM_sendwait].len = 8;
     atoms[NS_ATOM_sent].name             = "sent";           atoms[NS_ATOM_sent].len = 4;
     atoms[NS_ATOM_serial].name           = "serial";         atoms[NS_ATOM_serial].len = 6;
     atoms[NS_ATOM_server].name           = "server";         atoms[NS_ATOM_server].len = 6;
     atoms[NS_ATOM_servername].name       = "servername";     atoms[NS_ATOM_servername].len = 10;
+    atoms[NS_ATOM_shard].name            = "shard";          atoms[NS_ATOM_shard].len = 5;
     atoms[NS_ATOM_signature].name        = "signature";      atoms[NS_ATOM_signature].len = 9;
     atoms[NS_ATOM_size_dynamic].name     = "size_dynamic";   atoms[NS_ATOM_size_dynamic].len = 12;
     atoms[NS_ATOM_size_static].name      = "size_static";    atoms[NS_ATOM_size_static].len = 11;
@@ -501,6 +518,7 @@ InitCoreAtomSpecs(void)
     atoms[NS_ATOM_x448].name             = "x448";           atoms[NS_ATOM_x448].len = 4;
     atoms[NS_ATOM_x].name                = "x";              atoms[NS_ATOM_x].len = 1;
     atoms[NS_ATOM_y].name                = "y";              atoms[NS_ATOM_y].len = 1;
+    atoms[NS_ATOM_zstd].name             = "zstd";           atoms[NS_ATOM_zstd].len = 4;
 
     for (NsAtomId i = 0; i < (NsAtomId)NS_ATOM__CORE_MAX; i++) {
         atoms[i].ownedName = NS_FALSE;
@@ -76,7 +76,9 @@ typedef enum {
     NS_ATOM_boundary,
     NS_ATOM_brotli,
     NS_ATOM_bytes,
+    NS_ATOM_bytespercall,
     NS_ATOM_callback,
+    NS_ATOM_callspersec,
     NS_ATOM_capabilities,
     NS_ATOM_channel,
     NS_ATOM_charset,
@@ -87,7 +89,9 @@ typedef enum {
     NS_ATOM_code,
     NS_ATOM_compiler,
     NS_ATOM_complete,
+    NS_ATOM_compression,
     NS_ATOM_condition,
+    NS_ATOM_cpuaffinity,
     NS_ATOM_crv,
     NS_ATOM_currentaddr,
     NS_ATOM_curve,
@@ -96,6 +100,7 @@ typedef enum {
     NS_ATOM_description,
     NS_ATOM_digest,
     NS_ATOM_digests,
+    NS_ATOM_direct,
     NS_ATOM_dns,
     NS_ATOM_driver,
     NS_ATOM_e,
@@ -110,6 +115,7 @@ typedef enum {
     NS_ATOM_expire,
     NS_ATOM_expires,
     NS_ATOM_extraheaders,
+    NS_ATOM_fastlane,
     NS_ATOM_file,
     NS_ATOM_filename,
     NS_ATOM_fin,
@@ -137,9 +143,12 @@ typedef enum {
     NS_ATOM_ip,
     NS_ATOM_iso8859_DASH_1,
     NS_ATOM_issuer,
+    NS_ATOM_jobs,
     NS_ATOM_kem,
     NS_ATOM_keytypes,
+    NS_ATOM_ktls,
     NS_ATOM_libraryversion,
+    NS_ATOM_localhandoffs,
     NS_ATOM_location,
     NS_ATOM_major,
     NS_ATOM_maxentry,
@@ -158,6 +167,7 @@ typedef enum {
     NS_ATOM_opcode,
     NS_ATOM_output,
     NS_ATOM_outputchan,
+    NS_ATOM_parked,
     NS_ATOM_partial,
     NS_ATOM_patch,
     NS_ATOM_path,
@@ -165,6 +175,7 @@ typedef enum {
     NS_ATOM_peer,
     NS_ATOM_pem,
     NS_ATOM_phrase,
+    NS_ATOM_pollbackend,
     NS_ATOM_pool,
     NS_ATOM_port,
     NS_ATOM_preload,
@@ -178,11 +189,13 @@ typedef enum {
     NS_ATOM_query,
     NS_ATOM_queued,
     NS_ATOM_raw,
+    NS_ATOM_readcalls,
     NS_ATOM_reading,
     NS_ATOM_received,
     NS_ATOM_recverror,
     NS_ATOM_recvwait,
     NS_ATOM_remaining_days,
+    NS_ATOM_remotehandoffs,
     NS_ATOM_replybodysize,
     NS_ATOM_replylength,
     NS_ATOM_replysize,
@@ -190,6 +203,8 @@ typedef enum {
     NS_ATOM_requestlength,
     NS_ATOM_requests,
     NS_ATOM_requiresdigest,
+    NS_ATOM_resumptionmisses,
+    NS_ATOM_resumptions,
     NS_ATOM_rsa,
     NS_ATOM_running,
     NS_ATOM_runtimeVersion,
@@ -201,12 +216,14 @@ typedef enum {
     NS_ATOM_securityCategory,
     NS_ATOM_sendbodysize,
     NS_ATOM_sendbuffer,
+    NS_ATOM_sendcalls,
     NS_ATOM_senderror,
     NS_ATOM_sendwait,
     NS_ATOM_sent,
     NS_ATOM_serial,
     NS_ATOM_server,
     NS_ATOM_servername,
+    NS_ATOM_shard,
     NS_ATOM_signature,
     NS_ATOM_size_dynamic,
     NS_ATOM_size_static,
@@ -249,6 +266,7 @@ typedef enum {
     NS_ATOM_x25519,
     NS_ATOM_x448,
     NS_ATOM_y,
+    NS_ATOM_zstd,
 
     /* end marker */
     NS_ATOM__CORE_MAX
@@ -93,11 +93,20 @@ typedef enum {
     NS_WRITER_STREAM_FINISH =      2
 } NsWriterStreamState;
 
+/*
+ * Event notification backends usable by the driver and spooler threads.
+ */
+typedef enum {
+    NS_POLL_BACKEND_POLL =         0,
+    NS_POLL_BACKEND_EPOLL =        1
+} NsPollBackend;
+
 #define MAX_URLSPACES                  16
 #define MAX_LISTEN_ADDR_PER_DRIVER     16
 
 #define NS_SET_SIZE                    ((unsigned)TCL_INTEGER_SPACE + 2u)
 #define NS_MAX_RANGES                  32
+#define NS_ICTL_EPOCH_STATS            8
 
 #define CONN_TCLFORM                   0x01u  /* Query form set is registered for interp */
 #define CONN_TCLHDRS                   0x02u  /* Input headers set is registered for interp */
@@ -283,9 +292,17 @@ typedef struct SpoolerQueue {
     Ns_Thread            thread;      /* Running WriterThread/Spoolerthread */
     int                  id;          /* Queue id */
     int                  queuesize;   /* Number of active sockets in the queue */
+    NsPollBackend        pollBackend; /* Event notification backend of the thread */
     const char          *threadName;  /* Name of the thread working on this queue */
     bool                 stopped;     /* Flag to indicate thread stopped */
     bool                 shutdown;    /* Flag to indicate shutdown */
+    Ns_Time              startTime;   /* Start time of the thread */
+    struct {
+        Tcl_WideInt bytes;            /* Bytes sent by the writer thread */
+        Tcl_WideInt sendcalls;        /* Send operations (send, sendfile) */
+        Tcl_WideInt readcalls;        /* Read operations into the writer buffer */
+        Tcl_WideInt direct;           /* Bytes sent directly from files (sendfile, mapped windows) */
+    } stats;                          /* Throughput, updated only by the writer thread */
 } SpoolerQueue;
 
 
@@ -446,12 +463,14 @@ typedef struct {
 typedef struct {
     size_t              writersize;     /* Use writer thread above this size */
     size_t              bufsize;        /* Size of the output buffer */
-    Ns_Mutex            lock;           /* Lock around writer queues */
+    size_t              maxbufsize;     /* Upper limit for adaptive send sizes */
     SpoolerQueue       *firstPtr;       /* List of writer threads */
-    SpoolerQueue       *curPtr;         /* Current writer thread */
+    SpoolerQueue      **queues;         /* Writer threads indexed by queue id */
     int                 threads;        /* Number of writer threads to run */
+    int64_t             next;           /* Round robin counter for writer threads, accessed atomically */
     int                 rateLimit;      /* Limit transmission rate in KB/s for a writer job */
     NsWriterStreamState doStream;       /* Activate writer for HTML streaming */
+    bool                sendfile;       /* Send files without the output buffer */
     struct {
         size_t queued;   /* Writer jobs queued for a writer thread but not yet active. */
         size_t writing;  /* Writer jobs currently active in writer threads. */
@@ -533,6 +552,10 @@ typedef struct Driver {
     int acceptsize;                     /* Number requests to accept at once */
     int sockacceptlog;                  /* Report, when more than this sockets are received in one step */
     int driverthreads;                  /* Number of identical driver threads to be created */
+    NsPollBackend pollBackend;          /* Event notification backend of driver and spooler threads */
+    int shard;                          /* Shard number (over all drivers with "cpuaffinity") or
+                                         * index of this thread among the driverthreads */
+    bool cpuaffinity;                   /* Bind driver thread and its conn threads to the CPUs of the shard */
     unsigned int loggingFlags;          /* Logging control flags */
 
     unsigned int flags;                 /* Driver state flags. */
@@ -553,12 +576,22 @@ typedef struct Driver {
         Tcl_WideInt partial;            /* Partial operations */
         Tcl_WideInt received;           /* Received requests */
         Tcl_WideInt errors;             /* Dropped requests due to errors */
+        Tcl_WideInt fastlane;           /* Requests delivered via the fast lane */
         /*
          * Current driver-thread state. These are gauges, not cumulative counters.
          */
         size_t waiting;                 /* Sockets on the driver retry list for queueing into a pool. */
         size_t reading;                 /* Sockets on the driver's read or keepalive-wait list. */
         size_t closing;                 /* Sockets on the driver's closewait list. */
+        size_t parked;                  /* Idle keepalive sockets registered persistently (epoll). */
+        /*
+         * Hand-offs to idle connection threads when "cpuaffinity" is active.
+         */
+        int64_t     localhandoffs;      /* .. to a conn thread of the same shard (atomic) */
+        int64_t     remotehandoffs;     /* .. to a conn thread of a different shard (atomic) */
+        int64_t     ktls;               /* TLS connections with kernel TLS send offload (atomic) */
+        int64_t     resumptions;        /* TLS handshakes resuming a previous session (atomic) */
+        int64_t     resumptionmisses;   /* TLS resumption attempts with unknown session or ticket (atomic) */
     } stats;
     Ns_DList ports;
     const char *libraryVersion;
@@ -578,7 +611,13 @@ typedef enum {
     NS_EXTRACTED_HEADER_CONTENT_LENGTH =  1,
     NS_EXTRACTED_HEADER_HOST =            2,
     NS_EXTRACTED_HEADER_EXPECT =          3,
-    NS_EXTRACTED_NONE =                   4
+    NS_EXTRACTED_HEADER_TRANSFER_ENCODING = 4,
+    NS_EXTRACTED_HEADER_ACCEPT_ENCODING = 5,
+    NS_EXTRACTED_HEADER_RANGE =           6,
+    NS_EXTRACTED_HEADER_X_EXPECTED_ENTITY_LENGTH = 7,
+    NS_EXTRACTED_HEADER_X_FORWARDED_FOR = 8,
+    NS_EXTRACTED_HEADER_CONNECTION =      9,
+    NS_EXTRACTED_NONE =                   10
 } NsExtractedHeaderIndex;
 
 /*
@@ -604,11 +643,16 @@ typedef struct Sock {
     struct NS_SOCKADDR_STORAGE clientsa; /* Client addr as determined via x-forwarded-for header field */
 
     struct Sock        *nextPtr;
+    struct Sock        *prevPtr;          /* Only used in the list of parked sockets */
     struct NsServer    *servPtr;
     struct ConnPool    *poolPtr;
 
     const char         *location;
     NS_POLL_NFDS_TYPE   pidx;             /* poll() index */
+    int                 pollfd;           /* Event fd, in which the socket was registered last */
+    short               revents;          /* Returned events when not using poll() */
+    bool                pollArmed;        /* Registered interest is active (epoll) */
+    bool                parked;           /* Sock is in the list of parked sockets */
     unsigned int        flags;            /* State flags used by driver */
     Ns_Time             timeout;
     Request            *reqPtr;
@@ -627,6 +671,7 @@ typedef struct Sock {
     ssize_t             sendRejected;     /* handling of SSL_ERROR_WANT_WRITE */
     void               *sendRejectedBase; /* for retransmitting in case of SSL_ERROR_WANT_WRITE */
     unsigned int        deliveryRefs;     /* Nr of delivery objects/threads that may invoke sendProc */
+    int                 writerQueue;      /* Writer thread of the socket plus one, 0 when not yet assigned */
     size_t              sendCount;        // debugging
     void               *sls[1];           /* Slots for sls storage */
 
@@ -750,6 +795,7 @@ typedef struct Conn {
     Ns_CompressStream cStream;
     int requestCompress;
     int compress;
+    Ns_CompressEncoding compressEncoding;
 
     Ns_Set *query;
     Ns_Set *formData;
@@ -780,9 +826,9 @@ typedef struct ConnThreadArg {
     struct ConnPool      *poolPtr;
     struct Conn          *connPtr;
     Ns_Cond               cond;        /* Cond for signaling this conn thread */
-    Ns_Mutex              lock;
-    struct ConnThreadArg *nextPtr;     /* used for the conn thread queue */
+    Ns_Mutex              lock;        /* Protects connPtr during hand-off and introspection */
     ConnThreadState       state;
+    int                   shard;       /* Shard of the driver feeding this thread, -1 when unbound */
 } ConnThreadArg;
 
 /*
@@ -797,12 +843,16 @@ typedef struct ConnPool {
     /*
      * The following struct maintains the active and waiting connection
      * queues, the free conn list, the next conn id, and the number
-     * of waiting connects.
+     * of waiting connects. The free conn list is a lock-free stack over
+     * the "conns" array; "freeTop" contains the index+1 of the top
+     * element in the lower and a modification count against ABA in the
+     * upper 32 bits.
      */
 
     struct {
-        Conn *freePtr;
-        int maxconns;
+        Conn     *conns;
+        uint64_t  freeTop;
+        int       maxconns;
 
         struct {
             Conn *firstPtr;
@@ -836,21 +886,24 @@ typedef struct ConnPool {
         int       min;
         int       max;
         int       current;
-        int       idle;
+        int64_t   idle;             /* Updated atomically */
         int       connsperthread;
         int       creating;
     } threads;
 
     /*
      * The following struct maintains the state of the thread
-     * connection queue.  "nextPtr" points to the next available
-     * connection thread, "args" keeps the array of all configured
-     * connection structs, and "lock" is used for locking this queue.
+     * connection queue.  "args" keeps the array of all configured
+     * connection structs, "idle" is a bitmap with a bit set for every
+     * connection thread in "args" waiting for a connection. Idle threads
+     * are claimed by clearing their bit atomically. "lock" is used for
+     * allocating slots in "args".
      */
 
     struct {
-        ConnThreadArg *nextPtr;
         ConnThreadArg *args;
+        uint64_t      *idle;
+        int            nidle;       /* Number of words in the idle bitmap */
         Ns_Mutex       lock;
     } tqueue;
 
@@ -859,7 +912,8 @@ typedef struct ConnPool {
      */
 
     struct {
-        unsigned long processed;
+        uint64_t      processed;    /* Updated atomically */
+        int64_t       fastlane;     /* Updated atomically */
         unsigned long spool;
         unsigned long queued;
         unsigned long dropped;
@@ -896,7 +950,7 @@ typedef struct NsServer {
 
     struct {
         Ns_Mutex lock;
-        uintptr_t nextconnid;
+        uint64_t nextconnid;        /* Updated atomically */
         ConnPool *firstPtr;
         ConnPool *defaultPtr;
         Ns_Thread joinThread;
@@ -948,6 +1002,8 @@ typedef struct NsServer {
         const char *diradp;
         Ns_UrlToFileProc *url2file;
         TCL_SIZE_T dirc;
+        const char **lanev;     /* URL prefixes served by the driver fast lane */
+        TCL_SIZE_T lanec;
     } fastpath;
 
     /*
@@ -990,6 +1046,9 @@ typedef struct NsServer {
 
     struct {
         struct Filter *firstFilterPtr;
+        struct FilterIndex *indexPtr;
+        long minSeq;
+        long maxSeq;
         struct Trace *firstTracePtr;
         struct Trace *firstCleanupPtr;
         union {
@@ -1019,8 +1078,7 @@ typedef struct NsServer {
         struct TclTrace  *lastTracePtr;
         Tcl_Obj          *initfile;
         Ns_RWLock         lock;
-        const char       *script;
-        TCL_SIZE_T        length;
+        struct Blueprint *blueprintPtr;
         int               epoch;
         Tcl_DString       modules;
         Tcl_HashTable     runTable;
@@ -1029,6 +1087,26 @@ typedef struct NsServer {
         Ns_RWLock         cachelock;
         uintptr_t         transactionEpoch;
 
+        /*
+         * The following tracks the time spent for creating and updating
+         * interpreters.
+         */
+        struct {
+            unsigned long created;
+            unsigned long updated;
+            Ns_Time       createTime;
+            Ns_Time       createTimeMax;
+            Ns_Time       updateTime;
+            Ns_Time       updateTimeMax;
+            unsigned long deltaUpdated;
+            struct {
+                int           epoch;
+                unsigned long updated;
+                unsigned long deltaUpdated;
+                Ns_Time       updateTime;
+            } epochs[NS_ICTL_EPOCH_STATS]; /* Per-epoch update times */
+        } stats;
+
         /*
          * The following tracks synchronization
          * objects which are looked up by name.
@@ -1060,6 +1138,7 @@ typedef struct NsServer {
         const char *startpage;
         const char *debuginit;
         const char *defaultExtension;
+        bool watchfiles;
 
         Ns_Cond pagecond;
         Ns_Mutex pagelock;
@@ -1070,10 +1149,14 @@ typedef struct NsServer {
     } adp;
 
     struct {
-        int  level;     /* 1-9 */
-        int  minsize;   /* min size of response to compress, in bytes */
-        bool enable;    /* on/off */
-        bool preinit;   /* initialize the compression stream buffers in advance */
+        int  level;       /* 1-9 */
+        int  brotliLevel; /* 1-11 */
+        int  zstdLevel;   /* 1-19 */
+        int  minsize;     /* min size of response to compress, in bytes */
+        bool enable;      /* on/off */
+        bool preinit;     /* initialize the compression stream buffers in advance */
+        int  nrFormats;
+        Ns_CompressEncoding formats[3]; /* content-encodings in order of preference */
     } compress;
 
     /*
@@ -1149,6 +1232,7 @@ typedef struct NsInterp {
     NsServer   *servPtr;
     int         epoch;         /* Run the update script if != to server epoch */
     int         refcnt;        /* Counts recursive allocations of cached interp */
+    Ns_Time     createTime;    /* Time needed to create and initialize the interp */
 
     /*
      * The following pointer maintains the first in
@@ -1428,6 +1512,7 @@ NS_EXTERN TCL_OBJCMDPROC_T
     NsTclCacheKeysObjCmd,
     NsTclCacheLappendObjCmd,
     NsTclCacheNamesObjCmd,
+    NsTclCacheRefreshObjCmd,
     NsTclCacheStatsObjCmd,
     NsTclCacheTransactionBeginObjCmd,
     NsTclCacheTransactionCommitObjCmd,
@@ -1773,6 +1858,8 @@ NS_EXTERN Ns_ReturnCode NsAuthorizeRequest(NsServer *servPtr,
     NS_GNUC_NONNULL(1,2,3);
 NS_EXTERN void NsGetAuthprocs(Tcl_DString *dsPtr, NsServer *servPtr)
     NS_GNUC_NONNULL(1,2);
+NS_EXTERN bool NsAuthorizeRequestRegistered(NsServer *servPtr)
+    NS_GNUC_NONNULL(1);
 
 /*
  * binder.c
@@ -1799,6 +1886,14 @@ NS_EXTERN void NsRunAtExitProcs(void);
  */
 NS_EXTERN void NsClsCleanup(Conn *connPtr) NS_GNUC_NONNULL(1);
 
+/*
+ * compress.c
+ */
+NS_EXTERN const char *NsCompressEncodingName(Ns_CompressEncoding encoding)
+    NS_GNUC_RETURNS_NONNULL;
+NS_EXTERN Ns_ReturnCode NsCompressEncodingFromName(const char *name, Ns_CompressEncoding *encodingPtr)
+    NS_GNUC_NONNULL(1,2);
+
 /*
  * config.c
  */
@@ -1857,6 +1952,12 @@ NS_EXTERN int NsConnChanWrite(Tcl_Interp *interp, const char *connChanName, cons
                               TCL_SIZE_T msgLength, ssize_t *bytesSentPtr, unsigned long *errnoPtr)
     NS_GNUC_NONNULL(1,2,3,5,6);
 
+/*
+ * connio.c
+ */
+NS_EXTERN Ns_CompressEncoding NsConnSelectCompression(const Conn *connPtr, int gzipLevel, int *levelPtr)
+    NS_GNUC_NONNULL(1,3);
+
 /*
  * dlist.c
  */
@@ -1885,7 +1986,7 @@ NS_EXTERN bool NsHostnameIsNumericIP(const char *hostname) NS_GNUC_PURE
 /*
  * driver.c
  */
-NS_EXTERN void NsAddNslogEntry(Sock *sockPtr, int statusCode, Ns_Conn *connPtr, const char *headers)
+NS_EXTERN void NsAddNslogEntry(Sock *sockPtr, int statusCode, Ns_Conn *connPtr, size_t contentSent)
     NS_GNUC_NONNULL(1);
 
 NS_EXTERN Ns_ReturnCode NsDispatchRequest(Sock *sockPtr)
@@ -1897,6 +1998,8 @@ NS_EXTERN TCL_SIZE_T NsDriverBindAddresses(Driver *drvPtr)
 NS_EXTERN Ns_Driver *NsDriverFromConfigSection(const char *section)
     NS_GNUC_NONNULL(1);
 
+NS_EXTERN void NsDriverSetShardAffinity(int shard, bool singleCpu);
+
 NS_EXTERN NS_TLS_SSL_CTX *NsDriverLookupHostCtx(Tcl_DString *hostDs, const char *hostName, Ns_Driver *drvPtr)
     NS_GNUC_NONNULL(1,3);
 
@@ -1957,8 +2060,8 @@ NS_EXTERN void NsStopSpoolers(void);
 
 NS_EXTERN void NsWakeupDriver(const Driver *drvPtr) NS_GNUC_NONNULL(1);
 
-NS_EXTERN void NsWriterLock(void);
-NS_EXTERN void NsWriterUnlock(void);
+NS_EXTERN void NsWriterLock(const void *key) NS_GNUC_NONNULL(1);
+NS_EXTERN void NsWriterUnlock(const void *key) NS_GNUC_NONNULL(1);
 NS_EXTERN void NsWriterFinish(NsWriterSock *wrSockPtr)
     NS_GNUC_NONNULL(1);
 
@@ -1977,6 +2080,30 @@ NS_EXTERN Ns_ReturnCode NsGetFallbackEncoding(Tcl_Interp *interp, NsServer *serv
                                               Tcl_Encoding *encodingPtr)
     NS_GNUC_NONNULL(1,5);
 
+/*
+ * fastpath.c
+ */
+NS_EXTERN bool NsCompressCacheEnabled(void) NS_GNUC_PURE;
+NS_EXTERN const char *NsCompressCacheGet(const char *key, const struct stat *stPtr,
+                                         Ns_CompressEncoding encoding, int level,
+                                         const char *fileName, const struct iovec *bufs, int nbufs,
+                                         size_t *lengthPtr, void **handlePtr)
+    NS_GNUC_NONNULL(1,8,9);
+NS_EXTERN void NsCompressCacheRelease(void *handle)
+    NS_GNUC_NONNULL(1);
+
+typedef struct NsFastLaneReply {
+    Tcl_DString headers;        /* Complete response header */
+    int         statusCode;
+    int         fd;             /* File to send or NS_INVALID_FD (no body) */
+    off_t       offset;         /* Offset of the body in the file */
+    size_t      length;         /* Length of the body */
+    bool        keep;           /* Keep-alive was granted */
+} NsFastLaneReply;
+
+NS_EXTERN bool NsFastLaneLookup(Sock *sockPtr, NsFastLaneReply *replyPtr)
+    NS_GNUC_NONNULL(1,2);
+
 /*
  * filter.c
  */
@@ -1988,6 +2115,8 @@ NS_EXTERN void NsRunCleanups(Ns_Conn *conn) NS_GNUC_NONNULL(1);
 NS_EXTERN void NsRunTraces(Ns_Conn *conn) NS_GNUC_NONNULL(1);
 NS_EXTERN void NsRunSelectedTraces(Ns_Conn *conn, const char *traceProcDescription)
     NS_GNUC_NONNULL(1,2);
+NS_EXTERN bool NsFiltersRegistered(NsServer *servPtr, const char *method, const char *url)
+    NS_GNUC_NONNULL(1,2,3);
 
 /*
  * info.c
@@ -2090,6 +2219,9 @@ NS_EXTERN Ns_Set *NsHeaderSetGet(size_t size);
 NS_EXTERN Ns_ReturnCode NsQueueConn(Sock *sockPtr, const Ns_Time *nowPtr)
     NS_GNUC_NONNULL(1);
 
+NS_EXTERN ConnPool *NsSockSelectPool(const NsServer *servPtr, Sock *sockPtr)
+    NS_GNUC_NONNULL(1,2) NS_GNUC_RETURNS_NONNULL;
+
 NS_EXTERN void NsEnsureRunningConnectionThreads(const NsServer *servPtr, ConnPool *poolPtr)
     NS_GNUC_NONNULL(1);
 
@@ -2124,8 +2256,11 @@ NS_EXTERN int NsConnParseRange(Ns_Conn *conn, const char *type,
 /*
  * request.c
  */
-NS_EXTERN void NsParseAcceptEncoding(double version, const char *hdr, bool *gzipAcceptPtr, bool *brotliAcceptPtr)
-    NS_GNUC_NONNULL(2,3,4);
+NS_EXTERN void NsParseAcceptEncoding(double version, const char *hdr,
+                                     bool *gzipAcceptPtr, bool *brotliAcceptPtr, bool *zstdAcceptPtr)
+    NS_GNUC_NONNULL(2,3,4,5);
+NS_EXTERN Ns_ReturnCode NsParseRequestHeaderLine(Ns_Set *set, const char *line, size_t length)
+    NS_GNUC_NONNULL(1,2);
 
 /*
  * return.c
@@ -2242,6 +2377,9 @@ NS_EXTERN BIO *NsPemOpenReadStream(const char *fnOrData)  NS_GNUC_NONNULL(1);
  */
 NS_EXTERN void NsStartJobsShutdown(void);
 NS_EXTERN void NsWaitJobsShutdown(const Ns_Time *toPtr);
+NS_EXTERN Ns_ReturnCode NsJobQueueDetached(const NsServer *servPtr, const char *queueName,
+                                          const char *queueDesc, const char *script)
+    NS_GNUC_NONNULL(2,3,4);
 
 /*
  * tclhttp.c
@@ -2306,6 +2444,7 @@ NS_EXTERN void NsTclInitTimeType(void);
  */
 NS_EXTERN struct Bucket *NsTclCreateBuckets(const NsServer *servPtr, int nbuckets)
     NS_GNUC_NONNULL(1);
+NS_EXTERN void NsTclInitNsvType(void);
 
 
 #ifdef NS_WITH_DEPRECATED
@@ -2333,6 +2472,25 @@ NS_EXTERN Ns_ReturnCode NsTLSAddClientCertInfo(Tcl_Interp *interp, NS_TLS_SSL *s
 NS_EXTERN Ns_ReturnCode NsTLSAddClientCertDetails(Tcl_Interp *interp, NS_TLS_SSL *ssl, Tcl_Obj *dictObj)
         NS_GNUC_NONNULL(2,3);
 
+/*
+ * Maximum payload of a TLS record (RFC 8446 section 5.1). Multiple small
+ * buffers are gathered up to this size into a single SSL_write().
+ */
+#define NS_TLS_MAX_RECORD_SIZE 16384u
+
+NS_EXTERN size_t NsTLSGatherBufs(char *staging, size_t size, const struct iovec *bufs, int nbufs, size_t offset)
+        NS_GNUC_NONNULL(1,3);
+NS_EXTERN int NsTLSAdvanceBufs(const struct iovec **bufsPtr, int nbufs, size_t *offsetPtr, size_t length)
+        NS_GNUC_NONNULL(1,3);
+
+/*
+ * tlssession.c
+ */
+NS_EXTERN void NsTLSSessionsSetupCtx(NS_TLS_SSL_CTX *ctx)
+        NS_GNUC_NONNULL(1);
+NS_EXTERN int NsTLSResumptionStatus(const NS_TLS_SSL *ssl)
+        NS_GNUC_NONNULL(1);
+
 
 
 /*
@@ -2366,6 +2524,8 @@ NS_EXTERN void NsGetUrl2FileProcs(Tcl_DString *dsPtr, const char *server)
 
 NS_EXTERN Ns_ReturnCode NsUrlToFile(Tcl_DString *dsPtr, NsServer *servPtr, const char *url)
     NS_GNUC_NONNULL(1,2,3);
+NS_EXTERN Ns_ReturnCode NsUrlToFileDirect(Tcl_DString *dsPtr, NsServer *servPtr, const char *url)
+    NS_GNUC_NONNULL(1,2,3);
 
 
 /*
@@ -71,6 +71,7 @@ typedef struct NsTLSConfig {
             int    nodelay;           /* Enable the TCP_NODELAY optimization.              */
             bool   h3advertise;       /* add h3 advertise automatically when h3 is enabled */
             bool   h3persist;         /* add persit flag to h3 advertise when activated    */
+            bool   ktls;              /* try to activate kernel TLS offload                */
         } h1;
 # if defined(HAVE_OPENSSL_4)
         struct {
@@ -27,9 +27,21 @@
 static void ConnRun(Conn *connPtr)
     NS_GNUC_NONNULL(1);
 
-static void CreateConnThread(ConnPool *poolPtr)
+static void CreateConnThread(ConnPool *poolPtr, const Driver *drvPtr)
     NS_GNUC_NONNULL(1);
 
+static ConnThreadArg *ConnThreadClaimIdle(ConnPool *poolPtr, Driver *drvPtr)
+    NS_GNUC_NONNULL(1,2);
+static void ConnThreadSetIdle(ConnPool *poolPtr, const ConnThreadArg *argPtr)
+    NS_GNUC_NONNULL(1,2);
+static bool ConnThreadUnsetIdle(ConnPool *poolPtr, const ConnThreadArg *argPtr)
+    NS_GNUC_NONNULL(1,2);
+
+static Conn *ConnFreePop(ConnPool *poolPtr)
+    NS_GNUC_NONNULL(1);
+static void ConnFreePush(ConnPool *poolPtr, Conn *connPtr)
+    NS_GNUC_NONNULL(1,2);
+
 static void AppendConn(Tcl_DString *dsPtr, const Conn *connPtr, const char *state, bool checkforproxy)
     NS_GNUC_NONNULL(1,3);
 static void AppendConnList(Tcl_DString *dsPtr, const Conn *firstPtr, const char *state, bool checkforproxy)
@@ -120,12 +132,14 @@ static int    poolid = 0;
 static void ConnThreadQueuePrint(ConnPool *poolPtr, char *key) {
     ConnThreadArg *aPtr;
 
-    fprintf(stderr, "%s: thread queue (idle %d): ", key, poolPtr->threads.idle);
-    Ns_MutexLock(&poolPtr->tqueue.lock);
-    for (aPtr = poolPtr->tqueue.nextPtr; aPtr; aPtr = aPtr->nextPtr) {
-        fprintf(stderr, "[%d] state %d, ", ThreadNr(poolPtr, aPtr), aPtr->state);
+    fprintf(stderr, "%s: thread queue (idle %d): ", key, (int)NS_ATOMIC_LOAD(&poolPtr->threads.idle));
+    for (aPtr = poolPtr->tqueue.args; aPtr < poolPtr->tqueue.args + poolPtr->threads.max; aPtr++) {
+        int i = ThreadNr(poolPtr, aPtr);
+
+        if ((NS_ATOMIC_LOAD(&poolPtr->tqueue.idle[i / 64]) & ((uint64_t)1u << (i % 64))) != 0u) {
+            fprintf(stderr, "[%d] state %d, ", i, aPtr->state);
+        }
     }
-    Ns_MutexUnlock(&poolPtr->tqueue.lock);
     fprintf(stderr, "\n");
 }
 #endif
@@ -477,13 +491,59 @@ NsEnsureRunningConnectionThreads(const NsServer *servPtr, ConnPool *poolPtr) {
         Ns_Log(Notice, "NsEnsureRunningConnectionThreads wantCreate %d waiting %d idle %d current %d",
                (int)create,
                waitnum,
-               poolPtr->threads.idle,
+               (int)NS_ATOMIC_LOAD(&poolPtr->threads.idle),
                poolPtr->threads.current);
-        CreateConnThread(poolPtr);
+        CreateConnThread(poolPtr, NULL);
     }
 }
 
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * NsSockSelectPool --
+ *
+ *      Determine the connection pool for the request of the socket based
+ *      on the request method and URL. For non-HTTP drivers, the
+ *      request.method won't be provided.
+ *
+ * Results:
+ *      The mapped connection pool or the default pool of the server.
+ *
+ * Side effects:
+ *      Sets sockPtr->poolPtr, when a pool mapping applies.
+ *
+ *----------------------------------------------------------------------
+ */
+ConnPool *
+NsSockSelectPool(const NsServer *servPtr, Sock *sockPtr)
+{
+    ConnPool *poolPtr = sockPtr->poolPtr;
+
+    NS_NONNULL_ASSERT(servPtr != NULL);
+    NS_NONNULL_ASSERT(sockPtr != NULL);
+
+    if ((poolPtr == NULL)
+        && (sockPtr->reqPtr != NULL)
+        && (sockPtr->reqPtr->request.method != NULL)) {
+        NsUrlSpaceContext ctx;
+
+        NsUrlSpaceContextInit(&ctx, sockPtr, sockPtr->reqPtr->headers);
+        poolPtr = Ns_UrlSpecificGet((Ns_Server*)servPtr,
+                                    sockPtr->reqPtr->request.method,
+                                    sockPtr->reqPtr->request.url,
+                                    poolid, 0u, NS_URLSPACE_DEFAULT,
+                                    NULL,
+                                    NsUrlSpaceContextFilterEval, &ctx);
+        sockPtr->poolPtr = poolPtr;
+    }
+    if (poolPtr == NULL) {
+        poolPtr = servPtr->pools.defaultPtr;
+    }
+    return poolPtr;
+}
+
+
 /*
  *----------------------------------------------------------------------
  *
@@ -551,44 +611,20 @@ NsQueueConn(Sock *sockPtr, const Ns_Time *nowPtr)
     }
 
     /*
-     * Select connection pool. For non-HTTP drivers, the request.method
-     * won't be provided.
+     * Select connection pool.
      */
-    if ((sockPtr->poolPtr == NULL)
-        && (sockPtr->reqPtr != NULL)
-        && (sockPtr->reqPtr->request.method != NULL)) {
-        NsUrlSpaceContext ctx;
-
-        NsUrlSpaceContextInit(&ctx, sockPtr, sockPtr->reqPtr->headers);
-        poolPtr = Ns_UrlSpecificGet((Ns_Server*)servPtr,
-                                    sockPtr->reqPtr->request.method,
-                                    sockPtr->reqPtr->request.url,
-                                    poolid, 0u, NS_URLSPACE_DEFAULT,
-                                    NULL,
-                                    NsUrlSpaceContextFilterEval, &ctx);
-        sockPtr->poolPtr = poolPtr;
-
-    } else if (sockPtr->poolPtr != NULL) {
-        poolPtr = sockPtr->poolPtr;
+    if (sockPtr->poolPtr != NULL) {
         Ns_Log(Notice , "=== NsQueueConn URL <%s> was already assigned to pool <%s>",
-               sockPtr->reqPtr->request.url, poolPtr->pool);
-    }
-    if (poolPtr == NULL) {
-        poolPtr = servPtr->pools.defaultPtr;
+               sockPtr->reqPtr->request.url, sockPtr->poolPtr->pool);
     }
+    poolPtr = NsSockSelectPool(servPtr, sockPtr);
 
    /*
     * We know the pool. Try to add connection into the queue of this pool
     * (either into a free slot or into its waiting list, or, when everything
     * fails signal an error or timeout (for retry attempts) to the caller.
     */
-    Ns_MutexLock(&poolPtr->wqueue.lock);
-    if (poolPtr->wqueue.freePtr != NULL) {
-        connPtr = poolPtr->wqueue.freePtr;
-        poolPtr->wqueue.freePtr = connPtr->nextPtr;
-        connPtr->nextPtr = NULL;
-    }
-    Ns_MutexUnlock(&poolPtr->wqueue.lock);
+    connPtr = ConnFreePop(poolPtr);
 
     if (likely(connPtr != NULL)) {
         const unsigned int deliveryFlag = sockPtr->flags & NS_CONN_DELIVERY_TRACKED;
@@ -599,10 +635,8 @@ NsQueueConn(Sock *sockPtr, const Ns_Time *nowPtr)
 
         /* ConnThreadQueuePrint(poolPtr, "driver");*/
 
-        Ns_MutexLock(&servPtr->pools.lock);
-        connPtr->id = servPtr->pools.nextconnid++;
-        poolPtr->stats.processed++;
-        Ns_MutexUnlock(&servPtr->pools.lock);
+        connPtr->id = (uintptr_t)NS_ATOMIC_FETCH_ADD(&servPtr->pools.nextconnid, 1);
+        (void) NS_ATOMIC_FETCH_ADD(&poolPtr->stats.processed, 1);
 
         connPtr->requestQueueTime     = *nowPtr;
         connPtr->sockPtr              = sockPtr;
@@ -636,33 +670,25 @@ NsQueueConn(Sock *sockPtr, const Ns_Time *nowPtr)
         }
 
         /*
-         * Try to get an entry from the connection thread queue,
-         * and dequeue it when possible.
+         * Try to claim an idle thread from the connection thread queue.
          */
-        if (poolPtr->tqueue.nextPtr != NULL) {
-            Ns_MutexLock(&poolPtr->tqueue.lock);
-            if (poolPtr->tqueue.nextPtr != NULL) {
-                argPtr = poolPtr->tqueue.nextPtr;
-                poolPtr->tqueue.nextPtr = argPtr->nextPtr;
-            }
-            Ns_MutexUnlock(&poolPtr->tqueue.lock);
-        }
+        argPtr = ConnThreadClaimIdle(poolPtr, sockPtr->drvPtr);
 
         if (argPtr != NULL) {
             /*
-             * We could obtain an idle thread. Dequeue the entry,
-             * such that no one else might grab it, and fill in the
-             * connPtr that should be run by this thread.
+             * We could obtain an idle thread. The connPtr is handed over,
+             * when the thread is signaled below. Check for the need of
+             * additional threads only, when the pool is below minthreads
+             * (the waiting list is empty in this case). The unlocked read
+             * is just a hint and rechecked under the lock.
              */
-
-            assert(argPtr->state == connThread_idle);
-            argPtr->connPtr = connPtr;
-
-            Ns_MutexLock(&poolPtr->wqueue.lock);
-            Ns_MutexLock(&poolPtr->threads.lock);
-            create = neededAdditionalConnectionThreads(poolPtr);
-            Ns_MutexUnlock(&poolPtr->threads.lock);
-            Ns_MutexUnlock(&poolPtr->wqueue.lock);
+            if (unlikely(poolPtr->threads.current < poolPtr->threads.min)) {
+                Ns_MutexLock(&poolPtr->wqueue.lock);
+                Ns_MutexLock(&poolPtr->threads.lock);
+                create = neededAdditionalConnectionThreads(poolPtr);
+                Ns_MutexUnlock(&poolPtr->threads.lock);
+                Ns_MutexUnlock(&poolPtr->wqueue.lock);
+            }
 
         } else {
             /*
@@ -737,7 +763,7 @@ NsQueueConn(Sock *sockPtr, const Ns_Time *nowPtr)
                 int idle, current;
 
                 Ns_MutexLock(&poolPtr->threads.lock);
-                idle = poolPtr->threads.idle;
+                idle = (int)NS_ATOMIC_LOAD(&poolPtr->threads.idle);
                 current = poolPtr->threads.current;
                 Ns_MutexUnlock(&poolPtr->threads.lock);
 
@@ -782,20 +808,19 @@ NsQueueConn(Sock *sockPtr, const Ns_Time *nowPtr)
          * Perform lock just in the debugging case to avoid race condition.
          */
         if (Ns_LogSeverityEnabled(Debug)) {
-            int idle;
-
-            Ns_MutexLock(&poolPtr->threads.lock);
-            idle = poolPtr->threads.idle;
-            Ns_MutexUnlock(&poolPtr->threads.lock);
-
             Ns_Log(Debug, "[%d] dequeue thread connPtr %p idle %d state %d create %d",
-                   ThreadNr(poolPtr, argPtr), (void *)connPtr, idle, argPtr->state, (int)create);
+                   ThreadNr(poolPtr, argPtr), (void *)connPtr,
+                   (int)NS_ATOMIC_LOAD(&poolPtr->threads.idle), argPtr->state, (int)create);
         }
 
         /*
-         * Signal the associated thread to start with this request.
+         * Hand the connection over and signal the associated thread to
+         * start with this request. The thread-specific lock is only
+         * contended, when the thread is just going idle.
          */
         Ns_MutexLock(&argPtr->lock);
+        assert(argPtr->state == connThread_idle);
+        argPtr->connPtr = connPtr;
         Ns_CondSignal(&argPtr->cond);
         Ns_MutexUnlock(&argPtr->lock);
 
@@ -810,7 +835,7 @@ NsQueueConn(Sock *sockPtr, const Ns_Time *nowPtr)
         int idle, current;
 
         Ns_MutexLock(&poolPtr->threads.lock);
-        idle = poolPtr->threads.idle;
+        idle = (int)NS_ATOMIC_LOAD(&poolPtr->threads.idle);
         current = poolPtr->threads.current;
         poolPtr->threads.current ++;
         poolPtr->threads.creating ++;
@@ -822,12 +847,196 @@ NsQueueConn(Sock *sockPtr, const Ns_Time *nowPtr)
                idle,
                current);
 
-        CreateConnThread(poolPtr);
+        CreateConnThread(poolPtr, sockPtr->drvPtr);
     }
 
     return queued;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * ConnThreadClaimIdle --
+ *
+ *      Claim an idle connection thread without locking the queue. A
+ *      thread is claimed by clearing its bit in the idle bitmap; when
+ *      this fails (another driver thread was faster, or the thread
+ *      terminated), the scan is repeated.
+ *
+ *      For drivers using "cpuaffinity", prefer a thread bound to the
+ *      shard of the driver, then an unbound thread, which is bound to the
+ *      shard of the driver from now on. Only when no such thread is idle,
+ *      a thread of a different shard is used.
+ *
+ * Results:
+ *      Claimed connection thread or NULL, when no thread is idle.
+ *
+ * Side effects:
+ *      Updates the hand-off statistics of the driver.
+ *
+ *----------------------------------------------------------------------
+ */
+static ConnThreadArg *
+ConnThreadClaimIdle(ConnPool *poolPtr, Driver *drvPtr)
+{
+    ConnThreadArg *argPtr = NULL;
+    int            nwords;
+    bool           sharded;
+
+    NS_NONNULL_ASSERT(poolPtr != NULL);
+    NS_NONNULL_ASSERT(drvPtr != NULL);
+
+    sharded = drvPtr->cpuaffinity;
+    nwords = MIN((poolPtr->threads.max + 63) / 64, poolPtr->tqueue.nidle);
+
+    for (;;) {
+        int      w, best = -1, bestRank = 3;
+        uint64_t mask;
+
+        for (w = 0; w < nwords && bestRank > 0; w++) {
+            uint64_t bits = NS_ATOMIC_LOAD(&poolPtr->tqueue.idle[w]);
+            int      b;
+
+            for (b = 0; bits != 0u; b++, bits >>= 1) {
+                if ((bits & 1u) != 0u) {
+                    const ConnThreadArg *aPtr = &poolPtr->tqueue.args[w * 64 + b];
+                    int                  rank;
+
+                    if (!sharded
+                        || aPtr->shard == drvPtr->shard) {
+                        rank = 0;
+                    } else if (aPtr->shard < 0) {
+                        rank = 1;
+                    } else {
+                        rank = 2;
+                    }
+                    if (rank < bestRank) {
+                        best = w * 64 + b;
+                        bestRank = rank;
+                        if (rank == 0) {
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+        if (best < 0) {
+            break;
+        }
+
+        mask = (uint64_t)1u << (best % 64);
+        if (((uint64_t)NS_ATOMIC_FETCH_AND(&poolPtr->tqueue.idle[best / 64], ~mask) & mask) != 0u) {
+            argPtr = &poolPtr->tqueue.args[best];
+            if (sharded) {
+                if (bestRank == 1) {
+                    argPtr->shard = drvPtr->shard;
+                }
+                if (bestRank < 2) {
+                    (void) NS_ATOMIC_FETCH_ADD(&drvPtr->stats.localhandoffs, 1);
+                } else {
+                    (void) NS_ATOMIC_FETCH_ADD(&drvPtr->stats.remotehandoffs, 1);
+                }
+            }
+            break;
+        }
+    }
+    return argPtr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ConnThreadSetIdle, ConnThreadUnsetIdle --
+ *
+ *      Add or remove the connection thread to/from the idle bitmap of the
+ *      pool.
+ *
+ * Results:
+ *      ConnThreadUnsetIdle() returns NS_FALSE, when the thread was
+ *      already claimed by NsQueueConn().
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+static void
+ConnThreadSetIdle(ConnPool *poolPtr, const ConnThreadArg *argPtr)
+{
+    int i = ThreadNr(poolPtr, argPtr);
+
+    (void) NS_ATOMIC_FETCH_OR(&poolPtr->tqueue.idle[i / 64], (uint64_t)1u << (i % 64));
+}
+
+static bool
+ConnThreadUnsetIdle(ConnPool *poolPtr, const ConnThreadArg *argPtr)
+{
+    int      i = ThreadNr(poolPtr, argPtr);
+    uint64_t mask = (uint64_t)1u << (i % 64);
+
+    return (((uint64_t)NS_ATOMIC_FETCH_AND(&poolPtr->tqueue.idle[i / 64], ~mask) & mask) != 0u);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ConnFreePop, ConnFreePush --
+ *
+ *      Pop or push a Conn structure from/to the lock-free free list of
+ *      the pool. The list is a stack over the "conns" array; the top
+ *      contains a modification count against the ABA problem, so reading
+ *      a stale nextPtr of an element popped concurrently lets only the
+ *      compare-and-swap fail.
+ *
+ * Results:
+ *      ConnFreePop() returns a Conn structure or NULL, when all Conn
+ *      structures are in use (maxconnections is reached).
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+static Conn *
+ConnFreePop(ConnPool *poolPtr)
+{
+    Conn     *connPtr;
+    uint64_t  top, newTop;
+
+    do {
+        const Conn *nextPtr;
+        uint64_t    index;
+
+        top = (uint64_t)NS_ATOMIC_LOAD(&poolPtr->wqueue.freeTop);
+        index = top & 0xffffffffu;
+        if (index == 0u) {
+            return NULL;
+        }
+        connPtr = &poolPtr->wqueue.conns[index - 1u];
+        nextPtr = connPtr->nextPtr;
+        newTop = (((top >> 32) + 1u) << 32)
+            | (nextPtr != NULL ? (uint64_t)(nextPtr - poolPtr->wqueue.conns) + 1u : 0u);
+    } while (!NS_ATOMIC_CAS(&poolPtr->wqueue.freeTop, top, newTop));
+
+    connPtr->nextPtr = NULL;
+    return connPtr;
+}
+
+static void
+ConnFreePush(ConnPool *poolPtr, Conn *connPtr)
+{
+    uint64_t top, newTop, index;
+
+    index = (uint64_t)(connPtr - poolPtr->wqueue.conns) + 1u;
+    do {
+        top = (uint64_t)NS_ATOMIC_LOAD(&poolPtr->wqueue.freeTop);
+        connPtr->nextPtr = (top & 0xffffffffu) != 0u
+            ? &poolPtr->wqueue.conns[(top & 0xffffffffu) - 1u]
+            : NULL;
+        newTop = (((top >> 32) + 1u) << 32) | index;
+    } while (!NS_ATOMIC_CAS(&poolPtr->wqueue.freeTop, top, newTop));
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -1431,15 +1640,15 @@ ServerListActive(Tcl_DString *dsPtr, ConnPool *poolPtr, bool checkforproxy)
     NS_NONNULL_ASSERT(dsPtr != NULL);
     NS_NONNULL_ASSERT(poolPtr != NULL);
 
-    Ns_MutexLock(&poolPtr->tqueue.lock);
     for (i = 0; i < poolPtr->threads.max; i++) {
-        const ConnThreadArg *argPtr = &poolPtr->tqueue.args[i];
+        ConnThreadArg *argPtr = &poolPtr->tqueue.args[i];
 
+        Ns_MutexLock(&argPtr->lock);
         if (argPtr->connPtr != NULL) {
             AppendConnList(dsPtr, argPtr->connPtr, "running", checkforproxy);
         }
+        Ns_MutexUnlock(&argPtr->lock);
     }
-    Ns_MutexUnlock(&poolPtr->tqueue.lock);
 }
 
 static void
@@ -1996,7 +2205,7 @@ NsTclServerObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_SIZE_T objc, Tc
 
     case SConnectionsIdx:
         if (Ns_ParseObjv(NULL, NULL, interp, objc-nargs, objc, objv) == NS_OK) {
-            Tcl_SetObjResult(interp, Tcl_NewLongObj((long)poolPtr->stats.processed));
+            Tcl_SetObjResult(interp, Tcl_NewWideIntObj((Tcl_WideInt)NS_ATOMIC_LOAD(&poolPtr->stats.processed)));
             result = TCL_OK;
         }
         break;
@@ -2005,8 +2214,9 @@ NsTclServerObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_SIZE_T objc, Tc
         if (Ns_ParseObjv(NULL, NULL, interp, objc-nargs, objc, objv) == NS_OK) {
             Tcl_DStringInit(dsPtr);
 
-            Ns_DStringPrintf(dsPtr, "requests %lu ", poolPtr->stats.processed);
+            Ns_DStringPrintf(dsPtr, "requests %" PRIu64 " ", (uint64_t)NS_ATOMIC_LOAD(&poolPtr->stats.processed));
             Ns_DStringPrintf(dsPtr, "spools %lu ", poolPtr->stats.spool);
+            Ns_DStringPrintf(dsPtr, "fastlane %" PRId64 " ", NS_ATOMIC_LOAD(&poolPtr->stats.fastlane));
             Ns_DStringPrintf(dsPtr, "queued %lu ", poolPtr->stats.queued);
             Ns_DStringPrintf(dsPtr, "dropped %lu ", poolPtr->stats.dropped);
             Ns_DStringPrintf(dsPtr, "sent %" TCL_LL_MODIFIER "d ", poolPtr->rate.bytesSent);
@@ -2038,7 +2248,7 @@ NsTclServerObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_SIZE_T objc, Tc
             Ns_TclPrintfResult(interp,
                                "min %d max %d current %d idle %d stopping 0",
                                poolPtr->threads.min, poolPtr->threads.max,
-                               poolPtr->threads.current, poolPtr->threads.idle);
+                               poolPtr->threads.current, (int)NS_ATOMIC_LOAD(&poolPtr->threads.idle));
             Ns_MutexUnlock(&poolPtr->threads.lock);
             result = TCL_OK;
         }
@@ -2109,11 +2319,11 @@ NsStartServer(const NsServer *servPtr)
 
     poolPtr = servPtr->pools.firstPtr;
     while (poolPtr != NULL) {
-        poolPtr->threads.idle = 0;
+        NS_ATOMIC_STORE(&poolPtr->threads.idle, 0);
         poolPtr->threads.current = poolPtr->threads.min;
         poolPtr->threads.creating = poolPtr->threads.min;
         for (n = 0; n < poolPtr->threads.min; ++n) {
-            CreateConnThread(poolPtr);
+            CreateConnThread(poolPtr, NULL);
         }
         poolPtr = poolPtr->nextPtr;
     }
@@ -2143,18 +2353,15 @@ WakeupConnThreads(ConnPool *poolPtr) {
 
     NS_NONNULL_ASSERT(poolPtr != NULL);
 
-    Ns_MutexLock(&poolPtr->tqueue.lock);
     for (i = 0; i < poolPtr->threads.max; i++) {
         ConnThreadArg *argPtr = &poolPtr->tqueue.args[i];
 
+        Ns_MutexLock(&argPtr->lock);
         if (argPtr->state == connThread_idle) {
-            assert(argPtr->connPtr == NULL);
-            Ns_MutexLock(&argPtr->lock);
             Ns_CondSignal(&argPtr->cond);
-            Ns_MutexUnlock(&argPtr->lock);
         }
+        Ns_MutexUnlock(&argPtr->lock);
     }
-    Ns_MutexUnlock(&poolPtr->tqueue.lock);
 }
 
 
@@ -2245,16 +2452,20 @@ NsWaitServer(NsServer *servPtr, const Ns_Time *toPtr)
 void
 NsConnArgProc(Tcl_DString *dsPtr, const void *arg)
 {
-    const ConnThreadArg *argPtr = arg;
-
     NS_NONNULL_ASSERT(dsPtr != NULL);
 
     if (arg != NULL) {
-        ConnPool     *poolPtr = argPtr->poolPtr;
+        const ConnThreadArg *argPtr = arg;
+        ConnThreadArg       *slotPtr;
 
-        Ns_MutexLock(&poolPtr->tqueue.lock);
-        AppendConn(dsPtr, argPtr->connPtr, "running", NS_FALSE);
-        Ns_MutexUnlock(&poolPtr->tqueue.lock);
+        /*
+         * Get a modifiable reference to the slot for locking.
+         */
+        slotPtr = &argPtr->poolPtr->tqueue.args[ThreadNr(argPtr->poolPtr, argPtr)];
+
+        Ns_MutexLock(&slotPtr->lock);
+        AppendConn(dsPtr, slotPtr->connPtr, "running", NS_FALSE);
+        Ns_MutexUnlock(&slotPtr->lock);
     } else {
         Tcl_DStringAppendElement(dsPtr, NS_EMPTY_STRING);
     }
@@ -2321,6 +2532,7 @@ NsConnThread(void *arg)
     const char    *exitMsg;
     Ns_Thread      joinThread;
     Ns_Mutex      *threadsLockPtr, *tqueueLockPtr, *wqueueLockPtr;
+    int            boundShard;
 
     NS_NONNULL_ASSERT(arg != NULL);
 
@@ -2353,6 +2565,13 @@ NsConnThread(void *arg)
 
     Ns_ThreadSelf(&joinThread);
 
+    /*
+     * Bind the thread to the CPUs of its shard. Unbound threads get the
+     * affinity of the process instead of the one of the creating thread.
+     */
+    boundShard = argPtr->shard;
+    NsDriverSetShardAffinity(boundShard, NS_FALSE);
+
     cpt     = poolPtr->threads.connsperthread;
     ncons   = cpt;
     timeout = poolPtr->threads.timeout;
@@ -2422,27 +2641,20 @@ NsConnThread(void *arg)
 
         if (argPtr->connPtr == NULL) {
             /*
-             * There is nothing urgent to do. We can add ourself to the
-             * conn thread queue.
+             * There is nothing urgent to do. We can mark ourself as idle
+             * in the conn thread queue.
              */
-            Ns_MutexLock(threadsLockPtr);
-            poolPtr->threads.idle ++;
-            Ns_MutexUnlock(threadsLockPtr);
+            (void) NS_ATOMIC_FETCH_ADD(&poolPtr->threads.idle, 1);
 
-            Ns_MutexLock(tqueueLockPtr);
-            argPtr->state = connThread_idle;
             /*
-             * We put an entry into the thread queue. However, we must
-             * take care, that signals are not sent, before this thread
-             * is waiting for it. Therefore, we lock the connection
+             * We have to take care, that signals are not sent, before this
+             * thread is waiting for it. Therefore, we lock the connection
              * thread specific lock right here, also the signal sending
              * code uses the same lock.
              */
             Ns_MutexLock(&argPtr->lock);
-
-            argPtr->nextPtr = poolPtr->tqueue.nextPtr;
-            poolPtr->tqueue.nextPtr = argPtr;
-            Ns_MutexUnlock(tqueueLockPtr);
+            argPtr->state = connThread_idle;
+            ConnThreadSetIdle(poolPtr, argPtr);
 
             while (!servPtr->pools.shutdown) {
 
@@ -2493,47 +2705,29 @@ NsConnThread(void *arg)
                 Ns_Log(Debug, "Unexpected condition after CondTimedWait; maybe shutdown?");
             }
 
-            Ns_MutexUnlock(&argPtr->lock);
-
-            assert(argPtr->state == connThread_idle);
-
-            if (argPtr->connPtr == NULL) {
+            if (argPtr->connPtr == NULL && !ConnThreadUnsetIdle(poolPtr, argPtr)) {
                 /*
-                 * We were not signaled on purpose, so we have to dequeue
-                 * the current thread.
+                 * We were not signaled, but the thread was claimed in the
+                 * meantime by NsQueueConn(), which is blocked on our lock
+                 * to hand over the connection. Wait for it.
                  */
-                ConnThreadArg *aPtr, **prevPtr;
-
-                Ns_MutexLock(tqueueLockPtr);
-                for (aPtr = poolPtr->tqueue.nextPtr, prevPtr = &poolPtr->tqueue.nextPtr;
-                     aPtr != NULL;
-                     prevPtr = &aPtr->nextPtr, aPtr = aPtr->nextPtr) {
-                    if (aPtr == argPtr) {
-                        /*
-                         * This request is for us.
-                         */
-                        *prevPtr = aPtr->nextPtr;
-                        argPtr->nextPtr = NULL;
-                        break;
-                    }
+                while (argPtr->connPtr == NULL) {
+                    Ns_CondWait(&argPtr->cond, &argPtr->lock);
                 }
-                argPtr->state = connThread_busy;
-                Ns_MutexUnlock(tqueueLockPtr);
-            } else {
-                Ns_MutexLock(tqueueLockPtr);
-                argPtr->state = connThread_busy;
-                Ns_MutexUnlock(tqueueLockPtr);
+                status = NS_OK;
             }
+            assert(argPtr->state == connThread_idle);
+            argPtr->state = connThread_busy;
+            Ns_MutexUnlock(&argPtr->lock);
 
-            Ns_MutexLock(threadsLockPtr);
-            poolPtr->threads.idle --;
-            Ns_MutexUnlock(threadsLockPtr);
+            (void) NS_ATOMIC_FETCH_ADD(&poolPtr->threads.idle, -1);
 
-            if (servPtr->pools.shutdown) {
-                exitMsg = "shutdown pending";
-                break;
-            } else if (status == NS_TIMEOUT) {
-                exitMsg = "idle thread terminates";
+            if (argPtr->connPtr == NULL) {
+                if (servPtr->pools.shutdown) {
+                    exitMsg = "shutdown pending";
+                } else {
+                    exitMsg = "idle thread terminates";
+                }
                 break;
             }
         }
@@ -2541,6 +2735,14 @@ NsConnThread(void *arg)
         connPtr = argPtr->connPtr;
         assert(connPtr != NULL);
 
+        if (unlikely(argPtr->shard != boundShard)) {
+            /*
+             * An unbound thread was adopted by a shard.
+             */
+            boundShard = argPtr->shard;
+            NsDriverSetShardAffinity(boundShard, NS_FALSE);
+        }
+
         Ns_GetTime(&connPtr->requestDequeueTime);
 
         /*
@@ -2602,7 +2804,7 @@ NsConnThread(void *arg)
          * since we are deallocating its content. This is especially important
          * for e.g. "ns_server active" since it accesses the header fields.
          */
-        Ns_MutexLock(tqueueLockPtr);
+        Ns_MutexLock(&argPtr->lock);
         connPtr->flags &= ~NS_CONN_CONFIGURED;
 
         /*
@@ -2611,12 +2813,12 @@ NsConnThread(void *arg)
         Ns_SetTrunc(connPtr->headers, 0);
 
         argPtr->state = connThread_ready;
-        Ns_MutexUnlock(tqueueLockPtr);
+        argPtr->connPtr = NULL;
+        Ns_MutexUnlock(&argPtr->lock);
 
         /*
          * Push connection to the free list.
          */
-        argPtr->connPtr = NULL;
 
         if (connPtr->prevPtr != NULL) {
             connPtr->prevPtr->nextPtr = connPtr->nextPtr;
@@ -2626,10 +2828,7 @@ NsConnThread(void *arg)
         }
         connPtr->prevPtr = NULL;
 
-        Ns_MutexLock(wqueueLockPtr);
-        connPtr->nextPtr = poolPtr->wqueue.freePtr;
-        poolPtr->wqueue.freePtr = connPtr;
-        Ns_MutexUnlock(wqueueLockPtr);
+        ConnFreePush(poolPtr, connPtr);
 
         if (cpt > 0) {
             int waiting, idle, lowwater;
@@ -2637,16 +2836,24 @@ NsConnThread(void *arg)
             --ncons;
 
             /*
-             * Get a consistent snapshot of the controlling variables.
+             * Get a consistent snapshot of the controlling variables, when
+             * there are waiting requests. Otherwise, avoid the locks; a
+             * request missed by the unlocked read is picked up from the
+             * waiting list at the begin of the next iteration.
              */
-            Ns_MutexLock(wqueueLockPtr);
-            Ns_MutexLock(threadsLockPtr);
-            waiting  = poolPtr->wqueue.wait.num;
             lowwater = poolPtr->wqueue.lowwatermark;
-            idle     = poolPtr->threads.idle;
-            current  = poolPtr->threads.current;
-            Ns_MutexUnlock(threadsLockPtr);
-            Ns_MutexUnlock(wqueueLockPtr);
+            waiting  = poolPtr->wqueue.wait.num;
+            if (waiting > 0) {
+                Ns_MutexLock(wqueueLockPtr);
+                Ns_MutexLock(threadsLockPtr);
+                waiting  = poolPtr->wqueue.wait.num;
+                current  = poolPtr->threads.current;
+                Ns_MutexUnlock(threadsLockPtr);
+                Ns_MutexUnlock(wqueueLockPtr);
+            } else {
+                current  = poolPtr->threads.current;
+            }
+            idle = (int)NS_ATOMIC_LOAD(&poolPtr->threads.idle);
 
             if (Ns_LogSeverityEnabled(Debug)) {
                 Ns_Time now, acceptTime, queueTime, filterTime, netRunTime, runTime, fullTime;
@@ -2886,6 +3093,7 @@ ConnRun(Conn *connPtr)
     servPtr = connPtr->poolPtr->servPtr;
     Ns_ConnSetCompression(conn, servPtr->compress.enable ? servPtr->compress.level : 0);
     connPtr->compress = -1;
+    connPtr->compressEncoding = NS_COMPRESS_NONE;
 
     connPtr->outputEncoding = servPtr->encoding.outputEncoding;
     connPtr->urlEncoding = servPtr->encoding.urlEncoding;
@@ -3013,7 +3221,7 @@ ConnRun(Conn *connPtr)
             NsRunTraces(conn);
         }
     } else {
-        NsAddNslogEntry(sockPtr, connPtr->responseStatus, conn, NULL);
+        NsAddNslogEntry(sockPtr, connPtr->responseStatus, conn, 0u);
 
         Ns_Log(Notice, "not running NS_FILTER_TRACE status %s http status code %d: %s",
                Ns_ReturnCodeString(status), connPtr->responseStatus, connPtr->request.url);
@@ -3055,9 +3263,14 @@ ConnRun(Conn *connPtr)
 
     (void) Ns_ConnClose(conn);
 
-    Ns_MutexLock(&connPtr->poolPtr->tqueue.lock);
-    connPtr->reqPtr = NULL;
-    Ns_MutexUnlock(&connPtr->poolPtr->tqueue.lock);
+    {
+        ConnThreadArg *argPtr = Ns_TlsGet(&argtls);
+
+        assert(argPtr != NULL);
+        Ns_MutexLock(&argPtr->lock);
+        connPtr->reqPtr = NULL;
+        Ns_MutexUnlock(&argPtr->lock);
+    }
 
     /*
      * Deactivate stream writer, if defined
@@ -3068,7 +3281,7 @@ ConnRun(Conn *connPtr)
     if (connPtr->strWriter != NULL) {
         void *wrPtr;
 
-        NsWriterLock();
+        NsWriterLock(connPtr);
         /*
          * Avoid potential race conditions, so refetch inside the lock.
          */
@@ -3077,7 +3290,7 @@ ConnRun(Conn *connPtr)
             NsWriterFinish(wrPtr);
             connPtr->strWriter = NULL;
         }
-        NsWriterUnlock();
+        NsWriterUnlock(connPtr);
     }
 
     /*
@@ -3116,7 +3329,9 @@ ConnRun(Conn *connPtr)
  *
  * CreateConnThread --
  *
- *      Create a connection thread.
+ *      Create a connection thread. When the thread is created on behalf
+ *      of a driver using "cpuaffinity", it is bound to the shard of this
+ *      driver, otherwise it is bound on first use.
  *
  * Results:
  *      None.
@@ -3128,7 +3343,7 @@ ConnRun(Conn *connPtr)
  */
 
 static void
-CreateConnThread(ConnPool *poolPtr)
+CreateConnThread(ConnPool *poolPtr, const Driver *drvPtr)
 {
     Ns_Thread      thread;
     ConnThreadArg *argPtr = NULL;
@@ -3171,7 +3386,11 @@ CreateConnThread(ConnPool *poolPtr)
 
         argPtr->poolPtr = poolPtr;
         argPtr->connPtr = NULL;
-        argPtr->nextPtr = NULL;
+        if (drvPtr != NULL && drvPtr->cpuaffinity) {
+            argPtr->shard = drvPtr->shard;
+        } else {
+            argPtr->shard = -1;
+        }
         //argPtr->cond = NULL;
 
         Ns_ThreadCreate(NsConnThread, argPtr, 0, &thread);
@@ -912,6 +912,91 @@ Ns_ParseHeader(Ns_Set *set, const char *line, const char *prefix, size_t *fieldN
     return status;
 }
 
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * NsParseRequestHeaderLine --
+ *
+ *    Variant of Ns_ParseHeader() for header lines received by the driver.
+ *    Since the driver knows already the length of the line, the field
+ *    name is validated and the colon is located in a single pass over the
+ *    name, and the value is added to the set without scanning it again.
+ *
+ *    In contrast to Ns_ParseHeader(), the field name must be a token as
+ *    defined in RFC 9110 section 5.1, immediately followed by the colon.
+ *    In particular, whitespace between the field name and the colon is
+ *    rejected (RFC 9112 section 5.1). Lines containing NUL characters are
+ *    rejected (RFC 9110 section 5.5) instead of being truncated at the
+ *    NUL. Continuation lines are handled by Ns_ParseHeader().
+ *
+ * Results:
+ *    NS_OK/NS_ERROR
+ *
+ * Side effects:
+ *    Adds a field to the provided set.
+ *
+ *----------------------------------------------------------------------
+ */
+
+Ns_ReturnCode
+NsParseRequestHeaderLine(Ns_Set *set, const char *line, size_t length)
+{
+    Ns_ReturnCode status;
+    /*
+     * tchar = "!" / "#" / "$" / "%" / "&" / "'" / "*" / "+" / "-" / "."
+     *         / "^" / "_" / "`" / "|" / "~" / DIGIT / ALPHA
+     */
+    static const bool tokenChar[256] = {
+        /*          0  1  2  3  4  5  6  7  8  9  A  B  C  D  E  F */
+        /* 0x00 */  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        /* 0x10 */  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        /* 0x20 */  0, 1, 0, 1, 1, 1, 1, 1, 0, 0, 1, 1, 0, 1, 1, 0,
+        /* 0x30 */  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0,
+        /* 0x40 */  0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        /* 0x50 */  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 1, 1,
+        /* 0x60 */  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        /* 0x70 */  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 1, 0, 1, 0
+        /* 0x80 - 0xff: 0 */
+    };
+
+    NS_NONNULL_ASSERT(set != NULL);
+    NS_NONNULL_ASSERT(line != NULL);
+
+    if (memchr(line, INTCHAR('\0'), length) != NULL) {
+        status = NS_ERROR;
+
+    } else if (length > 0u && CHARTYPE(space, *line) != 0) {
+        status = Ns_ParseHeader(set, line, NULL, NULL);
+
+    } else {
+        const unsigned char *p = (const unsigned char *)line;
+        const unsigned char *end = p + length;
+        const char          *value;
+
+        while (p < end && tokenChar[*p]) {
+            p++;
+        }
+        if ((const char *)p == line || p == end || *p != UCHAR(':')) {
+            /*
+             * Empty or invalid field name, or no colon.
+             */
+            status = NS_ERROR;
+
+        } else {
+            for (value = (const char *)p + 1;
+                 value < (const char *)end && CHARTYPE(space, *value) != 0;
+                 value++) {
+                ;
+            }
+            (void) Ns_SetPutSz(set, line, (TCL_SIZE_T)((const char *)p - line),
+                               value, (TCL_SIZE_T)((const char *)end - value));
+            status = NS_OK;
+        }
+    }
+    return status;
+}
+
 
 /*
  *----------------------------------------------------------------------
@@ -1282,11 +1367,11 @@ CompressAllow(double compressQvalue, double identityQvalue, double starQvalue)
  *
  * NsParseAcceptEncoding --
  *
- *      Parse the accept-encoding line and return whether gzip
- *      encoding is accepted or not.
+ *      Parse the accept-encoding line and return whether gzip, brotli
+ *      and zstd encodings are accepted or not.
  *
  * Results:
- *      The result is passed back in the last two arguments.
+ *      The result is passed back in the last three arguments.
  *
  * Side effects:
  *      None.
@@ -1294,25 +1379,29 @@ CompressAllow(double compressQvalue, double identityQvalue, double starQvalue)
  *----------------------------------------------------------------------
  */
 void
-NsParseAcceptEncoding(double version, const char *hdr, bool *gzipAcceptPtr, bool *brotliAcceptPtr)
+NsParseAcceptEncoding(double version, const char *hdr,
+                      bool *gzipAcceptPtr, bool *brotliAcceptPtr, bool *zstdAcceptPtr)
 {
-    double      gzipQvalue = -1.0, brotliQvalue = -1, starQvalue = -1.0, identityQvalue = -1.0;
-    bool        gzipAccept, brotliAccept;
-    const char *gzipFormat, *brotliFormat, *starFormat;
+    double      gzipQvalue = -1.0, brotliQvalue = -1, zstdQvalue = -1.0, starQvalue = -1.0, identityQvalue = -1.0;
+    bool        gzipAccept, brotliAccept, zstdAccept;
+    const char *gzipFormat, *brotliFormat, *zstdFormat, *starFormat;
 
     NS_NONNULL_ASSERT(hdr != NULL);
     NS_NONNULL_ASSERT(gzipAcceptPtr != NULL);
     NS_NONNULL_ASSERT(brotliAcceptPtr != NULL);
+    NS_NONNULL_ASSERT(zstdAcceptPtr != NULL);
 
     gzipFormat    = GetEncodingFormat(hdr, "gzip", 4u, &gzipQvalue);
     brotliFormat  = GetEncodingFormat(hdr, "br", 2u, &brotliQvalue);
+    zstdFormat    = GetEncodingFormat(hdr, "zstd", 4u, &zstdQvalue);
     starFormat    = GetEncodingFormat(hdr, "*", 1u, &starQvalue);
     (void)GetEncodingFormat(hdr, "identity", 8u, &identityQvalue);
 
     //fprintf(stderr, "hdr line <%s> gzipFormat <%s> brotliFormat <%s>\n", hdr, gzipFormat, brotliFormat);
-    if ((gzipFormat != NULL) || (brotliFormat != NULL)) {
+    if ((gzipFormat != NULL) || (brotliFormat != NULL) || (zstdFormat != NULL)) {
         gzipAccept   = CompressAllow(gzipQvalue, identityQvalue, starQvalue);
         brotliAccept = CompressAllow(brotliQvalue, identityQvalue, starQvalue);
+        zstdAccept   = CompressAllow(zstdQvalue, identityQvalue, starQvalue);
     } else if (starFormat != NULL) {
         /*
          * No compress format was specified, star matches everything, so as
@@ -1337,15 +1426,18 @@ NsParseAcceptEncoding(double version, const char *hdr, bool *gzipAcceptPtr, bool
             gzipAccept = (version >= 1.1);
         }
         /*
-         * The implicit rules are the same for gzip and brotli.
+         * The implicit rules are the same for all compression formats.
          */
         brotliAccept = gzipAccept;
+        zstdAccept = gzipAccept;
     } else {
         gzipAccept   = NS_FALSE;
         brotliAccept = NS_FALSE;
+        zstdAccept   = NS_FALSE;
     }
     *gzipAcceptPtr   = gzipAccept;
     *brotliAcceptPtr = brotliAccept;
+    *zstdAcceptPtr   = zstdAccept;
 }
 
 
@@ -428,6 +428,43 @@ NsInitServer(const char *server, Ns_ServerInitProc *initProc)
     servPtr->compress.level = Ns_ConfigIntRange(section, "compresslevel", 4, 1, 9);
     servPtr->compress.minsize = (int)Ns_ConfigMemUnitRange(section, "compressminsize", NULL, 512, 0, INT_MAX);
     servPtr->compress.preinit = Ns_ConfigBool(section, "compresspreinit", NS_FALSE);
+    servPtr->compress.brotliLevel = Ns_ConfigIntRange(section, "compressbrotlilevel", 5, 1, 11);
+    servPtr->compress.zstdLevel = Ns_ConfigIntRange(section, "compresszstdlevel", 3, 1, 19);
+    {
+        const char  *formats = Ns_ConfigString(section, "compressformats", "gzip");
+        const char **argv;
+        TCL_SIZE_T   argc;
+
+        /*
+         * Content-encodings for on-the-fly compression in order of the
+         * server's preference. Encodings not built in are skipped.
+         */
+        servPtr->compress.nrFormats = 0;
+        if (Tcl_SplitList(NULL, formats, &argc, &argv) == TCL_OK) {
+            for (TCL_SIZE_T i = 0; i < argc; i++) {
+                Ns_CompressEncoding encoding;
+                int                 j;
+
+                if (NsCompressEncodingFromName(argv[i], &encoding) != NS_OK) {
+                    Ns_Log(Warning, "init server %s: compressformats: ignore unknown or unsupported"
+                           " content-encoding '%s'", server, argv[i]);
+                    continue;
+                }
+                for (j = 0; j < servPtr->compress.nrFormats; j++) {
+                    if (servPtr->compress.formats[j] == encoding) {
+                        break;
+                    }
+                }
+                if (j == servPtr->compress.nrFormats
+                    && j < Ns_NrElements(servPtr->compress.formats)) {
+                    servPtr->compress.formats[servPtr->compress.nrFormats++] = encoding;
+                }
+            }
+            Tcl_Free((char *)argv);
+        } else {
+            Ns_Log(Error, "init server %s: compressformats is not a list: %s", server, formats);
+        }
+    }
 
     /*
      * Run the library init procs in the order they were registered.
@@ -659,7 +696,8 @@ CreatePool(NsServer *servPtr, const char *pool)
     }
 
     connBufPtr[n].nextPtr = NULL;
-    poolPtr->wqueue.freePtr = &connBufPtr[0];
+    poolPtr->wqueue.conns = connBufPtr;
+    poolPtr->wqueue.freeTop = 1u;
 
     queueLength = maxconns - poolPtr->threads.max;
 
@@ -679,6 +717,8 @@ CreatePool(NsServer *servPtr, const char *pool)
      * sufficient.
      */
     poolPtr->tqueue.args = ns_calloc((size_t)maxconns, sizeof(ConnThreadArg));
+    poolPtr->tqueue.nidle = (maxconns + 63) / 64;
+    poolPtr->tqueue.idle = ns_calloc((size_t)poolPtr->tqueue.nidle, sizeof(uint64_t));
 
     Ns_DListInit(&(poolPtr->rate.writerRates));
 
@@ -37,9 +37,9 @@ typedef struct TclCache {
 
 static int CacheAppendObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_SIZE_T objc, Tcl_Obj *const* objv, bool append);
 
-static Ns_Entry *CreateEntry(const NsInterp *itPtr, TclCache *cPtr, const char *key,
+static Ns_Entry *CreateEntry(const NsInterp *itPtr, TclCache *cPtr, Ns_Cache *cache, const char *key,
                              int *newPtr, Ns_Time *timeoutPtr, const Ns_CacheTransactionStack *transactionStackPtr)
-    NS_GNUC_NONNULL(1,2,3,4);
+    NS_GNUC_NONNULL(1,2,3,4,5);
 
 static void SetEntry(NsInterp *itPtr, TclCache *cPtr, Ns_Entry *entry, Tcl_Obj *valObj, Ns_Time *expPtr, int cost)
     NS_GNUC_NONNULL(1,2,3,4);
@@ -47,7 +47,8 @@ static void SetEntry(NsInterp *itPtr, TclCache *cPtr, Ns_Entry *entry, Tcl_Obj *
 static bool noGlobChars(const char *pattern)
     NS_GNUC_NONNULL(1) NS_GNUC_PURE;
 
-static TclCache *TclCacheCreate(const char *name, size_t maxEntry, size_t maxSize,
+static TclCache *TclCacheCreate(const char *name, size_t maxEntry, size_t maxSize, int nsegments,
+                                Ns_CacheAdmission admission, Ns_CacheEviction eviction,
                                 const Ns_Time *timeoutPtr, const Ns_Time *expPtr)
     NS_GNUC_NONNULL(1) NS_GNUC_RETURNS_NONNULL;
 
@@ -67,6 +68,16 @@ CacheTransactionFinishPop(NsInterp *itPtr, Tcl_Obj *listObj, bool commit, unsign
 
 static int CacheEval(Tcl_Interp *interp, TCL_SIZE_T nargs, TCL_SIZE_T objc, Tcl_Obj *const* objv);
 
+static bool CacheEvalStale(NsInterp *itPtr, TclCache *cPtr, const char *key,
+                           const Ns_Time *stalePtr, double refreshAhead, Ns_Time *expPtr,
+                           TCL_SIZE_T nargs, TCL_SIZE_T objc, Tcl_Obj *const* objv, int *statusPtr)
+    NS_GNUC_NONNULL(1,2,3,9,10);
+
+static void QueueRefresh(const NsInterp *itPtr, const TclCache *cPtr, Ns_Cache *cache, const char *key,
+                         const Ns_Time *expPtr,
+                         TCL_SIZE_T nargs, TCL_SIZE_T objc, Tcl_Obj *const* objv)
+    NS_GNUC_NONNULL(1,2,3,4,8);
+
 static Ns_ObjvProc ObjvCache;
 
 
@@ -123,7 +134,10 @@ GetCacheNames(NsServer *servPtr, bool withUncommittedEntries) {
  *
  * TclCacheCreate --
  *
- *      Create a new Tcl cache.
+ *      Create a new Tcl cache. When "nsegments" is larger than 1, the
+ *      cache is segmented. The "admission" policy determines, whether new
+ *      entries are admitted when eviction is required, the "eviction"
+ *      policy, which entries are evicted.
  *
  * Results:
  *      TclCache *
@@ -135,7 +149,8 @@ GetCacheNames(NsServer *servPtr, bool withUncommittedEntries) {
  */
 
 static TclCache *
-TclCacheCreate(const char *name, size_t maxEntry, size_t maxSize,
+TclCacheCreate(const char *name, size_t maxEntry, size_t maxSize, int nsegments,
+               Ns_CacheAdmission admission, Ns_CacheEviction eviction,
                const Ns_Time *timeoutPtr, const Ns_Time *expPtr)
 {
     TclCache *cPtr;
@@ -143,7 +158,13 @@ TclCacheCreate(const char *name, size_t maxEntry, size_t maxSize,
     NS_NONNULL_ASSERT(name != NULL);
 
     cPtr = ns_calloc(1u, sizeof(TclCache));
-    cPtr->cache = Ns_CacheCreateSz(name, TCL_STRING_KEYS, maxSize, ns_free);
+    cPtr->cache = Ns_CacheCreateSegmented(name, TCL_STRING_KEYS, maxSize, ns_free, nsegments);
+    if (admission != NS_CACHE_ADMIT_ALL) {
+        Ns_CacheSetAdmission(cPtr->cache, admission);
+    }
+    if (eviction != NS_CACHE_EVICT_LRU) {
+        Ns_CacheSetEviction(cPtr->cache, eviction);
+    }
     cPtr->maxEntry = maxEntry;
     cPtr->maxSize  = maxSize;
     if (timeoutPtr != NULL) {
@@ -177,15 +198,30 @@ int
 NsTclCacheCreateObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_SIZE_T objc, Tcl_Obj *const* objv)
 {
     char        *name = NULL;
-    int         result = TCL_OK;
+    int         result = TCL_OK, nsegments = 1, admission = (int)NS_CACHE_ADMIT_ALL,
+                eviction = (int)NS_CACHE_EVICT_LRU;
     Tcl_WideInt maxSize = 0, maxEntry = 0;
     Ns_Time    *timeoutPtr = NULL, *expPtr = NULL;
+    Ns_ObjvValueRange segmentsRange = {1, NS_CACHE_MAX_SEGMENTS};
+    static Ns_ObjvTable admissionTable[] = {
+        {"all",     (unsigned int)NS_CACHE_ADMIT_ALL},
+        {"tinylfu", (unsigned int)NS_CACHE_ADMIT_TINYLFU},
+        {NULL,      0u}
+    };
+    static Ns_ObjvTable evictionTable[] = {
+        {"lru",     (unsigned int)NS_CACHE_EVICT_LRU},
+        {"cost",    (unsigned int)NS_CACHE_EVICT_COST},
+        {NULL,      0u}
+    };
 
     Ns_ObjvSpec opts[] = {
-        {"-timeout",  Ns_ObjvTime,    &timeoutPtr, NULL},
-        {"-expires",  Ns_ObjvTime,    &expPtr,     NULL},
-        {"-maxentry", Ns_ObjvMemUnit, &maxEntry,   NULL},
-        {"--",        Ns_ObjvBreak,   NULL,        NULL},
+        {"-timeout",   Ns_ObjvTime,    &timeoutPtr, NULL},
+        {"-expires",   Ns_ObjvTime,    &expPtr,     NULL},
+        {"-maxentry",  Ns_ObjvMemUnit, &maxEntry,   NULL},
+        {"-segments",  Ns_ObjvInt,     &nsegments,  &segmentsRange},
+        {"-admission", Ns_ObjvIndex,   &admission,  admissionTable},
+        {"-eviction",  Ns_ObjvIndex,   &eviction,   evictionTable},
+        {"--",         Ns_ObjvBreak,   NULL,        NULL},
         {NULL, NULL,  NULL, NULL}
     };
     Ns_ObjvSpec args[] = {
@@ -209,7 +245,9 @@ NsTclCacheCreateObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_SIZE_T obj
         Ns_RWLockWrLock(&servPtr->tcl.cachelock);
         hPtr = Tcl_CreateHashEntry(&servPtr->tcl.caches, name, &isNew);
         if (isNew != 0) {
-            TclCache *cPtr = TclCacheCreate(name, (size_t)maxEntry, (size_t)maxSize, timeoutPtr, expPtr);
+            TclCache *cPtr = TclCacheCreate(name, (size_t)maxEntry, (size_t)maxSize, nsegments,
+                                            (Ns_CacheAdmission)admission,
+                                            (Ns_CacheEviction)eviction, timeoutPtr, expPtr);
             Tcl_SetHashValue(hPtr, cPtr);
         }
         Ns_RWLockUnlock(&servPtr->tcl.cachelock);
@@ -450,6 +488,12 @@ CacheEval(Tcl_Interp *interp, TCL_SIZE_T nargs, TCL_SIZE_T objc, Tcl_Obj *const*
  *
  *      The -force switch causes an existing valid entry to replaced.
  *
+ *      With -stale, expired entries are served for the specified time
+ *      after expiry, while the value is recomputed by a background job;
+ *      with -refresh-ahead, the background recompute is started already
+ *      when the remaining lifetime of an entry drops below the specified
+ *      fraction of its expiry time.
+ *
  * Results:
  *      Tcl result.
  *
@@ -464,15 +508,18 @@ NsTclCacheEvalObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_SIZE_T objc,
 {
     TclCache   *cPtr = NULL;
     char       *key = NULL;
-    Ns_Time    *timeoutPtr = NULL, *expPtr = NULL;
+    Ns_Time    *timeoutPtr = NULL, *expPtr = NULL, *stalePtr = NULL;
     int         force = (int)NS_FALSE, status;
+    double      refreshAhead = 0.0;
     TCL_SIZE_T  nargs = 0;
 
     Ns_ObjvSpec opts[] = {
-        {"-timeout", Ns_ObjvTime,  &timeoutPtr, NULL},
-        {"-expires", Ns_ObjvTime,  &expPtr,     NULL},
-        {"-force",   Ns_ObjvBool,  &force,      INT2PTR(NS_TRUE)},
-        {"--",       Ns_ObjvBreak, NULL,        NULL},
+        {"-timeout",       Ns_ObjvTime,   &timeoutPtr,   NULL},
+        {"-expires",       Ns_ObjvTime,   &expPtr,       NULL},
+        {"-stale",         Ns_ObjvTime,   &stalePtr,     NULL},
+        {"-refresh-ahead", Ns_ObjvDouble, &refreshAhead, NULL},
+        {"-force",         Ns_ObjvBool,   &force,        INT2PTR(NS_TRUE)},
+        {"--",             Ns_ObjvBreak,  NULL,          NULL},
         {NULL, NULL, NULL, NULL}
     };
     Ns_ObjvSpec args[] = {
@@ -485,12 +532,27 @@ NsTclCacheEvalObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_SIZE_T objc,
     if (Ns_ParseObjv(opts, args, interp, 1, objc, objv) != NS_OK) {
         status = TCL_ERROR;
 
+    } else if (refreshAhead < 0.0 || refreshAhead > 1.0) {
+        Ns_TclPrintfResult(interp, "value for -refresh-ahead must be between 0.0 and 1.0");
+        status = TCL_ERROR;
+
     } else if (unlikely(nsconf.nocache == NS_TRUE)) {
         /*Ns_Log(Notice, "nocache: %s %d", Tcl_GetString(objv[objc-nargs]), nargs);*/
         status = CacheEval(interp, nargs, objc, objv);
 
+    } else if ((stalePtr != NULL || refreshAhead > 0.0)
+               && force == (int)NS_FALSE
+               && ((NsInterp *)clientData)->cacheTransactionStack.depth == 0
+               && CacheEvalStale(clientData, cPtr, key,
+                                 stalePtr, refreshAhead, expPtr,
+                                 nargs, objc, objv, &status)) {
+        /*
+         * The request was handled stale-while-revalidate.
+         */
+
     } else {
         Ns_Entry                 *entry;
+        Ns_Cache                 *cache;
         NsInterp                 *itPtr;
         const Ns_CacheTransactionStack *transactionStackPtr;
         int                       isNew;
@@ -501,6 +563,7 @@ NsTclCacheEvalObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_SIZE_T objc,
 
         itPtr = clientData;
         transactionStackPtr = &itPtr->cacheTransactionStack;
+        cache = Ns_CacheSegment(cPtr->cache, key);
 
         /*
          * CreateEntry waits for ongoing transactions. If it succeeds, it
@@ -508,7 +571,7 @@ NsTclCacheEvalObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_SIZE_T objc,
          * provided cache value (isNew == 0) ... which might be from the
          * current transaction.
          */
-        entry = CreateEntry(itPtr, cPtr, key, &isNew, timeoutPtr, transactionStackPtr);
+        entry = CreateEntry(itPtr, cPtr, cache, key, &isNew, timeoutPtr, transactionStackPtr);
 
         if (unlikely(entry == NULL)) {
             status = TCL_ERROR;
@@ -520,7 +583,7 @@ NsTclCacheEvalObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_SIZE_T objc,
             /*
              * We have a value for the cache entry, return it.
              */
-            Ns_CacheUnlock(cPtr->cache);
+            Ns_CacheUnlock(cache);
             Tcl_SetObjResult(interp, resultObj);
             status = TCL_OK;
 
@@ -540,7 +603,7 @@ NsTclCacheEvalObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_SIZE_T objc,
             /*
              * Evaluate the cmd to obtain the cache value.
              */
-            Ns_CacheUnlock(cPtr->cache);
+            Ns_CacheUnlock(cache);
 
             Ns_GetTime(&start);
             status = CacheEval(interp, nargs, objc, objv);
@@ -548,7 +611,7 @@ NsTclCacheEvalObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_SIZE_T objc,
 
             (void)Ns_DiffTime(&end, &start, &diff);
 
-            Ns_CacheLock(cPtr->cache);
+            Ns_CacheLock(cache);
             {
                 /*
                  * This is just a sanity check, hopefully transitional code.
@@ -556,7 +619,7 @@ NsTclCacheEvalObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_SIZE_T objc,
                 Ns_Entry *entry2;
                 int isNew2 = 0;
 
-                entry2 = Ns_CacheCreateEntry(cPtr->cache, key, &isNew2);
+                entry2 = Ns_CacheLookupCreateEntry(cache, key, &isNew2);
                 if (isNew2 != 0) {
                     Ns_Log(Warning, "==== cache %s key %s old entry %p"
                            " different from re-fetched entry %p",
@@ -598,14 +661,232 @@ NsTclCacheEvalObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_SIZE_T objc,
                 SetEntry(itPtr, cPtr, entry, resultObj, expPtr,
                          (int)(diff.sec * 1000000 + diff.usec));
             }
-            Ns_CacheBroadcast(cPtr->cache);
-            Ns_CacheUnlock(cPtr->cache);
+            Ns_CacheBroadcast(cache);
+            Ns_CacheUnlock(cache);
         }
     }
     return status;
 }
 
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * CacheEvalStale --
+ *
+ *      Helper function for NsTclCacheEvalObjCmd implementing
+ *      stale-while-revalidate. An entry which is valid or expired not
+ *      longer than the stale time ago is returned immediately. When it is
+ *      expired or expires soon (refresh-ahead), exactly one background
+ *      job is queued to recompute the value.
+ *
+ * Results:
+ *      NS_TRUE, when the request was handled, the Tcl result code is
+ *      returned in "statusPtr". NS_FALSE, when no usable entry exists,
+ *      such that the value has to be computed in the foreground.
+ *
+ * Side effects:
+ *      Might queue a detached ns_job.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static bool
+CacheEvalStale(NsInterp *itPtr, TclCache *cPtr, const char *key,
+               const Ns_Time *stalePtr, double refreshAhead, Ns_Time *expPtr,
+               TCL_SIZE_T nargs, TCL_SIZE_T objc, Tcl_Obj *const* objv, int *statusPtr)
+{
+    Ns_Cache      *cache;
+    Tcl_Interp    *interp;
+    Ns_Entry      *entry;
+    bool           handled = NS_FALSE, refresh;
+    Ns_Time        refreshTime;
+    const Ns_Time *ttlPtr, *refreshTimePtr = NULL;
+
+    NS_NONNULL_ASSERT(itPtr != NULL);
+    NS_NONNULL_ASSERT(cPtr != NULL);
+    NS_NONNULL_ASSERT(key != NULL);
+    NS_NONNULL_ASSERT(statusPtr != NULL);
+
+    interp = itPtr->interp;
+    cache = Ns_CacheSegment(cPtr->cache, key);
+
+    /*
+     * Refresh-ahead is relative to the lifetime of the entry, which is
+     * only known for relative expiry times.
+     */
+    ttlPtr = (expPtr != NULL) ? expPtr : &cPtr->expires;
+    if (refreshAhead > 0.0
+        && (ttlPtr->sec > 0 || ttlPtr->usec > 0)
+        && ttlPtr->sec < 1000000000) {
+        double secs = ((double)ttlPtr->sec + (double)ttlPtr->usec / 1000000.0) * refreshAhead;
+
+        refreshTime.sec = (time_t)secs;
+        refreshTime.usec = (long)((secs - (double)refreshTime.sec) * 1000000.0);
+        refreshTimePtr = &refreshTime;
+    }
+
+    Ns_CacheLock(cache);
+    entry = Ns_CacheFindEntryStale(cache, key, stalePtr, refreshTimePtr, &refresh);
+    if (entry != NULL) {
+        Tcl_SetObjResult(interp, Tcl_NewStringObj(Ns_CacheGetValue(entry),
+                                                  (TCL_SIZE_T)Ns_CacheGetSize(entry)));
+        if (refresh) {
+            QueueRefresh(itPtr, cPtr, cache, key, expPtr, nargs, objc, objv);
+        }
+        *statusPtr = TCL_OK;
+        handled = NS_TRUE;
+    }
+    Ns_CacheUnlock(cache);
+
+    return handled;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * NsTclCacheRefreshObjCmd --
+ *
+ *      Implements the internal command "_ns_cache_refresh", which is
+ *      evaluated by the background jobs queued by QueueRefresh(). The
+ *      value is recomputed without removing the current value first,
+ *      such that concurrent stale readers are not blocked during the
+ *      recompute. When the recompute fails, the failure is logged and
+ *      the entry is removed, such that the next request recomputes the
+ *      value in the foreground and receives the error.
+ *
+ * Results:
+ *      Tcl result.
+ *
+ * Side effects:
+ *      Updates or removes the cache entry.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+NsTclCacheRefreshObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_SIZE_T objc, Tcl_Obj *const* objv)
+{
+    TclCache   *cPtr = NULL;
+    char       *key = NULL;
+    Ns_Time    *expPtr = NULL;
+    int         status;
+    TCL_SIZE_T  nargs = 0;
+
+    Ns_ObjvSpec opts[] = {
+        {"-expires", Ns_ObjvTime,  &expPtr, NULL},
+        {"--",       Ns_ObjvBreak, NULL,    NULL},
+        {NULL, NULL, NULL, NULL}
+    };
+    Ns_ObjvSpec args[] = {
+        {"cache",    ObjvCache,     &cPtr,   clientData},
+        {"key",      Ns_ObjvString, &key,    NULL},
+        {"arg",      Ns_ObjvArgs,   &nargs,  NULL},
+        {NULL, NULL, NULL, NULL}
+    };
+
+    if (Ns_ParseObjv(opts, args, interp, 1, objc, objv) != NS_OK) {
+        status = TCL_ERROR;
+
+    } else {
+        Ns_Cache *cache;
+        Ns_Entry *entry;
+        Ns_Time   start, end, diff;
+        int       isNew;
+
+        cache = Ns_CacheSegment(cPtr->cache, key);
+
+        Ns_GetTime(&start);
+        status = CacheEval(interp, nargs, objc, objv);
+        Ns_GetTime(&end);
+        (void)Ns_DiffTime(&end, &start, &diff);
+
+        Ns_CacheLock(cache);
+        if (status != TCL_OK) {
+            /*
+             * Don't keep serving a value, which can't be recomputed.
+             */
+            if (status == TCL_ERROR) {
+                Ns_Log(Warning, "ns_cache %s key '%s': background refresh failed: %s",
+                       Ns_CacheName(cPtr->cache), key, Tcl_GetString(Tcl_GetObjResult(interp)));
+            }
+            entry = Ns_CacheLookupEntryT(cache, key, NULL);
+            if (entry != NULL) {
+                Ns_CacheDeleteEntry(entry);
+            }
+        } else {
+            entry = Ns_CacheLookupCreateEntry(cache, key, &isNew);
+            SetEntry(clientData, cPtr, entry, Tcl_GetObjResult(interp), expPtr,
+                     (int)(diff.sec * 1000000 + diff.usec));
+        }
+        Ns_CacheBroadcast(cache);
+        Ns_CacheUnlock(cache);
+    }
+
+    return status;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * QueueRefresh --
+ *
+ *      Queue a detached job in the "ns:cache_refresh" job queue, which
+ *      recomputes the value of the cache entry via the internal command
+ *      "_ns_cache_refresh". Must be called with the cache
+ *      locked. The job runs in a different interpreter, so the script
+ *      must be self-contained (no local variables or connection state
+ *      of the requesting interpreter).
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      When the job cannot be queued, the refreshing state of the entry
+ *      is reset.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+QueueRefresh(const NsInterp *itPtr, const TclCache *cPtr, Ns_Cache *cache, const char *key,
+             const Ns_Time *expPtr,
+             TCL_SIZE_T nargs, TCL_SIZE_T objc, Tcl_Obj *const* objv)
+{
+    Tcl_Obj       *listObj;
+    TCL_SIZE_T     i;
+
+    NS_NONNULL_ASSERT(itPtr != NULL);
+    NS_NONNULL_ASSERT(cPtr != NULL);
+    NS_NONNULL_ASSERT(cache != NULL);
+    NS_NONNULL_ASSERT(key != NULL);
+
+    listObj = Tcl_NewListObj(0, NULL);
+    Tcl_IncrRefCount(listObj);
+    Tcl_ListObjAppendElement(NULL, listObj, Tcl_NewStringObj("_ns_cache_refresh", 17));
+    if (expPtr != NULL) {
+        Tcl_ListObjAppendElement(NULL, listObj, Tcl_NewStringObj("-expires", 8));
+        Tcl_ListObjAppendElement(NULL, listObj, Ns_TclNewTimeObj(expPtr));
+    }
+    Tcl_ListObjAppendElement(NULL, listObj, Tcl_NewStringObj("--", 2));
+    Tcl_ListObjAppendElement(NULL, listObj, Tcl_NewStringObj(Ns_CacheName(cPtr->cache), TCL_INDEX_NONE));
+    Tcl_ListObjAppendElement(NULL, listObj, Tcl_NewStringObj(key, TCL_INDEX_NONE));
+    for (i = objc - nargs; i < objc; i++) {
+        Tcl_ListObjAppendElement(NULL, listObj, objv[i]);
+    }
+
+    if (NsJobQueueDetached(itPtr->servPtr, "ns:cache_refresh", "background refresh of cache entries",
+                           Tcl_GetString(listObj)) != NS_OK) {
+        Ns_Log(Warning, "ns_cache %s key '%s': cannot queue background refresh",
+               Ns_CacheName(cPtr->cache), key);
+        Ns_CacheRefreshDone(cache, key);
+    }
+    Tcl_DecrRefCount(listObj);
+}
+
+
 /*
  *----------------------------------------------------------------------
  *
@@ -652,21 +933,22 @@ NsTclCacheIncrObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_SIZE_T objc,
         result = TCL_ERROR;
     } else {
         const Ns_CacheTransactionStack *transactionStackPtr = &itPtr->cacheTransactionStack;
-        Ns_Entry   *entry = CreateEntry(itPtr, cPtr, key, &isNew, timeoutPtr, transactionStackPtr);
+        Ns_Cache   *cache = Ns_CacheSegment(cPtr->cache, key);
+        Ns_Entry   *entry = CreateEntry(itPtr, cPtr, cache, key, &isNew, timeoutPtr, transactionStackPtr);
         int         cur = 0;
 
         if (entry == NULL) {
             result = TCL_ERROR;
         } else if ((isNew == 0)
                    && (Tcl_GetInt(interp, Ns_CacheGetValueT(entry, transactionStackPtr), &cur) != TCL_OK)) {
-            Ns_CacheUnlock(cPtr->cache);
+            Ns_CacheUnlock(cache);
             result = TCL_ERROR;
         } else {
             Tcl_Obj *valObj = Tcl_NewIntObj(cur + incr);
 
             SetEntry(itPtr, cPtr, entry, valObj, expPtr, 0);
             Tcl_SetObjResult(interp, valObj);
-            Ns_CacheUnlock(cPtr->cache);
+            Ns_CacheUnlock(cache);
             result = TCL_OK;
         }
     }
@@ -734,12 +1016,14 @@ CacheAppendObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_SIZE_T objc, Tc
     } else {
         int                             isNew;
         Ns_Entry                       *entry;
+        Ns_Cache                       *cache;
         const Ns_CacheTransactionStack *transactionStackPtr = &itPtr->cacheTransactionStack;
 
         assert(cPtr != NULL);
         assert(key != NULL);
 
-        entry = CreateEntry(itPtr, cPtr, key, &isNew, timeoutPtr, transactionStackPtr);
+        cache = Ns_CacheSegment(cPtr->cache, key);
+        entry = CreateEntry(itPtr, cPtr, cache, key, &isNew, timeoutPtr, transactionStackPtr);
         if (entry == NULL) {
             result = TCL_ERROR;
         } else {
@@ -762,7 +1046,7 @@ CacheAppendObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_SIZE_T objc, Tc
                 SetEntry(itPtr, cPtr, entry, valObj, expPtr, 0);
                 Tcl_SetObjResult(interp, valObj);
             }
-            Ns_CacheUnlock(cPtr->cache);
+            Ns_CacheUnlock(cache);
         }
     }
     return result;
@@ -865,6 +1149,7 @@ NsTclCacheKeysObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_SIZE_T objc,
 
     } else if (pattern != NULL && (exact != 0 || noGlobChars(pattern))) {
         Tcl_Obj  *listObj = Tcl_NewListObj(0, NULL);
+        Ns_Cache *cache;
 
         /*
          * If the provided pattern (key) contains no glob characters,
@@ -873,12 +1158,13 @@ NsTclCacheKeysObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_SIZE_T objc,
          * lookup is sufficient.
          */
         assert(cPtr != NULL);
-        Ns_CacheLock(cPtr->cache);
-        entry = Ns_CacheFindEntryT(cPtr->cache, pattern, transactionStackPtr);
+        cache = Ns_CacheSegment(cPtr->cache, pattern);
+        Ns_CacheLock(cache);
+        entry = Ns_CacheLookupEntryT(cache, pattern, transactionStackPtr);
         if (entry != NULL && Ns_CacheGetValueT(entry, transactionStackPtr) != NULL) {
             Tcl_ListObjAppendElement(interp, listObj, Tcl_NewStringObj(pattern, TCL_INDEX_NONE));
         }
-        Ns_CacheUnlock(cPtr->cache);
+        Ns_CacheUnlock(cache);
         Tcl_SetObjResult(interp, listObj);
 
     } else {
@@ -991,7 +1277,7 @@ NsTclCacheFlushObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_SIZE_T objc
              */
 
             for (i = npatterns; i > 0; i--) {
-                entry = Ns_CacheFindEntryT(cache, Tcl_GetString(objv[(TCL_SIZE_T)objc-i]), transactionStackPtr);
+                entry = Ns_CacheLookupEntryT(cache, Tcl_GetString(objv[(TCL_SIZE_T)objc-i]), transactionStackPtr);
                 if (entry != NULL && Ns_CacheGetValueT(entry, transactionStackPtr) != NULL) {
                     Ns_CacheFlushEntry(entry);
                     nflushed++;
@@ -1066,14 +1352,16 @@ NsTclCacheGetObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_SIZE_T objc,
 
     } else {
         const Ns_Entry  *entry;
+        Ns_Cache        *cache;
         Tcl_Obj         *resultObj;
         const NsInterp  *itPtr = clientData;
         const Ns_CacheTransactionStack *transactionStackPtr = &itPtr->cacheTransactionStack;
 
         assert(cPtr != NULL);
 
-        Ns_CacheLock(cPtr->cache);
-        entry = Ns_CacheFindEntryT(cPtr->cache, key, transactionStackPtr);
+        cache = Ns_CacheSegment(cPtr->cache, key);
+        Ns_CacheLock(cache);
+        entry = Ns_CacheFindEntryT(cache, key, transactionStackPtr);
         if (entry != NULL) {
             void  *value = Ns_CacheGetValueT(entry, transactionStackPtr);
 
@@ -1085,7 +1373,7 @@ NsTclCacheGetObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_SIZE_T objc,
         } else {
             resultObj = NULL;
         }
-        Ns_CacheUnlock(cPtr->cache);
+        Ns_CacheUnlock(cache);
 
         if (unlikely(varNameObj != NULL)) {
             Tcl_SetObjResult(interp, Tcl_NewBooleanObj(resultObj != NULL));
@@ -1207,7 +1495,8 @@ NsTclCacheStatsObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_SIZE_T objc
  *
  *      Lock the cache and create a new entry or return existing entry,
  *      waiting up to timeout seconds for another thread to complete
- *      an update.
+ *      an update. The provided cache is the segment of the Tcl cache
+ *      responsible for the key.
  *
  * Results:
  *      Pointer to entry, or NULL on timeout.
@@ -1219,20 +1508,18 @@ NsTclCacheStatsObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_SIZE_T objc
  */
 
 static Ns_Entry *
-CreateEntry(const NsInterp *itPtr, TclCache *cPtr, const char *key, int *newPtr,
+CreateEntry(const NsInterp *itPtr, TclCache *cPtr, Ns_Cache *cache, const char *key, int *newPtr,
             Ns_Time *timeoutPtr, const Ns_CacheTransactionStack *transactionStackPtr)
 {
-    Ns_Cache *cache;
     Ns_Entry *entry;
     Ns_Time   t;
 
     NS_NONNULL_ASSERT(itPtr != NULL);
     NS_NONNULL_ASSERT(cPtr != NULL);
+    NS_NONNULL_ASSERT(cache != NULL);
     NS_NONNULL_ASSERT(key != NULL);
     NS_NONNULL_ASSERT(newPtr != NULL);
 
-    cache = cPtr->cache;
-
     if (timeoutPtr == NULL
         && (cPtr->timeout.sec > 0 || cPtr->timeout.usec > 0)) {
         timeoutPtr = Ns_AbsoluteTime(&t, &cPtr->timeout);
@@ -179,6 +179,7 @@ static const Cmd basicCmds[] = {
 
 static const Cmd servCmds[] = {
     {"_ns_adp_include",          NsTclAdpIncludeObjCmd},
+    {"_ns_cache_refresh",        NsTclCacheRefreshObjCmd},
     {"ns_adp_abort",             NsTclAdpAbortObjCmd},
     {"ns_adp_append",            NsTclAdpAppendObjCmd},
     {"ns_adp_argc",              NsTclAdpArgcObjCmd},
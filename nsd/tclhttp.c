@@ -1685,40 +1685,55 @@ NsTclParseMessageObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp, TCL_S
  * NsTclParseHeaderObjCmd --
  *
  *      Implements "ns_parseheader". Consume a header line, handling header
- *      continuation, placing results in given set.
+ *      continuation, placing results in given set. With "-strict", the
+ *      line is parsed like request header lines received by the driver.
  *
  * Results:
  *      Tcl result.
  *
  * Side effects:
  *      Parse an HTTP header and add it to an existing set; see
- *      Ns_ParseHeader.
+ *      Ns_ParseHeader and NsParseRequestHeaderLine.
  *
  *----------------------------------------------------------------------
  */
 int
 NsTclParseHeaderObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp, TCL_SIZE_T objc, Tcl_Obj *const* objv)
 {
-    int          result = TCL_OK;
+    int          result = TCL_OK, strict = 0;
     Ns_Set      *set = NULL;
     const char  *headerString = NS_EMPTY_STRING;
     char        *prefix = NULL;
+    TCL_SIZE_T   headerLength = 0;
     Ns_ObjvSpec opts[] = {
         {"-prefix",  Ns_ObjvString,  &prefix,  NULL},
+        {"-strict",  Ns_ObjvBool,    &strict,  INT2PTR(NS_TRUE)},
         {NULL, NULL, NULL, NULL}
     };
 
     Ns_ObjvSpec  args[] = {
         {"set",          Ns_ObjvSet,    &set, NULL},
-        {"headerline",   Ns_ObjvString, &headerString, NULL},
+        {"headerline",   Ns_ObjvString, &headerString, &headerLength},
         {NULL, NULL, NULL, NULL}
     };
 
     if (Ns_ParseObjv(opts, args, interp, 1, objc, objv) != NS_OK) {
         result = TCL_ERROR;
+
+    } else if (strict == (int)NS_TRUE && prefix != NULL) {
+        Ns_TclPrintfResult(interp, "the options -strict and -prefix are mutually exclusive");
+        result = TCL_ERROR;
     }
 
-    if (result == TCL_OK) {
+    if (result == TCL_OK && strict == (int)NS_TRUE) {
+        if (NsParseRequestHeaderLine(set, headerString, (size_t)headerLength) != NS_OK) {
+            Ns_TclPrintfResult(interp, "invalid header: %s", headerString);
+            result = TCL_ERROR;
+        } else {
+            Tcl_SetObjResult(interp, Tcl_NewWideIntObj((Tcl_WideInt)Ns_SetSize(set) - 1));
+        }
+
+    } else if (result == TCL_OK) {
         size_t fieldNumber;
 
         if (Ns_ParseHeader(set, headerString, prefix, &fieldNumber) != NS_OK) {
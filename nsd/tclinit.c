@@ -55,6 +55,51 @@ typedef struct AtClose {
     Tcl_Obj        *objPtr;
 } AtClose;
 
+/*
+ * The following structure maintains the top-level commands of a blueprint
+ * which are new compared to the blueprint of the previous epoch, preceded
+ * by the deletions of the procs, variables, aliases and namespaces which
+ * are gone. Evaluating the delta brings an interp from "fromEpoch" to
+ * "toEpoch".
+ */
+
+typedef struct BlueprintDelta {
+    struct BlueprintDelta *nextPtr;    /* Delta of the following epoch. */
+    int                    fromEpoch;  /* Epoch the delta applies to. */
+    int                    toEpoch;    /* Epoch after applying the delta. */
+    TCL_SIZE_T             length;     /* Length of the script. */
+    char                   script[1];  /* The script, allocated with the structure. */
+} BlueprintDelta;
+
+/*
+ * The following structure maintains the blueprint script saved via "ns_ictl
+ * save". It is shared by reference between the interps evaluating it, so
+ * that large blueprints are not copied for every interp.
+ */
+
+typedef struct Blueprint {
+    int64_t         refCount;   /* Atomic reference count. */
+    BlueprintDelta *deltas;     /* Deltas of the recent epochs, oldest first. */
+    TCL_SIZE_T      length;     /* Length of the script. */
+    char            script[1];  /* The script, allocated with the structure. */
+} Blueprint;
+
+/*
+ * The following structure is used for computing the delta between two
+ * blueprints.
+ */
+
+typedef struct BlueprintDiff {
+    Tcl_HashTable commands;    /* Occurrences of the commands of the old blueprint. */
+    Tcl_HashTable definitions; /* Names defined by the new blueprint. */
+    Tcl_DString   keyDs;       /* Buffer for hash keys. */
+    Tcl_DString   deltaDs;     /* Delta script being built. */
+    bool          collect;     /* Collect changed commands instead of counting. */
+    int           nrCommands;  /* Number of commands of the new blueprint. */
+    int           nrChanged;   /* Number of changed commands. */
+    int           nrRemoved;   /* Number of removed definitions. */
+} BlueprintDiff;
+
 static Ns_ObjvTable traceWhen[] = {
     {"allocate",   (unsigned int)NS_TCL_TRACE_ALLOCATE},
     {"create",     (unsigned int)NS_TCL_TRACE_CREATE},
@@ -90,6 +135,43 @@ static NsInterp *NewInterpData(Tcl_Interp *interp, const NsServer *servPtr)
 static int UpdateInterp(NsInterp *itPtr)
     NS_GNUC_NONNULL(1);
 
+static Blueprint *BlueprintNew(const char *script, TCL_SIZE_T length)
+    NS_GNUC_NONNULL(1) NS_GNUC_RETURNS_NONNULL;
+
+static void BlueprintRelease(Blueprint *blueprintPtr)
+    NS_GNUC_NONNULL(1);
+
+static void BlueprintAddDeltas(Blueprint *blueprintPtr, const Blueprint *oldBlueprintPtr,
+                               int fromEpoch, int toEpoch)
+    NS_GNUC_NONNULL(1,2);
+
+static bool BlueprintDiffScript(BlueprintDiff *diffPtr, const char *script, TCL_SIZE_T length,
+                                const char *nsName, TCL_SIZE_T nsLength)
+    NS_GNUC_NONNULL(1,2);
+
+static bool BlueprintDeletions(BlueprintDiff *diffPtr, Tcl_DString *dsPtr)
+    NS_GNUC_NONNULL(1,2);
+
+static char BlueprintDefinition(const char *command, TCL_SIZE_T length,
+                                const char **namePtr, TCL_SIZE_T *nameLengthPtr)
+    NS_GNUC_NONNULL(1,3,4);
+
+static bool BlueprintWordIs(const Tcl_Token *tokenPtr, const char *literal)
+    NS_GNUC_NONNULL(1,2) NS_GNUC_PURE;
+
+static void BlueprintDefinitionKey(Tcl_DString *dsPtr, const char *nsName, TCL_SIZE_T nsLength,
+                                   char kind, const char *name, TCL_SIZE_T nameLength)
+    NS_GNUC_NONNULL(1,5);
+
+static BlueprintDelta *BlueprintDeltaNew(int fromEpoch, int toEpoch, const char *script, TCL_SIZE_T length)
+    NS_GNUC_NONNULL(3) NS_GNUC_RETURNS_NONNULL;
+
+static const BlueprintDelta *BlueprintFindDelta(const Blueprint *blueprintPtr, int epoch)
+    NS_GNUC_NONNULL(1);
+
+static void AddInterpTime(NsServer *servPtr, const Ns_Time *timePtr, int updateEpoch, bool isDelta)
+    NS_GNUC_NONNULL(1,2);
+
 static void RunTraces(NsInterp *itPtr, Ns_TclTraceType why)
     NS_GNUC_NONNULL(1);
 
@@ -126,6 +208,7 @@ static TCL_OBJCMDPROC_T ICtlOnDeleteObjCmd;
 #endif
 static TCL_OBJCMDPROC_T ICtlRunTracesObjCmd;
 static TCL_OBJCMDPROC_T ICtlSaveObjCmd;
+static TCL_OBJCMDPROC_T ICtlStatsObjCmd;
 static TCL_OBJCMDPROC_T ICtlTraceObjCmd;
 static TCL_OBJCMDPROC_T ICtlUpdateObjCmd;
 
@@ -138,6 +221,7 @@ static Ns_Tls tls;  /* Slot for per-thread Tcl interp cache. */
 static Ns_Mutex updateLock = NULL;
 static int concurrentUpdates = 0;
 static int maxConcurrentUpdates = 1000;
+static int maxBlueprintDeltas = 10;
 
 static Ns_Mutex interpLock = NULL;
 static bool concurrent_interp_create = NS_FALSE;
@@ -214,6 +298,7 @@ NsConfigTcl(void)
 #endif
                                              );
     maxConcurrentUpdates = Ns_ConfigIntRange(NS_GLOBAL_CONFIG_PARAMETERS, "maxconcurrentupdates", 1000, 1, INT_MAX);
+    maxBlueprintDeltas = Ns_ConfigIntRange(NS_GLOBAL_CONFIG_PARAMETERS, "blueprintdeltas", 10, 0, 1000);
 }
 
 
@@ -1184,8 +1269,13 @@ ICtlGetObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_SIZE_T objc, Tcl_Ob
         result = TCL_ERROR;
 
     } else {
+        const Blueprint *blueprintPtr;
+
         Ns_RWLockRdLock(&servPtr->tcl.lock);
-        Tcl_SetObjResult(interp, Tcl_NewStringObj(servPtr->tcl.script, TCL_INDEX_NONE));
+        blueprintPtr = servPtr->tcl.blueprintPtr;
+        if (blueprintPtr != NULL) {
+            Tcl_SetObjResult(interp, Tcl_NewStringObj(blueprintPtr->script, blueprintPtr->length));
+        }
         Ns_RWLockUnlock(&servPtr->tcl.lock);
     }
     return result;
@@ -1379,23 +1469,120 @@ ICtlSaveObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_SIZE_T objc, Tcl_O
         const NsInterp *itPtr = (const NsInterp *)clientData;
         NsServer       *servPtr = itPtr->servPtr;
         TCL_SIZE_T      length;
-        const char     *script = ns_strdup(Tcl_GetStringFromObj(scriptObj, &length));
+        const char     *script = Tcl_GetStringFromObj(scriptObj, &length);
+        Blueprint      *blueprintPtr = BlueprintNew(script, length), *oldBlueprintPtr;
+        int             oldEpoch;
 
         Ns_RWLockWrLock(&servPtr->tcl.lock);
-        ns_free_const(servPtr->tcl.script);
-        servPtr->tcl.script = script;
-        servPtr->tcl.length = length;
+        oldBlueprintPtr = servPtr->tcl.blueprintPtr;
+        oldEpoch = servPtr->tcl.epoch;
         if (++servPtr->tcl.epoch == 0) {
             /*
              * Epoch zero is reserved for new interps.
              */
             ++itPtr->servPtr->tcl.epoch;
         }
+        /*
+         * Computing the deltas under the write lock guarantees that they
+         * are computed against the blueprint being replaced.
+         */
+        if (oldBlueprintPtr != NULL && oldEpoch > 0 && maxBlueprintDeltas > 0) {
+            BlueprintAddDeltas(blueprintPtr, oldBlueprintPtr, oldEpoch, servPtr->tcl.epoch);
+        }
+        servPtr->tcl.blueprintPtr = blueprintPtr;
         Ns_RWLockUnlock(&servPtr->tcl.lock);
+
+        /*
+         * Interps still evaluating the old blueprint keep their reference.
+         */
+        if (oldBlueprintPtr != NULL) {
+            BlueprintRelease(oldBlueprintPtr);
+        }
     }
     return result;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * ICtlStatsObjCmd - subcommand of NsTclICtlObjCmd --
+ *
+ *      Implements "ns_ictl stats" command.
+ *      Return statistics about the creation and update of interps of
+ *      the server and the creation time of the current interp.
+ *
+ * Results:
+ *      Standard Tcl result.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+static int
+ICtlStatsObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_SIZE_T objc, Tcl_Obj *const* objv)
+{
+    int result = TCL_OK;
+
+    if (Ns_ParseObjv(NULL, NULL, interp, 2, objc, objv) != NS_OK) {
+        result = TCL_ERROR;
+
+    } else {
+        const NsInterp *itPtr = (const NsInterp *)clientData;
+        NsServer       *servPtr = itPtr->servPtr;
+        Tcl_DString     ds, *dsPtr = &ds;
+        TCL_SIZE_T      blueprintSize;
+        int             epoch, i;
+
+        Ns_RWLockRdLock(&servPtr->tcl.lock);
+        blueprintSize = (servPtr->tcl.blueprintPtr != NULL) ? servPtr->tcl.blueprintPtr->length : 0;
+        epoch = servPtr->tcl.epoch;
+        Ns_RWLockUnlock(&servPtr->tcl.lock);
+
+        Tcl_DStringInit(dsPtr);
+
+        Ns_MutexLock(&updateLock);
+        Ns_DStringPrintf(dsPtr, "created %lu", servPtr->tcl.stats.created);
+        Tcl_DStringAppend(dsPtr, " createtime ", 12);
+        Ns_DStringAppendTime(dsPtr, &servPtr->tcl.stats.createTime);
+        Tcl_DStringAppend(dsPtr, " maxcreatetime ", 15);
+        Ns_DStringAppendTime(dsPtr, &servPtr->tcl.stats.createTimeMax);
+        Ns_DStringPrintf(dsPtr, " updated %lu", servPtr->tcl.stats.updated);
+        Tcl_DStringAppend(dsPtr, " updatetime ", 12);
+        Ns_DStringAppendTime(dsPtr, &servPtr->tcl.stats.updateTime);
+        Tcl_DStringAppend(dsPtr, " maxupdatetime ", 15);
+        Ns_DStringAppendTime(dsPtr, &servPtr->tcl.stats.updateTimeMax);
+        Ns_DStringPrintf(dsPtr, " deltaupdated %lu", servPtr->tcl.stats.deltaUpdated);
+
+        /*
+         * Report the update statistics of the recent epochs, newest first.
+         */
+        Tcl_DStringAppend(dsPtr, " epochs {", 9);
+        for (i = 0; i < NS_ICTL_EPOCH_STATS && epoch - i > 0; i++) {
+            const int e = epoch - i;
+            const unsigned int slot = (unsigned int)e % NS_ICTL_EPOCH_STATS;
+
+            if (servPtr->tcl.stats.epochs[slot].epoch == e) {
+                Ns_DStringPrintf(dsPtr, "%s{epoch %d updated %lu deltaupdated %lu updatetime ",
+                                 i > 0 ? " " : "", e,
+                                 servPtr->tcl.stats.epochs[slot].updated,
+                                 servPtr->tcl.stats.epochs[slot].deltaUpdated);
+                Ns_DStringAppendTime(dsPtr, &servPtr->tcl.stats.epochs[slot].updateTime);
+                Tcl_DStringAppend(dsPtr, "}", 1);
+            }
+        }
+        Tcl_DStringAppend(dsPtr, "}", 1);
+        Ns_MutexUnlock(&updateLock);
+
+        Tcl_DStringAppend(dsPtr, " interpcreatetime ", 18);
+        Ns_DStringAppendTime(dsPtr, &itPtr->createTime);
+        Ns_DStringPrintf(dsPtr, " blueprintsize %" PRITcl_Size, blueprintSize);
+
+        Tcl_DStringResult(interp, dsPtr);
+    }
+    return result;
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -1663,6 +1850,7 @@ NsTclICtlObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_SIZE_T objc, Tcl_
 #endif
         {"runtraces",            ICtlRunTracesObjCmd},
         {"save",                 ICtlSaveObjCmd},
+        {"stats",                ICtlStatsObjCmd},
         {"trace",                ICtlTraceObjCmd},
         {"update",               ICtlUpdateObjCmd},
         {NULL, NULL}
@@ -1963,9 +2151,12 @@ PopInterp(const NsServer *servPtr, Tcl_Interp *interp)
     hPtr = GetCacheEntry(servPtr);
     itPtr = Tcl_GetHashValue(hPtr);
     if (itPtr == NULL) {
+        Ns_Time startTime, initTime, tracesTime, now;
+
         if (nsconf.tcl.lockoninit) {
             Ns_CsEnter(&popInterpCsLock);
         }
+        Ns_GetTime(&startTime);
         if (interp != NULL) {
             itPtr = NewInterpData(interp, servPtr);
         } else {
@@ -1973,11 +2164,35 @@ PopInterp(const NsServer *servPtr, Tcl_Interp *interp)
         }
         if (servPtr != NULL) {
             itPtr->servPtr = ns_const2voidp(servPtr);
+            Ns_GetTime(&initTime);
             NsTclAddServerCmds(itPtr);
             RunTraces(itPtr, NS_TCL_TRACE_CREATE);
+            Ns_GetTime(&tracesTime);
             if (UpdateInterp(itPtr) != TCL_OK) {
                 (void) Ns_TclLogErrorInfo(interp, "\n(context: update interpreter)");
             }
+            Ns_GetTime(&now);
+
+            /*
+             * Keep the time needed for creating the interp including the
+             * blueprint and report the phases in the log.
+             */
+            (void) Ns_DiffTime(&now, &startTime, &itPtr->createTime);
+            AddInterpTime(itPtr->servPtr, &itPtr->createTime, 0, NS_FALSE);
+            {
+                Ns_Time initDiff, tracesDiff, updateDiff;
+
+                (void) Ns_DiffTime(&initTime, &startTime, &initDiff);
+                (void) Ns_DiffTime(&tracesTime, &initTime, &tracesDiff);
+                (void) Ns_DiffTime(&now, &tracesTime, &updateDiff);
+                Ns_Log(Notice, "created interpreter for server %s in " NS_TIME_FMT " secs"
+                       " (init " NS_TIME_FMT ", create traces " NS_TIME_FMT ", blueprint " NS_TIME_FMT ")",
+                       servPtr->server,
+                       (int64_t) itPtr->createTime.sec, itPtr->createTime.usec,
+                       (int64_t) initDiff.sec, initDiff.usec,
+                       (int64_t) tracesDiff.sec, tracesDiff.usec,
+                       (int64_t) updateDiff.sec, updateDiff.usec);
+            }
         } else {
             RunTraces(itPtr, NS_TCL_TRACE_CREATE);
         }
@@ -2204,6 +2419,7 @@ static bool InitializeInterpData(void) {
     NsTclInitAddrType();
     NsTclInitTimeType();
     NsTclInitMemUnitType();
+    NsTclInitNsvType();
 #ifdef NS_WITH_DEPRECATED
     NsTclInitKeylistType();
 #endif
@@ -2285,7 +2501,9 @@ NewInterpData(Tcl_Interp *interp, const NsServer *servPtr)
  * UpdateInterp --
  *
  *      Update the state of an interp by evaluating the saved script
- *      whenever the epoch changes.
+ *      whenever the epoch changes. When the deltas of all epochs since
+ *      the last update of the interp are available, only these are
+ *      evaluated instead of the full blueprint.
  *
  * Results:
  *      Tcl result.
@@ -2301,9 +2519,8 @@ UpdateInterp(NsInterp *itPtr)
 {
     NsServer   *servPtr;
     int         result = TCL_OK, epoch;
-    TCL_SIZE_T  scriptLength = 0;
-    const char *script = NULL;
-    bool        doUpdateNow = NS_FALSE;
+    Blueprint  *blueprintPtr = NULL;
+    bool        doUpdateNow = NS_FALSE, isDelta = NS_FALSE;
 
     NS_NONNULL_ASSERT(itPtr != NULL);
     servPtr = itPtr->servPtr;
@@ -2315,7 +2532,8 @@ UpdateInterp(NsInterp *itPtr)
      * variables.
      *
      * In the code block below, we want to avoid running the blueprint update
-     * under the lock. Therefore, we copy the blueprint script with ns_strdup.
+     * under the lock. Therefore, we take a reference to the blueprint, which
+     * stays valid, even when a new blueprint is saved in the meantime.
      */
     Ns_RWLockRdLock(&servPtr->tcl.lock);
     if (itPtr->epoch != servPtr->tcl.epoch) {
@@ -2325,11 +2543,17 @@ UpdateInterp(NsInterp *itPtr)
          * either (a) the interpreter is fresh, or (b) when the concurrently
          * running updates are below "maxConcurrentUpdates".
          */
+        Ns_MutexLock(&updateLock);
         doUpdateNow = (itPtr->epoch < 1) || (concurrentUpdates < maxConcurrentUpdates);
         if (doUpdateNow) {
             concurrentUpdates++;
-            script = ns_strdup(servPtr->tcl.script);
-            scriptLength = servPtr->tcl.length;
+        }
+        Ns_MutexUnlock(&updateLock);
+        if (doUpdateNow) {
+            blueprintPtr = servPtr->tcl.blueprintPtr;
+            if (blueprintPtr != NULL) {
+                (void) NS_ATOMIC_FETCH_ADD(&blueprintPtr->refCount, 1);
+            }
         }
     } else {
         epoch = itPtr->epoch;
@@ -2343,19 +2567,48 @@ UpdateInterp(NsInterp *itPtr)
             Ns_Log(Notice, "start update interpreter %s to epoch %d, concurrent %d",
                    servPtr->server, epoch, concurrentUpdates);
             Ns_GetTime(&startTime);
-            result = Tcl_EvalEx(itPtr->interp, script,
-                                scriptLength, TCL_EVAL_GLOBAL);
+            if (blueprintPtr != NULL) {
+                const BlueprintDelta *deltaPtr = NULL;
+
+                if (itPtr->epoch > 0) {
+                    deltaPtr = BlueprintFindDelta(blueprintPtr, itPtr->epoch);
+                }
+                if (deltaPtr != NULL) {
+                    isDelta = NS_TRUE;
+                    for (; deltaPtr != NULL && result == TCL_OK; deltaPtr = deltaPtr->nextPtr) {
+                        result = Tcl_EvalEx(itPtr->interp, deltaPtr->script,
+                                            deltaPtr->length, TCL_EVAL_GLOBAL);
+                    }
+                    if (result != TCL_OK) {
+                        Ns_Log(Warning, "update interpreter %s to epoch %d: evaluation of delta"
+                               " failed, replaying full blueprint: %s",
+                               servPtr->server, epoch, Tcl_GetStringResult(itPtr->interp));
+                        isDelta = NS_FALSE;
+                    }
+                }
+                if (!isDelta) {
+                    result = Tcl_EvalEx(itPtr->interp, blueprintPtr->script,
+                                        blueprintPtr->length, TCL_EVAL_GLOBAL);
+                }
+                BlueprintRelease(blueprintPtr);
+            }
             Ns_GetTime(&now);
             Ns_DiffTime(&now, &startTime, &diffTime);
-            Ns_Log(Notice, "update interpreter %s to epoch %d done, trace %s, time "
+            Ns_Log(Notice, "update interpreter %s to epoch %d done (%s), trace %s, time "
                    NS_TIME_FMT " secs concurrent %d",
-                   servPtr->server, epoch,
+                   servPtr->server, epoch, isDelta ? "delta" : "full",
                    GetTraceLabel(itPtr->currentTrace),
                    (int64_t) diffTime.sec, diffTime.usec,
                    concurrentUpdates);
 
+            /*
+             * The blueprint evaluation of fresh interps is accounted as
+             * part of their creation.
+             */
+            if (itPtr->epoch > 0) {
+                AddInterpTime(servPtr, &diffTime, epoch, isDelta);
+            }
             itPtr->epoch = epoch;
-            ns_free_const(script);
 
             Ns_MutexLock(&updateLock);
             concurrentUpdates--;
@@ -2369,6 +2622,735 @@ UpdateInterp(NsInterp *itPtr)
     return result;
 }
 
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * BlueprintNew, BlueprintRelease --
+ *
+ *      Create a new blueprint from a script or release a reference to a
+ *      blueprint.
+ *
+ * Results:
+ *      BlueprintNew() returns a blueprint with a reference count of 1.
+ *
+ * Side effects:
+ *      The blueprint is freed, when the last reference is released.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Blueprint *
+BlueprintNew(const char *script, TCL_SIZE_T length)
+{
+    Blueprint *blueprintPtr;
+
+    NS_NONNULL_ASSERT(script != NULL);
+
+    blueprintPtr = ns_malloc(sizeof(Blueprint) + (size_t)length);
+    blueprintPtr->refCount = 1;
+    blueprintPtr->deltas = NULL;
+    blueprintPtr->length = length;
+    memcpy(blueprintPtr->script, script, (size_t)length);
+    blueprintPtr->script[length] = '\0';
+
+    return blueprintPtr;
+}
+
+static void
+BlueprintRelease(Blueprint *blueprintPtr)
+{
+    NS_NONNULL_ASSERT(blueprintPtr != NULL);
+
+    if (NS_ATOMIC_FETCH_ADD(&blueprintPtr->refCount, -1) == 1) {
+        BlueprintDelta *deltaPtr = blueprintPtr->deltas;
+
+        while (deltaPtr != NULL) {
+            BlueprintDelta *nextPtr = deltaPtr->nextPtr;
+
+            ns_free(deltaPtr);
+            deltaPtr = nextPtr;
+        }
+        ns_free(blueprintPtr);
+    }
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * BlueprintAddDeltas --
+ *
+ *      Compute the delta between the blueprint of the previous epoch and
+ *      a new blueprint. The delta consists of the commands of the new
+ *      blueprint which do not occur in the old blueprint, in the order of
+ *      the new blueprint. Commands are compared at the top level and
+ *      within the bodies of top-level "namespace eval" commands, such
+ *      that for blueprints produced by "ns_eval" the delta contains just
+ *      the changed procs and variables. The delta starts with the
+ *      deletions of the definitions of the old blueprint, which are gone
+ *      in the new one (see BlueprintDeletions()).
+ *
+ *      The new blueprint inherits the deltas of the most recent previous
+ *      epochs, such that interps being a few epochs behind can be updated
+ *      incrementally as well.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Sets the deltas of the new blueprint. When a blueprint cannot be
+ *      parsed or a removed command cannot be undone, no deltas are added,
+ *      and interps are updated by replaying the full blueprint.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+BlueprintAddDeltas(Blueprint *blueprintPtr, const Blueprint *oldBlueprintPtr,
+                   int fromEpoch, int toEpoch)
+{
+    BlueprintDiff         diff;
+    const BlueprintDelta *oldDeltaPtr;
+    BlueprintDelta       *deltaPtr, **nextPtrPtr;
+    Tcl_DString           scriptDs;
+    int                   nrDeltas = 0;
+
+    NS_NONNULL_ASSERT(blueprintPtr != NULL);
+    NS_NONNULL_ASSERT(oldBlueprintPtr != NULL);
+
+    Tcl_InitHashTable(&diff.commands, TCL_STRING_KEYS);
+    Tcl_InitHashTable(&diff.definitions, TCL_STRING_KEYS);
+    Tcl_DStringInit(&diff.keyDs);
+    Tcl_DStringInit(&diff.deltaDs);
+    Tcl_DStringInit(&scriptDs);
+    diff.nrCommands = 0;
+    diff.nrChanged = 0;
+    diff.nrRemoved = 0;
+
+    /*
+     * First count the occurrences of the commands of the old blueprint,
+     * then collect the commands of the new blueprint without a remaining
+     * counterpart in the old one. Finally, the commands of the old
+     * blueprint without a counterpart in the new one are undone.
+     */
+    diff.collect = NS_FALSE;
+    if (BlueprintDiffScript(&diff, oldBlueprintPtr->script, oldBlueprintPtr->length, NULL, 0)) {
+        diff.collect = NS_TRUE;
+        if (BlueprintDiffScript(&diff, blueprintPtr->script, blueprintPtr->length, NULL, 0)
+            && BlueprintDeletions(&diff, &scriptDs)) {
+            Tcl_DStringAppend(&scriptDs, diff.deltaDs.string, diff.deltaDs.length);
+            /*
+             * Inherit the most recent deltas of the old blueprint, while
+             * keeping at most maxBlueprintDeltas deltas.
+             */
+            for (oldDeltaPtr = oldBlueprintPtr->deltas; oldDeltaPtr != NULL; oldDeltaPtr = oldDeltaPtr->nextPtr) {
+                nrDeltas++;
+            }
+            nextPtrPtr = &blueprintPtr->deltas;
+            for (oldDeltaPtr = oldBlueprintPtr->deltas; oldDeltaPtr != NULL; oldDeltaPtr = oldDeltaPtr->nextPtr) {
+                if (nrDeltas-- < maxBlueprintDeltas) {
+                    deltaPtr = BlueprintDeltaNew(oldDeltaPtr->fromEpoch, oldDeltaPtr->toEpoch,
+                                                 oldDeltaPtr->script, oldDeltaPtr->length);
+                    *nextPtrPtr = deltaPtr;
+                    nextPtrPtr = &deltaPtr->nextPtr;
+                }
+            }
+            *nextPtrPtr = BlueprintDeltaNew(fromEpoch, toEpoch, scriptDs.string, scriptDs.length);
+        }
+    }
+
+    if (blueprintPtr->deltas != NULL) {
+        Ns_Log(Notice, "blueprint of epoch %d: %" PRITcl_Size " bytes, delta %" PRITcl_Size
+               " bytes (%d of %d commands changed, %d definitions removed)",
+               toEpoch, blueprintPtr->length, scriptDs.length, diff.nrChanged, diff.nrCommands,
+               diff.nrRemoved);
+    } else {
+        Ns_Log(Notice, "blueprint of epoch %d: cannot compute delta, interps will replay"
+               " the full blueprint", toEpoch);
+    }
+
+    Tcl_DStringFree(&scriptDs);
+    Tcl_DStringFree(&diff.keyDs);
+    Tcl_DStringFree(&diff.deltaDs);
+    Tcl_DeleteHashTable(&diff.definitions);
+    Tcl_DeleteHashTable(&diff.commands);
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * BlueprintDiffScript --
+ *
+ *      Helper of BlueprintAddDeltas() processing the commands of a
+ *      script. Without "collect", the occurrences of the commands are
+ *      counted, otherwise the commands without a counted occurrence are
+ *      appended to the delta and the names defined by the commands are
+ *      recorded. The bodies of top-level "namespace eval" commands with
+ *      a braced body are processed recursively, commands of these bodies
+ *      are appended to the delta wrapped into a "namespace eval" command
+ *      for the same namespace.
+ *
+ * Results:
+ *      NS_TRUE on success, NS_FALSE when the script cannot be parsed.
+ *
+ * Side effects:
+ *      Updates the hash table and delta of the provided diff structure.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static bool
+BlueprintDiffScript(BlueprintDiff *diffPtr, const char *script, TCL_SIZE_T length,
+                    const char *nsName, TCL_SIZE_T nsLength)
+{
+    const char *p = script;
+    TCL_SIZE_T  remaining = length;
+    bool        success = NS_TRUE;
+
+    NS_NONNULL_ASSERT(diffPtr != NULL);
+    NS_NONNULL_ASSERT(script != NULL);
+
+    while (remaining > 0 && success) {
+        Tcl_Parse         parse;
+        TCL_SIZE_T        size, consumed;
+        const Tcl_Token  *tokenPtr = NULL;
+
+        if (Tcl_ParseCommand(NULL, p, remaining, 0, &parse) != TCL_OK) {
+            success = NS_FALSE;
+            break;
+        }
+        consumed = (TCL_SIZE_T)((parse.commandStart + parse.commandSize) - p);
+        size = parse.commandSize;
+        while (size > 0 && CHARTYPE(space, parse.commandStart[size - 1]) != 0) {
+            size--;
+        }
+        if (size > 0 && parse.commandStart[size - 1] == ';') {
+            size--;
+        }
+
+        if (nsName == NULL && parse.numWords == 4) {
+            /*
+             * Check for "namespace eval /ns/ {/body/}", where all words
+             * are literal and the body is braced.
+             */
+            const Tcl_Token *wordPtr = parse.tokenPtr;
+            int              i;
+
+            for (i = 0; i < 4; i++) {
+                if (wordPtr->type != TCL_TOKEN_SIMPLE_WORD) {
+                    break;
+                }
+                if ((i == 0 && (wordPtr[1].size != 9 || strncmp(wordPtr[1].start, "namespace", 9u) != 0))
+                    || (i == 1 && (wordPtr[1].size != 4 || strncmp(wordPtr[1].start, "eval", 4u) != 0))
+                    || (i == 3 && *wordPtr->start != '{')
+                    ) {
+                    break;
+                }
+                wordPtr += wordPtr->numComponents + 1;
+            }
+            if (i == 4) {
+                tokenPtr = parse.tokenPtr;
+            }
+        }
+
+        if (tokenPtr != NULL) {
+            const Tcl_Token *nsTokenPtr = &tokenPtr[5], *bodyTokenPtr = &tokenPtr[7];
+            TCL_SIZE_T       deltaLength = diffPtr->deltaDs.length;
+            bool             isKnownNamespace;
+
+            /*
+             * Record the namespace, such that new namespaces are created
+             * by the delta even when their body is empty.
+             */
+            Tcl_DStringSetLength(&diffPtr->keyDs, 0);
+            Tcl_DStringAppend(&diffPtr->keyDs, "N ", 2);
+            Tcl_DStringAppend(&diffPtr->keyDs, nsTokenPtr->start, nsTokenPtr->size);
+            Tcl_DStringAppend(&diffPtr->keyDs, "\n", 1);
+            if (!diffPtr->collect) {
+                int isNew;
+
+                (void) Tcl_CreateHashEntry(&diffPtr->commands, diffPtr->keyDs.string, &isNew);
+                isKnownNamespace = NS_TRUE;
+            } else {
+                Tcl_HashEntry *hPtr;
+                int            isNew;
+
+                /*
+                 * Mark the namespace as used by the new blueprint.
+                 */
+                hPtr = Tcl_CreateHashEntry(&diffPtr->commands, diffPtr->keyDs.string, &isNew);
+                Tcl_SetHashValue(hPtr, INT2PTR(-1));
+                isKnownNamespace = (isNew == 0);
+            }
+
+            if (diffPtr->collect) {
+                Tcl_DStringAppend(&diffPtr->deltaDs, "namespace eval ", 15);
+                Tcl_DStringAppend(&diffPtr->deltaDs, tokenPtr[4].start, tokenPtr[4].size);
+                Tcl_DStringAppend(&diffPtr->deltaDs, " {\n", 3);
+            }
+            success = BlueprintDiffScript(diffPtr, bodyTokenPtr->start, bodyTokenPtr->size,
+                                          nsTokenPtr->start, nsTokenPtr->size);
+            if (diffPtr->collect) {
+                if (isKnownNamespace && diffPtr->deltaDs.length == deltaLength + 18 + tokenPtr[4].size) {
+                    /*
+                     * No changed commands in the body.
+                     */
+                    Tcl_DStringSetLength(&diffPtr->deltaDs, deltaLength);
+                } else {
+                    Tcl_DStringAppend(&diffPtr->deltaDs, "}\n", 2);
+                }
+            }
+
+        } else if (parse.numWords > 0 && size > 0) {
+            Tcl_HashEntry *hPtr;
+            int            isNew;
+
+            /*
+             * The key of a command is its text, prefixed by the namespace
+             * for commands in "namespace eval" bodies.
+             */
+            Tcl_DStringSetLength(&diffPtr->keyDs, 0);
+            if (nsName != NULL) {
+                Tcl_DStringAppend(&diffPtr->keyDs, "N ", 2);
+                Tcl_DStringAppend(&diffPtr->keyDs, nsName, nsLength);
+                Tcl_DStringAppend(&diffPtr->keyDs, "\n", 1);
+            } else {
+                Tcl_DStringAppend(&diffPtr->keyDs, "T ", 2);
+            }
+            Tcl_DStringAppend(&diffPtr->keyDs, parse.commandStart, size);
+
+            if (!diffPtr->collect) {
+                hPtr = Tcl_CreateHashEntry(&diffPtr->commands, diffPtr->keyDs.string, &isNew);
+                Tcl_SetHashValue(hPtr, INT2PTR(isNew != 0 ? 1 : PTR2INT(Tcl_GetHashValue(hPtr)) + 1));
+            } else {
+                const char *name;
+                TCL_SIZE_T  nameLength;
+                char        kind;
+                int         defined = 1;
+
+                diffPtr->nrCommands++;
+                hPtr = Tcl_FindHashEntry(&diffPtr->commands, diffPtr->keyDs.string);
+                if (hPtr != NULL && PTR2INT(Tcl_GetHashValue(hPtr)) > 0) {
+                    Tcl_SetHashValue(hPtr, INT2PTR(PTR2INT(Tcl_GetHashValue(hPtr)) - 1));
+                } else {
+                    diffPtr->nrChanged++;
+                    defined = 2;
+                    Tcl_DStringAppend(&diffPtr->deltaDs, parse.commandStart, size);
+                    Tcl_DStringAppend(&diffPtr->deltaDs, "\n", 1);
+                }
+
+                /*
+                 * Record the defined name: 1 when the definition is
+                 * unchanged, 2 when it is part of the delta.
+                 */
+                kind = BlueprintDefinition(parse.commandStart, size, &name, &nameLength);
+                if (kind != '\0') {
+                    BlueprintDefinitionKey(&diffPtr->keyDs, nsName, nsLength, kind, name, nameLength);
+                    hPtr = Tcl_CreateHashEntry(&diffPtr->definitions, diffPtr->keyDs.string, &isNew);
+                    if (isNew != 0 || PTR2INT(Tcl_GetHashValue(hPtr)) < defined) {
+                        Tcl_SetHashValue(hPtr, INT2PTR(defined));
+                    }
+                }
+            }
+        }
+        Tcl_FreeParse(&parse);
+        if (consumed <= 0) {
+            break;
+        }
+        p += consumed;
+        remaining -= consumed;
+    }
+    return success;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * BlueprintDeletions --
+ *
+ *      Helper of BlueprintAddDeltas() building the deletions of the
+ *      delta. Procs, variables, arrays and aliases defined by commands of
+ *      the old blueprint without a counterpart in the new one are
+ *      deleted, unless the new blueprint defines them again. The
+ *      elements of a changed array are removed before the array is set
+ *      again. Namespaces of the old blueprint missing in the new one are
+ *      deleted, unless a namespace of the new blueprint is nested in
+ *      them.
+ *
+ * Results:
+ *      NS_TRUE on success, NS_FALSE when a command of the old blueprint
+ *      without a counterpart cannot be undone.
+ *
+ * Side effects:
+ *      Appends the deletions to the provided dstring.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static bool
+BlueprintDeletions(BlueprintDiff *diffPtr, Tcl_DString *dsPtr)
+{
+    const Tcl_HashEntry *hPtr;
+    Tcl_HashSearch       search;
+    Tcl_DString          nsDs;
+    bool                 success = NS_TRUE;
+
+    NS_NONNULL_ASSERT(diffPtr != NULL);
+    NS_NONNULL_ASSERT(dsPtr != NULL);
+
+    Tcl_DStringInit(&nsDs);
+
+    /*
+     * Delete the definitions first, since this might recreate a deleted
+     * namespace via "namespace eval".
+     */
+    for (hPtr = Tcl_FirstHashEntry(&diffPtr->commands, &search);
+         hPtr != NULL && success;
+         hPtr = Tcl_NextHashEntry(&search)) {
+        const Tcl_HashEntry *defPtr;
+        const char          *key = Tcl_GetHashKey(&diffPtr->commands, hPtr), *command, *nsName = NULL, *name;
+        TCL_SIZE_T           nsLength = 0, nameLength;
+        char                 kind;
+        int                  defined;
+
+        if (*key == 'N') {
+            command = strchr(key + 2, INTCHAR('\n')) + 1;
+            nsName = key + 2;
+            nsLength = (TCL_SIZE_T)(command - nsName) - 1;
+        } else {
+            command = key + 2;
+        }
+        if (*command == '\0' || PTR2INT(Tcl_GetHashValue(hPtr)) <= 0) {
+            /*
+             * Namespace, or command with a counterpart.
+             */
+            continue;
+        }
+
+        kind = BlueprintDefinition(command, (TCL_SIZE_T)strlen(command), &name, &nameLength);
+        if (kind == '\0') {
+            Ns_Log(Notice, "blueprint: removed command cannot be undone by a delta: %.80s", command);
+            success = NS_FALSE;
+            break;
+        }
+        BlueprintDefinitionKey(&diffPtr->keyDs, nsName, nsLength, kind, name, nameLength);
+        defPtr = Tcl_FindHashEntry(&diffPtr->definitions, diffPtr->keyDs.string);
+        defined = (defPtr != NULL) ? PTR2INT(Tcl_GetHashValue(defPtr)) : 0;
+        if (defined == 1 || (defined == 2 && kind != 'a')) {
+            /*
+             * Defined again by the new blueprint.
+             */
+            continue;
+        }
+
+        diffPtr->nrRemoved++;
+        if (nsName != NULL) {
+            Tcl_DStringSetLength(&nsDs, 0);
+            Tcl_DStringAppend(&nsDs, nsName, nsLength);
+            Tcl_DStringAppend(dsPtr, "namespace eval", 14);
+            Tcl_DStringAppendElement(dsPtr, nsDs.string);
+            Tcl_DStringAppend(dsPtr, " {\n", 3);
+        }
+        switch (kind) {
+        case 'p':
+            Tcl_DStringAppend(dsPtr, "catch {rename ", 14);
+            Tcl_DStringAppend(dsPtr, name, nameLength);
+            Tcl_DStringAppend(dsPtr, " {}}\n", 5);
+            break;
+        case 'i':
+            Tcl_DStringAppend(dsPtr, "catch {interp alias {} ", 23);
+            Tcl_DStringAppend(dsPtr, name, nameLength);
+            Tcl_DStringAppend(dsPtr, " {}}\n", 5);
+            break;
+        default:
+            /*
+             * Variables and arrays: declare the variable first, such
+             * that the variable of the namespace is addressed.
+             */
+            Tcl_DStringAppend(dsPtr, "variable ", 9);
+            Tcl_DStringAppend(dsPtr, name, nameLength);
+            if (kind == 'a') {
+                Tcl_DStringAppend(dsPtr, "\narray unset ", 13);
+                Tcl_DStringAppend(dsPtr, name, nameLength);
+                Tcl_DStringAppend(dsPtr, " *\n", 3);
+            } else {
+                Tcl_DStringAppend(dsPtr, "\nunset -nocomplain ", 19);
+                Tcl_DStringAppend(dsPtr, name, nameLength);
+                Tcl_DStringAppend(dsPtr, "\n", 1);
+            }
+            break;
+        }
+        if (nsName != NULL) {
+            Tcl_DStringAppend(dsPtr, "}\n", 2);
+        }
+    }
+
+    /*
+     * Delete the namespaces, which were only used by the old blueprint
+     * (value 0). Namespaces of the new blueprint have the value -1.
+     */
+    for (hPtr = Tcl_FirstHashEntry(&diffPtr->commands, &search);
+         hPtr != NULL && success;
+         hPtr = Tcl_NextHashEntry(&search)) {
+        const char          *key = Tcl_GetHashKey(&diffPtr->commands, hPtr);
+        const Tcl_HashEntry *otherPtr;
+        Tcl_HashSearch       otherSearch;
+        size_t               keyLength = strlen(key);
+        bool                 nested = NS_FALSE;
+
+        if (*key != 'N' || key[keyLength - 1] != '\n' || PTR2INT(Tcl_GetHashValue(hPtr)) != 0) {
+            continue;
+        }
+        for (otherPtr = Tcl_FirstHashEntry(&diffPtr->commands, &otherSearch);
+             otherPtr != NULL && !nested;
+             otherPtr = Tcl_NextHashEntry(&otherSearch)) {
+            const char *otherKey = Tcl_GetHashKey(&diffPtr->commands, otherPtr);
+
+            nested = (PTR2INT(Tcl_GetHashValue(otherPtr)) == -1
+                      && strncmp(otherKey, key, keyLength - 1u) == 0
+                      && otherKey[keyLength - 1u] == ':'
+                      && otherKey[keyLength] == ':');
+        }
+        if (!nested) {
+            diffPtr->nrRemoved++;
+            Tcl_DStringSetLength(&nsDs, 0);
+            Tcl_DStringAppend(&nsDs, key + 2, (TCL_SIZE_T)keyLength - 3);
+            Tcl_DStringAppend(dsPtr, "catch {namespace delete", 23);
+            Tcl_DStringAppendElement(dsPtr, nsDs.string);
+            Tcl_DStringAppend(dsPtr, "}\n", 2);
+        }
+    }
+
+    Tcl_DStringFree(&nsDs);
+    return success;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * BlueprintDefinition, BlueprintWordIs, BlueprintDefinitionKey --
+ *
+ *      BlueprintDefinition() checks, whether a command of a blueprint
+ *      defines a proc ("proc /name/ ..."), a variable ("variable /name/
+ *      ?/value/?"), an array ("array set /name/ /list/") or an alias
+ *      ("interp alias {} /name/ {} ..."), as produced by nstrace.
+ *      BlueprintWordIs() compares a word with a literal.
+ *      BlueprintDefinitionKey() builds the hash key of a definition.
+ *
+ * Results:
+ *      BlueprintDefinition() returns the kind of the definition ('p',
+ *      'v', 'a' or 'i') and the name as written in the command, or '\0',
+ *      when the command is not a definition.
+ *
+ * Side effects:
+ *      BlueprintDefinitionKey() overwrites the provided dstring.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static char
+BlueprintDefinition(const char *command, TCL_SIZE_T length, const char **namePtr, TCL_SIZE_T *nameLengthPtr)
+{
+    Tcl_Parse        parse;
+    const Tcl_Token *words[4], *nameTokenPtr = NULL;
+    char             kind = '\0';
+
+    NS_NONNULL_ASSERT(command != NULL);
+    NS_NONNULL_ASSERT(namePtr != NULL);
+    NS_NONNULL_ASSERT(nameLengthPtr != NULL);
+
+    if (Tcl_ParseCommand(NULL, command, length, 0, &parse) == TCL_OK && parse.numWords >= 2) {
+        const Tcl_Token *wordPtr = parse.tokenPtr;
+        int              i;
+
+        for (i = 0; i < parse.numWords && i < 4; i++) {
+            words[i] = wordPtr;
+            wordPtr += wordPtr->numComponents + 1;
+        }
+        if (BlueprintWordIs(words[0], "proc") && parse.numWords == 4) {
+            kind = 'p';
+            nameTokenPtr = words[1];
+        } else if (BlueprintWordIs(words[0], "variable") && parse.numWords <= 3) {
+            kind = 'v';
+            nameTokenPtr = words[1];
+        } else if (BlueprintWordIs(words[0], "array") && parse.numWords == 4
+                   && BlueprintWordIs(words[1], "set")) {
+            kind = 'a';
+            nameTokenPtr = words[2];
+        } else if (BlueprintWordIs(words[0], "interp") && parse.numWords >= 5
+                   && BlueprintWordIs(words[1], "alias") && BlueprintWordIs(words[2], "")) {
+            kind = 'i';
+            nameTokenPtr = words[3];
+        }
+        if (nameTokenPtr != NULL) {
+            if (nameTokenPtr->type == TCL_TOKEN_SIMPLE_WORD) {
+                *namePtr = nameTokenPtr->start;
+                *nameLengthPtr = nameTokenPtr->size;
+            } else {
+                kind = '\0';
+            }
+        }
+        Tcl_FreeParse(&parse);
+    }
+    return kind;
+}
+
+static bool
+BlueprintWordIs(const Tcl_Token *tokenPtr, const char *literal)
+{
+    size_t length = strlen(literal);
+
+    return (tokenPtr->type == TCL_TOKEN_SIMPLE_WORD
+            && (size_t)tokenPtr[1].size == length
+            && strncmp(tokenPtr[1].start, literal, length) == 0);
+}
+
+static void
+BlueprintDefinitionKey(Tcl_DString *dsPtr, const char *nsName, TCL_SIZE_T nsLength,
+                       char kind, const char *name, TCL_SIZE_T nameLength)
+{
+    NS_NONNULL_ASSERT(dsPtr != NULL);
+    NS_NONNULL_ASSERT(name != NULL);
+
+    Tcl_DStringSetLength(dsPtr, 0);
+    if (nsName != NULL) {
+        Tcl_DStringAppend(dsPtr, nsName, nsLength);
+    }
+    Tcl_DStringAppend(dsPtr, "\n", 1);
+    Tcl_DStringAppend(dsPtr, &kind, 1);
+    Tcl_DStringAppend(dsPtr, name, nameLength);
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * BlueprintDeltaNew --
+ *
+ *      Allocate a delta script.
+ *
+ * Results:
+ *      New delta, to be freed together with its blueprint.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static BlueprintDelta *
+BlueprintDeltaNew(int fromEpoch, int toEpoch, const char *script, TCL_SIZE_T length)
+{
+    BlueprintDelta *deltaPtr;
+
+    NS_NONNULL_ASSERT(script != NULL);
+
+    deltaPtr = ns_malloc(sizeof(BlueprintDelta) + (size_t)length);
+    deltaPtr->nextPtr = NULL;
+    deltaPtr->fromEpoch = fromEpoch;
+    deltaPtr->toEpoch = toEpoch;
+    deltaPtr->length = length;
+    memcpy(deltaPtr->script, script, (size_t)length);
+    deltaPtr->script[length] = '\0';
+
+    return deltaPtr;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * BlueprintFindDelta --
+ *
+ *      Find the delta of the blueprint applicable to an interp, which was
+ *      last updated to the provided epoch.
+ *
+ * Results:
+ *      The first delta to be evaluated, followed by the deltas of the
+ *      subsequent epochs via nextPtr, or NULL, when the interp has to
+ *      replay the full blueprint.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static const BlueprintDelta *
+BlueprintFindDelta(const Blueprint *blueprintPtr, int epoch)
+{
+    const BlueprintDelta *deltaPtr;
+
+    NS_NONNULL_ASSERT(blueprintPtr != NULL);
+
+    for (deltaPtr = blueprintPtr->deltas; deltaPtr != NULL; deltaPtr = deltaPtr->nextPtr) {
+        if (deltaPtr->fromEpoch == epoch) {
+            break;
+        }
+    }
+    return deltaPtr;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * AddInterpTime --
+ *
+ *      Add the time needed for creating or updating an interp to the
+ *      statistics of the server. Updates are accounted as well per
+ *      epoch.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Updates the statistics reported by "ns_ictl stats".
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+AddInterpTime(NsServer *servPtr, const Ns_Time *timePtr, int updateEpoch, bool isDelta)
+{
+    Ns_Time *totalPtr, *maxPtr;
+
+    NS_NONNULL_ASSERT(servPtr != NULL);
+    NS_NONNULL_ASSERT(timePtr != NULL);
+
+    Ns_MutexLock(&updateLock);
+    if (updateEpoch > 0) {
+        const unsigned int slot = (unsigned int)updateEpoch % NS_ICTL_EPOCH_STATS;
+
+        if (servPtr->tcl.stats.epochs[slot].epoch != updateEpoch) {
+            memset(&servPtr->tcl.stats.epochs[slot], 0, sizeof(servPtr->tcl.stats.epochs[slot]));
+            servPtr->tcl.stats.epochs[slot].epoch = updateEpoch;
+        }
+        servPtr->tcl.stats.epochs[slot].updated++;
+        Ns_IncrTime(&servPtr->tcl.stats.epochs[slot].updateTime, timePtr->sec, timePtr->usec);
+        if (isDelta) {
+            servPtr->tcl.stats.epochs[slot].deltaUpdated++;
+            servPtr->tcl.stats.deltaUpdated++;
+        }
+        servPtr->tcl.stats.updated++;
+        totalPtr = &servPtr->tcl.stats.updateTime;
+        maxPtr = &servPtr->tcl.stats.updateTimeMax;
+    } else {
+        servPtr->tcl.stats.created++;
+        totalPtr = &servPtr->tcl.stats.createTime;
+        maxPtr = &servPtr->tcl.stats.createTimeMax;
+    }
+    Ns_IncrTime(totalPtr, timePtr->sec, timePtr->usec);
+    if (Ns_DiffTime(timePtr, maxPtr, NULL) > 0) {
+        *maxPtr = *timePtr;
+    }
+    Ns_MutexUnlock(&updateLock);
+}
+
 
 /*
  *----------------------------------------------------------------------
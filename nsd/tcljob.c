@@ -195,6 +195,9 @@ static Queue* NewQueue(const char* queueName, const char* queueDesc, int maxThre
 static void   FreeQueue(Queue *queue)
     NS_GNUC_NONNULL(1);
 
+static bool   ScheduleJob(Job *jobPtr, bool head)
+    NS_GNUC_NONNULL(1);
+
 static Job*   NewJob(const NsServer *servPtr, const char *queueName,
                      JobTypes type, const char *script)
     NS_GNUC_NONNULL(2,4)
@@ -615,37 +618,9 @@ JobQueueObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_SIZE_T objc, Tcl_O
             jobIdLength = (TCL_SIZE_T)strlen(buf);
         }
 
-        /*
-         * Add the job to the thread pool's job list, if "-head" is
-         * specified, insert new job at the beginning, otherwise
-         * append new job to the end.
-         */
-        if (head != 0) {
-            jobPtr->nextPtr = tp.firstPtr;
-            tp.firstPtr = jobPtr;
-        } else {
-            Job  **nextPtrPtr = &tp.firstPtr;
-
-            while (*nextPtrPtr != NULL) {
-                nextPtrPtr = &((*nextPtrPtr)->nextPtr);
-            }
-            *nextPtrPtr = jobPtr;
-        }
-
-        /*
-         * Start a new thread if there are less than maxThreads
-         * currently running and there currently no idle threads.
-         */
-        if (tp.nidle == 0 && tp.nthreads < tp.maxThreads) {
-            create = NS_TRUE;
-            ++tp.nthreads;
-        } else {
-            create = NS_FALSE;
-        }
-
         Tcl_DStringAppend(&jobPtr->id, jobIdString, jobIdLength);
         Tcl_SetHashValue(hPtr, jobPtr);
-        Ns_CondBroadcast(&tp.cond);
+        create = ScheduleJob(jobPtr, (head != 0));
 
     releaseQueue:
         if (queue != NULL) {
@@ -663,6 +638,127 @@ JobQueueObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_SIZE_T objc, Tcl_O
 }
 
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * NsJobQueueDetached --
+ *
+ *          Queue a detached job from C code, e.g. for background
+ *          refreshes of cache entries. When the named queue does not
+ *          exist, it is created with the default number of threads.
+ *
+ * Results:
+ *          NS_OK or NS_ERROR, when the system or the queue is
+ *          shutting down.
+ *
+ * Side effects:
+ *          Might create a queue and a job thread.
+ *
+ *----------------------------------------------------------------------
+ */
+Ns_ReturnCode
+NsJobQueueDetached(const NsServer *servPtr, const char *queueName, const char *queueDesc,
+                   const char *script)
+{
+    Ns_ReturnCode  status = NS_OK;
+    Queue         *queue = NULL;
+    Tcl_HashEntry *hPtr;
+    bool           create = NS_FALSE;
+    int            isNew;
+
+    NS_NONNULL_ASSERT(queueName != NULL);
+    NS_NONNULL_ASSERT(queueDesc != NULL);
+    NS_NONNULL_ASSERT(script != NULL);
+
+    Ns_MutexLock(&tp.queuelock);
+    hPtr = Tcl_CreateHashEntry(&tp.queues, queueName, &isNew);
+    if (isNew != 0) {
+        Tcl_SetHashValue(hPtr, NewQueue(Ns_TclGetHashKeyString(&tp.queues, hPtr), queueDesc,
+                                        NS_JOB_DEFAULT_MAXTHREADS));
+    }
+    (void) LookupQueue(NULL, queueName, &queue, NS_TRUE);
+    assert(queue != NULL);
+
+    if (tp.req == THREADPOOL_REQ_STOP || queue->req == QUEUE_REQ_DELETE) {
+        status = NS_ERROR;
+    } else {
+        Job  *jobPtr = NewJob(servPtr, queue->name, JOB_DETACHED, script);
+        char  buf[100];
+
+        Ns_GetTime(&jobPtr->startTime);
+        memcpy(buf, "job", 3);
+        do {
+            (void) ns_uint64toa(&buf[3], (uint64_t)queue->nextid++);
+            hPtr = Tcl_CreateHashEntry(&queue->jobs, buf, &isNew);
+        } while (isNew == 0);
+
+        Tcl_DStringAppend(&jobPtr->id, buf, TCL_INDEX_NONE);
+        Tcl_SetHashValue(hPtr, jobPtr);
+        create = ScheduleJob(jobPtr, NS_FALSE);
+    }
+    (void)ReleaseQueue(queue, NS_TRUE);
+    Ns_MutexUnlock(&tp.queuelock);
+
+    if (create) {
+        Ns_ThreadCreate(JobThread, NULL, 0, NULL);
+    }
+    return status;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ScheduleJob --
+ *
+ *          Add the job to the thread pool's job list. When "head" is
+ *          specified, insert the new job at the beginning, otherwise
+ *          append the new job to the end. Must be called with the
+ *          queuelock held.
+ *
+ * Results:
+ *          NS_TRUE, when the caller has to start a new job thread.
+ *
+ * Side effects:
+ *          Wakes up idle job threads.
+ *
+ *----------------------------------------------------------------------
+ */
+static bool
+ScheduleJob(Job *jobPtr, bool head)
+{
+    bool create;
+
+    NS_NONNULL_ASSERT(jobPtr != NULL);
+
+    if (head) {
+        jobPtr->nextPtr = tp.firstPtr;
+        tp.firstPtr = jobPtr;
+    } else {
+        Job  **nextPtrPtr = &tp.firstPtr;
+
+        while (*nextPtrPtr != NULL) {
+            nextPtrPtr = &((*nextPtrPtr)->nextPtr);
+        }
+        *nextPtrPtr = jobPtr;
+    }
+
+    /*
+     * Start a new thread if there are less than maxThreads
+     * currently running and there currently no idle threads.
+     */
+    if (tp.nidle == 0 && tp.nthreads < tp.maxThreads) {
+        create = NS_TRUE;
+        ++tp.nthreads;
+    } else {
+        create = NS_FALSE;
+    }
+    Ns_CondBroadcast(&tp.cond);
+
+    return create;
+}
+
+
 /*
  *----------------------------------------------------------------------
  *
@@ -28,8 +28,21 @@ typedef struct Bucket {
     Ns_Mutex        mlock;
     Tcl_HashTable   arrays;
     const NsServer *servPtr;
+    int             nstriped;  /* Number of striped arrays in this bucket. */
 } Bucket;
 
+/*
+ * The following structure defines a stripe of a striped array.  The keys
+ * of a striped array are distributed over the stripes, each having its own
+ * lock, such that operations on different keys of the same array do not
+ * serialize on the lock of the bucket.
+ */
+
+typedef struct Stripe {
+    Ns_RWLock       rwlock;
+    Tcl_HashTable   vars;
+} Stripe;
+
 /*
  * The following structure maintains the context for each
  * variable array.
@@ -38,10 +51,72 @@ typedef struct Bucket {
 typedef struct Array {
     Bucket        *bucketPtr; /* Array bucket. */
     Tcl_HashEntry *entryPtr;  /* Entry in bucket array table. */
-    Tcl_HashTable  vars;      /* Table of variables. */
+    Tcl_HashTable  vars;      /* Table of variables, when not striped. */
+    Stripe        *stripes;   /* Stripes of the array or NULL. */
+    unsigned int   nstripes;  /* Number of stripes, 0 when not striped. */
     long           locks;     /* Number of array locks */
+    int64_t        contended; /* Number of locks which had to wait. */
 } Array;
 
+/*
+ * The following structure defines a string element of a list or dict
+ * value.
+ */
+
+typedef struct VarElem {
+    char       *string;
+    TCL_SIZE_T  length;
+} VarElem;
+
+/*
+ * The following structure defines the shared representation of list and
+ * dict values.  Dicts keep their keys and values as alternating elements
+ * plus an index of the key positions.  The representation is reference
+ * counted and shared with the Tcl_Objs returned by the nsv commands.  It is
+ * modified in place only when it is not shared (copy-on-write).
+ */
+
+typedef struct VarRep {
+    int64_t        refCount;  /* Atomic reference count. */
+    TCL_SIZE_T     nelems;    /* Number of elements in use. */
+    TCL_SIZE_T     size;      /* Number of allocated elements. */
+    VarElem       *elems;     /* List elements, or keys and values of dicts. */
+    Tcl_HashTable *indexPtr;  /* Key positions of dicts, NULL for lists. */
+} VarRep;
+
+/*
+ * The following structure defines the value of an array variable.  Values
+ * are kept in the type they were provided in, when this type is known,
+ * such that they are not converted from and to strings on every access.
+ * Integer values are updated atomically by concurrent increments holding
+ * only a shared lock.
+ */
+
+typedef enum {
+    VAR_STRING,
+    VAR_INT,
+    VAR_DOUBLE,
+    VAR_BYTES,
+    VAR_LIST,
+    VAR_DICT
+} VarType;
+
+typedef struct Var {
+    VarType type;
+    union {
+        VarElem  string;   /* VAR_STRING and VAR_BYTES */
+        int64_t  counter;  /* VAR_INT */
+        double   number;   /* VAR_DOUBLE */
+        VarRep  *repPtr;   /* VAR_LIST and VAR_DICT */
+    } v;
+} Var;
+
+/*
+ * Maximum number of stripes of an array.
+ */
+
+#define NSV_MAX_STRIPES 1024
+
 
 /*
  * Local functions defined in this file.
@@ -56,19 +131,113 @@ static void UpdateVar(Tcl_HashEntry *hPtr, const char *value, size_t len)
 static int IncrVar(Array *arrayPtr, const char *keyString, int incr, Tcl_WideInt *valuePtr)
     NS_GNUC_NONNULL(1,2,4);
 
+static bool IncrCounter(Array *arrayPtr, const char *keyString, int incr, Tcl_WideInt *valuePtr)
+    NS_GNUC_NONNULL(1,2,4);
+
+static void SetVarObj(Array *arrayPtr, const char *keyString, Tcl_Obj *valueObj)
+    NS_GNUC_NONNULL(1,2,3);
+
+static Var *GetVar(Tcl_HashEntry *hPtr)
+    NS_GNUC_NONNULL(1) NS_GNUC_RETURNS_NONNULL;
+
+static void VarClear(Var *varPtr)
+    NS_GNUC_NONNULL(1);
+
+static void VarSetString(Var *varPtr, const char *value, TCL_SIZE_T length)
+    NS_GNUC_NONNULL(1,2);
+
+static void VarSetObj(Var *varPtr, Tcl_Obj *valueObj)
+    NS_GNUC_NONNULL(1,2);
+
+static Tcl_Obj *VarObj(const Var *varPtr)
+    NS_GNUC_NONNULL(1) NS_GNUC_RETURNS_NONNULL;
+
+static Tcl_Obj *VarRefObj(const Var *varPtr)
+    NS_GNUC_NONNULL(1) NS_GNUC_RETURNS_NONNULL;
+
+static Tcl_Obj *VarDictObj(const Var *varPtr, Tcl_Obj *firstKeyObj)
+    NS_GNUC_NONNULL(1) NS_GNUC_RETURNS_NONNULL;
+
+static void VarAppend(Tcl_DString *dsPtr, const Var *varPtr)
+    NS_GNUC_NONNULL(1,2);
+
+static bool VarToList(Var *varPtr)
+    NS_GNUC_NONNULL(1);
+
+static int VarToDict(Tcl_Interp *interp, Var *varPtr)
+    NS_GNUC_NONNULL(2);
+
+static void VarFree(Var *varPtr)
+    NS_GNUC_NONNULL(1);
+
+static VarRep *VarRepNew(TCL_SIZE_T size, bool isDict)
+    NS_GNUC_RETURNS_NONNULL;
+
+static VarRep *VarRepUnshare(Var *varPtr)
+    NS_GNUC_NONNULL(1) NS_GNUC_RETURNS_NONNULL;
+
+static void VarRepRelease(VarRep *repPtr)
+    NS_GNUC_NONNULL(1);
+
+static void VarRepAppend(VarRep *repPtr, const char *string, TCL_SIZE_T length)
+    NS_GNUC_NONNULL(1,2);
+
+static const VarElem *VarRepDictGet(const VarRep *repPtr, const char *keyString)
+    NS_GNUC_NONNULL(1,2);
+
+static void VarRepDictPut(VarRep *repPtr, Tcl_Obj *keyObj, Tcl_Obj *valueObj)
+    NS_GNUC_NONNULL(1,2,3);
+
+static void VarRepDictRemove(VarRep *repPtr, const char *keyString)
+    NS_GNUC_NONNULL(1,2);
+
+static Tcl_Obj *VarRepObj(const VarRep *repPtr)
+    NS_GNUC_NONNULL(1) NS_GNUC_RETURNS_NONNULL;
+
+static Tcl_FreeInternalRepProc FreeNsvValueInternalRep;
+static Tcl_DupInternalRepProc  DupNsvValueInternalRep;
+static Tcl_UpdateStringProc    UpdateStringOfNsvValue;
+
 static Ns_ReturnCode Unset(Array *arrayPtr, const char *keyString)
     NS_GNUC_NONNULL(1);
 
 static void Flush(Array *arrayPtr)
     NS_GNUC_NONNULL(1);
 
-static Array *LockArray(const NsServer *servPtr, const char *arrayName, bool create, NS_RW rw)
+static void DeleteArray(Array *arrayPtr)
+    NS_GNUC_NONNULL(1);
+
+static void SetStripes(Array *arrayPtr, unsigned int nstripes)
+    NS_GNUC_NONNULL(1);
+
+static Tcl_HashTable *KeyTable(Array *arrayPtr, const char *keyString)
+    NS_GNUC_NONNULL(1,2) NS_GNUC_RETURNS_NONNULL;
+
+static unsigned int ArrayTableCount(const Array *arrayPtr)
+    NS_GNUC_NONNULL(1) NS_GNUC_PURE;
+
+static Tcl_HashTable *ArrayTable(Array *arrayPtr, unsigned int i)
+    NS_GNUC_NONNULL(1) NS_GNUC_RETURNS_NONNULL;
+
+static bool BucketLock(Bucket *bucketPtr, NS_RW rw)
+    NS_GNUC_NONNULL(1);
+
+static void BucketUnlock(Bucket *bucketPtr)
+    NS_GNUC_NONNULL(1);
+
+static Array *LockBucketArray(Bucket *bucketPtr, const char *arrayName, const char *keyString,
+                              bool create, NS_RW rw)
     NS_GNUC_NONNULL(1,2);
 
-static void UnlockArray(const Array *arrayPtr)
+static Array *LockArray(const NsServer *servPtr, const char *arrayName, const char *keyString,
+                        bool create, NS_RW rw)
+    NS_GNUC_NONNULL(1,2);
+
+static void UnlockArray(Array *arrayPtr, const char *keyString)
     NS_GNUC_NONNULL(1);
 
-static Array *LockArrayObj(Tcl_Interp *interp, Tcl_Obj *arrayObj, bool create, NS_RW rw)
+static Array *LockArrayObj(Tcl_Interp *interp, Tcl_Obj *arrayObj, const char *keyString,
+                           bool create, NS_RW rw)
     NS_GNUC_NONNULL(1,2);
 
 static Array *GetArray(Bucket *bucketPtr, const char *arrayName, bool create)
@@ -78,9 +247,29 @@ static unsigned int BucketIndex(const char *arrayName)
     NS_GNUC_NONNULL(1) NS_GNUC_PURE;
 
 static int GetArrayAndKey(Tcl_Interp *interp, Tcl_Obj *arrayObj, const char *keyString,
-                          NS_RW rw, Array  **arrayPtrPtr, Tcl_Obj **objPtr)
+                          NS_RW rw, Array  **arrayPtrPtr, Var **varPtrPtr)
     NS_GNUC_NONNULL(1,2,3,5,6);
 
+/*
+ * Local variables defined in this file.
+ */
+
+static CONST86 Tcl_ObjType nsvValueType = {
+    "nsv:value",
+    FreeNsvValueInternalRep,
+    DupNsvValueInternalRep,
+    UpdateStringOfNsvValue,
+    NULL
+#ifdef TCL_OBJTYPE_V0
+   ,TCL_OBJTYPE_V0
+#endif
+};
+
+static const Tcl_ObjType *listTypePtr;
+static const Tcl_ObjType *dictTypePtr;
+static const Tcl_ObjType *doubleTypePtr;
+static const Tcl_ObjType *wideIntTypePtr;
+
 
 /*
  *-----------------------------------------------------------------------------
@@ -120,6 +309,7 @@ NsTclCreateBuckets(const NsServer *servPtr, int nbuckets)
         buckets[nbuckets].rwlock = NULL;
         buckets[nbuckets].mlock = NULL;
         buckets[nbuckets].servPtr = servPtr;
+        buckets[nbuckets].nstriped = 0;
         if (servPtr->nsv.rwlocks) {
             Ns_RWLockInit(&buckets[nbuckets].rwlock);
             Ns_RWLockSetName2(&buckets[nbuckets].rwlock, buf, servPtr->server);
@@ -132,6 +322,49 @@ NsTclCreateBuckets(const NsServer *servPtr, int nbuckets)
     return buckets;
 }
 
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * NsTclInitNsvType --
+ *
+ *      Determine the Tcl_ObjTypes of values which are stored in typed form
+ *      in nsv arrays and register the type of the values returned by nsv
+ *      commands.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+void
+NsTclInitNsvType(void)
+{
+    Tcl_Obj *tmpObj, *elemObj = Tcl_NewStringObj("x", 1);
+
+    tmpObj = Tcl_NewListObj(1, &elemObj);
+    listTypePtr = tmpObj->typePtr;
+    Tcl_DecrRefCount(tmpObj);
+
+    tmpObj = Tcl_NewDictObj();
+    dictTypePtr = tmpObj->typePtr;
+    Tcl_DecrRefCount(tmpObj);
+
+    tmpObj = Tcl_NewDoubleObj(0.5);
+    doubleTypePtr = tmpObj->typePtr;
+    Tcl_DecrRefCount(tmpObj);
+
+    tmpObj = Tcl_NewWideIntObj(INT64_MAX);
+    wideIntTypePtr = tmpObj->typePtr;
+    Tcl_DecrRefCount(tmpObj);
+
+    Tcl_RegisterObjType(&nsvValueType);
+}
+
 
 /*
  *-----------------------------------------------------------------------------
@@ -160,7 +393,8 @@ NsTclNsvGetObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp,
         result = TCL_ERROR;
 
     } else {
-        Array *arrayPtr = LockArrayObj(interp, objv[1], NS_FALSE, NS_READ);
+        const char *keyString = Tcl_GetString(objv[2]);
+        Array      *arrayPtr = LockArrayObj(interp, objv[1], keyString, NS_FALSE, NS_READ);
 
         if (unlikely(arrayPtr == NULL)) {
             result = TCL_ERROR;
@@ -168,11 +402,10 @@ NsTclNsvGetObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp,
         } else {
             Tcl_Obj             *resultObj;
             const Tcl_HashEntry *hPtr;
-            const char          *keyString = Tcl_GetString(objv[2]);
 
-            hPtr = Tcl_FindHashEntry(&arrayPtr->vars, keyString);
-            resultObj = likely(hPtr != NULL) ? Tcl_NewStringObj(Tcl_GetHashValue(hPtr), TCL_INDEX_NONE) : NULL;
-            UnlockArray(arrayPtr);
+            hPtr = Tcl_FindHashEntry(KeyTable(arrayPtr, keyString), keyString);
+            resultObj = likely(hPtr != NULL) ? VarObj(Tcl_GetHashValue(hPtr)) : NULL;
+            UnlockArray(arrayPtr, keyString);
 
             if (objc == 3) {
                 if (likely(resultObj != NULL)) {
@@ -222,14 +455,15 @@ NsTclNsvExistsObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp,
         Tcl_WrongNumArgs(interp, 1, objv, "/array/ /key/");
         result = TCL_ERROR;
     } else {
-        bool   exists = NS_FALSE;
-        Array *arrayPtr = LockArrayObj(interp, objv[1], NS_FALSE, NS_READ);
+        bool        exists = NS_FALSE;
+        const char *keyString = Tcl_GetString(objv[2]);
+        Array      *arrayPtr = LockArrayObj(interp, objv[1], keyString, NS_FALSE, NS_READ);
 
         if (likely(arrayPtr != NULL)) {
-            if (Tcl_FindHashEntry(&arrayPtr->vars, Tcl_GetString(objv[2])) != NULL) {
+            if (Tcl_FindHashEntry(KeyTable(arrayPtr, keyString), keyString) != NULL) {
                 exists = NS_TRUE;
             }
-            UnlockArray(arrayPtr);
+            UnlockArray(arrayPtr, keyString);
         }
         Tcl_SetObjResult(interp, Tcl_NewBooleanObj(exists));
         result = TCL_OK;
@@ -247,10 +481,10 @@ SetResultToOldValue(Tcl_Interp *interp, Array *arrayPtr, const char *key)
     /*
      * Get old value
      */
-    hPtr = Tcl_FindHashEntry(&arrayPtr->vars, key);
+    hPtr = Tcl_FindHashEntry(KeyTable(arrayPtr, key), key);
     if (likely(hPtr != NULL)) {
         result = NS_TRUE;
-        Tcl_SetObjResult(interp, Tcl_NewStringObj(Tcl_GetHashValue(hPtr), TCL_INDEX_NONE));
+        Tcl_SetObjResult(interp, VarObj(Tcl_GetHashValue(hPtr)));
     } else {
         result = NS_FALSE;
         Tcl_SetObjResult(interp, NsAtomObj(NS_ATOM_EMPTY));
@@ -306,11 +540,9 @@ NsTclNsvSetObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp,
         result = TCL_ERROR;
 
     } else if (valueObj != NULL) {
-        TCL_SIZE_T  len;
-        bool        setArrayValue = NS_TRUE, returnNewValue = NS_TRUE;
-        const char *value = Tcl_GetStringFromObj(valueObj, &len);
+        bool setArrayValue = NS_TRUE, returnNewValue = NS_TRUE;
 
-        arrayPtr = LockArrayObj(interp, arrayObj, NS_TRUE, NS_WRITE);
+        arrayPtr = LockArrayObj(interp, arrayObj, keyString, NS_TRUE, NS_WRITE);
         assert(arrayPtr != NULL);
 
         /*
@@ -345,9 +577,9 @@ NsTclNsvSetObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp,
          * Set the array to the provided value.
          */
         if (setArrayValue) {
-            SetVar(arrayPtr, keyString, value, (size_t)len);
+            SetVarObj(arrayPtr, keyString, valueObj);
         }
-        UnlockArray(arrayPtr);
+        UnlockArray(arrayPtr, keyString);
 
         if (returnNewValue) {
             Tcl_SetObjResult(interp, valueObj);
@@ -359,14 +591,14 @@ NsTclNsvSetObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp,
          * Get the old value and unset.
          */
 
-        arrayPtr = LockArrayObj(interp, arrayObj, NS_FALSE, NS_WRITE);
+        arrayPtr = LockArrayObj(interp, arrayObj, keyString, NS_FALSE, NS_WRITE);
         if (unlikely(arrayPtr == NULL)) {
             result = TCL_ERROR;
 
         } else {
             SetResultToOldValue(interp, arrayPtr, keyString);
             (void) Unset(arrayPtr, keyString);
-            UnlockArray(arrayPtr);
+            UnlockArray(arrayPtr, keyString);
         }
 
     } else if (doDefault == (int)NS_TRUE) {
@@ -380,17 +612,17 @@ NsTclNsvSetObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp,
          * "ns_set" behaving like "nsv_get".
          */
 
-        arrayPtr = LockArrayObj(interp, objv[1], NS_FALSE, NS_READ);
+        arrayPtr = LockArrayObj(interp, arrayObj, keyString, NS_FALSE, NS_READ);
         if (arrayPtr == NULL) {
             result = TCL_ERROR;
         } else {
             const Tcl_HashEntry *hPtr;
 
-            hPtr = Tcl_FindHashEntry(&arrayPtr->vars, keyString);
+            hPtr = Tcl_FindHashEntry(KeyTable(arrayPtr, keyString), keyString);
             if (likely(hPtr != NULL)) {
-                Tcl_SetObjResult(interp, Tcl_NewStringObj(Tcl_GetHashValue(hPtr), TCL_INDEX_NONE));
+                Tcl_SetObjResult(interp, VarObj(Tcl_GetHashValue(hPtr)));
             }
-            UnlockArray(arrayPtr);
+            UnlockArray(arrayPtr, keyString);
             if (hPtr == NULL) {
                 Ns_TclPrintfResult(interp, "no such key: %s", keyString);
                 Tcl_SetErrorCode(interp, "TCL", "LOOKUP", "NSV", "KEY", keyString, NS_SENTINEL);
@@ -433,12 +665,32 @@ NsTclNsvIncrObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp,
         result = TCL_ERROR;
 
     } else {
-        Tcl_WideInt  current;
-        Array       *arrayPtr = LockArrayObj(interp, objv[1], NS_TRUE, NS_WRITE);
+        Tcl_WideInt  current = 0;
+        const char  *keyString = Tcl_GetString(objv[2]);
+        bool         done = NS_FALSE;
+        Array       *arrayPtr;
 
-        assert(arrayPtr != NULL);
-        result = IncrVar(arrayPtr, Tcl_GetString(objv[2]), count, &current);
-        UnlockArray(arrayPtr);
+        /*
+         * Existing counters are incremented atomically under the shared
+         * lock. Only when the variable has to be created or converted, the
+         * exclusive lock is needed.
+         */
+        arrayPtr = LockArrayObj(interp, objv[1], keyString, NS_FALSE, NS_READ);
+        if (likely(arrayPtr != NULL)) {
+            done = IncrCounter(arrayPtr, keyString, count, &current);
+            UnlockArray(arrayPtr, keyString);
+        } else {
+            Tcl_ResetResult(interp);
+        }
+
+        if (likely(done)) {
+            result = TCL_OK;
+        } else {
+            arrayPtr = LockArrayObj(interp, objv[1], keyString, NS_TRUE, NS_WRITE);
+            assert(arrayPtr != NULL);
+            result = IncrVar(arrayPtr, keyString, count, &current);
+            UnlockArray(arrayPtr, keyString);
+        }
 
         if (likely(result == TCL_OK)) {
             Tcl_SetObjResult(interp, Tcl_NewWideIntObj(current));
@@ -478,28 +730,50 @@ NsTclNsvLappendObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp,
     } else {
         Array         *arrayPtr;
         Tcl_HashEntry *hPtr;
+        Var           *varPtr;
         int            isNew;
         TCL_SIZE_T     i;
-        Tcl_DString    ds;
+        const char    *keyString = Tcl_GetString(objv[2]);
+
+        /*
+         * Release a previous result, which might share the list of the
+         * variable and would force a copy on modification.
+         */
+        Tcl_ResetResult(interp);
 
-        arrayPtr = LockArrayObj(interp, objv[1], NS_TRUE, NS_WRITE);
+        arrayPtr = LockArrayObj(interp, objv[1], keyString, NS_TRUE, NS_WRITE);
         assert(arrayPtr != NULL);
 
-        Tcl_DStringInit(&ds);
+        hPtr = Tcl_CreateHashEntry(KeyTable(arrayPtr, keyString), keyString, &isNew);
+        varPtr = GetVar(hPtr);
 
-        hPtr = Tcl_CreateHashEntry(&arrayPtr->vars, Tcl_GetString(objv[2]), &isNew);
-        if (unlikely(isNew == 0)) {
-            Tcl_DStringAppend(&ds, Tcl_GetHashValue(hPtr), TCL_INDEX_NONE);
-        }
+        if (likely(VarToList(varPtr))) {
+            VarRep *repPtr = VarRepUnshare(varPtr);
 
-        for (i = 3; i < objc; ++i) {
-            Tcl_DStringAppendElement(&ds, Tcl_GetString(objv[i]));
-        }
+            for (i = 3; i < objc; ++i) {
+                TCL_SIZE_T  length;
+                const char *value = Tcl_GetStringFromObj(objv[i], &length);
 
-        UpdateVar(hPtr, ds.string, (size_t)ds.length);
-        UnlockArray(arrayPtr);
+                VarRepAppend(repPtr, value, length);
+            }
+            Tcl_SetObjResult(interp, VarRefObj(varPtr));
 
-        Tcl_DStringResult(interp, &ds);
+        } else {
+            Tcl_DString ds;
+
+            /*
+             * The value is not a valid list, append the elements to the
+             * string.
+             */
+            Tcl_DStringInit(&ds);
+            VarAppend(&ds, varPtr);
+            for (i = 3; i < objc; ++i) {
+                Tcl_DStringAppendElement(&ds, Tcl_GetString(objv[i]));
+            }
+            UpdateVar(hPtr, ds.string, (size_t)ds.length);
+            Tcl_DStringResult(interp, &ds);
+        }
+        UnlockArray(arrayPtr, keyString);
     }
     return result;
 }
@@ -536,15 +810,16 @@ NsTclNsvAppendObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp,
         TCL_SIZE_T     i;
         int            isNew;
         Tcl_DString    ds;
+        const char    *keyString = Tcl_GetString(objv[2]);
 
-        arrayPtr = LockArrayObj(interp, objv[1], NS_TRUE, NS_WRITE);
+        arrayPtr = LockArrayObj(interp, objv[1], keyString, NS_TRUE, NS_WRITE);
         assert(arrayPtr != NULL);
 
         Tcl_DStringInit(&ds);
 
-        hPtr = Tcl_CreateHashEntry(&arrayPtr->vars, Tcl_GetString(objv[2]), &isNew);
+        hPtr = Tcl_CreateHashEntry(KeyTable(arrayPtr, keyString), keyString, &isNew);
         if (unlikely(isNew == 0)) {
-            Tcl_DStringAppend(&ds, Tcl_GetHashValue(hPtr), TCL_INDEX_NONE);
+            VarAppend(&ds, Tcl_GetHashValue(hPtr));
         }
 
         for (i = 3; i < objc; ++i) {
@@ -555,7 +830,7 @@ NsTclNsvAppendObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp,
         }
 
         UpdateVar(hPtr, ds.string, (size_t)ds.length);
-        UnlockArray(arrayPtr);
+        UnlockArray(arrayPtr, keyString);
 
         Tcl_DStringResult(interp, &ds);
 
@@ -602,7 +877,7 @@ NsTclNsvUnsetObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp,
         result = TCL_ERROR;
 
     } else {
-        Array *arrayPtr = LockArrayObj(interp, arrayObj, NS_FALSE, NS_WRITE);
+        Array *arrayPtr = LockArrayObj(interp, arrayObj, keyString, NS_FALSE, NS_WRITE);
 
         if (unlikely(arrayPtr == NULL)) {
             result = TCL_ERROR;
@@ -626,10 +901,9 @@ NsTclNsvUnsetObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp,
                  * Delete the hash-table of this array and the entry in the
                  * table of array names.
                  */
-                Tcl_DeleteHashTable(&arrayPtr->vars);
-                Tcl_DeleteHashEntry(arrayPtr->entryPtr);
+                DeleteArray(arrayPtr);
             }
-            UnlockArray(arrayPtr);
+            UnlockArray(arrayPtr, keyString);
 
             if (result == TCL_OK && keyString == NULL) {
                 /*
@@ -695,11 +969,7 @@ NsTclNsvNamesObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_SIZE_T objc,
             Tcl_HashSearch       search;
             Bucket              *bucketPtr = &servPtr->nsv.buckets[i];
 
-            if (servPtr->nsv.rwlocks) {
-                Ns_RWLockRdLock(&bucketPtr->rwlock);
-            } else {
-                Ns_MutexLock(&bucketPtr->mlock);
-            }
+            (void) BucketLock(bucketPtr, NS_READ);
             hPtr = Tcl_FirstHashEntry(&bucketPtr->arrays, &search);
             while (hPtr != NULL) {
                 const char *keyString = Ns_TclGetHashKeyString(&bucketPtr->arrays, hPtr);
@@ -713,11 +983,7 @@ NsTclNsvNamesObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_SIZE_T objc,
                 }
                 hPtr = Tcl_NextHashEntry(&search);
             }
-            if (servPtr->nsv.rwlocks) {
-                Ns_RWLockUnlock(&bucketPtr->rwlock);
-            } else {
-                Ns_MutexUnlock(&bucketPtr->mlock);
-            }
+            BucketUnlock(bucketPtr);
 
             if (unlikely(result != TCL_OK)) {
                 break;
@@ -750,10 +1016,10 @@ NsTclNsvArrayObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp,
 {
     int                      opt, result = TCL_OK;
     static const char *const opts[] = {
-        "set", "reset", "get", "names", "size", "exists", NULL
+        "set", "reset", "get", "names", "size", "exists", "stripes", NULL
     };
     enum ISubCmdIdx {
-        CSetIdx, CResetIdx, CGetIdx, CNamesIdx, CSizeIdx, CExistsIdx
+        CSetIdx, CResetIdx, CGetIdx, CNamesIdx, CSizeIdx, CExistsIdx, CStripesIdx
     };
 
     if (objc < 2) {
@@ -786,18 +1052,16 @@ NsTclNsvArrayObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp,
             } else {
                 TCL_SIZE_T i;
 
-                arrayPtr = LockArrayObj(interp, objv[2], NS_TRUE, NS_WRITE);
+                arrayPtr = LockArrayObj(interp, objv[2], NULL, NS_TRUE, NS_WRITE);
                 assert(arrayPtr != NULL);
 
                 if (opt == (int)CResetIdx) {
                     Flush(arrayPtr);
                 }
                 for (i = 0; i < lobjc; i += 2) {
-                    const char *value = Tcl_GetStringFromObj(lobjv[i+1], &size);
-
-                    SetVar(arrayPtr, Tcl_GetString(lobjv[i]), value, (size_t)size);
+                    SetVarObj(arrayPtr, Tcl_GetString(lobjv[i]), lobjv[i+1]);
                 }
-                UnlockArray(arrayPtr);
+                UnlockArray(arrayPtr, NULL);
             }
             break;
 
@@ -807,12 +1071,17 @@ NsTclNsvArrayObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp,
                 result = TCL_ERROR;
 
             } else {
-                arrayPtr = LockArrayObj(interp, objv[2], NS_FALSE, NS_READ);
+                arrayPtr = LockArrayObj(interp, objv[2], NULL, NS_FALSE, NS_READ);
                 if (arrayPtr == NULL) {
                     size = 0;
                 } else {
-                    size = arrayPtr->vars.numEntries;
-                    UnlockArray(arrayPtr);
+                    unsigned int i;
+
+                    size = 0;
+                    for (i = 0u; i < ArrayTableCount(arrayPtr); i++) {
+                        size += ArrayTable(arrayPtr, i)->numEntries;
+                    }
+                    UnlockArray(arrayPtr, NULL);
                 }
                 Tcl_SetObjResult(interp, Tcl_NewIntObj(size));
             }
@@ -824,12 +1093,12 @@ NsTclNsvArrayObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp,
                 result = TCL_ERROR;
 
             } else {
-                arrayPtr = LockArrayObj(interp, objv[2], NS_FALSE, NS_READ);
+                arrayPtr = LockArrayObj(interp, objv[2], NULL, NS_FALSE, NS_READ);
                 if (arrayPtr == NULL) {
                     size = 0;
                 } else {
                     size = 1;
-                    UnlockArray(arrayPtr);
+                    UnlockArray(arrayPtr, NULL);
                 }
                 Tcl_SetObjResult(interp, Tcl_NewBooleanObj(size));
             }
@@ -844,31 +1113,76 @@ NsTclNsvArrayObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp,
             } else {
                 Tcl_HashSearch  search;
 
-                arrayPtr = LockArrayObj(interp, objv[2], NS_FALSE, NS_READ);
+                arrayPtr = LockArrayObj(interp, objv[2], NULL, NS_FALSE, NS_READ);
                 Tcl_ResetResult(interp);
                 if (arrayPtr != NULL) {
-                    Tcl_Obj             *listObj = Tcl_NewListObj(0, NULL);
-                    const Tcl_HashEntry *hPtr    = Tcl_FirstHashEntry(&arrayPtr->vars, &search);
-                    const char          *pattern = (objc > 3) ? Tcl_GetString(objv[3]) : NULL;
-
-                    while (hPtr != NULL) {
-                        const char *keyString = Ns_TclGetHashKeyString(&arrayPtr->vars, hPtr);
-
-                        if ((pattern == NULL) || (Tcl_StringMatch(keyString, pattern) != 0)) {
-                            Tcl_ListObjAppendElement(interp, listObj, Tcl_NewStringObj(keyString, TCL_INDEX_NONE));
-                            if (opt == (int)CGetIdx) {
-                                Tcl_ListObjAppendElement(interp, listObj,
-                                                         Tcl_NewStringObj(Tcl_GetHashValue(hPtr), TCL_INDEX_NONE));
+                    Tcl_Obj      *listObj = Tcl_NewListObj(0, NULL);
+                    const char   *pattern = (objc > 3) ? Tcl_GetString(objv[3]) : NULL;
+                    unsigned int  i;
+
+                    for (i = 0u; i < ArrayTableCount(arrayPtr); i++) {
+                        Tcl_HashTable       *tablePtr = ArrayTable(arrayPtr, i);
+                        const Tcl_HashEntry *hPtr     = Tcl_FirstHashEntry(tablePtr, &search);
+
+                        while (hPtr != NULL) {
+                            const char *keyString = Ns_TclGetHashKeyString(tablePtr, hPtr);
+
+                            if ((pattern == NULL) || (Tcl_StringMatch(keyString, pattern) != 0)) {
+                                Tcl_ListObjAppendElement(interp, listObj, Tcl_NewStringObj(keyString, TCL_INDEX_NONE));
+                                if (opt == (int)CGetIdx) {
+                                    Tcl_ListObjAppendElement(interp, listObj, VarObj(Tcl_GetHashValue(hPtr)));
+                                }
                             }
+                            hPtr = Tcl_NextHashEntry(&search);
                         }
-                        hPtr = Tcl_NextHashEntry(&search);
                     }
-                    UnlockArray(arrayPtr);
+                    UnlockArray(arrayPtr, NULL);
                     Tcl_SetObjResult(interp, listObj);
                 }
             }
             break;
 
+        case CStripesIdx: {
+            Tcl_Obj          *arrayObj;
+            int               nstripes = -1;
+            Ns_ObjvValueRange stripesRange = {0, NSV_MAX_STRIPES};
+            Ns_ObjvSpec       args[] = {
+                {"array",  Ns_ObjvObj, &arrayObj, NULL},
+                {"?count", Ns_ObjvInt, &nstripes, &stripesRange},
+                {NULL, NULL, NULL, NULL}
+            };
+
+            if (Ns_ParseObjv(NULL, args, interp, 2, objc, objv) != NS_OK) {
+                result = TCL_ERROR;
+
+            } else if (nstripes == -1) {
+                /*
+                 * Query the number of stripes of the array.
+                 */
+                arrayPtr = LockArrayObj(interp, arrayObj, NULL, NS_FALSE, NS_READ);
+                Tcl_ResetResult(interp);
+                if (arrayPtr != NULL) {
+                    nstripes = (int)arrayPtr->nstripes;
+                    UnlockArray(arrayPtr, NULL);
+                } else {
+                    nstripes = 0;
+                }
+                Tcl_SetObjResult(interp, Tcl_NewIntObj(nstripes));
+
+            } else {
+                /*
+                 * Redistribute the keys of the (maybe new) array over the
+                 * requested number of stripes.
+                 */
+                arrayPtr = LockArrayObj(interp, arrayObj, NULL, NS_TRUE, NS_WRITE);
+                assert(arrayPtr != NULL);
+                SetStripes(arrayPtr, (unsigned int)nstripes);
+                UnlockArray(arrayPtr, NULL);
+                Tcl_SetObjResult(interp, Tcl_NewIntObj(nstripes));
+            }
+            break;
+        }
+
         default:
             /* unexpected value */
             assert(opt && 0);
@@ -883,8 +1197,9 @@ NsTclNsvArrayObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp,
  *
  * GetArrayAndKey --
  *
- *      Get access to array and dictionary object in one command.  Returns
- *      TCL_ERROR, when either the array or the dict does not exist.
+ *      Get access to array and the variable holding the dictionary in one
+ *      command.  Returns TCL_ERROR, when either the array or the dict does
+ *      not exist.
  *
  * Results:
  *      Tcl result.
@@ -897,29 +1212,29 @@ NsTclNsvArrayObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp,
 static int
 GetArrayAndKey(Tcl_Interp *interp, Tcl_Obj *arrayObj, const char *keyString,
                NS_RW rw,
-               Array **arrayPtrPtr, Tcl_Obj **objPtr)
+               Array **arrayPtrPtr, Var **varPtrPtr)
 {
-    int      result = TCL_OK;
-    Tcl_Obj *obj = NULL;
-    Array   *arrayPtr;
+    int    result = TCL_OK;
+    Var   *varPtr = NULL;
+    Array *arrayPtr;
 
-    arrayPtr = LockArrayObj(interp, arrayObj, NS_FALSE, rw);
+    arrayPtr = LockArrayObj(interp, arrayObj, keyString, NS_FALSE, rw);
     if (arrayPtr != NULL) {
         const Tcl_HashEntry *hPtr;
 
-        hPtr = Tcl_FindHashEntry(&arrayPtr->vars, keyString);
+        hPtr = Tcl_FindHashEntry(KeyTable(arrayPtr, keyString), keyString);
         if (unlikely(hPtr == NULL)) {
             Ns_TclPrintfResult(interp, "no such key: %s", keyString);
             Tcl_SetErrorCode(interp, "TCL", "LOOKUP", "NSV", "KEY", keyString, NS_SENTINEL);
             result = TCL_ERROR;
         } else {
-            obj = Tcl_NewStringObj(Tcl_GetHashValue(hPtr), TCL_INDEX_NONE);
+            varPtr = Tcl_GetHashValue(hPtr);
         }
     } else {
         result = TCL_ERROR;
     }
     *arrayPtrPtr = arrayPtr;
-    *objPtr = obj;
+    *varPtrPtr = varPtr;
 
     return result;
 }
@@ -984,6 +1299,7 @@ NsTclNsvDictObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp,
 
     } else {
         Array      *arrayPtr;
+        Var        *varPtr;
         Tcl_Obj    *arrayObj, *keyObj, *dictKeyObj, *dictObj;
 
         if (opt == CGetdefwithdefaultIdx) {
@@ -1016,8 +1332,32 @@ NsTclNsvDictObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp,
 
             } else {
                 result = GetArrayAndKey(interp, arrayObj, Tcl_GetString(keyObj), NS_READ,
-                                        &arrayPtr, &dictObj);
-                if (result == TCL_OK) {
+                                        &arrayPtr, &varPtr);
+                if (result == TCL_OK && varPtr->type == VAR_DICT) {
+                    const VarRep *repPtr = varPtr->v.repPtr;
+
+                    /*
+                     * Use the dict representation directly.
+                     */
+                    if (opt == CSizeIdx) {
+                        Tcl_SetObjResult(interp, Tcl_NewIntObj(repPtr->nelems / 2));
+                    } else {
+                        Tcl_Obj   *listObj = Tcl_NewListObj(0, NULL);
+                        TCL_SIZE_T i;
+
+                        for (i = 0; i < repPtr->nelems; i += 2) {
+                            const VarElem *elemPtr = &repPtr->elems[i];
+
+                            if (!pattern || Tcl_StringMatch(elemPtr->string, pattern)) {
+                                Tcl_ListObjAppendElement(NULL, listObj,
+                                                         Tcl_NewStringObj(elemPtr->string, elemPtr->length));
+                            }
+                        }
+                        Tcl_SetObjResult(interp, listObj);
+                    }
+
+                } else if (result == TCL_OK) {
+                    dictObj = VarObj(varPtr);
                     if (opt == CSizeIdx) {
                         TCL_SIZE_T size;
 
@@ -1045,7 +1385,7 @@ NsTclNsvDictObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp,
                     Tcl_DecrRefCount(dictObj);
                 }
                 if (arrayPtr != NULL) {
-                    UnlockArray(arrayPtr);
+                    UnlockArray(arrayPtr, Tcl_GetString(keyObj));
                 }
             }
             break;
@@ -1092,10 +1432,23 @@ NsTclNsvDictObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp,
                                    Tcl_GetString(objv[1]));
                 result = TCL_ERROR;
             } else {
+                if (opt == CUnsetIdx) {
+                    /*
+                     * Release a previous result, which might share the
+                     * dict of the variable.
+                     */
+                    Tcl_ResetResult(interp);
+                }
                 result = GetArrayAndKey(interp, arrayObj, Tcl_GetString(keyObj),
                                         (opt != CUnsetIdx ? NS_READ : NS_WRITE),
-                                        &arrayPtr, &dictObj);
+                                        &arrayPtr, &varPtr);
                 if (result == TCL_OK) {
+                    /*
+                     * For dict values, all operations below need from the
+                     * value only the entry of the first dict key.
+                     */
+                    dictKeyObj = (nargs > 0) ? objv[objc-nargs] : NULL;
+
                     if (opt == CUnsetIdx) {
                         /*
                          * dict unset
@@ -1103,26 +1456,40 @@ NsTclNsvDictObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp,
                          * "unset is silent, when dict key does not exist
                          * in the dict.
                          */
-                        if (nargs == 1) {
-                            result = Tcl_DictObjRemove(interp, dictObj,  objv[objc-1]);
-                        } else {
-                            /*
-                             * Nested dict
-                             */
-                            result = Tcl_DictObjRemoveKeyList(interp, dictObj,
-                                                              nargs, &objv[(TCL_SIZE_T)objc-nargs]);
-                        }
+                        result = VarToDict(interp, varPtr);
                         if (result == TCL_OK) {
-                            TCL_SIZE_T dictStringLength;
-                            const char *dictString = Tcl_GetStringFromObj(dictObj, &dictStringLength);
+                            dictObj = VarDictObj(varPtr, dictKeyObj);
+                            Tcl_IncrRefCount(dictObj);
 
-                            SetVar(arrayPtr, Tcl_GetString(keyObj), dictString, (size_t)dictStringLength);
-                            Tcl_SetObjResult(interp, dictObj);
+                            if (nargs == 1) {
+                                result = Tcl_DictObjRemove(interp, dictObj,  objv[objc-1]);
+                            } else {
+                                /*
+                                 * Nested dict
+                                 */
+                                result = Tcl_DictObjRemoveKeyList(interp, dictObj,
+                                                                  nargs, &objv[(TCL_SIZE_T)objc-nargs]);
+                            }
+                            if (result == TCL_OK) {
+                                Tcl_Obj *dictValueObj;
+                                VarRep  *repPtr = VarRepUnshare(varPtr);
+
+                                (void) Tcl_DictObjGet(NULL, dictObj, dictKeyObj, &dictValueObj);
+                                if (dictValueObj != NULL) {
+                                    VarRepDictPut(repPtr, dictKeyObj, dictValueObj);
+                                } else {
+                                    VarRepDictRemove(repPtr, Tcl_GetString(dictKeyObj));
+                                }
+                                Tcl_SetObjResult(interp, VarRefObj(varPtr));
+                            }
+                            Tcl_DecrRefCount(dictObj);
                         }
                     } else {
                         TCL_SIZE_T lastObjc = (opt == CGetdefIdx ? objc -1 : objc);
                         Tcl_Obj   *dictValueObj = NULL;
 
+                        dictObj = VarDictObj(varPtr, dictKeyObj);
+
                         if (nargs == 0) {
                             /*
                              * no keys
@@ -1247,7 +1614,7 @@ NsTclNsvDictObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp,
                     }
                 }
                 if (arrayPtr != NULL) {
-                    UnlockArray(arrayPtr);
+                    UnlockArray(arrayPtr, Tcl_GetString(keyObj));
                 }
             }
             break;
@@ -1255,7 +1622,8 @@ NsTclNsvDictObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp,
 
         case CAppendIdx:  NS_FALL_THROUGH; /* fall through */
         case CIncrIdx:    NS_FALL_THROUGH; /* fall through */
-        case CLappendIdx: NS_FALL_THROUGH; /* fall through */
+        case CLappendIdx:
+            NS_FALL_THROUGH; /* fall through */
         case CSetIdx: {
             /*
              * Operations on a dict key with a value
@@ -1296,24 +1664,44 @@ NsTclNsvDictObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp,
                 result = TCL_ERROR;
 
             } else {
-                const char *keyString;
+                const char          *keyString = Tcl_GetString(keyObj);
                 const Tcl_HashEntry *hPtr;
 
+                /*
+                 * Release a previous result, which might share the dict of
+                 * the variable.
+                 */
+                Tcl_ResetResult(interp);
+
                 /*
                  * Create array and key if it does not exist
                  */
-                arrayPtr = LockArrayObj(interp, arrayObj, NS_TRUE, NS_WRITE);
+                arrayPtr = LockArrayObj(interp, arrayObj, keyString, NS_TRUE, NS_WRITE);
                 assert(arrayPtr != NULL);
 
-                keyString = Tcl_GetString(keyObj);
-                hPtr = Tcl_FindHashEntry(&arrayPtr->vars, keyString);
+                hPtr = Tcl_FindHashEntry(KeyTable(arrayPtr, keyString), keyString);
                 if (likely(hPtr != NULL)) {
-                    dictObj = Tcl_NewStringObj(Tcl_GetHashValue(hPtr), TCL_INDEX_NONE);
+                    varPtr = Tcl_GetHashValue(hPtr);
+                    result = VarToDict(interp, varPtr);
                 } else {
-                    dictObj = Tcl_NewDictObj();
+                    varPtr = NULL;
+                    result = TCL_OK;
                 }
 
-                if (opt == CSetIdx) {
+                /*
+                 * Only the entry of the first dict key is needed from the
+                 * value.
+                 */
+                dictObj = (varPtr != NULL && result == TCL_OK)
+                    ? VarDictObj(varPtr, dictKeyObj)
+                    : Tcl_NewDictObj();
+                Tcl_IncrRefCount(dictObj);
+
+                if (result != TCL_OK) {
+                    /*
+                     * The value is not a dict, error message is already set.
+                     */
+                } else if (opt == CSetIdx) {
                     /*
                      * dict set dictkey:1..n dictvalue
                      */
@@ -1378,16 +1766,23 @@ NsTclNsvDictObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp,
                     }
                 }
                 if (result == TCL_OK) {
-                    const char *dictString;
-                    TCL_SIZE_T  dictStringLength;
+                    Tcl_Obj *dictValueObj;
+
+                    if (varPtr == NULL) {
+                        int isNew;
 
-                    dictString = Tcl_GetStringFromObj(dictObj, &dictStringLength);
-                    SetVar(arrayPtr, keyString, dictString, (size_t)dictStringLength);
-                    Tcl_SetObjResult(interp, dictObj);
+                        varPtr = GetVar(Tcl_CreateHashEntry(KeyTable(arrayPtr, keyString), keyString, &isNew));
+                        (void) VarToDict(NULL, varPtr);
+                    }
+                    (void) Tcl_DictObjGet(NULL, dictObj, dictKeyObj, &dictValueObj);
+                    assert(dictValueObj != NULL);
+                    VarRepDictPut(VarRepUnshare(varPtr), dictKeyObj, dictValueObj);
+                    Tcl_SetObjResult(interp, VarRefObj(varPtr));
                 } else {
                     result = TCL_ERROR;
                 }
-                UnlockArray(arrayPtr);
+                Tcl_DecrRefCount(dictObj);
+                UnlockArray(arrayPtr, keyString);
             }
             break;
         }
@@ -1433,14 +1828,14 @@ Ns_VarGet(const char *server, const char *array, const char *keyString, Tcl_DStr
 
     servPtr = NsGetServer(server);
     if (likely(servPtr != NULL)) {
-        Array *arrayPtr = LockArray(servPtr, array, NS_FALSE, NS_READ);
+        Array *arrayPtr = LockArray(servPtr, array, keyString, NS_FALSE, NS_READ);
         if (likely(arrayPtr != NULL)) {
-            const Tcl_HashEntry *hPtr = Tcl_FindHashEntry(&arrayPtr->vars, keyString);
+            const Tcl_HashEntry *hPtr = Tcl_FindHashEntry(KeyTable(arrayPtr, keyString), keyString);
             if (likely(hPtr != NULL)) {
-                Tcl_DStringAppend(dsPtr, Tcl_GetHashValue(hPtr), TCL_INDEX_NONE);
+                VarAppend(dsPtr, Tcl_GetHashValue(hPtr));
                 status = NS_OK;
             }
-            UnlockArray(arrayPtr);
+            UnlockArray(arrayPtr, keyString);
         }
     }
     return status;
@@ -1475,13 +1870,13 @@ Ns_VarExists(const char *server, const char *array, const char *keyString)
 
     servPtr = NsGetServer(server);
     if (likely(servPtr != NULL)) {
-        Array *arrayPtr = LockArray(servPtr, array, NS_FALSE, NS_READ);
+        Array *arrayPtr = LockArray(servPtr, array, keyString, NS_FALSE, NS_READ);
 
         if (likely(arrayPtr != NULL)) {
-            if (Tcl_FindHashEntry(&arrayPtr->vars, keyString) != NULL) {
+            if (Tcl_FindHashEntry(KeyTable(arrayPtr, keyString), keyString) != NULL) {
                 exists = NS_TRUE;
             }
-            UnlockArray(arrayPtr);
+            UnlockArray(arrayPtr, keyString);
         }
     }
     return exists;
@@ -1518,11 +1913,11 @@ Ns_VarSet(const char *server, const char *array, const char *keyString,
 
     servPtr = NsGetServer(server);
     if (likely(servPtr != NULL)) {
-        Array *arrayPtr = LockArray(servPtr, array, NS_TRUE, NS_WRITE);
+        Array *arrayPtr = LockArray(servPtr, array, keyString, NS_TRUE, NS_WRITE);
 
         if (likely(arrayPtr != NULL)) {
             SetVar(arrayPtr, keyString, value, (len > -1) ? (size_t)len : strlen(value));
-            UnlockArray(arrayPtr);
+            UnlockArray(arrayPtr, keyString);
             status = NS_OK;
         }
     }
@@ -1558,11 +1953,19 @@ Ns_VarIncr(const char *server, const char *array, const char *keyString, int inc
 
     servPtr = NsGetServer(server);
     if (likely(servPtr != NULL)) {
-        Array *arrayPtr = LockArray(servPtr, array, NS_TRUE, NS_WRITE);
+        bool   done = NS_FALSE;
+        Array *arrayPtr = LockArray(servPtr, array, keyString, NS_FALSE, NS_READ);
 
         if (likely(arrayPtr != NULL)) {
-            (void) IncrVar(arrayPtr, keyString, incr, &counter);
-            UnlockArray(arrayPtr);
+            done = IncrCounter(arrayPtr, keyString, incr, &counter);
+            UnlockArray(arrayPtr, keyString);
+        }
+        if (!done) {
+            arrayPtr = LockArray(servPtr, array, keyString, NS_TRUE, NS_WRITE);
+            if (likely(arrayPtr != NULL)) {
+                (void) IncrVar(arrayPtr, keyString, incr, &counter);
+                UnlockArray(arrayPtr, keyString);
+            }
         }
     }
     return counter;
@@ -1600,24 +2003,21 @@ Ns_VarAppend(const char *server, const char *array, const char *keyString,
 
     servPtr = NsGetServer(server);
     if (likely(servPtr != NULL)) {
-        Array  *arrayPtr = LockArray(servPtr, array, NS_TRUE, NS_WRITE);
+        Array  *arrayPtr = LockArray(servPtr, array, keyString, NS_TRUE, NS_WRITE);
         if (likely(arrayPtr != NULL)) {
             Tcl_HashEntry *hPtr;
-            size_t         oldLen, newLen;
-            char          *oldString, *newString;
-
-            hPtr = Tcl_CreateHashEntry(&arrayPtr->vars, keyString, &isNew);
-
-            oldString = Tcl_GetHashValue(hPtr);
-            oldLen = (oldString != NULL) ? strlen(oldString) : 0u;
-
-            newLen = oldLen + ((len > -1) ? (size_t)len : strlen(value)) + 1u;
-            newString = ns_realloc(oldString, newLen + 1u);
-            memcpy(newString + oldLen, value, newLen + 1u);
+            Tcl_DString    ds;
 
-            Tcl_SetHashValue(hPtr, newString);
+            Tcl_DStringInit(&ds);
+            hPtr = Tcl_CreateHashEntry(KeyTable(arrayPtr, keyString), keyString, &isNew);
+            if (isNew == 0) {
+                VarAppend(&ds, Tcl_GetHashValue(hPtr));
+            }
+            Tcl_DStringAppend(&ds, value, (len > -1) ? (TCL_SIZE_T)len : TCL_INDEX_NONE);
+            UpdateVar(hPtr, ds.string, (size_t)ds.length);
+            Tcl_DStringFree(&ds);
 
-            UnlockArray(arrayPtr);
+            UnlockArray(arrayPtr, keyString);
             status = NS_OK;
         }
     }
@@ -1654,19 +2054,22 @@ Ns_VarUnset(const char *server, const char *array, const char *keyString)
 
     servPtr = NsGetServer(server);
     if (likely(servPtr != NULL)) {
-        Array  *arrayPtr = LockArray(servPtr, array, NS_FALSE, NS_WRITE);
+        Array  *arrayPtr = LockArray(servPtr, array, keyString, NS_FALSE, NS_WRITE);
         if (unlikely(arrayPtr == NULL)) {
             /* Error */
         } else {
             status = Unset(arrayPtr, keyString);
             if (status != NS_OK && keyString != NULL) {
                 /* Error, no such key. */
+                UnlockArray(arrayPtr, keyString);
             } else if (status == NS_OK && keyString == NULL) {
                 /* Finish deleting the entire array, same as in NsTclNsvUnsetObjCmd(). */
-                Tcl_DeleteHashTable(&arrayPtr->vars);
-                Tcl_DeleteHashEntry(arrayPtr->entryPtr);
+                DeleteArray(arrayPtr);
+                UnlockArray(arrayPtr, keyString);
+                ns_free(arrayPtr);
+            } else {
+                UnlockArray(arrayPtr, keyString);
             }
-            UnlockArray(arrayPtr);
         }
     }
     return status;
@@ -1751,19 +2154,18 @@ GetArray(Bucket *bucketPtr, const char *arrayName, bool create) {
         } else {
             arrayPtr = ns_malloc(sizeof(Array));
             arrayPtr->locks = 0;
+            arrayPtr->contended = 0;
             arrayPtr->bucketPtr = bucketPtr;
             arrayPtr->entryPtr = hPtr;
+            arrayPtr->stripes = NULL;
+            arrayPtr->nstripes = 0u;
             Tcl_InitHashTable(&arrayPtr->vars, TCL_STRING_KEYS);
             Tcl_SetHashValue(hPtr, arrayPtr);
         }
     } else {
         hPtr = Tcl_FindHashEntry(&bucketPtr->arrays, arrayName);
         if (unlikely(hPtr == NULL)) {
-            if (bucketPtr->servPtr->nsv.rwlocks) {
-                Ns_RWLockUnlock(&bucketPtr->rwlock);
-            } else {
-                Ns_MutexUnlock(&bucketPtr->mlock);
-            }
+            BucketUnlock(bucketPtr);
             return NULL;
         }
         arrayPtr = Tcl_GetHashValue(hPtr);
@@ -1773,101 +2175,1148 @@ GetArray(Bucket *bucketPtr, const char *arrayName, bool create) {
     return arrayPtr;
 }
 
-
+
 /*
  *-----------------------------------------------------------------------------
  *
- * LockArray, UnlockArray --
+ * BucketLock, BucketUnlock --
  *
- *      Lock the array of the given name.
- *      Array structure must be later unlocked with UnlockArray.
+ *      Lock the bucket in the requested mode (in mutex mode, all locks are
+ *      exclusive) resp. unlock it.
  *
  * Results:
- *      Pointer to Array or NULL.
+ *      BucketLock returns NS_TRUE, when the lock was busy and the caller had
+ *      to wait.
  *
  * Side effects;
- *      Array is created if 'create' is 1.
+ *      None.
  *
  *-----------------------------------------------------------------------------
  */
-static Array *
-LockArray(const NsServer *servPtr, const char *arrayName, bool create, NS_RW rw)
+
+static bool
+BucketLock(Bucket *bucketPtr, NS_RW rw)
 {
-    Bucket        *bucketPtr;
-    unsigned int   idx;
+    bool busy;
 
-    NS_NONNULL_ASSERT(servPtr != NULL);
-    NS_NONNULL_ASSERT(arrayName != NULL);
+    NS_NONNULL_ASSERT(bucketPtr != NULL);
 
-    idx = BucketIndex(arrayName);
-    bucketPtr = &servPtr->nsv.buckets[idx % (unsigned int)servPtr->nsv.nbuckets];
-    if (servPtr->nsv.rwlocks) {
+    if (bucketPtr->servPtr->nsv.rwlocks) {
         if (rw == NS_READ) {
-            Ns_RWLockRdLock(&bucketPtr->rwlock);
+            busy = (Ns_RWLockTryRdLock(&bucketPtr->rwlock) != NS_OK);
+            if (busy) {
+                Ns_RWLockRdLock(&bucketPtr->rwlock);
+            }
         } else {
-            Ns_RWLockWrLock(&bucketPtr->rwlock);
+            busy = (Ns_RWLockTryWrLock(&bucketPtr->rwlock) != NS_OK);
+            if (busy) {
+                Ns_RWLockWrLock(&bucketPtr->rwlock);
+            }
         }
     } else {
-        Ns_MutexLock(&bucketPtr->mlock);
+        busy = (Ns_MutexTryLock(&bucketPtr->mlock) != NS_OK);
+        if (busy) {
+            Ns_MutexLock(&bucketPtr->mlock);
+        }
     }
-
-    return GetArray(bucketPtr, arrayName, create);
+    return busy;
 }
 
 static void
-UnlockArray(const Array *arrayPtr)
+BucketUnlock(Bucket *bucketPtr)
 {
-    NS_NONNULL_ASSERT(arrayPtr != NULL);
+    NS_NONNULL_ASSERT(bucketPtr != NULL);
 
-    if (arrayPtr->bucketPtr->servPtr->nsv.rwlocks) {
-        Ns_RWLockUnlock(&((arrayPtr)->bucketPtr->rwlock));
+    if (bucketPtr->servPtr->nsv.rwlocks) {
+        Ns_RWLockUnlock(&bucketPtr->rwlock);
     } else {
-        Ns_MutexUnlock(&((arrayPtr)->bucketPtr->mlock));
+        Ns_MutexUnlock(&bucketPtr->mlock);
     }
 }
 
-
+
 /*
  *-----------------------------------------------------------------------------
  *
- * UpdateVar --
+ * KeyTable, ArrayTableCount, ArrayTable --
  *
- *      Update a variable entry.
+ *      Access the variable tables of an array. KeyTable() returns the table
+ *      containing the given key, ArrayTableCount() and ArrayTable() are used
+ *      for iterating over all tables of an array.
  *
  * Results:
- *      None.
+ *      Pointer to hash table resp. number of tables.
  *
  * Side effects;
- *      New value is set.
+ *      None.
  *
  *-----------------------------------------------------------------------------
  */
 
-static void
-UpdateVar(Tcl_HashEntry *hPtr, const char *value, size_t len)
+static Tcl_HashTable *
+KeyTable(Array *arrayPtr, const char *keyString)
 {
-    char *oldString, *newString;
+    NS_NONNULL_ASSERT(arrayPtr != NULL);
+    NS_NONNULL_ASSERT(keyString != NULL);
 
-    NS_NONNULL_ASSERT(hPtr != NULL);
-    NS_NONNULL_ASSERT(value != NULL);
+    return likely(arrayPtr->nstripes == 0u)
+        ? &arrayPtr->vars
+        : &arrayPtr->stripes[BucketIndex(keyString) % arrayPtr->nstripes].vars;
+}
+
+static unsigned int
+ArrayTableCount(const Array *arrayPtr)
+{
+    NS_NONNULL_ASSERT(arrayPtr != NULL);
+
+    return (arrayPtr->nstripes == 0u) ? 1u : arrayPtr->nstripes;
+}
+
+static Tcl_HashTable *
+ArrayTable(Array *arrayPtr, unsigned int i)
+{
+    NS_NONNULL_ASSERT(arrayPtr != NULL);
+
+    return (arrayPtr->nstripes == 0u) ? &arrayPtr->vars : &arrayPtr->stripes[i].vars;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * LockBucketArray, LockArray, UnlockArray --
+ *
+ *      Lock the array of the given name.  When a key is provided, only
+ *      this key is going to be accessed, otherwise the whole array.
+ *      Array structure must be later unlocked with UnlockArray using the
+ *      same key.
+ *
+ *      For arrays which are not striped, the bucket lock is taken in the
+ *      requested mode.  For striped arrays, key operations take the bucket
+ *      lock shared and lock only the stripe of the key in the requested
+ *      mode, while operations on the whole array need the bucket lock
+ *      exclusively.
+ *
+ * Results:
+ *      Pointer to Array or NULL.
+ *
+ * Side effects;
+ *      Array is created if 'create' is 1.  The contention counter of the
+ *      array is incremented, when a lock was busy.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static Array *
+LockBucketArray(Bucket *bucketPtr, const char *arrayName, const char *keyString,
+                bool create, NS_RW rw)
+{
+    Array *arrayPtr;
+    NS_RW  bucketRw = rw;
+    bool   busy = NS_FALSE;
+
+    NS_NONNULL_ASSERT(bucketPtr != NULL);
+    NS_NONNULL_ASSERT(arrayName != NULL);
+
+    /*
+     * The number of striped arrays is just a hint to avoid relocking in the
+     * common cases, the decision is made below under the lock.
+     */
+    if (keyString != NULL && rw == NS_WRITE && bucketPtr->nstriped > 0) {
+        bucketRw = NS_READ;
+    } else if (keyString == NULL && bucketPtr->nstriped > 0) {
+        bucketRw = NS_WRITE;
+    }
+
+    for (;;) {
+        busy |= BucketLock(bucketPtr, bucketRw);
+        arrayPtr = GetArray(bucketPtr, arrayName, (create && bucketRw == NS_WRITE));
+
+        if (bucketRw == NS_WRITE) {
+            break;
+        } else if (arrayPtr == NULL) {
+            /*
+             * GetArray() has already released the lock.
+             */
+            if (!create) {
+                break;
+            }
+        } else if (arrayPtr->nstripes > 0u ? (keyString != NULL) : (rw == NS_READ)) {
+            break;
+        } else {
+            BucketUnlock(bucketPtr);
+        }
+        bucketRw = NS_WRITE;
+    }
+
+    if (arrayPtr != NULL) {
+        if (keyString != NULL && arrayPtr->nstripes > 0u) {
+            Stripe *stripePtr = &arrayPtr->stripes[BucketIndex(keyString) % arrayPtr->nstripes];
+
+            if (rw == NS_READ) {
+                if (Ns_RWLockTryRdLock(&stripePtr->rwlock) != NS_OK) {
+                    busy = NS_TRUE;
+                    Ns_RWLockRdLock(&stripePtr->rwlock);
+                }
+            } else if (Ns_RWLockTryWrLock(&stripePtr->rwlock) != NS_OK) {
+                busy = NS_TRUE;
+                Ns_RWLockWrLock(&stripePtr->rwlock);
+            }
+        }
+        if (unlikely(busy)) {
+            (void) NS_ATOMIC_FETCH_ADD(&arrayPtr->contended, 1);
+        }
+    }
+
+    return arrayPtr;
+}
+
+static Array *
+LockArray(const NsServer *servPtr, const char *arrayName, const char *keyString,
+          bool create, NS_RW rw)
+{
+    Bucket        *bucketPtr;
+    unsigned int   idx;
+
+    NS_NONNULL_ASSERT(servPtr != NULL);
+    NS_NONNULL_ASSERT(arrayName != NULL);
+
+    idx = BucketIndex(arrayName);
+    bucketPtr = &servPtr->nsv.buckets[idx % (unsigned int)servPtr->nsv.nbuckets];
+
+    return LockBucketArray(bucketPtr, arrayName, keyString, create, rw);
+}
+
+static void
+UnlockArray(Array *arrayPtr, const char *keyString)
+{
+    NS_NONNULL_ASSERT(arrayPtr != NULL);
+
+    if (keyString != NULL && arrayPtr->nstripes > 0u) {
+        Ns_RWLockUnlock(&arrayPtr->stripes[BucketIndex(keyString) % arrayPtr->nstripes].rwlock);
+    }
+    BucketUnlock(arrayPtr->bucketPtr);
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * SetStripes --
+ *
+ *      Change the number of stripes of an array and redistribute the
+ *      existing keys.  A value of 0 turns striping off.  The function
+ *      has to be called with the bucket locked exclusively.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects;
+ *      Stripes are allocated or freed.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+SetStripes(Array *arrayPtr, unsigned int nstripes)
+{
+    Stripe       *stripes = NULL;
+    unsigned int  i;
+
+    NS_NONNULL_ASSERT(arrayPtr != NULL);
+
+    if (nstripes == arrayPtr->nstripes) {
+        return;
+    }
+
+    if (nstripes > 0u) {
+        stripes = ns_malloc(sizeof(Stripe) * nstripes);
+        for (i = 0u; i < nstripes; i++) {
+            stripes[i].rwlock = NULL;
+            Ns_RWLockInit(&stripes[i].rwlock);
+            Ns_RWLockSetName2(&stripes[i].rwlock, "nsv:stripe", arrayPtr->bucketPtr->servPtr->server);
+            Tcl_InitHashTable(&stripes[i].vars, TCL_STRING_KEYS);
+        }
+    }
+
+    /*
+     * Move the values into the new tables.
+     */
+    for (i = 0u; i < ArrayTableCount(arrayPtr); i++) {
+        Tcl_HashTable       *tablePtr = ArrayTable(arrayPtr, i);
+        Tcl_HashSearch       search;
+        const Tcl_HashEntry *hPtr;
+
+        for (hPtr = Tcl_FirstHashEntry(tablePtr, &search);
+             hPtr != NULL;
+             hPtr = Tcl_NextHashEntry(&search)) {
+            const char    *keyString = Tcl_GetHashKey(tablePtr, hPtr);
+            Tcl_HashTable *newTablePtr;
+            Tcl_HashEntry *newPtr;
+            int            isNew;
+
+            newTablePtr = (stripes != NULL)
+                ? &stripes[BucketIndex(keyString) % nstripes].vars
+                : &arrayPtr->vars;
+            newPtr = Tcl_CreateHashEntry(newTablePtr, keyString, &isNew);
+            Tcl_SetHashValue(newPtr, Tcl_GetHashValue(hPtr));
+        }
+    }
+
+    if (arrayPtr->nstripes == 0u) {
+        /*
+         * Keep the table of the array valid but empty.
+         */
+        Tcl_DeleteHashTable(&arrayPtr->vars);
+        Tcl_InitHashTable(&arrayPtr->vars, TCL_STRING_KEYS);
+        arrayPtr->bucketPtr->nstriped++;
+    } else {
+        for (i = 0u; i < arrayPtr->nstripes; i++) {
+            Tcl_DeleteHashTable(&arrayPtr->stripes[i].vars);
+            Ns_RWLockDestroy(&arrayPtr->stripes[i].rwlock);
+        }
+        ns_free(arrayPtr->stripes);
+        if (nstripes == 0u) {
+            arrayPtr->bucketPtr->nstriped--;
+        }
+    }
+    arrayPtr->stripes = stripes;
+    arrayPtr->nstripes = nstripes;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * DeleteArray --
+ *
+ *      Delete the variable tables of a flushed array and its entry in the
+ *      table of array names.  The function has to be called with the bucket
+ *      locked exclusively; the caller has to free the Array structure after
+ *      unlocking.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects;
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+DeleteArray(Array *arrayPtr)
+{
+    NS_NONNULL_ASSERT(arrayPtr != NULL);
+
+    SetStripes(arrayPtr, 0u);
+    Tcl_DeleteHashTable(&arrayPtr->vars);
+    Tcl_DeleteHashEntry(arrayPtr->entryPtr);
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * VarRepNew, VarRepRelease --
+ *
+ *      Create a new representation of a list or dict value, or release a
+ *      reference to it.
+ *
+ * Results:
+ *      VarRepNew() returns the new representation with a reference count
+ *      of 1.
+ *
+ * Side effects;
+ *      The representation is freed, when the last reference is released.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static VarRep *
+VarRepNew(TCL_SIZE_T size, bool isDict)
+{
+    VarRep *repPtr = ns_malloc(sizeof(VarRep));
+
+    repPtr->refCount = 1;
+    repPtr->nelems = 0;
+    repPtr->size = (size > 0) ? size : 8;
+    repPtr->elems = ns_malloc(sizeof(VarElem) * (size_t)repPtr->size);
+    if (isDict) {
+        repPtr->indexPtr = ns_malloc(sizeof(Tcl_HashTable));
+        Tcl_InitHashTable(repPtr->indexPtr, TCL_STRING_KEYS);
+    } else {
+        repPtr->indexPtr = NULL;
+    }
+    return repPtr;
+}
+
+static void
+VarRepRelease(VarRep *repPtr)
+{
+    NS_NONNULL_ASSERT(repPtr != NULL);
+
+    if (NS_ATOMIC_FETCH_ADD(&repPtr->refCount, -1) == 1) {
+        TCL_SIZE_T i;
+
+        for (i = 0; i < repPtr->nelems; i++) {
+            ns_free(repPtr->elems[i].string);
+        }
+        ns_free(repPtr->elems);
+        if (repPtr->indexPtr != NULL) {
+            Tcl_DeleteHashTable(repPtr->indexPtr);
+            ns_free(repPtr->indexPtr);
+        }
+        ns_free(repPtr);
+    }
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * VarRepUnshare --
+ *
+ *      Make sure, the list or dict representation of a variable is not
+ *      shared with Tcl_Objs, before it is modified in place.  The function
+ *      has to be called with the key locked exclusively.
+ *
+ * Results:
+ *      The representation of the variable.
+ *
+ * Side effects;
+ *      A shared representation is copied.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static VarRep *
+VarRepUnshare(Var *varPtr)
+{
+    VarRep *repPtr;
+
+    NS_NONNULL_ASSERT(varPtr != NULL);
+    assert(varPtr->type == VAR_LIST || varPtr->type == VAR_DICT);
+
+    repPtr = varPtr->v.repPtr;
+
+    /*
+     * New references are only created while holding a lock on the key, so
+     * an unshared representation cannot become shared while the caller
+     * holds the exclusive lock.
+     */
+    if (NS_ATOMIC_LOAD(&repPtr->refCount) > 1) {
+        VarRep    *newPtr = VarRepNew(repPtr->nelems, (repPtr->indexPtr != NULL));
+        TCL_SIZE_T i;
+
+        for (i = 0; i < repPtr->nelems; i++) {
+            VarRepAppend(newPtr, repPtr->elems[i].string, repPtr->elems[i].length);
+        }
+        if (newPtr->indexPtr != NULL) {
+            for (i = 0; i < newPtr->nelems; i += 2) {
+                Tcl_HashEntry *hPtr;
+                int            isNew;
+
+                hPtr = Tcl_CreateHashEntry(newPtr->indexPtr, newPtr->elems[i].string, &isNew);
+                Tcl_SetHashValue(hPtr, INT2PTR(i));
+            }
+        }
+        VarRepRelease(repPtr);
+        varPtr->v.repPtr = newPtr;
+        repPtr = newPtr;
+    }
+    return repPtr;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * VarRepAppend --
+ *
+ *      Append a copy of a string as element to a list or dict
+ *      representation.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects;
+ *      The element array is grown when necessary.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+VarRepAppend(VarRep *repPtr, const char *string, TCL_SIZE_T length)
+{
+    VarElem *elemPtr;
+
+    NS_NONNULL_ASSERT(repPtr != NULL);
+    NS_NONNULL_ASSERT(string != NULL);
+
+    if (repPtr->nelems == repPtr->size) {
+        repPtr->size *= 2;
+        repPtr->elems = ns_realloc(repPtr->elems, sizeof(VarElem) * (size_t)repPtr->size);
+    }
+    elemPtr = &repPtr->elems[repPtr->nelems++];
+    elemPtr->string = ns_malloc((size_t)length + 1u);
+    memcpy(elemPtr->string, string, (size_t)length);
+    elemPtr->string[length] = '\0';
+    elemPtr->length = length;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * VarRepDictGet, VarRepDictPut, VarRepDictRemove --
+ *
+ *      Lookup, set or remove a key of a dict representation.  The key
+ *      order is the same as in Tcl dicts: new keys are added at the end,
+ *      updated keys keep their position.
+ *
+ * Results:
+ *      VarRepDictGet() returns the value element or NULL, when the key does
+ *      not exist.
+ *
+ * Side effects;
+ *      VarRepDictPut() and VarRepDictRemove() modify the representation,
+ *      which must not be shared.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static const VarElem *
+VarRepDictGet(const VarRep *repPtr, const char *keyString)
+{
+    const Tcl_HashEntry *hPtr;
+
+    NS_NONNULL_ASSERT(repPtr != NULL);
+    NS_NONNULL_ASSERT(keyString != NULL);
+    assert(repPtr->indexPtr != NULL);
+
+    hPtr = Tcl_FindHashEntry(repPtr->indexPtr, keyString);
+    return (hPtr != NULL) ? &repPtr->elems[PTR2INT(Tcl_GetHashValue(hPtr)) + 1] : NULL;
+}
+
+static void
+VarRepDictPut(VarRep *repPtr, Tcl_Obj *keyObj, Tcl_Obj *valueObj)
+{
+    Tcl_HashEntry *hPtr;
+    TCL_SIZE_T     keyLength, valueLength;
+    const char    *keyString, *valueString;
+    int            isNew;
+
+    NS_NONNULL_ASSERT(repPtr != NULL);
+    NS_NONNULL_ASSERT(keyObj != NULL);
+    NS_NONNULL_ASSERT(valueObj != NULL);
+    assert(repPtr->indexPtr != NULL);
+
+    keyString = Tcl_GetStringFromObj(keyObj, &keyLength);
+    valueString = Tcl_GetStringFromObj(valueObj, &valueLength);
+
+    hPtr = Tcl_CreateHashEntry(repPtr->indexPtr, keyString, &isNew);
+    if (isNew != 0) {
+        Tcl_SetHashValue(hPtr, INT2PTR(repPtr->nelems));
+        VarRepAppend(repPtr, keyString, keyLength);
+        VarRepAppend(repPtr, valueString, valueLength);
+    } else {
+        VarElem *elemPtr = &repPtr->elems[PTR2INT(Tcl_GetHashValue(hPtr)) + 1];
+
+        elemPtr->string = ns_realloc(elemPtr->string, (size_t)valueLength + 1u);
+        memcpy(elemPtr->string, valueString, (size_t)valueLength);
+        elemPtr->string[valueLength] = '\0';
+        elemPtr->length = valueLength;
+    }
+}
+
+static void
+VarRepDictRemove(VarRep *repPtr, const char *keyString)
+{
+    Tcl_HashEntry *hPtr;
+
+    NS_NONNULL_ASSERT(repPtr != NULL);
+    NS_NONNULL_ASSERT(keyString != NULL);
+    assert(repPtr->indexPtr != NULL);
+
+    hPtr = Tcl_FindHashEntry(repPtr->indexPtr, keyString);
+    if (hPtr != NULL) {
+        TCL_SIZE_T i, pos = (TCL_SIZE_T)PTR2INT(Tcl_GetHashValue(hPtr));
+
+        Tcl_DeleteHashEntry(hPtr);
+        ns_free(repPtr->elems[pos].string);
+        ns_free(repPtr->elems[pos + 1].string);
+        memmove(&repPtr->elems[pos], &repPtr->elems[pos + 2],
+                sizeof(VarElem) * (size_t)(repPtr->nelems - pos - 2));
+        repPtr->nelems -= 2;
+
+        /*
+         * Update the positions of the following keys.
+         */
+        for (i = pos; i < repPtr->nelems; i += 2) {
+            hPtr = Tcl_FindHashEntry(repPtr->indexPtr, repPtr->elems[i].string);
+            Tcl_SetHashValue(hPtr, INT2PTR(i));
+        }
+    }
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * VarRepObj --
+ *
+ *      Create a Tcl list or dict from a representation.
+ *
+ * Results:
+ *      New Tcl_Obj.
+ *
+ * Side effects;
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static Tcl_Obj *
+VarRepObj(const VarRep *repPtr)
+{
+    Tcl_Obj   *resultObj;
+    TCL_SIZE_T i;
+
+    NS_NONNULL_ASSERT(repPtr != NULL);
+
+    if (repPtr->indexPtr != NULL) {
+        resultObj = Tcl_NewDictObj();
+        for (i = 0; i < repPtr->nelems; i += 2) {
+            (void) Tcl_DictObjPut(NULL, resultObj,
+                                  Tcl_NewStringObj(repPtr->elems[i].string, repPtr->elems[i].length),
+                                  Tcl_NewStringObj(repPtr->elems[i+1].string, repPtr->elems[i+1].length));
+        }
+    } else if (repPtr->nelems == 0) {
+        resultObj = Tcl_NewListObj(0, NULL);
+    } else {
+        Tcl_Obj **objv = ns_malloc(sizeof(Tcl_Obj *) * (size_t)repPtr->nelems);
+
+        for (i = 0; i < repPtr->nelems; i++) {
+            objv[i] = Tcl_NewStringObj(repPtr->elems[i].string, repPtr->elems[i].length);
+        }
+        resultObj = Tcl_NewListObj(repPtr->nelems, objv);
+        ns_free(objv);
+    }
+    return resultObj;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * FreeNsvValueInternalRep, DupNsvValueInternalRep, UpdateStringOfNsvValue --
+ *
+ *      Functions of the "nsv:value" Tcl_ObjType.  Tcl_Objs of this type
+ *      share the list or dict representation of an nsv variable and create
+ *      their string representation only when it is needed.  When such a
+ *      Tcl_Obj is used as list or dict, Tcl converts it via its string
+ *      representation.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects;
+ *      Reference count of the representation is updated.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+FreeNsvValueInternalRep(Tcl_Obj *objPtr)
+{
+    VarRepRelease(objPtr->internalRep.otherValuePtr);
+}
+
+static void
+DupNsvValueInternalRep(Tcl_Obj *srcPtr, Tcl_Obj *dupPtr)
+{
+    VarRep *repPtr = srcPtr->internalRep.otherValuePtr;
+
+    (void) NS_ATOMIC_FETCH_ADD(&repPtr->refCount, 1);
+    dupPtr->internalRep.otherValuePtr = repPtr;
+    dupPtr->typePtr = &nsvValueType;
+}
+
+static void
+UpdateStringOfNsvValue(Tcl_Obj *objPtr)
+{
+    Tcl_Obj    *valueObj;
+    const char *string;
+    TCL_SIZE_T  length;
+
+    valueObj = VarRepObj(objPtr->internalRep.otherValuePtr);
+    Tcl_IncrRefCount(valueObj);
+    string = Tcl_GetStringFromObj(valueObj, &length);
+    Ns_TclSetStringRep(objPtr, string, length);
+    Tcl_DecrRefCount(valueObj);
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * GetVar --
+ *
+ *      Get the variable of a hash entry, create an empty string variable
+ *      for new entries.
+ *
+ * Results:
+ *      Pointer to the variable.
+ *
+ * Side effects;
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
 
-    /*
-     * The hash entry owns the value string.  Resize the existing allocation
-     * and store the resulting pointer back into the entry.
-     */
-    oldString = Tcl_GetHashValue(hPtr);
-    newString = ns_realloc(oldString, len + 1u);
-    memcpy(newString, value, len + 1u);
-    Tcl_SetHashValue(hPtr, newString);
+static Var *
+GetVar(Tcl_HashEntry *hPtr)
+{
+    Var *varPtr;
+
+    NS_NONNULL_ASSERT(hPtr != NULL);
+
+    varPtr = Tcl_GetHashValue(hPtr);
+    if (varPtr == NULL) {
+        varPtr = ns_malloc(sizeof(Var));
+        varPtr->type = VAR_STRING;
+        varPtr->v.string.string = ns_calloc(1u, 1u);
+        varPtr->v.string.length = 0;
+        Tcl_SetHashValue(hPtr, varPtr);
+    }
+    return varPtr;
 }
 
-
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * VarClear, VarFree --
+ *
+ *      Release the value of a variable, or free the variable.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects;
+ *      VarClear() leaves the variable without a valid value.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+VarClear(Var *varPtr)
+{
+    NS_NONNULL_ASSERT(varPtr != NULL);
+
+    switch (varPtr->type) {
+    case VAR_STRING: NS_FALL_THROUGH; /* fall through */
+    case VAR_BYTES:
+        ns_free(varPtr->v.string.string);
+        break;
+    case VAR_LIST: NS_FALL_THROUGH; /* fall through */
+    case VAR_DICT:
+        VarRepRelease(varPtr->v.repPtr);
+        break;
+    case VAR_INT: NS_FALL_THROUGH; /* fall through */
+    case VAR_DOUBLE:
+        break;
+    }
+}
+
+static void
+VarFree(Var *varPtr)
+{
+    NS_NONNULL_ASSERT(varPtr != NULL);
+
+    VarClear(varPtr);
+    ns_free(varPtr);
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * VarSetString, VarSetObj --
+ *
+ *      Set the value of a variable from a string or a Tcl_Obj.  Values of
+ *      Tcl_Objs without string representation are stored in typed form,
+ *      since for these, the string representation generated later is the
+ *      same as the one Tcl would have generated.  Values shared from other
+ *      nsv variables are not copied.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects;
+ *      Previous value is released.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+VarSetString(Var *varPtr, const char *value, TCL_SIZE_T length)
+{
+    NS_NONNULL_ASSERT(varPtr != NULL);
+    NS_NONNULL_ASSERT(value != NULL);
+
+    if (varPtr->type != VAR_STRING) {
+        VarClear(varPtr);
+        varPtr->type = VAR_STRING;
+        varPtr->v.string.string = NULL;
+    }
+    varPtr->v.string.string = ns_realloc(varPtr->v.string.string, (size_t)length + 1u);
+    memcpy(varPtr->v.string.string, value, (size_t)length);
+    varPtr->v.string.string[length] = '\0';
+    varPtr->v.string.length = length;
+}
+
+static void
+VarSetObj(Var *varPtr, Tcl_Obj *valueObj)
+{
+    const Tcl_ObjType *typePtr;
+    const char        *string;
+    TCL_SIZE_T         length;
+
+    NS_NONNULL_ASSERT(varPtr != NULL);
+    NS_NONNULL_ASSERT(valueObj != NULL);
+
+    typePtr = valueObj->typePtr;
+
+    if (valueObj->bytes == NULL && typePtr != NULL) {
+        Tcl_WideInt wideValue;
+        double      doubleValue;
+
+        if (typePtr == &nsvValueType) {
+            VarRep *repPtr = valueObj->internalRep.otherValuePtr;
+
+            (void) NS_ATOMIC_FETCH_ADD(&repPtr->refCount, 1);
+            VarClear(varPtr);
+            varPtr->type = (repPtr->indexPtr != NULL) ? VAR_DICT : VAR_LIST;
+            varPtr->v.repPtr = repPtr;
+            return;
+
+        } else if ((typePtr == NS_intTypePtr || typePtr == wideIntTypePtr)
+                   && Tcl_GetWideIntFromObj(NULL, valueObj, &wideValue) == TCL_OK) {
+            VarClear(varPtr);
+            varPtr->type = VAR_INT;
+            varPtr->v.counter = (int64_t)wideValue;
+            return;
+
+        } else if (typePtr == doubleTypePtr
+                   && Tcl_GetDoubleFromObj(NULL, valueObj, &doubleValue) == TCL_OK) {
+            VarClear(varPtr);
+            varPtr->type = VAR_DOUBLE;
+            varPtr->v.number = doubleValue;
+            return;
+
+        } else if (NsTclObjIsByteArray(valueObj)) {
+            const unsigned char *bytes = Tcl_GetByteArrayFromObj(valueObj, &length);
+
+            VarClear(varPtr);
+            varPtr->type = VAR_BYTES;
+            varPtr->v.string.string = ns_malloc((size_t)length + 1u);
+            memcpy(varPtr->v.string.string, bytes, (size_t)length);
+            varPtr->v.string.string[length] = '\0';
+            varPtr->v.string.length = length;
+            return;
+
+        } else if (typePtr == listTypePtr) {
+            TCL_SIZE_T objc, i;
+            Tcl_Obj  **objv;
+
+            if (Tcl_ListObjGetElements(NULL, valueObj, &objc, &objv) == TCL_OK) {
+                VarRep *repPtr = VarRepNew(objc, NS_FALSE);
+
+                for (i = 0; i < objc; i++) {
+                    string = Tcl_GetStringFromObj(objv[i], &length);
+                    VarRepAppend(repPtr, string, length);
+                }
+                VarClear(varPtr);
+                varPtr->type = VAR_LIST;
+                varPtr->v.repPtr = repPtr;
+                return;
+            }
+
+        } else if (typePtr == dictTypePtr) {
+            TCL_SIZE_T size;
+
+            if (Tcl_DictObjSize(NULL, valueObj, &size) == TCL_OK) {
+                VarRep         *repPtr = VarRepNew(size * 2, NS_TRUE);
+                Tcl_DictSearch  search;
+                Tcl_Obj        *keyObj, *elemObj;
+                int             done;
+
+                for (Tcl_DictObjFirst(NULL, valueObj, &search, &keyObj, &elemObj, &done);
+                     done == 0;
+                     Tcl_DictObjNext(&search, &keyObj, &elemObj, &done)) {
+                    VarRepDictPut(repPtr, keyObj, elemObj);
+                }
+                Tcl_DictObjDone(&search);
+                VarClear(varPtr);
+                varPtr->type = VAR_DICT;
+                varPtr->v.repPtr = repPtr;
+                return;
+            }
+        }
+    }
+
+    string = Tcl_GetStringFromObj(valueObj, &length);
+    VarSetString(varPtr, string, length);
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * VarObj, VarRefObj, VarDictObj, VarAppend --
+ *
+ *      Get the value of a variable as Tcl_Obj or append it to a
+ *      Tcl_DString.  VarRefObj() returns for lists and dicts a Tcl_Obj
+ *      sharing the representation of the variable, the string
+ *      representation is created on demand.  VarDictObj() returns for
+ *      dicts and a provided first key a dict containing only this key,
+ *      which is sufficient for lookups and updates of this key.
+ *
+ * Results:
+ *      VarObj(), VarRefObj() and VarDictObj() return a new Tcl_Obj.
+ *
+ * Side effects;
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static Tcl_Obj *
+VarObj(const Var *varPtr)
+{
+    Tcl_Obj *resultObj;
+
+    NS_NONNULL_ASSERT(varPtr != NULL);
+
+    switch (varPtr->type) {
+    case VAR_INT:
+        resultObj = Tcl_NewWideIntObj((Tcl_WideInt)NS_ATOMIC_LOAD(&varPtr->v.counter));
+        break;
+    case VAR_DOUBLE:
+        resultObj = Tcl_NewDoubleObj(varPtr->v.number);
+        break;
+    case VAR_BYTES:
+        resultObj = Tcl_NewByteArrayObj((const unsigned char *)varPtr->v.string.string,
+                                        varPtr->v.string.length);
+        break;
+    case VAR_LIST: NS_FALL_THROUGH; /* fall through */
+    case VAR_DICT:
+        resultObj = VarRepObj(varPtr->v.repPtr);
+        break;
+    case VAR_STRING: NS_FALL_THROUGH; /* fall through */
+    default:
+        resultObj = Tcl_NewStringObj(varPtr->v.string.string, varPtr->v.string.length);
+        break;
+    }
+    return resultObj;
+}
+
+static Tcl_Obj *
+VarRefObj(const Var *varPtr)
+{
+    Tcl_Obj *resultObj;
+
+    NS_NONNULL_ASSERT(varPtr != NULL);
+
+    if (varPtr->type == VAR_LIST || varPtr->type == VAR_DICT) {
+        resultObj = Tcl_NewObj();
+        Tcl_InvalidateStringRep(resultObj);
+        (void) NS_ATOMIC_FETCH_ADD(&varPtr->v.repPtr->refCount, 1);
+        Ns_TclSetOtherValuePtr(resultObj, &nsvValueType, varPtr->v.repPtr);
+    } else {
+        resultObj = VarObj(varPtr);
+    }
+    return resultObj;
+}
+
+static Tcl_Obj *
+VarDictObj(const Var *varPtr, Tcl_Obj *firstKeyObj)
+{
+    Tcl_Obj *resultObj;
+
+    NS_NONNULL_ASSERT(varPtr != NULL);
+
+    if (varPtr->type == VAR_DICT && firstKeyObj != NULL) {
+        const VarElem *elemPtr = VarRepDictGet(varPtr->v.repPtr, Tcl_GetString(firstKeyObj));
+
+        resultObj = Tcl_NewDictObj();
+        if (elemPtr != NULL) {
+            (void) Tcl_DictObjPut(NULL, resultObj, firstKeyObj,
+                                  Tcl_NewStringObj(elemPtr->string, elemPtr->length));
+        }
+    } else {
+        resultObj = VarObj(varPtr);
+    }
+    return resultObj;
+}
+
+static void
+VarAppend(Tcl_DString *dsPtr, const Var *varPtr)
+{
+    NS_NONNULL_ASSERT(dsPtr != NULL);
+    NS_NONNULL_ASSERT(varPtr != NULL);
+
+    if (varPtr->type == VAR_STRING) {
+        Tcl_DStringAppend(dsPtr, varPtr->v.string.string, varPtr->v.string.length);
+
+    } else if (varPtr->type == VAR_INT) {
+        char buf[TCL_INTEGER_SPACE+2];
+
+        snprintf(buf, sizeof(buf), "%" PRId64, NS_ATOMIC_LOAD(&varPtr->v.counter));
+        Tcl_DStringAppend(dsPtr, buf, TCL_INDEX_NONE);
+
+    } else {
+        Tcl_Obj    *valueObj = VarObj(varPtr);
+        const char *string;
+        TCL_SIZE_T  length;
+
+        Tcl_IncrRefCount(valueObj);
+        string = Tcl_GetStringFromObj(valueObj, &length);
+        Tcl_DStringAppend(dsPtr, string, length);
+        Tcl_DecrRefCount(valueObj);
+    }
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * VarToList, VarToDict --
+ *
+ *      Convert the value of a variable into a list or dict representation,
+ *      such that it can be modified element-wise.  The function has to be
+ *      called with the key locked exclusively.
+ *
+ * Results:
+ *      VarToList() returns NS_FALSE, when the value is not a valid list.
+ *      VarToDict() returns TCL_OK or TCL_ERROR, when the value is not a
+ *      valid dict, leaving an error message in the interp.
+ *
+ * Side effects;
+ *      Value of the variable is converted.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static bool
+VarToList(Var *varPtr)
+{
+    bool success = NS_TRUE;
+
+    NS_NONNULL_ASSERT(varPtr != NULL);
+
+    if (varPtr->type == VAR_DICT) {
+        VarRep *repPtr = VarRepUnshare(varPtr);
+
+        Tcl_DeleteHashTable(repPtr->indexPtr);
+        ns_free(repPtr->indexPtr);
+        repPtr->indexPtr = NULL;
+        varPtr->type = VAR_LIST;
+
+    } else if (varPtr->type != VAR_LIST) {
+        Tcl_Obj   *valueObj = VarObj(varPtr), **objv;
+        TCL_SIZE_T objc, i;
+
+        Tcl_IncrRefCount(valueObj);
+        if (Tcl_ListObjGetElements(NULL, valueObj, &objc, &objv) == TCL_OK) {
+            VarRep *repPtr = VarRepNew(objc, NS_FALSE);
+
+            for (i = 0; i < objc; i++) {
+                TCL_SIZE_T  length;
+                const char *string = Tcl_GetStringFromObj(objv[i], &length);
+
+                VarRepAppend(repPtr, string, length);
+            }
+            VarClear(varPtr);
+            varPtr->type = VAR_LIST;
+            varPtr->v.repPtr = repPtr;
+        } else {
+            success = NS_FALSE;
+        }
+        Tcl_DecrRefCount(valueObj);
+    }
+    return success;
+}
+
+static int
+VarToDict(Tcl_Interp *interp, Var *varPtr)
+{
+    int result = TCL_OK;
+
+    NS_NONNULL_ASSERT(varPtr != NULL);
+
+    if (varPtr->type != VAR_DICT) {
+        Tcl_Obj   *valueObj = VarObj(varPtr);
+        TCL_SIZE_T size;
+
+        Tcl_IncrRefCount(valueObj);
+        result = Tcl_DictObjSize(interp, valueObj, &size);
+        if (result == TCL_OK) {
+            VarRep         *repPtr = VarRepNew(size * 2, NS_TRUE);
+            Tcl_DictSearch  search;
+            Tcl_Obj        *keyObj, *elemObj;
+            int             done;
+
+            for (Tcl_DictObjFirst(NULL, valueObj, &search, &keyObj, &elemObj, &done);
+                 done == 0;
+                 Tcl_DictObjNext(&search, &keyObj, &elemObj, &done)) {
+                VarRepDictPut(repPtr, keyObj, elemObj);
+            }
+            Tcl_DictObjDone(&search);
+            VarClear(varPtr);
+            varPtr->type = VAR_DICT;
+            varPtr->v.repPtr = repPtr;
+        }
+        Tcl_DecrRefCount(valueObj);
+    }
+    return result;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * UpdateVar --
+ *
+ *      Update a variable entry with a string value.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects;
+ *      New value is set.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+UpdateVar(Tcl_HashEntry *hPtr, const char *value, size_t len)
+{
+    NS_NONNULL_ASSERT(hPtr != NULL);
+    NS_NONNULL_ASSERT(value != NULL);
+
+    VarSetString(GetVar(hPtr), value, (TCL_SIZE_T)len);
+}
+
+
 /*
  *-----------------------------------------------------------------------------
  *
- * SetVar --
+ * SetVar, SetVarObj --
  *
- *      Set (or reset) an array entry.
+ *      Set (or reset) an array entry from a string or a Tcl_Obj.
  *
  * Results:
  *      None.
@@ -1888,17 +3337,33 @@ SetVar(Array *arrayPtr, const char *keyString, const char *value, size_t len)
     NS_NONNULL_ASSERT(keyString != NULL);
     NS_NONNULL_ASSERT(value != NULL);
 
-    hPtr = Tcl_CreateHashEntry(&arrayPtr->vars, keyString, &isNew);
+    hPtr = Tcl_CreateHashEntry(KeyTable(arrayPtr, keyString), keyString, &isNew);
     UpdateVar(hPtr, value, len);
 }
 
-
+static void
+SetVarObj(Array *arrayPtr, const char *keyString, Tcl_Obj *valueObj)
+{
+    Tcl_HashEntry *hPtr;
+    int            isNew;
+
+    NS_NONNULL_ASSERT(arrayPtr != NULL);
+    NS_NONNULL_ASSERT(keyString != NULL);
+    NS_NONNULL_ASSERT(valueObj != NULL);
+
+    hPtr = Tcl_CreateHashEntry(KeyTable(arrayPtr, keyString), keyString, &isNew);
+    VarSetObj(GetVar(hPtr), valueObj);
+}
+
+
 /*
  *-----------------------------------------------------------------------------
  *
  * IncrVar --
  *
- *      Increment the value of the variable.
+ *      Increment the value of the variable.  The function has to be called
+ *      with the key locked exclusively.  The variable is converted into an
+ *      integer, such that further increments can use IncrCounter().
  *
  * Results:
  *      TCL_OK, or TCL_ERROR if existing value is not an integer.
@@ -1914,40 +3379,88 @@ static int
 IncrVar(Array *arrayPtr, const char *keyString, int incr, Tcl_WideInt *valuePtr)
 {
     Tcl_HashEntry *hPtr;
-    int            isNew, status;
+    Var           *varPtr;
+    int            isNew, status = TCL_OK;
     Tcl_WideInt    counter = -1;
 
     NS_NONNULL_ASSERT(arrayPtr != NULL);
     NS_NONNULL_ASSERT(keyString != NULL);
     NS_NONNULL_ASSERT(valuePtr != NULL);
 
-    hPtr = Tcl_CreateHashEntry(&arrayPtr->vars, keyString, &isNew);
+    hPtr = Tcl_CreateHashEntry(KeyTable(arrayPtr, keyString), keyString, &isNew);
+    varPtr = GetVar(hPtr);
 
     if (isNew != 0) {
-        counter = 0;
-        status = TCL_OK;
-    } else {
-        const char *oldString;
+        VarClear(varPtr);
+        varPtr->type = VAR_INT;
+        varPtr->v.counter = 0;
 
-        oldString = Tcl_GetHashValue(hPtr);
-        status = (Ns_StrToWideInt(oldString, &counter) == NS_OK)
-            ? TCL_OK
-            : TCL_ERROR;
+    } else if (varPtr->type != VAR_INT) {
+        Tcl_DString ds;
+
+        Tcl_DStringInit(&ds);
+        VarAppend(&ds, varPtr);
+        if (Ns_StrToWideInt(ds.string, &counter) == NS_OK) {
+            VarClear(varPtr);
+            varPtr->type = VAR_INT;
+            varPtr->v.counter = (int64_t)counter;
+        } else {
+            status = TCL_ERROR;
+        }
+        Tcl_DStringFree(&ds);
     }
 
     if (status == TCL_OK) {
-        char buf[TCL_INTEGER_SPACE+2];
-
-        counter += incr;
-        snprintf(buf, sizeof(buf), "%" TCL_LL_MODIFIER "d", counter);
-        UpdateVar(hPtr, buf, strlen(buf));
+        counter = (Tcl_WideInt)(NS_ATOMIC_FETCH_ADD(&varPtr->v.counter, (int64_t)incr) + incr);
     }
     *valuePtr = counter;
 
     return status;
 }
 
-
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * IncrCounter --
+ *
+ *      Increment an existing integer variable atomically.  The function
+ *      requires only a shared lock on the key.
+ *
+ * Results:
+ *      NS_TRUE when the variable is an integer and was incremented, the new
+ *      value is returned in valuePtr.  NS_FALSE, when the variable does not
+ *      exist or is not an integer; in this case, IncrVar() has to be used.
+ *
+ * Side effects;
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static bool
+IncrCounter(Array *arrayPtr, const char *keyString, int incr, Tcl_WideInt *valuePtr)
+{
+    const Tcl_HashEntry *hPtr;
+    bool                 success = NS_FALSE;
+
+    NS_NONNULL_ASSERT(arrayPtr != NULL);
+    NS_NONNULL_ASSERT(keyString != NULL);
+    NS_NONNULL_ASSERT(valuePtr != NULL);
+
+    hPtr = Tcl_FindHashEntry(KeyTable(arrayPtr, keyString), keyString);
+    if (likely(hPtr != NULL)) {
+        Var *varPtr = Tcl_GetHashValue(hPtr);
+
+        if (varPtr->type == VAR_INT) {
+            *valuePtr = (Tcl_WideInt)(NS_ATOMIC_FETCH_ADD(&varPtr->v.counter, (int64_t)incr) + incr);
+            success = NS_TRUE;
+        }
+    }
+    return success;
+}
+
+
 /*
  *-----------------------------------------------------------------------------
  *
@@ -1972,10 +3485,10 @@ Unset(Array *arrayPtr, const char *keyString)
     NS_NONNULL_ASSERT(arrayPtr != NULL);
 
     if (keyString != NULL) {
-        Tcl_HashEntry *hPtr = Tcl_FindHashEntry(&arrayPtr->vars, keyString);
+        Tcl_HashEntry *hPtr = Tcl_FindHashEntry(KeyTable(arrayPtr, keyString), keyString);
 
         if (hPtr != NULL) {
-            ns_free(Tcl_GetHashValue(hPtr));
+            VarFree(Tcl_GetHashValue(hPtr));
             Tcl_DeleteHashEntry(hPtr);
             status = NS_OK;
         }
@@ -1987,7 +3500,7 @@ Unset(Array *arrayPtr, const char *keyString)
     return status;
 }
 
-
+
 /*
  *-----------------------------------------------------------------------------
  *
@@ -2007,26 +3520,32 @@ Unset(Array *arrayPtr, const char *keyString)
 static void
 Flush(Array *arrayPtr)
 {
-    Tcl_HashEntry  *hPtr;
-    Tcl_HashSearch  search;
+    unsigned int i;
 
     NS_NONNULL_ASSERT(arrayPtr != NULL);
 
-    hPtr = Tcl_FirstHashEntry(&arrayPtr->vars, &search);
-    while (hPtr != NULL) {
-        ns_free(Tcl_GetHashValue(hPtr));
-        Tcl_DeleteHashEntry(hPtr);
-        hPtr = Tcl_NextHashEntry(&search);
+    for (i = 0u; i < ArrayTableCount(arrayPtr); i++) {
+        Tcl_HashTable  *tablePtr = ArrayTable(arrayPtr, i);
+        Tcl_HashEntry  *hPtr;
+        Tcl_HashSearch  search;
+
+        hPtr = Tcl_FirstHashEntry(tablePtr, &search);
+        while (hPtr != NULL) {
+            VarFree(Tcl_GetHashValue(hPtr));
+            Tcl_DeleteHashEntry(hPtr);
+            hPtr = Tcl_NextHashEntry(&search);
+        }
     }
 }
 
-
+
 /*
  *-----------------------------------------------------------------------------
  *
  * LockArrayObj --
  *
- *      Lock the array of the given name.
+ *      Lock the array of the given name, for the given key or for the whole
+ *      array, when keyString is NULL.
  *      Array structure must be later unlocked with UnlockArray.
  *
  * Results:
@@ -2039,7 +3558,7 @@ Flush(Array *arrayPtr)
  */
 
 static Array *
-LockArrayObj(Tcl_Interp *interp, Tcl_Obj *arrayObj, bool create, NS_RW rw)
+LockArrayObj(Tcl_Interp *interp, Tcl_Obj *arrayObj, const char *keyString, bool create, NS_RW rw)
 {
     Array              *arrayPtr;
     Bucket             *bucketPtr;
@@ -2053,27 +3572,18 @@ LockArrayObj(Tcl_Interp *interp, Tcl_Obj *arrayObj, bool create, NS_RW rw)
 
     if (likely(Ns_TclGetOpaqueFromObj(arrayObj, arrayType, (void **) &bucketPtr) == TCL_OK)
         && bucketPtr != NULL) {
-        if (bucketPtr->servPtr->nsv.rwlocks) {
-            if (rw == NS_READ) {
-                Ns_RWLockRdLock(&bucketPtr->rwlock);
-            } else {
-                Ns_RWLockWrLock(&bucketPtr->rwlock);
-            }
-        } else {
-            Ns_MutexLock(&bucketPtr->mlock);
-        }
-        arrayPtr = GetArray(bucketPtr, arrayName, create);
+        arrayPtr = LockBucketArray(bucketPtr, arrayName, keyString, create, rw);
     } else {
         const NsInterp *itPtr = NsGetInterpData(interp);
 
-        arrayPtr = LockArray(itPtr->servPtr, arrayName, create, rw);
+        arrayPtr = LockArray(itPtr->servPtr, arrayName, keyString, create, rw);
         if (arrayPtr != NULL) {
             Ns_TclSetOpaqueObj(arrayObj, arrayType, arrayPtr->bucketPtr);
         }
     }
 
     /*
-     * Both, GetArray() and LockArray() can return NULL.
+     * Both, LockBucketArray() and LockArray() can return NULL.
      */
     if (arrayPtr == NULL && !create) {
         Ns_TclPrintfResult(interp, "no such array: %s", arrayName);
@@ -2093,7 +3603,8 @@ LockArrayObj(Tcl_Interp *interp, Tcl_Obj *arrayObj, bool create, NS_RW rw)
  *      Implements "nsv_bucket".
  *
  *      Returns the names of the arrays kept in various buckets of the current
- *      interp.  If called a bucket number it returns a list array kept in
+ *      interp together with the number of locks and the number of contended
+ *      locks.  If called a bucket number it returns a list array kept in
  *      that bucket. If called with no arguments, it returns a list of every
  *      bucket (list of lists).
  *
@@ -2140,11 +3651,7 @@ NsTclNsvBucketObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_SIZE_T objc,
             }
             listObj = Tcl_NewListObj(0, NULL);
             bucketPtr = &servPtr->nsv.buckets[i];
-            if (servPtr->nsv.rwlocks) {
-                Ns_RWLockRdLock(&bucketPtr->rwlock);
-            } else {
-                Ns_MutexLock(&bucketPtr->mlock);
-            }
+            (void) BucketLock(bucketPtr, NS_READ);
 
             hPtr = Tcl_FirstHashEntry(&bucketPtr->arrays, &search);
             while (hPtr != NULL) {
@@ -2156,6 +3663,10 @@ NsTclNsvBucketObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_SIZE_T objc,
                 if (likely(result == TCL_OK)) {
                     result = Tcl_ListObjAppendElement(interp, elemObj, Tcl_NewLongObj(arrayPtr->locks));
                 }
+                if (likely(result == TCL_OK)) {
+                    result = Tcl_ListObjAppendElement(interp, elemObj,
+                                                      Tcl_NewWideIntObj((Tcl_WideInt)NS_ATOMIC_LOAD(&arrayPtr->contended)));
+                }
                 if (likely(result == TCL_OK)) {
                     result = Tcl_ListObjAppendElement(interp, listObj, elemObj);
                 }
@@ -2164,11 +3675,7 @@ NsTclNsvBucketObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_SIZE_T objc,
                 }
                 hPtr = Tcl_NextHashEntry(&search);
             }
-            if (servPtr->nsv.rwlocks) {
-                Ns_RWLockUnlock(&bucketPtr->rwlock);
-            } else {
-                Ns_MutexUnlock(&bucketPtr->mlock);
-            }
+            BucketUnlock(bucketPtr);
 
             if (likely(result == TCL_OK)) {
                 result = Tcl_ListObjAppendElement(interp, resultObj, listObj);
@@ -3017,8 +3017,7 @@ Ns_TLS_CtxServerInit(const char *section, Tcl_Interp *interp,
                 SSL_CTX_set_app_data(*ctxPtr, (void *)dc);
             }
 
-            SSL_CTX_set_session_id_context(*ctxPtr, (const unsigned char *)&nsconf.pid, sizeof(pid_t));
-            SSL_CTX_set_session_cache_mode(*ctxPtr, SSL_SESS_CACHE_SERVER);
+            NsTLSSessionsSetupCtx(*ctxPtr);
 
             SSL_CTX_set_info_callback(*ctxPtr, SSL_infoCB);
 
@@ -4146,6 +4145,92 @@ Ns_SSLRecvBufs2(SSL *sslPtr, struct iovec *bufs, int UNUSED(nbufs),
 }
 
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * NsTLSGatherBufs --
+ *
+ *      Copy the content of the provided buffers, starting at "offset" in
+ *      the first buffer, into the staging area until it is full. This is
+ *      used to pack several small buffers (e.g. response header, body and
+ *      chunk framing) into a single SSL_write() call, producing a single
+ *      TLS record instead of one record per buffer.
+ *
+ *      When an SSL_write() of the staging area has to be retried, the
+ *      caller passes the same buffers again, such that the gathered
+ *      content is identical, as required by OpenSSL (the contexts use
+ *      SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER).
+ *
+ * Results:
+ *      Number of bytes copied into the staging area.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+size_t
+NsTLSGatherBufs(char *staging, size_t size, const struct iovec *bufs, int nbufs, size_t offset)
+{
+    size_t length = 0u;
+    int    i;
+
+    NS_NONNULL_ASSERT(staging != NULL);
+    NS_NONNULL_ASSERT(bufs != NULL);
+
+    for (i = 0; i < nbufs && length < size; i++) {
+        size_t toCopy = bufs[i].iov_len - offset;
+
+        if (toCopy > size - length) {
+            toCopy = size - length;
+        }
+        memcpy(staging + length, (const char *)bufs[i].iov_base + offset, toCopy);
+        length += toCopy;
+        offset = 0u;
+    }
+
+    return length;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * NsTLSAdvanceBufs --
+ *
+ *      Advance the buffer pointer and the offset in the current buffer by
+ *      "length" bytes, which were sent.
+ *
+ * Results:
+ *      Number of remaining buffers.
+ *
+ * Side effects:
+ *      Updates *bufsPtr and *offsetPtr.
+ *
+ *----------------------------------------------------------------------
+ */
+int
+NsTLSAdvanceBufs(const struct iovec **bufsPtr, int nbufs, size_t *offsetPtr, size_t length)
+{
+    const struct iovec *bufs;
+    size_t              offset;
+
+    NS_NONNULL_ASSERT(bufsPtr != NULL);
+    NS_NONNULL_ASSERT(offsetPtr != NULL);
+
+    bufs = *bufsPtr;
+    offset = *offsetPtr + length;
+
+    while (nbufs > 0 && offset >= bufs->iov_len) {
+        offset -= bufs->iov_len;
+        bufs++;
+        nbufs--;
+    }
+    *bufsPtr = bufs;
+    *offsetPtr = (nbufs > 0) ? offset : 0u;
+
+    return nbufs;
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -4159,6 +4244,9 @@ Ns_SSLRecvBufs2(SSL *sslPtr, struct iovec *bufs, int UNUSED(nbufs),
  *        c) it never blocks
  *        d) it does not try corking
  *
+ *      Multiple small buffers are gathered into TLS records of up to
+ *      NS_TLS_MAX_RECORD_SIZE bytes.
+ *
  * Results:
  *      Number of bytes sent (which might be also 0 on NS_EAGAIN cases)
  *      or -1 on error.
@@ -4172,29 +4260,50 @@ ssize_t
 Ns_SSLSendBufs2(SSL *ssl, const struct iovec *bufs, int nbufs)
 {
     ssize_t sent = 0;
+    size_t  offset = 0u;
+    char    staging[NS_TLS_MAX_RECORD_SIZE];
 
     NS_NONNULL_ASSERT(ssl != NULL);
     NS_NONNULL_ASSERT(bufs != NULL);
 
-    if (nbufs > 1) {
-        /* sent = -1; to silence bad static checkers (cppcheck), fb infer complains when set */
-        Ns_Fatal("Ns_SSLSendBufs2: can handle at most one buffer at the time");
+    while (nbufs > 0) {
+        const char *data = (const char *)bufs->iov_base + offset;
+        size_t      length = bufs->iov_len - offset;
+        int         rc, err;
 
-    } else if (bufs[0].iov_len > 0) {
-        int  err;
+        if (length == 0u) {
+            nbufs = NsTLSAdvanceBufs(&bufs, nbufs, &offset, 0u);
+            continue;
+        }
+        if (nbufs > 1 && length < sizeof(staging)) {
+            length = NsTLSGatherBufs(staging, sizeof(staging), bufs, nbufs, offset);
+            data = staging;
+        }
 
-        sent = SSL_write(ssl, bufs[0].iov_base, (int)bufs[0].iov_len);
-        err = SSL_get_error(ssl, (int)sent);
+        rc = SSL_write(ssl, data, (int)length);
+        err = SSL_get_error(ssl, rc);
 
         if (err == SSL_ERROR_WANT_WRITE) {
-            sent = 0;
+            break;
 
         } else if (err == SSL_ERROR_SYSCALL) {
             Ns_Log(Debug, "SSL_write ERROR_SYSCALL %s", ns_sockstrerror(ns_sockerrno));
 
         } else if (err != SSL_ERROR_NONE) {
-            Ns_Log(Debug, "SSL_write: sent:%ld, error:%d", sent, err);
+            Ns_Log(Debug, "SSL_write: sent:%d, error:%d", rc, err);
+        }
+
+        if (rc <= 0) {
+            if (sent == 0) {
+                sent = rc;
+            }
+            break;
+        }
+        sent += (ssize_t)rc;
+        if ((size_t)rc < length) {
+            break;
         }
+        nbufs = NsTLSAdvanceBufs(&bufs, nbufs, &offset, (size_t)rc);
     }
 
     return sent;
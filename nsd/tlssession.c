@@ -0,0 +1,887 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * The Initial Developer of the Original Code and related documentation
+ * is America Online, Inc. Portions created by AOL are Copyright (C) 1999
+ * America Online, Inc. All Rights Reserved.
+ *
+ */
+
+
+/*
+ * tlssession.c --
+ *
+ *      TLS session resumption support for server contexts. All server
+ *      contexts (all TLS drivers and their SNI/vhost contexts) share
+ *
+ *        - a sharded, process-wide session cache for session-id based
+ *          resumption (TLS 1.2), and
+ *
+ *        - a ring of session-ticket keys, which is rotated periodically
+ *          (TLS 1.2 and TLS 1.3 tickets).
+ *
+ *      Optionally, the session cache and the ticket keys are persisted
+ *      in a local file, such that clients can resume their sessions
+ *      after a restart of the server.
+ */
+
+#include "nsd.h"
+
+#ifdef HAVE_OPENSSL_EVP_H
+# include "nsopenssl.h"
+# include <openssl/ssl.h>
+# include <openssl/rand.h>
+# ifdef HAVE_OPENSSL_3
+#  include <openssl/core_names.h>
+# endif
+
+#define SESSION_SHARDS      16
+#define TICKET_KEYS         3
+#define TICKET_KEY_NAME_LEN 16
+#define STATE_FILE_MAGIC    "NSTLSS1\n"
+
+/*
+ * Prefix of the session-id context of all server contexts. The
+ * session-id context is derived from this prefix and the client
+ * certificate verification configuration of the context (see
+ * SessionIdContext()), such that sessions created via one driver can be
+ * resumed via every other driver with the same verification
+ * configuration, but e.g. a session established without client
+ * certificate can't be resumed on a context requiring one.
+ */
+#define SESSION_ID_CONTEXT  "naviserver"
+
+typedef struct SessionKey {
+    unsigned int  length;
+    unsigned char id[SSL_MAX_SSL_SESSION_ID_LENGTH];
+} SessionKey;
+
+typedef struct SessionEntry {
+    time_t        expires;
+    size_t        length;
+    unsigned char der[1];    /* DER encoded session, i2d_SSL_SESSION() */
+} SessionEntry;
+
+typedef struct SessionShard {
+    Ns_Mutex      lock;
+    Tcl_HashTable table;
+} SessionShard;
+
+typedef struct TicketKey {
+    unsigned char name[TICKET_KEY_NAME_LEN];
+    unsigned char aesKey[32];
+    unsigned char hmacKey[32];
+    time_t        created;
+} TicketKey;
+
+/*
+ * Static functions defined in this file.
+ */
+
+static void SessionsInit(void);
+static SessionShard *GetShard(const unsigned char *id, unsigned int length, SessionKey *keyPtr)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(3);
+static void StoreSession(const SessionKey *keyPtr, const unsigned char *der, size_t length, time_t expires)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
+static void PruneShard(SessionShard *shardPtr, time_t now)
+    NS_GNUC_NONNULL(1);
+static unsigned int SessionIdContext(SSL_CTX *ctx, unsigned char *sidCtx)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
+
+static int NewSessionCB(SSL *ssl, SSL_SESSION *session);
+static SSL_SESSION *GetSessionCB(SSL *ssl, const unsigned char *id, int length, int *copy);
+static void RemoveSessionCB(SSL_CTX *ctx, SSL_SESSION *session);
+#ifdef HAVE_OPENSSL_3
+static int TicketKeyCB(SSL *ssl, unsigned char *keyName, unsigned char *iv,
+                       EVP_CIPHER_CTX *cipherCtx, EVP_MAC_CTX *macCtx, int enc);
+#endif
+
+static bool NewTicketKey(TicketKey *keyPtr) NS_GNUC_NONNULL(1);
+static Ns_SchedProc RotateTicketKeys;
+static Ns_ShutdownProc SessionsShutdown;
+static void SaveState(void);
+static void LoadState(void);
+
+/*
+ * Static variables defined in this file.
+ */
+
+static struct {
+    bool         initialized;
+    bool         enabled;
+    int          missIdx;               /* SSL ex_data index for flagging failed resumptions */
+    size_t       maxEntries;            /* max number of sessions per shard */
+    long         timeout;               /* session lifetime in seconds */
+    const char  *stateFile;             /* optional persistence file */
+    SessionShard shards[SESSION_SHARDS];
+    Ns_RWLock    keyLock;
+    int          nrKeys;
+    TicketKey    keys[TICKET_KEYS];     /* keys[0] is the current encryption key */
+} sessions;
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * NsTLSSessionsSetupCtx --
+ *
+ *      Configure session resumption for a TLS server context. When the
+ *      shared session cache is enabled (default), the context uses the
+ *      process-wide session store and ticket keys. Otherwise, OpenSSL's
+ *      internal per-context session cache is used. Must be called after
+ *      the verification settings of the context are configured.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Initializes on the first call the shared session store and
+ *      schedules the ticket key rotation.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+NsTLSSessionsSetupCtx(SSL_CTX *ctx)
+{
+    unsigned char sidCtx[SSL_MAX_SID_CTX_LENGTH];
+    unsigned int  sidCtxLength;
+
+    NS_NONNULL_ASSERT(ctx != NULL);
+
+    Ns_MasterLock();
+    if (!sessions.initialized) {
+        SessionsInit();
+        sessions.initialized = NS_TRUE;
+    }
+    Ns_MasterUnlock();
+
+    if (!sessions.enabled) {
+        SSL_CTX_set_session_id_context(ctx, (const unsigned char *)&nsconf.pid, sizeof(pid_t));
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+        return;
+    }
+
+    sidCtxLength = SessionIdContext(ctx, sidCtx);
+    SSL_CTX_set_session_id_context(ctx, sidCtx, sidCtxLength);
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER | SSL_SESS_CACHE_NO_INTERNAL);
+    SSL_CTX_set_timeout(ctx, sessions.timeout);
+    SSL_CTX_sess_set_new_cb(ctx, NewSessionCB);
+    SSL_CTX_sess_set_get_cb(ctx, GetSessionCB);
+    SSL_CTX_sess_set_remove_cb(ctx, RemoveSessionCB);
+#ifdef HAVE_OPENSSL_3
+    SSL_CTX_set_tlsext_ticket_key_evp_cb(ctx, TicketKeyCB);
+#endif
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SessionIdContext --
+ *
+ *      Compute the session-id context of a server context as SHA-256
+ *      digest over SESSION_ID_CONTEXT, the verify mode, the names of
+ *      the client CAs and the certificates loaded into the certificate
+ *      store of the context. OpenSSL refuses to resume sessions (via
+ *      session-id or ticket) created under a different session-id
+ *      context. CAs looked up lazily from a "clientcapath" are not
+ *      included, only the verify mode.
+ *
+ * Results:
+ *      Length of the session-id context written to "sidCtx".
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static unsigned int
+SessionIdContext(SSL_CTX *ctx, unsigned char *sidCtx)
+{
+    EVP_MD_CTX                *mdctx;
+    const STACK_OF(X509_NAME) *caNames;
+    STACK_OF(X509_OBJECT)     *objects;
+    unsigned int               length = 0u;
+    int                        mode, i;
+
+    NS_NONNULL_ASSERT(ctx != NULL);
+    NS_NONNULL_ASSERT(sidCtx != NULL);
+
+    mode = SSL_CTX_get_verify_mode(ctx);
+    mdctx = EVP_MD_CTX_new();
+
+    if (mdctx != NULL && EVP_DigestInit_ex(mdctx, EVP_sha256(), NULL) == 1) {
+        (void) EVP_DigestUpdate(mdctx, SESSION_ID_CONTEXT, sizeof(SESSION_ID_CONTEXT) - 1u);
+        (void) EVP_DigestUpdate(mdctx, &mode, sizeof(mode));
+
+        caNames = SSL_CTX_get_client_CA_list(ctx);
+        for (i = 0; caNames != NULL && i < sk_X509_NAME_num(caNames); i++) {
+            unsigned char *der = NULL;
+            int            derLength = i2d_X509_NAME(sk_X509_NAME_value(caNames, i), &der);
+
+            if (derLength > 0) {
+                (void) EVP_DigestUpdate(mdctx, der, (size_t)derLength);
+                OPENSSL_free(der);
+            }
+        }
+        objects = X509_STORE_get0_objects(SSL_CTX_get_cert_store(ctx));
+        for (i = 0; objects != NULL && i < sk_X509_OBJECT_num(objects); i++) {
+            X509         *cert = X509_OBJECT_get0_X509(sk_X509_OBJECT_value(objects, i));
+            unsigned char md[EVP_MAX_MD_SIZE];
+            unsigned int  mdLength;
+
+            if (cert != NULL && X509_digest(cert, EVP_sha256(), md, &mdLength) == 1) {
+                (void) EVP_DigestUpdate(mdctx, md, mdLength);
+            }
+        }
+        if (EVP_DigestFinal_ex(mdctx, sidCtx, &length) != 1) {
+            length = 0u;
+        }
+    }
+    if (mdctx != NULL) {
+        EVP_MD_CTX_free(mdctx);
+    }
+    if (length == 0u || length > SSL_MAX_SID_CTX_LENGTH) {
+        /*
+         * Should not happen; fall back to the plain prefix combined with
+         * the verify mode.
+         */
+        memcpy(sidCtx, SESSION_ID_CONTEXT, sizeof(SESSION_ID_CONTEXT) - 1u);
+        memcpy(sidCtx + sizeof(SESSION_ID_CONTEXT) - 1u, &mode, sizeof(mode));
+        length = (unsigned int)(sizeof(SESSION_ID_CONTEXT) - 1u + sizeof(mode));
+    }
+    return length;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * NsTLSResumptionStatus --
+ *
+ *      Report, whether the handshake of the provided SSL connection
+ *      resumed a previous session.
+ *
+ * Results:
+ *      1 when the session was resumed, -1 when the client tried to
+ *      resume a session which is not available (unknown or expired
+ *      session-id or ticket), 0 for a full handshake without a resumption
+ *      attempt.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+NsTLSResumptionStatus(const SSL *ssl)
+{
+    int result;
+
+    NS_NONNULL_ASSERT(ssl != NULL);
+
+    if (SSL_session_reused(ssl) == 1) {
+        result = 1;
+    } else if (sessions.enabled && SSL_get_ex_data(ssl, sessions.missIdx) != NULL) {
+        result = -1;
+    } else {
+        result = 0;
+    }
+    return result;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SessionsInit --
+ *
+ *      Read the configuration and set up the shared session store and
+ *      the ticket keys. Called once, with the master lock held.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Might load persisted state, schedules the key rotation and
+ *      registers a shutdown callback.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+SessionsInit(void)
+{
+    const char *section = NS_GLOBAL_CONFIG_PARAMETERS;
+    Ns_Time     rotation, timeout;
+    int         i, maxEntries;
+
+    sessions.enabled = Ns_ConfigBool(section, "tlssessioncache", NS_TRUE);
+    if (!sessions.enabled) {
+        return;
+    }
+
+    maxEntries = Ns_ConfigIntRange(section, "tlssessioncachesize", 20000, SESSION_SHARDS, INT_MAX);
+    sessions.maxEntries = (size_t)maxEntries / SESSION_SHARDS;
+
+    Ns_ConfigTimeUnitRange(section, "tlssessiontimeout",
+                           "2h", 1, 0, INT_MAX, 0, &timeout);
+    sessions.timeout = timeout.sec;
+
+    Ns_ConfigTimeUnitRange(section, "tlsticketkeyrotation",
+                           "12h", 60, 0, INT_MAX, 0, &rotation);
+
+    sessions.stateFile = Ns_ConfigString(section, "tlssessionfile", NULL);
+    if (sessions.stateFile != NULL && *sessions.stateFile == '\0') {
+        sessions.stateFile = NULL;
+    }
+
+    sessions.missIdx = SSL_get_ex_new_index(0, (void *)"ns:tlsresumemiss", NULL, NULL, NULL);
+
+    for (i = 0; i < SESSION_SHARDS; i++) {
+        Ns_MutexInit(&sessions.shards[i].lock);
+        Ns_MutexSetName2(&sessions.shards[i].lock, "ns:tlssessions", NULL);
+        Tcl_InitHashTable(&sessions.shards[i].table, (int)(sizeof(SessionKey) / sizeof(int)));
+    }
+    Ns_RWLockInit(&sessions.keyLock);
+    Ns_RWLockSetName2(&sessions.keyLock, "ns:tlsticketkeys", NULL);
+
+    if (sessions.stateFile != NULL) {
+        LoadState();
+    }
+
+    if (sessions.nrKeys == 0
+        || sessions.keys[0].created + rotation.sec <= time(NULL)
+        ) {
+        RotateTicketKeys(NULL, 0);
+    }
+    (void) Ns_ScheduleProcEx(RotateTicketKeys, NULL, NS_SCHED_THREAD, &rotation, NULL);
+    (void) Ns_RegisterAtShutdown(SessionsShutdown, NULL);
+
+    Ns_Log(Notice, "tls: shared session cache with %d entries, timeout %lds, "
+           "ticket key rotation every %lds%s%s",
+           maxEntries, sessions.timeout, rotation.sec,
+           sessions.stateFile != NULL ? ", state file " : "",
+           sessions.stateFile != NULL ? sessions.stateFile : "");
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * GetShard --
+ *
+ *      Build the hash key for a session-id and determine the shard
+ *      responsible for it. Session-ids are random, so the first bytes
+ *      are good enough for distributing the sessions over the shards.
+ *
+ * Results:
+ *      Shard pointer.
+ *
+ * Side effects:
+ *      Fills in the provided key.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static SessionShard *
+GetShard(const unsigned char *id, unsigned int length, SessionKey *keyPtr)
+{
+    if (length > SSL_MAX_SSL_SESSION_ID_LENGTH) {
+        length = SSL_MAX_SSL_SESSION_ID_LENGTH;
+    }
+    memset(keyPtr, 0, sizeof(SessionKey));
+    keyPtr->length = length;
+    memcpy(keyPtr->id, id, length);
+
+    return &sessions.shards[(length > 0u ? id[0] : 0u) % SESSION_SHARDS];
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * StoreSession, PruneShard --
+ *
+ *      Add a DER encoded session to the store. When the shard is full,
+ *      expired entries are removed first; when this is not sufficient,
+ *      an arbitrary entry is evicted.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Memory allocation.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+StoreSession(const SessionKey *keyPtr, const unsigned char *der, size_t length, time_t expires)
+{
+    SessionShard  *shardPtr = &sessions.shards[(keyPtr->length > 0u ? keyPtr->id[0] : 0u) % SESSION_SHARDS];
+    SessionEntry  *entryPtr;
+    Tcl_HashEntry *hPtr;
+    int            isNew;
+
+    entryPtr = ns_malloc(sizeof(SessionEntry) + length);
+    entryPtr->expires = expires;
+    entryPtr->length = length;
+    memcpy(entryPtr->der, der, length);
+
+    Ns_MutexLock(&shardPtr->lock);
+    if ((size_t)shardPtr->table.numEntries >= sessions.maxEntries) {
+        PruneShard(shardPtr, time(NULL));
+    }
+    hPtr = Tcl_CreateHashEntry(&shardPtr->table, (const char *)keyPtr, &isNew);
+    if (isNew == 0) {
+        ns_free(Tcl_GetHashValue(hPtr));
+    }
+    Tcl_SetHashValue(hPtr, entryPtr);
+    Ns_MutexUnlock(&shardPtr->lock);
+}
+
+static void
+PruneShard(SessionShard *shardPtr, time_t now)
+{
+    Tcl_HashEntry  *hPtr;
+    Tcl_HashSearch  search;
+
+    hPtr = Tcl_FirstHashEntry(&shardPtr->table, &search);
+    while (hPtr != NULL) {
+        const SessionEntry *entryPtr = Tcl_GetHashValue(hPtr);
+
+        if (entryPtr->expires <= now) {
+            ns_free(Tcl_GetHashValue(hPtr));
+            Tcl_DeleteHashEntry(hPtr);
+        }
+        hPtr = Tcl_NextHashEntry(&search);
+    }
+    if ((size_t)shardPtr->table.numEntries >= sessions.maxEntries) {
+        hPtr = Tcl_FirstHashEntry(&shardPtr->table, &search);
+        if (hPtr != NULL) {
+            ns_free(Tcl_GetHashValue(hPtr));
+            Tcl_DeleteHashEntry(hPtr);
+        }
+    }
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * NewSessionCB, GetSessionCB, RemoveSessionCB --
+ *
+ *      OpenSSL callbacks for the external session cache.
+ *
+ * Results:
+ *      NewSessionCB returns 0 (the session is not retained by the
+ *      callback); GetSessionCB returns a new session or NULL.
+ *
+ * Side effects:
+ *      Update the shared session store. A lookup failure is flagged on
+ *      the SSL connection for the resumption statistics.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+NewSessionCB(SSL *UNUSED(ssl), SSL_SESSION *session)
+{
+    const unsigned char *id;
+    unsigned int         idLength;
+    int                  derLength;
+
+    id = SSL_SESSION_get_id(session, &idLength);
+    derLength = i2d_SSL_SESSION(session, NULL);
+
+    if (idLength > 0u && derLength > 0) {
+        SessionKey     key;
+        unsigned char *der, *p;
+
+        p = der = ns_malloc((size_t)derLength);
+        (void) i2d_SSL_SESSION(session, &p);
+        (void) GetShard(id, idLength, &key);
+        StoreSession(&key, der, (size_t)derLength,
+                     (time_t)(SSL_SESSION_get_time(session) + SSL_SESSION_get_timeout(session)));
+        ns_free(der);
+    }
+    return 0;
+}
+
+static SSL_SESSION *
+GetSessionCB(SSL *ssl, const unsigned char *id, int length, int *copy)
+{
+    SessionKey     key;
+    SessionShard  *shardPtr;
+    Tcl_HashEntry *hPtr;
+    SSL_SESSION   *session = NULL;
+
+    *copy = 0;
+    shardPtr = GetShard(id, (unsigned int)length, &key);
+
+    Ns_MutexLock(&shardPtr->lock);
+    hPtr = Tcl_FindHashEntry(&shardPtr->table, (const char *)&key);
+    if (hPtr != NULL) {
+        const SessionEntry *entryPtr = Tcl_GetHashValue(hPtr);
+
+        if (entryPtr->expires > time(NULL)) {
+            const unsigned char *p = entryPtr->der;
+
+            session = d2i_SSL_SESSION(NULL, &p, (long)entryPtr->length);
+        } else {
+            ns_free(Tcl_GetHashValue(hPtr));
+            Tcl_DeleteHashEntry(hPtr);
+        }
+    }
+    Ns_MutexUnlock(&shardPtr->lock);
+
+    if (session == NULL) {
+        (void) SSL_set_ex_data(ssl, sessions.missIdx, (void *)ssl);
+    }
+    return session;
+}
+
+static void
+RemoveSessionCB(SSL_CTX *UNUSED(ctx), SSL_SESSION *session)
+{
+    const unsigned char *id;
+    unsigned int         idLength;
+    SessionKey           key;
+    SessionShard        *shardPtr;
+    Tcl_HashEntry       *hPtr;
+
+    id = SSL_SESSION_get_id(session, &idLength);
+    shardPtr = GetShard(id, idLength, &key);
+
+    Ns_MutexLock(&shardPtr->lock);
+    hPtr = Tcl_FindHashEntry(&shardPtr->table, (const char *)&key);
+    if (hPtr != NULL) {
+        ns_free(Tcl_GetHashValue(hPtr));
+        Tcl_DeleteHashEntry(hPtr);
+    }
+    Ns_MutexUnlock(&shardPtr->lock);
+}
+
+#ifdef HAVE_OPENSSL_3
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TicketKeyCB --
+ *
+ *      OpenSSL callback for encrypting and decrypting session tickets
+ *      with the shared ticket keys (AES-256-CBC, HMAC-SHA256). New
+ *      tickets are always encrypted with the current key; tickets
+ *      encrypted with a previous key are accepted and renewed.
+ *
+ * Results:
+ *      1 on success, 2 when the ticket should be renewed, 0 when the
+ *      key is unknown, -1 on errors.
+ *
+ * Side effects:
+ *      Flags unknown tickets on the SSL connection for the resumption
+ *      statistics.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+TicketKeyCB(SSL *ssl, unsigned char *keyName, unsigned char *iv,
+            EVP_CIPHER_CTX *cipherCtx, EVP_MAC_CTX *macCtx, int enc)
+{
+    TicketKey key;
+    int       i, keyIndex = -1, result;
+
+    Ns_RWLockRdLock(&sessions.keyLock);
+    if (enc == 1) {
+        if (sessions.nrKeys > 0) {
+            keyIndex = 0;
+        }
+    } else {
+        for (i = 0; i < sessions.nrKeys; i++) {
+            if (memcmp(keyName, sessions.keys[i].name, TICKET_KEY_NAME_LEN) == 0) {
+                keyIndex = i;
+                break;
+            }
+        }
+    }
+    if (keyIndex >= 0) {
+        key = sessions.keys[keyIndex];
+    }
+    Ns_RWLockUnlock(&sessions.keyLock);
+
+    if (keyIndex < 0) {
+        if (enc == 1) {
+            return -1;
+        }
+        (void) SSL_set_ex_data(ssl, sessions.missIdx, (void *)ssl);
+        return 0;
+    }
+
+    if (enc == 1) {
+        if (RAND_bytes(iv, EVP_CIPHER_iv_length(EVP_aes_256_cbc())) <= 0) {
+            return -1;
+        }
+        memcpy(keyName, key.name, TICKET_KEY_NAME_LEN);
+        result = EVP_EncryptInit_ex(cipherCtx, EVP_aes_256_cbc(), NULL, key.aesKey, iv) == 1 ? 1 : -1;
+    } else {
+        result = EVP_DecryptInit_ex(cipherCtx, EVP_aes_256_cbc(), NULL, key.aesKey, iv) == 1
+            ? (keyIndex == 0 ? 1 : 2)
+            : -1;
+    }
+
+    if (result > 0) {
+        OSSL_PARAM params[3];
+
+        params[0] = OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY, key.hmacKey, sizeof(key.hmacKey));
+        params[1] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, (char *)"SHA256", 0);
+        params[2] = OSSL_PARAM_construct_end();
+        if (EVP_MAC_CTX_set_params(macCtx, params) != 1) {
+            result = -1;
+        }
+    }
+    OPENSSL_cleanse(&key, sizeof(key));
+
+    return result;
+}
+#endif
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * NewTicketKey, RotateTicketKeys --
+ *
+ *      Generate a new ticket key and make it the current key. The
+ *      previous keys are kept for decrypting tickets issued before the
+ *      rotation.
+ *
+ * Results:
+ *      NewTicketKey returns NS_FALSE, when no random bytes are available.
+ *
+ * Side effects:
+ *      Updates the key ring; saves the state file when configured.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static bool
+NewTicketKey(TicketKey *keyPtr)
+{
+    keyPtr->created = time(NULL);
+    return (RAND_bytes(keyPtr->name, (int)sizeof(keyPtr->name)) == 1
+            && RAND_bytes(keyPtr->aesKey, (int)sizeof(keyPtr->aesKey)) == 1
+            && RAND_bytes(keyPtr->hmacKey, (int)sizeof(keyPtr->hmacKey)) == 1);
+}
+
+static void
+RotateTicketKeys(void *UNUSED(arg), int UNUSED(id))
+{
+    TicketKey key;
+
+    if (!NewTicketKey(&key)) {
+        Ns_Log(Error, "tls: could not generate new session ticket key");
+        return;
+    }
+
+    Ns_RWLockWrLock(&sessions.keyLock);
+    memmove(&sessions.keys[1], &sessions.keys[0], sizeof(TicketKey) * (TICKET_KEYS - 1));
+    sessions.keys[0] = key;
+    if (sessions.nrKeys < TICKET_KEYS) {
+        sessions.nrKeys++;
+    }
+    Ns_RWLockUnlock(&sessions.keyLock);
+    OPENSSL_cleanse(&key, sizeof(key));
+
+    Ns_Log(Notice, "tls: rotated session ticket keys");
+
+    if (sessions.stateFile != NULL) {
+        SaveState();
+    }
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SessionsShutdown --
+ *
+ *      Shutdown callback, persisting the state of the session store.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Writes the state file when configured.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+SessionsShutdown(const Ns_Time *UNUSED(toPtr), void *UNUSED(arg))
+{
+    if (sessions.stateFile != NULL) {
+        SaveState();
+    }
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SaveState, LoadState --
+ *
+ *      Persist and restore the ticket keys and the unexpired sessions.
+ *      The file contains secret key material; it is written with mode
+ *      0600 to a temporary file, which is renamed afterwards. The
+ *      format is a host-specific binary format, the file is not
+ *      intended to be shared between machines.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      File I/O; LoadState populates the key ring and the session store.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+SaveState(void)
+{
+    Tcl_DString ds;
+    FILE       *f;
+    int         fd, i;
+    time_t      now = time(NULL);
+    bool        success;
+
+    Tcl_DStringInit(&ds);
+    Ns_DStringPrintf(&ds, "%s.%d", sessions.stateFile, (int)nsconf.pid);
+
+    fd = ns_open(ds.string, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY | O_CLOEXEC, 0600);
+    f = (fd != NS_INVALID_FD) ? fdopen(fd, "wb") : NULL;
+    if (f == NULL) {
+        Ns_Log(Warning, "tls: could not write session state file '%s': %s",
+               ds.string, strerror(errno));
+        if (fd != NS_INVALID_FD) {
+            (void) ns_close(fd);
+        }
+        Tcl_DStringFree(&ds);
+        return;
+    }
+
+    Ns_RWLockRdLock(&sessions.keyLock);
+    success = (fwrite(STATE_FILE_MAGIC, sizeof(STATE_FILE_MAGIC) - 1u, 1u, f) == 1u
+               && fwrite(&sessions.nrKeys, sizeof(sessions.nrKeys), 1u, f) == 1u
+               && fwrite(sessions.keys, sizeof(TicketKey), (size_t)sessions.nrKeys, f) == (size_t)sessions.nrKeys);
+    Ns_RWLockUnlock(&sessions.keyLock);
+
+    for (i = 0; success && i < SESSION_SHARDS; i++) {
+        SessionShard   *shardPtr = &sessions.shards[i];
+        Tcl_HashEntry  *hPtr;
+        Tcl_HashSearch  search;
+
+        Ns_MutexLock(&shardPtr->lock);
+        for (hPtr = Tcl_FirstHashEntry(&shardPtr->table, &search);
+             success && hPtr != NULL;
+             hPtr = Tcl_NextHashEntry(&search)
+             ) {
+            const SessionKey   *keyPtr = (const SessionKey *)Tcl_GetHashKey(&shardPtr->table, hPtr);
+            const SessionEntry *entryPtr = Tcl_GetHashValue(hPtr);
+
+            if (entryPtr->expires > now) {
+                success = (fwrite(keyPtr, sizeof(SessionKey), 1u, f) == 1u
+                           && fwrite(&entryPtr->expires, sizeof(entryPtr->expires), 1u, f) == 1u
+                           && fwrite(&entryPtr->length, sizeof(entryPtr->length), 1u, f) == 1u
+                           && fwrite(entryPtr->der, entryPtr->length, 1u, f) == 1u);
+            }
+        }
+        Ns_MutexUnlock(&shardPtr->lock);
+    }
+
+    if (fclose(f) != 0) {
+        success = NS_FALSE;
+    }
+    if (success && rename(ds.string, sessions.stateFile) == 0) {
+        Ns_Log(Notice, "tls: saved session state to '%s'", sessions.stateFile);
+    } else {
+        Ns_Log(Warning, "tls: could not save session state to '%s': %s",
+               sessions.stateFile, strerror(errno));
+        (void) unlink(ds.string);
+    }
+    Tcl_DStringFree(&ds);
+}
+
+static void
+LoadState(void)
+{
+    FILE         *f;
+    char          magic[sizeof(STATE_FILE_MAGIC) - 1u];
+    int           nrKeys = 0, nrSessions = 0;
+    time_t        now = time(NULL);
+    SessionKey    key;
+    time_t        expires;
+    size_t        length;
+
+    f = fopen(sessions.stateFile, "rb");
+    if (f == NULL) {
+        if (errno != ENOENT) {
+            Ns_Log(Warning, "tls: could not read session state file '%s': %s",
+                   sessions.stateFile, strerror(errno));
+        }
+        return;
+    }
+
+    if (fread(magic, sizeof(magic), 1u, f) != 1u
+        || memcmp(magic, STATE_FILE_MAGIC, sizeof(magic)) != 0
+        || fread(&nrKeys, sizeof(nrKeys), 1u, f) != 1u
+        || nrKeys < 0 || nrKeys > TICKET_KEYS
+        || fread(sessions.keys, sizeof(TicketKey), (size_t)nrKeys, f) != (size_t)nrKeys
+        ) {
+        Ns_Log(Warning, "tls: ignore invalid session state file '%s'", sessions.stateFile);
+        memset(sessions.keys, 0, sizeof(sessions.keys));
+        (void) fclose(f);
+        return;
+    }
+    sessions.nrKeys = nrKeys;
+
+    while (fread(&key, sizeof(key), 1u, f) == 1u
+           && fread(&expires, sizeof(expires), 1u, f) == 1u
+           && fread(&length, sizeof(length), 1u, f) == 1u
+           && key.length <= SSL_MAX_SSL_SESSION_ID_LENGTH
+           && length > 0u && length < 65536u
+           ) {
+        unsigned char *der = ns_malloc(length);
+
+        if (fread(der, length, 1u, f) != 1u) {
+            ns_free(der);
+            break;
+        }
+        if (expires > now) {
+            StoreSession(&key, der, length, expires);
+            nrSessions++;
+        }
+        ns_free(der);
+    }
+    (void) fclose(f);
+
+    Ns_Log(Notice, "tls: loaded %d ticket keys and %d sessions from '%s'",
+           nrKeys, nrSessions, sessions.stateFile);
+}
+
+#endif /* HAVE_OPENSSL_EVP_H */
+
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 4
+ * fill-column: 78
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -49,6 +49,8 @@ static Ns_Callback FreeMount;
 static void FreeUrl2File(void *arg);
 static Ns_WalkProc WalkCallback;
 static Ns_ServerInitProc ConfigServerUrl2File;
+static Ns_ReturnCode UrlToFile(Tcl_DString *dsPtr, NsServer *servPtr, const char *url, bool allowTcl)
+    NS_GNUC_NONNULL(1,2,3);
 
 
 /*
@@ -212,9 +214,12 @@ Ns_FastUrl2FileProc(Tcl_DString *dsPtr, const char *url, const void *arg)
 /*
  *----------------------------------------------------------------------
  *
- * Ns_UrlToFile, NsUrlToFile --
+ * Ns_UrlToFile, NsUrlToFile, NsUrlToFileDirect --
  *
  *      Construct the filename that corresponds to a URL.
+ *      NsUrlToFileDirect() refuses mappings requiring a Tcl interpreter
+ *      (registered via ns_register_url2file), since it is used from
+ *      threads without an interpreter.
  *
  * Results:
  *      Return NS_OK on success or NS_ERROR on failure.
@@ -249,12 +254,28 @@ Ns_UrlToFile(Tcl_DString *dsPtr, const char *server, const char *url)
 Ns_ReturnCode
 NsUrlToFile(Tcl_DString *dsPtr, NsServer *servPtr, const char *url)
 {
-    Ns_ReturnCode status;
+    NS_NONNULL_ASSERT(dsPtr != NULL);
+    NS_NONNULL_ASSERT(servPtr != NULL);
+    NS_NONNULL_ASSERT(url != NULL);
 
+    return UrlToFile(dsPtr, servPtr, url, NS_TRUE);
+}
+
+Ns_ReturnCode
+NsUrlToFileDirect(Tcl_DString *dsPtr, NsServer *servPtr, const char *url)
+{
     NS_NONNULL_ASSERT(dsPtr != NULL);
     NS_NONNULL_ASSERT(servPtr != NULL);
     NS_NONNULL_ASSERT(url != NULL);
 
+    return UrlToFile(dsPtr, servPtr, url, NS_FALSE);
+}
+
+static Ns_ReturnCode
+UrlToFile(Tcl_DString *dsPtr, NsServer *servPtr, const char *url, bool allowTcl)
+{
+    Ns_ReturnCode status;
+
     if (servPtr->fastpath.url2file != NULL) {
         Ns_Log(Debug, "url2file: url '%s' use fastpath.url2file", url);
         status = (*servPtr->fastpath.url2file)(dsPtr, servPtr->server, url);
@@ -269,6 +290,8 @@ NsUrlToFile(Tcl_DString *dsPtr, NsServer *servPtr, const char *url)
         if (u2fPtr == NULL) {
             Ns_Log(Error, "url2file: no proc found for url: %s", url);
             status = NS_ERROR;
+        } else if (!allowTcl && u2fPtr->proc == NsTclUrl2FileProc) {
+            status = NS_ERROR;
         } else {
             ++u2fPtr->refcnt;
             Ns_MutexUnlock(&ulock);
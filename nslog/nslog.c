@@ -37,8 +37,21 @@ NS_EXTERN const int Ns_ModuleVersion;
 NS_EXPORT const int Ns_ModuleVersion = 1;
 static const char *logType = "ACCESSLOG";
 
+/*
+ * Per-thread buffer for log entries, used when "asyncflush" is
+ * configured. The lock of a buffer is only contended by the flusher thread.
+ */
+typedef struct LogBuffer {
+    struct LogBuffer *nextPtr;
+    Ns_Mutex          lock;
+    Tcl_DString       buffer;
+    int64_t           lines;
+    bool              orphaned;  /* The owning thread has exited */
+} LogBuffer;
+
 typedef struct {
     Ns_Mutex     lock;
+    Ns_RWLock    rwlock;         /* Lock around the format configuration */
     const char  *module;
     const char  *server;
     const char  *filename;
@@ -62,6 +75,26 @@ typedef struct {
 #endif
     Tcl_DString   buffer;
     bool serverRootProcEnabled;
+    struct {
+        bool       enabled;
+        int64_t    drop;         /* Overflow policy: drop entries instead of blocking (atomic) */
+        bool       stop;
+        bool       wakeup;
+        Ns_Tls     tls;          /* Per-thread LogBuffer */
+        Ns_Mutex   lock;         /* Lock around list of buffers and flusher state */
+        Ns_Cond    cond;         /* Wakeup of the flusher thread */
+        Ns_Cond    drained;      /* Signaled after every flush */
+        Ns_Thread  thread;
+        LogBuffer *firstPtr;
+        Ns_Time    interval;
+        size_t     flushsize;
+        int64_t    maxqueued;    /* Limit of "queued" (atomic) */
+        int64_t    queued;       /* Bytes buffered but not written (atomic) */
+        int64_t    queuedlines;  /* Lines buffered but not written (atomic) */
+        int64_t    dropped;      /* Dropped lines (atomic) */
+        int64_t    blocked;      /* Times a thread had to wait for the flusher (atomic) */
+        int64_t    flushes;      /* Number of flush operations (atomic) */
+    } async;
 } Log;
 
 /*
@@ -76,6 +109,15 @@ static Ns_TclTraceProc AddCmds;
 static TCL_OBJCMDPROC_T  LogObjCmd;
 
 static Ns_ReturnCode LogFlush(Log *logPtr, Tcl_DString *dsPtr);
+static Ns_ReturnCode LogFlushAll(Log *logPtr);
+static void LogAsyncAppend(Log *logPtr, const Tcl_DString *dsPtr)
+    NS_GNUC_NONNULL(1,2);
+static int64_t LogAsyncCollect(Log *logPtr, Tcl_DString *dsPtr)
+    NS_GNUC_NONNULL(1,2);
+static void LogAsyncStop(Log *logPtr)
+    NS_GNUC_NONNULL(1);
+static Ns_ThreadProc  LogFlusherThread;
+static Ns_TlsCleanup  LogBufferCleanup;
 static Ns_LogCallbackProc LogOpen;
 static Ns_LogCallbackProc LogClose;
 static Ns_LogCallbackProc LogRoll;
@@ -164,6 +206,8 @@ Ns_ModuleInit(const char *server, const char *module)
     logPtr->serverRootProcEnabled = Ns_ServerRootProcEnabled(server);
     Ns_MutexInit(&logPtr->lock);
     Ns_MutexSetName2(&logPtr->lock, "nslog", server);
+    Ns_RWLockInit(&logPtr->rwlock);
+    Ns_RWLockSetName2(&logPtr->rwlock, "rw:nslog", server);
     Tcl_DStringInit(&logPtr->buffer);
 
     section = Ns_ConfigSectionPath(NULL, server, module, NS_SENTINEL);
@@ -237,6 +281,36 @@ Ns_ModuleInit(const char *server, const char *module)
 #endif
     logPtr->driverPattern = ns_strcopy(Ns_NullIfEmpty(Ns_ConfigString(section, "driver", "")));
 
+    /*
+     * Asynchronous flushing: connection threads append entries to
+     * per-thread buffers, which are written by a flusher thread. This is
+     * not available with a serverrootproc, since the log file depends there
+     * on the request.
+     */
+    logPtr->async.enabled = (Ns_ConfigBool(section, "asyncflush", NS_FALSE)
+                             && !logPtr->serverRootProcEnabled);
+    if (logPtr->async.enabled) {
+        const char *overflow = Ns_ConfigString(section, "overflow", "block");
+
+        Ns_ConfigTimeUnitRange(section, "flushinterval", "1s", 0, 1000, INT_MAX, 0,
+                               &logPtr->async.interval);
+        logPtr->async.flushsize = (size_t)Ns_ConfigMemUnitRange(section, "flushsize", "64KB",
+                                                                64 * 1024, 1024, INT_MAX);
+        logPtr->async.maxqueued = (int64_t)Ns_ConfigMemUnitRange(section, "maxqueued", "4MB",
+                                                                 4 * 1024 * 1024, 1024, INT_MAX);
+        if (strcmp(overflow, "drop") == 0) {
+            logPtr->async.drop = 1;
+        } else if (strcmp(overflow, "block") != 0) {
+            Ns_Log(Warning, "nslog: invalid value '%s' for parameter 'overflow' "
+                   "(must be 'block' or 'drop'), using 'block'", overflow);
+        }
+        Ns_MutexInit(&logPtr->async.lock);
+        Ns_MutexSetName2(&logPtr->async.lock, "nslog:async", server);
+        Ns_CondInit(&logPtr->async.cond);
+        Ns_CondInit(&logPtr->async.drained);
+        Ns_TlsAlloc(&logPtr->async.tls, LogBufferCleanup);
+    }
+
     logPtr->ipv4maskPtr = NULL;
 #ifdef HAVE_IPV6
     logPtr->ipv6maskPtr = NULL;
@@ -294,6 +368,9 @@ Ns_ModuleInit(const char *server, const char *module)
     if (!logPtr->serverRootProcEnabled && LogOpen(logPtr) != NS_OK) {
         return NS_ERROR;
     }
+    if (logPtr->async.enabled) {
+        Ns_ThreadCreate(LogFlusherThread, logPtr, 0, &logPtr->async.thread);
+    }
 
     Ns_RegisterServerTrace(server, LogTrace, logPtr);
     Ns_RegisterAtShutdown(LogCloseCallback, logPtr);
@@ -460,11 +537,11 @@ LogObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_SIZE_T objc, Tcl_Obj *c
 
     enum {
         ROLLFMT, MAXBACKUP, MAXBUFFER, EXTHDRS,
-        FLAGS, FILE, ROLL
+        FLAGS, FILE, ROLL, STATS, MAXQUEUED, OVERFLOW
     };
     static const char *const subcmd[] = {
         "rollfmt", "maxbackup", "maxbuffer", "extendedheaders",
-        "flags", "file", "roll", NULL
+        "flags", "file", "roll", "stats", "maxqueued", "overflow", NULL
     };
 
     if (objc < 2) {
@@ -564,7 +641,7 @@ LogObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_SIZE_T objc, Tcl_Obj *c
             result = TCL_ERROR;
 
         } else {
-            Ns_MutexLock(&logPtr->lock);
+            Ns_RWLockWrLock(&logPtr->rwlock);
             if (headers != NULL) {
                 if (ParseExtendedHeaders(logPtr, headers) != NS_OK) {
                     Ns_TclPrintfResult(interp, "invalid header specification: '%s'", headers);
@@ -573,7 +650,7 @@ LogObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_SIZE_T objc, Tcl_Obj *c
             if (result == TCL_OK) {
                 Tcl_SetObjResult(interp, Tcl_NewStringObj(logPtr->extendedHeaders, TCL_INDEX_NONE));
             }
-            Ns_MutexUnlock(&logPtr->lock);
+            Ns_RWLockUnlock(&logPtr->rwlock);
         }
         break;
     }
@@ -618,13 +695,13 @@ LogObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_SIZE_T objc, Tcl_Obj *c
                 }
                 Tcl_DStringSetLength(&ds, 0);
 
-                Ns_MutexLock(&logPtr->lock);
+                Ns_RWLockWrLock(&logPtr->rwlock);
                 logPtr->flags = flags;
-                Ns_MutexUnlock(&logPtr->lock);
+                Ns_RWLockUnlock(&logPtr->rwlock);
             } else {
-                Ns_MutexLock(&logPtr->lock);
+                Ns_RWLockRdLock(&logPtr->rwlock);
                 flags = logPtr->flags;
-                Ns_MutexUnlock(&logPtr->lock);
+                Ns_RWLockUnlock(&logPtr->rwlock);
             }
 
             if ((flags & LOG_COMBINED)) {
@@ -713,7 +790,7 @@ LogObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_SIZE_T objc, Tcl_Obj *c
                     if (rc != 0) {
                         status = NS_ERROR;
                     } else {
-                        LogFlush(logPtr, &logPtr->buffer);
+                        (void) LogFlushAll(logPtr);
                         status = LogOpen(logPtr);
                     }
                 }
@@ -729,6 +806,99 @@ LogObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_SIZE_T objc, Tcl_Obj *c
         }
         break;
     }
+
+    case STATS: {
+        if (Ns_ParseObjv(NULL, NULL, interp, 2, objc, objv) != NS_OK) {
+            result = TCL_ERROR;
+
+        } else {
+            Tcl_Obj   *dictObj = Tcl_NewDictObj();
+            int64_t    buffers = 0;
+
+            if (logPtr->async.enabled) {
+                const LogBuffer *bufPtr;
+
+                Ns_MutexLock(&logPtr->async.lock);
+                for (bufPtr = logPtr->async.firstPtr; bufPtr != NULL; bufPtr = bufPtr->nextPtr) {
+                    buffers++;
+                }
+                Ns_MutexUnlock(&logPtr->async.lock);
+            }
+            Tcl_DictObjPut(NULL, dictObj, Tcl_NewStringObj("async", 5),
+                           Tcl_NewBooleanObj(logPtr->async.enabled));
+            Tcl_DictObjPut(NULL, dictObj, Tcl_NewStringObj("buffers", 7),
+                           Tcl_NewWideIntObj((Tcl_WideInt)buffers));
+            Tcl_DictObjPut(NULL, dictObj, Tcl_NewStringObj("queued", 6),
+                           Tcl_NewWideIntObj((Tcl_WideInt)NS_ATOMIC_LOAD(&logPtr->async.queued)));
+            Tcl_DictObjPut(NULL, dictObj, Tcl_NewStringObj("queuedlines", 11),
+                           Tcl_NewWideIntObj((Tcl_WideInt)NS_ATOMIC_LOAD(&logPtr->async.queuedlines)));
+            Tcl_DictObjPut(NULL, dictObj, Tcl_NewStringObj("maxqueued", 9),
+                           Tcl_NewWideIntObj((Tcl_WideInt)NS_ATOMIC_LOAD(&logPtr->async.maxqueued)));
+            Tcl_DictObjPut(NULL, dictObj, Tcl_NewStringObj("dropped", 7),
+                           Tcl_NewWideIntObj((Tcl_WideInt)NS_ATOMIC_LOAD(&logPtr->async.dropped)));
+            Tcl_DictObjPut(NULL, dictObj, Tcl_NewStringObj("blocked", 7),
+                           Tcl_NewWideIntObj((Tcl_WideInt)NS_ATOMIC_LOAD(&logPtr->async.blocked)));
+            Tcl_DictObjPut(NULL, dictObj, Tcl_NewStringObj("flushes", 7),
+                           Tcl_NewWideIntObj((Tcl_WideInt)NS_ATOMIC_LOAD(&logPtr->async.flushes)));
+            Tcl_SetObjResult(interp, dictObj);
+        }
+        break;
+    }
+
+    case MAXQUEUED: {
+        Tcl_WideInt       maxQueued = -1;
+        Ns_ObjvValueRange maxQueuedRange = {1024, INT_MAX};
+        Ns_ObjvSpec largs[] = {
+            {"?size", Ns_ObjvMemUnit, &maxQueued, &maxQueuedRange},
+            {NULL, NULL, NULL, NULL}
+        };
+
+        if (Ns_ParseObjv(NULL, largs, interp, 2, objc, objv) != NS_OK) {
+            result = TCL_ERROR;
+
+        } else {
+            if (maxQueued != -1) {
+                NS_ATOMIC_STORE(&logPtr->async.maxqueued, (int64_t)maxQueued);
+                /*
+                 * Let threads waiting for the flusher recheck the limit.
+                 */
+                if (logPtr->async.enabled) {
+                    Ns_MutexLock(&logPtr->async.lock);
+                    Ns_CondBroadcast(&logPtr->async.drained);
+                    Ns_MutexUnlock(&logPtr->async.lock);
+                }
+            }
+            Tcl_SetObjResult(interp, Tcl_NewWideIntObj(
+                                 (Tcl_WideInt)NS_ATOMIC_LOAD(&logPtr->async.maxqueued)));
+        }
+        break;
+    }
+
+    case OVERFLOW: {
+        int                 policy = -1;
+        static Ns_ObjvTable policies[] = {
+            {"block", 0u},
+            {"drop",  1u},
+            {NULL,    0u}
+        };
+        Ns_ObjvSpec largs[] = {
+            {"?policy", Ns_ObjvIndex, &policy, policies},
+            {NULL, NULL, NULL, NULL}
+        };
+
+        if (Ns_ParseObjv(NULL, largs, interp, 2, objc, objv) != NS_OK) {
+            result = TCL_ERROR;
+
+        } else {
+            if (policy != -1) {
+                NS_ATOMIC_STORE(&logPtr->async.drop, (int64_t)policy);
+            }
+            Tcl_SetObjResult(interp, Tcl_NewStringObj(
+                                 NS_ATOMIC_LOAD(&logPtr->async.drop) != 0 ? "drop" : "block",
+                                 TCL_INDEX_NONE));
+        }
+        break;
+    }
     }
     return result;
 }
@@ -834,7 +1004,7 @@ LogTrace(void *arg, Ns_Conn *conn)
         fd = logPtr->fd;
     }
 
-    Ns_MutexLock(&logPtr->lock);
+    Ns_RWLockRdLock(&logPtr->rwlock);
 
     /*
      * Append the peer address.
@@ -859,7 +1029,7 @@ LogTrace(void *arg, Ns_Conn *conn)
      * Check if the actual IP address can be converted to internal format (this
      * should be always possible).
      */
-    if ((logPtr->flags |= LOG_MASKIP)
+    if ((logPtr->flags & LOG_MASKIP) != 0u
         && (ns_inet_pton(ipPtr, p) == 1)
         ) {
 
@@ -1040,7 +1210,15 @@ LogTrace(void *arg, Ns_Conn *conn)
      */
 
     Tcl_DStringAppend(dsPtr, "\n", 1);
+    Ns_RWLockUnlock(&logPtr->rwlock);
+
+    if (logPtr->async.enabled) {
+        LogAsyncAppend(logPtr, dsPtr);
+        Tcl_DStringFree(dsPtr);
+        return;
+    }
 
+    Ns_MutexLock(&logPtr->lock);
     if (logPtr->maxlines == 0) {
         bufferSize = (size_t)dsPtr->length;
         if (bufferSize < PIPE_BUF) {
@@ -1155,7 +1333,7 @@ LogClose(void *arg)
     }
 
     if (logPtr->fd >= 0) {
-        status = LogFlush(logPtr, &logPtr->buffer);
+        status = LogFlushAll(logPtr);
         ns_close(logPtr->fd);
         logPtr->fd = NS_INVALID_FD;
         Tcl_DStringFree(&logPtr->buffer);
@@ -1202,6 +1380,300 @@ LogFlush(Log *logPtr, Tcl_DString *dsPtr)
     return (logPtr->fd == NS_INVALID_FD) ? NS_ERROR : NS_OK;
 }
 
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * LogFlushAll --
+ *
+ *      Flush the log buffer and, when "asyncflush" is configured, the
+ *      entries pending in the per-thread buffers to the open log file.
+ *      Assume caller is holding the log mutex.
+ *
+ * Results:
+ *      NS_OK or NS_ERROR.
+ *
+ * Side effects:
+ *      See LogFlush.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Ns_ReturnCode
+LogFlushAll(Log *logPtr)
+{
+    Ns_ReturnCode status = LogFlush(logPtr, &logPtr->buffer);
+
+    if (logPtr->async.enabled) {
+        Tcl_DString ds;
+        int64_t     lines;
+
+        Tcl_DStringInit(&ds);
+        lines = LogAsyncCollect(logPtr, &ds);
+        if (lines > 0) {
+            TCL_SIZE_T length = ds.length;
+
+            status = LogFlush(logPtr, &ds);
+            (void) NS_ATOMIC_FETCH_ADD(&logPtr->async.queued, -(int64_t)length);
+            (void) NS_ATOMIC_FETCH_ADD(&logPtr->async.queuedlines, -lines);
+        }
+        Tcl_DStringFree(&ds);
+    }
+    return status;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * LogAsyncAppend --
+ *
+ *      Append a formatted log entry to the buffer of the current thread.
+ *      When the amount of not yet written data exceeds "maxqueued", the
+ *      entry is either dropped or the thread waits for the flusher
+ *      thread, depending on the "overflow" policy.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Might create the buffer of the current thread and wake up the
+ *      flusher thread.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+LogAsyncAppend(Log *logPtr, const Tcl_DString *dsPtr)
+{
+    LogBuffer *bufPtr;
+    int64_t    length = (int64_t)dsPtr->length;
+    bool       wakeup;
+
+    bufPtr = Ns_TlsGet(&logPtr->async.tls);
+    if (unlikely(bufPtr == NULL)) {
+        bufPtr = ns_calloc(1u, sizeof(LogBuffer));
+        Ns_MutexInit(&bufPtr->lock);
+        Ns_MutexSetName2(&bufPtr->lock, "nslog:buffer", logPtr->server);
+        Tcl_DStringInit(&bufPtr->buffer);
+        Ns_TlsSet(&logPtr->async.tls, bufPtr);
+
+        Ns_MutexLock(&logPtr->async.lock);
+        bufPtr->nextPtr = logPtr->async.firstPtr;
+        logPtr->async.firstPtr = bufPtr;
+        Ns_MutexUnlock(&logPtr->async.lock);
+    }
+
+    if (NS_ATOMIC_LOAD(&logPtr->async.queued) + length > NS_ATOMIC_LOAD(&logPtr->async.maxqueued)
+        && NS_ATOMIC_LOAD(&logPtr->async.queued) > 0) {
+
+        if (NS_ATOMIC_LOAD(&logPtr->async.drop) != 0) {
+            (void) NS_ATOMIC_FETCH_ADD(&logPtr->async.dropped, 1);
+            return;
+        }
+        (void) NS_ATOMIC_FETCH_ADD(&logPtr->async.blocked, 1);
+
+        Ns_MutexLock(&logPtr->async.lock);
+        while (!logPtr->async.stop
+               && NS_ATOMIC_LOAD(&logPtr->async.queued) > 0
+               && NS_ATOMIC_LOAD(&logPtr->async.queued) + length > NS_ATOMIC_LOAD(&logPtr->async.maxqueued)) {
+            Ns_Time timeout;
+
+            logPtr->async.wakeup = NS_TRUE;
+            Ns_CondSignal(&logPtr->async.cond);
+            Ns_GetTime(&timeout);
+            Ns_IncrTime(&timeout, 0, 100000);
+            (void) Ns_CondTimedWait(&logPtr->async.drained, &logPtr->async.lock, &timeout);
+        }
+        Ns_MutexUnlock(&logPtr->async.lock);
+    }
+
+    Ns_MutexLock(&bufPtr->lock);
+    Tcl_DStringAppend(&bufPtr->buffer, dsPtr->string, dsPtr->length);
+    bufPtr->lines++;
+    wakeup = ((size_t)bufPtr->buffer.length >= logPtr->async.flushsize);
+    Ns_MutexUnlock(&bufPtr->lock);
+
+    (void) NS_ATOMIC_FETCH_ADD(&logPtr->async.queued, length);
+    (void) NS_ATOMIC_FETCH_ADD(&logPtr->async.queuedlines, 1);
+
+    if (wakeup) {
+        Ns_MutexLock(&logPtr->async.lock);
+        logPtr->async.wakeup = NS_TRUE;
+        Ns_CondSignal(&logPtr->async.cond);
+        Ns_MutexUnlock(&logPtr->async.lock);
+    }
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * LogAsyncCollect --
+ *
+ *      Move the contents of all per-thread buffers into the provided
+ *      Tcl_DString. Buffers of exited threads are freed.
+ *
+ * Results:
+ *      Number of collected lines.
+ *
+ * Side effects:
+ *      Per-thread buffers are emptied.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int64_t
+LogAsyncCollect(Log *logPtr, Tcl_DString *dsPtr)
+{
+    LogBuffer **bufPtrPtr;
+    int64_t     lines = 0;
+
+    Ns_MutexLock(&logPtr->async.lock);
+    bufPtrPtr = &logPtr->async.firstPtr;
+    while (*bufPtrPtr != NULL) {
+        LogBuffer *bufPtr = *bufPtrPtr;
+        bool       orphaned;
+
+        Ns_MutexLock(&bufPtr->lock);
+        if (bufPtr->buffer.length > 0) {
+            Tcl_DStringAppend(dsPtr, bufPtr->buffer.string, bufPtr->buffer.length);
+            Tcl_DStringSetLength(&bufPtr->buffer, 0);
+            lines += bufPtr->lines;
+            bufPtr->lines = 0;
+        }
+        orphaned = bufPtr->orphaned;
+        Ns_MutexUnlock(&bufPtr->lock);
+
+        if (orphaned) {
+            *bufPtrPtr = bufPtr->nextPtr;
+            Tcl_DStringFree(&bufPtr->buffer);
+            Ns_MutexDestroy(&bufPtr->lock);
+            ns_free(bufPtr);
+        } else {
+            bufPtrPtr = &bufPtr->nextPtr;
+        }
+    }
+    Ns_MutexUnlock(&logPtr->async.lock);
+
+    return lines;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * LogBufferCleanup --
+ *
+ *      TLS cleanup callback, called on thread exit. Mark the buffer of the
+ *      thread as orphaned; the buffer is written and freed by the next
+ *      flush.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+LogBufferCleanup(void *arg)
+{
+    LogBuffer *bufPtr = arg;
+
+    Ns_MutexLock(&bufPtr->lock);
+    bufPtr->orphaned = NS_TRUE;
+    Ns_MutexUnlock(&bufPtr->lock);
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * LogFlusherThread --
+ *
+ *      Background thread writing the per-thread buffers to the log file
+ *      every "flushinterval", or earlier, when a thread buffer exceeds
+ *      "flushsize" or a thread waits for free space.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Writes to the log file.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+LogFlusherThread(void *arg)
+{
+    Log *logPtr = arg;
+
+    Ns_ThreadSetName("-nslog:%s-", logPtr->server);
+    Ns_Log(Notice, "nslog: flusher thread started (flushinterval " NS_TIME_FMT ")",
+           (int64_t)logPtr->async.interval.sec, logPtr->async.interval.usec);
+
+    Ns_MutexLock(&logPtr->async.lock);
+    while (!logPtr->async.stop) {
+        if (!logPtr->async.wakeup) {
+            Ns_Time timeout;
+
+            Ns_GetTime(&timeout);
+            Ns_IncrTime(&timeout, logPtr->async.interval.sec, logPtr->async.interval.usec);
+            (void) Ns_CondTimedWait(&logPtr->async.cond, &logPtr->async.lock, &timeout);
+        }
+        logPtr->async.wakeup = NS_FALSE;
+        Ns_MutexUnlock(&logPtr->async.lock);
+
+        Ns_MutexLock(&logPtr->lock);
+        (void) LogFlushAll(logPtr);
+        Ns_MutexUnlock(&logPtr->lock);
+        (void) NS_ATOMIC_FETCH_ADD(&logPtr->async.flushes, 1);
+
+        Ns_MutexLock(&logPtr->async.lock);
+        Ns_CondBroadcast(&logPtr->async.drained);
+    }
+    Ns_MutexUnlock(&logPtr->async.lock);
+
+    Ns_Log(Notice, "nslog: flusher thread exits");
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * LogAsyncStop --
+ *
+ *      Stop the flusher thread and wait for its termination. Entries
+ *      still pending are written by LogClose().
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Joins the flusher thread.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+LogAsyncStop(Log *logPtr)
+{
+    if (logPtr->async.enabled && logPtr->async.thread != NULL) {
+        Ns_MutexLock(&logPtr->async.lock);
+        logPtr->async.stop = NS_TRUE;
+        Ns_CondSignal(&logPtr->async.cond);
+        Ns_CondBroadcast(&logPtr->async.drained);
+        Ns_MutexUnlock(&logPtr->async.lock);
+
+        Ns_ThreadJoin(&logPtr->async.thread, NULL);
+        logPtr->async.thread = NULL;
+    }
+}
+
 
 /*
  *----------------------------------------------------------------------
@@ -1281,6 +1753,7 @@ static void
 LogCloseCallback(const Ns_Time *toPtr, void *arg)
 {
     if (toPtr == NULL) {
+        LogAsyncStop(arg);
         LogCallbackProc(LogClose, arg, "close");
     }
 }
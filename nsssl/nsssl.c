@@ -44,6 +44,8 @@ NS_EXPORT const int Ns_ModuleVersion = 1;
 typedef struct {
     SSL         *ssl;
     int          verified;
+    bool         handshakeChecked; /* resumption and kTLS state were determined after handshake */
+    bool         ktls;             /* kernel TLS is active for sending */
 } NssslSockCtx;
 
 /*
@@ -54,12 +56,18 @@ static Ns_DriverListenProc Listen;
 static Ns_DriverAcceptProc Accept;
 static Ns_DriverRecvProc Recv;
 static Ns_DriverSendProc Send;
+static Ns_DriverSendFileProc SendFile;
 static Ns_DriverKeepProc Keep;
 static Ns_DriverConnInfoProc ConnInfo;
 static Ns_DriverClientcertInfoProc ClientcertInfo;
 static Ns_DriverCloseProc Close;
 static Ns_DriverClientInitProc ClientInit;
 
+#if defined(SSL_OP_ENABLE_KTLS)
+static ssize_t SendFileKTLS(Ns_Sock *sock, NssslSockCtx *sslCtx, Ns_FileVec *bufs, int nbufs)
+    NS_GNUC_NONNULL(1,2,3);
+#endif
+
 /*
  * Static variables defined in this file.
  */
@@ -101,6 +109,13 @@ Ns_ModuleInit(const char *server, const char *module)
     dc->u.h1.nodelay       = Ns_ConfigBool(section, "nodelay", NS_TRUE);
     dc->u.h1.h3advertise   = Ns_ConfigBool(section, "h3advertise", NS_FALSE);
     dc->u.h1.h3persist     = Ns_ConfigBool(section, "h3persist", NS_FALSE);
+    dc->u.h1.ktls          = Ns_ConfigBool(section, "ktls", NS_FALSE);
+#if !defined(SSL_OP_ENABLE_KTLS)
+    if (dc->u.h1.ktls) {
+        Ns_Log(Warning, "nsssl: kernel TLS is not supported by this version of OpenSSL");
+        dc->u.h1.ktls = NS_FALSE;
+    }
+#endif
 
     init.version = NS_DRIVER_VERSION_6;
     init.name = "nsssl";
@@ -108,7 +123,7 @@ Ns_ModuleInit(const char *server, const char *module)
     init.acceptProc = Accept;
     init.recvProc = Recv;
     init.sendProc = Send;
-    init.sendFileProc = NULL;
+    init.sendFileProc = SendFile;
     init.keepProc = Keep;
     init.connInfoProc = ConnInfo;
     init.clientcertInfoProc = ClientcertInfo;
@@ -276,6 +291,15 @@ Accept(Ns_Sock *sock, NS_SOCKET listensock, struct sockaddr *sockaddrPtr, sockle
 
             SSL_set_fd(sslCtx->ssl, sock->sock);
             SSL_set_accept_state(sslCtx->ssl);
+#if defined(SSL_OP_ENABLE_KTLS)
+            if (dc->u.h1.ktls) {
+                /*
+                 * OpenSSL activates kTLS after the handshake, when the
+                 * kernel supports the negotiated cipher.
+                 */
+                SSL_set_options(sslCtx->ssl, SSL_OP_ENABLE_KTLS);
+            }
+#endif
 
             port = Ns_SockGetPort(sock); /* precise local port */
             if ((unsigned short)(((Driver *)(sock->driver))->listenfd[0]) != port) {
@@ -372,6 +396,32 @@ Recv(Ns_Sock *sock, struct iovec *bufs, int nbufs,
 #endif
         sslCtx->verified = 1;
     }
+
+    /*
+     * Once after the handshake, count session resumptions and determine,
+     * whether kTLS is active for sending.
+     */
+    if (!sslCtx->handshakeChecked
+        && nRead > -1
+        && SSL_is_init_finished(sslCtx->ssl)
+        ) {
+        Driver *drvPtr = (Driver *)sock->driver;
+        int     resumed = NsTLSResumptionStatus(sslCtx->ssl);
+
+        sslCtx->handshakeChecked = NS_TRUE;
+        if (resumed == 1) {
+            (void) NS_ATOMIC_FETCH_ADD(&drvPtr->stats.resumptions, 1);
+        } else if (resumed == -1) {
+            (void) NS_ATOMIC_FETCH_ADD(&drvPtr->stats.resumptionmisses, 1);
+        }
+#if defined(SSL_OP_ENABLE_KTLS)
+        if (dc->u.h1.ktls && BIO_get_ktls_send(SSL_get_wbio(sslCtx->ssl))) {
+            sslCtx->ktls = NS_TRUE;
+            (void) NS_ATOMIC_FETCH_ADD(&drvPtr->stats.ktls, 1);
+        }
+#endif
+        Ns_Log(Debug, "nsssl: sock %d resumed %d kTLS send %d", sock->sock, resumed, sslCtx->ktls);
+    }
     Ns_SockSetReceiveState(sock, sockState, sslERRcode);
 
     return nRead;
@@ -405,73 +455,89 @@ Send(Ns_Sock *sock, const struct iovec *bufs, int nbufs, unsigned int UNUSED(fla
                sock->sock);
         sent = -1;
     } else {
-        bool decork = Ns_SockCork(sock, NS_TRUE);
+        bool   decork = Ns_SockCork(sock, NS_TRUE);
+        size_t offset = 0u;
+        char   staging[NS_TLS_MAX_RECORD_SIZE];
 
         while (nbufs > 0) {
-            if (bufs->iov_len > 0) {
-                int rc;
-
-                ERR_clear_error();
-                (void)Ns_SockFlagClear(sock, NS_CONN_SSL_WANT_WRITE);
-
-                if (Ns_SockGetSendRejected(sock)) {
-                    ssize_t lastSend = Ns_SockGetSendRejected(sock);
-                    Ns_Log(Notice, "nsssl send: sock (%d,%ld) last send %ld rejected,"
-                           " try again base %p len %ld errorCode last %.8lx",
-                           sock->sock, Ns_SockGetSendCount(sock), lastSend,
-                           bufs->iov_base, bufs->iov_len, Ns_SockGetSendErrno(sock));
-                    if ((size_t)lastSend != bufs->iov_len) {
-                        Ns_Log(Notice, "nsssl send: sock (%d,%ld) last send %ld now %ld: expect error!",
-                               sock->sock, Ns_SockGetSendCount(sock), lastSend, bufs->iov_len);
-                    }
-                }
+            const char *data = (const char *)bufs->iov_base + offset;
+            size_t      length = bufs->iov_len - offset;
+            int         rc;
 
-                rc = SSL_write(sslCtx->ssl, bufs->iov_base, (int)bufs->iov_len);
-                if (rc <= 0) {
-                    int           sslerr    = SSL_get_error(sslCtx->ssl, rc);
-                    unsigned long errorCode = ERR_get_error();
-
-                    /*fprintf(stderr,
-                      "### SSL_write sock(%s): %p len %d rc %d SSL_get_error => %d: %s\n",
-                      sock->sock,
-                      (void*)bufs->iov_base, (int)bufs->iov_len,
-                      rc, sslerr, ERR_error_string(ERR_get_error(), NULL));*/
-
-                    if (sslerr == SSL_ERROR_WANT_WRITE) {
-
-                        /*
-                         * Effectively, SSL_ERROR_WANT_WRITE at this place
-                         * means we are against EWOULDBLOCK, so exit early,
-                         * reporting so much bytes sent as we did so far.
-                         */
-                        (void)Ns_SockFlagAdd(sock, NS_CONN_SSL_WANT_WRITE);
-                        break;
-                    }
-
-                    Ns_Log(Debug, "... errorCode %.8lx ERR_GET_LIB %d ERR_LIB_SYS %d",
-                           errorCode, ERR_GET_LIB(errorCode), ERR_LIB_SYS);
-
-                    if (ERR_GET_LIB(errorCode) == ERR_LIB_SYS) {
-                        Ns_Log(Debug, "...... reason %d", ERR_GET_REASON(errorCode));
-                        Ns_SockSetSendErrno(sock, (unsigned long)ERR_GET_REASON(errorCode));
-                    } else {
-                        Ns_SockSetSendErrno(sock, errorCode);
-                    }
+            if (length == 0u) {
+                nbufs = NsTLSAdvanceBufs(&bufs, nbufs, &offset, 0u);
+                continue;
+            }
 
-                    SSL_set_shutdown(sslCtx->ssl, SSL_RECEIVED_SHUTDOWN);
-                    sent = -1;
+            /*
+             * Gather small buffers (e.g. header, body and chunk framing)
+             * into a single TLS record instead of writing one record per
+             * buffer.
+             */
+            if (nbufs > 1 && length < sizeof(staging)) {
+                length = NsTLSGatherBufs(staging, sizeof(staging), bufs, nbufs, offset);
+                data = staging;
+            }
 
-                    break; /* Any other error case is terminal */
+            ERR_clear_error();
+            (void)Ns_SockFlagClear(sock, NS_CONN_SSL_WANT_WRITE);
+
+            if (Ns_SockGetSendRejected(sock)) {
+                ssize_t lastSend = Ns_SockGetSendRejected(sock);
+                Ns_Log(Notice, "nsssl send: sock (%d,%ld) last send %ld rejected,"
+                       " try again base %p len %ld errorCode last %.8lx",
+                       sock->sock, Ns_SockGetSendCount(sock), lastSend,
+                       (const void *)data, length, Ns_SockGetSendErrno(sock));
+                if ((size_t)lastSend != length) {
+                    Ns_Log(Notice, "nsssl send: sock (%d,%ld) last send %ld now %ld: expect error!",
+                           sock->sock, Ns_SockGetSendCount(sock), lastSend, length);
                 }
-                sent += (ssize_t)rc;
-                if (rc < (int)bufs->iov_len) {
-                    Ns_Log(Debug, "SSL: partial write, wanted %" PRIuz " wrote %d",
-                           bufs->iov_len, rc);
+            }
+
+            rc = SSL_write(sslCtx->ssl, data, (int)length);
+            if (rc <= 0) {
+                int           sslerr    = SSL_get_error(sslCtx->ssl, rc);
+                unsigned long errorCode = ERR_get_error();
+
+                /*fprintf(stderr,
+                  "### SSL_write sock(%s): %p len %d rc %d SSL_get_error => %d: %s\n",
+                  sock->sock,
+                  (void*)data, (int)length,
+                  rc, sslerr, ERR_error_string(ERR_get_error(), NULL));*/
+
+                if (sslerr == SSL_ERROR_WANT_WRITE) {
+
+                    /*
+                     * Effectively, SSL_ERROR_WANT_WRITE at this place
+                     * means we are against EWOULDBLOCK, so exit early,
+                     * reporting so much bytes sent as we did so far.
+                     */
+                    (void)Ns_SockFlagAdd(sock, NS_CONN_SSL_WANT_WRITE);
                     break;
                 }
+
+                Ns_Log(Debug, "... errorCode %.8lx ERR_GET_LIB %d ERR_LIB_SYS %d",
+                       errorCode, ERR_GET_LIB(errorCode), ERR_LIB_SYS);
+
+                if (ERR_GET_LIB(errorCode) == ERR_LIB_SYS) {
+                    Ns_Log(Debug, "...... reason %d", ERR_GET_REASON(errorCode));
+                    Ns_SockSetSendErrno(sock, (unsigned long)ERR_GET_REASON(errorCode));
+                } else {
+                    Ns_SockSetSendErrno(sock, errorCode);
+                }
+
+                SSL_set_shutdown(sslCtx->ssl, SSL_RECEIVED_SHUTDOWN);
+                sent = -1;
+
+                break; /* Any other error case is terminal */
+            }
+            sent += (ssize_t)rc;
+            if ((size_t)rc < length) {
+                Ns_Log(Debug, "SSL: partial write, wanted %" PRIuz " wrote %d",
+                       length, rc);
+                break;
             }
-            nbufs--;
-            bufs++;
+            nbufs = NsTLSAdvanceBufs(&bufs, nbufs, &offset, (size_t)rc);
         }
 
         if (decork) {
@@ -483,6 +549,123 @@ Send(Ns_Sock *sock, const struct iovec *bufs, int nbufs, unsigned int UNUSED(fla
 }
 
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * SendFile --
+ *
+ *      Send given file buffers. When kernel TLS is active for the
+ *      connection, file ranges are sent via SSL_sendfile(), which lets the
+ *      kernel encrypt the data without copying it through user space.
+ *      Otherwise, the file content is read and sent via SSL_write().
+ *
+ * Results:
+ *      Total number of bytes sent, -1 on error.
+ *      May return 0 (zero) if socket is not writable.
+ *
+ * Side effects:
+ *      May block on disk IO.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static ssize_t
+SendFile(Ns_Sock *sock, Ns_FileVec *bufs, int nbufs, unsigned int flags)
+{
+    ssize_t sent;
+#if defined(SSL_OP_ENABLE_KTLS)
+    NssslSockCtx *sslCtx = sock->arg;
+
+    if (sslCtx != NULL && sslCtx->ktls) {
+        sent = SendFileKTLS(sock, sslCtx, bufs, nbufs);
+    } else {
+        sent = Ns_SockSendFileBufs(sock, bufs, nbufs, flags);
+    }
+#else
+    sent = Ns_SockSendFileBufs(sock, bufs, nbufs, flags);
+#endif
+    return sent;
+}
+
+#if defined(SSL_OP_ENABLE_KTLS)
+/*
+ *----------------------------------------------------------------------
+ *
+ * SendFileKTLS --
+ *
+ *      Send given file buffers on a connection with active kernel TLS.
+ *      Memory buffers are sent via Send(), file ranges via SSL_sendfile().
+ *
+ * Results:
+ *      Total number of bytes sent, -1 on error.
+ *      May return 0 (zero) if socket is not writable.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static ssize_t
+SendFileKTLS(Ns_Sock *sock, NssslSockCtx *sslCtx, Ns_FileVec *bufs, int nbufs)
+{
+    ssize_t nwrote = 0;
+    int     i;
+    bool    decork = Ns_SockCork(sock, NS_TRUE);
+
+    for (i = 0; i < nbufs; i++) {
+        size_t  length = bufs[i].length;
+        ssize_t sent;
+
+        if (length == 0u) {
+            continue;
+        }
+
+        if (bufs[i].fd == NS_INVALID_FD) {
+            struct iovec iov;
+
+            (void) Ns_SetVec(&iov, 0, bufs[i].buffer + bufs[i].offset, length);
+            sent = Send(sock, &iov, 1, 0u);
+
+        } else {
+            ERR_clear_error();
+            (void)Ns_SockFlagClear(sock, NS_CONN_SSL_WANT_WRITE);
+
+            sent = (ssize_t)SSL_sendfile(sslCtx->ssl, bufs[i].fd, bufs[i].offset, length, 0);
+            if (sent < 0) {
+                int sslerr = SSL_get_error(sslCtx->ssl, (int)sent);
+
+                if (sslerr == SSL_ERROR_WANT_WRITE) {
+                    (void)Ns_SockFlagAdd(sock, NS_CONN_SSL_WANT_WRITE);
+                    sent = 0;
+                } else {
+                    Ns_Log(Debug, "nsssl: SSL_sendfile on sock %d failed: %s",
+                           sock->sock, ERR_error_string(ERR_get_error(), NULL));
+                    Ns_SockSetSendErrno(sock, (unsigned long)errno);
+                    SSL_set_shutdown(sslCtx->ssl, SSL_RECEIVED_SHUTDOWN);
+                }
+            }
+        }
+
+        if (sent == -1) {
+            nwrote = -1;
+            break;
+        }
+        nwrote += sent;
+        if ((size_t)sent < length) {
+            break;
+        }
+    }
+
+    if (decork) {
+        Ns_SockCork(sock, NS_FALSE);
+    }
+
+    return nwrote;
+}
+#endif
+
+
 /*
  *----------------------------------------------------------------------
  *
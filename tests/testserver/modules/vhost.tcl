@@ -50,6 +50,18 @@ if {"testvhost2" ne [ns_info server] } {
 ns_serverrootproc nstest::serverroot arg
 ns_locationproc   nstest::location arg
 
+#
+# Procs for testing the configured "compressformats".
+#
+ns_register_proc GET /compress {
+    ns_return 200 text/plain [string repeat [ns_queryget data "Hello World!"] [ns_queryget repeat 1]] ;#}
+
+ns_register_proc GET /compress-stream {
+    ns_headers 200 text/plain
+    foreach i {1 2 3} {
+        ns_write [string repeat "this is a test\n" 100]
+    } ;#}
+
 proc nstest::serverroot {{host ""} args} {
     if {$host ne "" } {
         set path [eval file join testserverroot $host $args]